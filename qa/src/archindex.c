@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * Temporal index exerciser and archive-open benchmark.
+ *
+ * Usage: archindex -c [-i interval] [-n nrec] archive
+ *	  archindex [-q] [-n nrec] [-r repeat] archive
+ *
+ * With -c, create an archive of nrec records of one metric, one second
+ * apart, with a temporal index entry every interval records (default 1,
+ * so the index is as large as it can be).  Record i has the value i.
+ *
+ * Otherwise, time opening the archive (repeat times), then position at
+ * and between every record, forwards and backwards, checking that the
+ * next record fetched is the right one.  With -q the elapsed time is not
+ * reported (output is deterministic, suitable for QA).
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define START	1000000000	/* archive start time, in seconds */
+
+static int	interval = 1;
+static int	nrec = 10000;
+static int	repeat = 10;
+static int	quiet;
+
+static int
+create(const char *archive)
+{
+    __pmLogCtl		logctl;
+    __pmArchCtl		archctl;
+    __pmPDU		*pdp;
+    pmResult		*rp;
+    pmValueSet		*vsp;
+    pmDesc		desc;
+    pmTimeval		stamp;
+    char		*name = "archindex.value";
+    int			i, sts;
+
+    memset(&logctl, 0, sizeof(logctl));
+    memset(&archctl, 0, sizeof(archctl));
+    archctl.ac_log = &logctl;
+    if ((sts = __pmLogCreate("qatest", archive, PM_LOG_VERS02, &archctl)) != 0) {
+	fprintf(stderr, "%s: __pmLogCreate failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	return sts;
+    }
+    logctl.l_state = PM_LOG_STATE_INIT;
+    logctl.l_label.ill_pid = 1234;
+    logctl.l_label.ill_start.tv_sec = START;
+    logctl.l_label.ill_start.tv_usec = 0;
+    strcpy(logctl.l_label.ill_hostname, "happycamper");
+    strcpy(logctl.l_label.ill_tz, "UTC");
+    logctl.l_label.ill_vol = PM_LOG_VOL_TI;
+    __pmLogWriteLabel(logctl.l_tifp, &logctl.l_label);
+    logctl.l_label.ill_vol = PM_LOG_VOL_META;
+    __pmLogWriteLabel(logctl.l_mdfp, &logctl.l_label);
+    logctl.l_label.ill_vol = 0;
+    __pmLogWriteLabel(archctl.ac_mfp, &logctl.l_label);
+
+    memset(&desc, 0, sizeof(desc));
+    desc.pmid = pmID_build(245, 0, 1);
+    desc.type = PM_TYPE_32;
+    desc.indom = PM_INDOM_NULL;
+    desc.sem = PM_SEM_INSTANT;
+    if ((sts = __pmLogPutDesc(&archctl, &desc, 1, &name)) < 0) {
+	fprintf(stderr, "%s: __pmLogPutDesc failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	return sts;
+    }
+
+    rp = (pmResult *)calloc(1, sizeof(pmResult));
+    vsp = (pmValueSet *)calloc(1, sizeof(pmValueSet));
+    if (rp == NULL || vsp == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	return -ENOMEM;
+    }
+    rp->numpmid = 1;
+    rp->vset[0] = vsp;
+    vsp->pmid = desc.pmid;
+    vsp->numval = 1;
+    vsp->valfmt = PM_VAL_INSITU;
+    vsp->vlist[0].inst = PM_IN_NULL;
+
+    for (i = 0; i < nrec; i++) {
+	stamp.tv_sec = START + i;
+	stamp.tv_usec = 0;
+	rp->timestamp.tv_sec = stamp.tv_sec;
+	rp->timestamp.tv_usec = stamp.tv_usec;
+	vsp->vlist[0].value.lval = i;
+	if (i % interval == 0)
+	    __pmLogPutIndex(&archctl, &stamp);
+	__pmOverrideLastFd(__pmFileno(archctl.ac_mfp));
+	if ((sts = __pmEncodeResult(__pmFileno(archctl.ac_mfp), rp, &pdp)) < 0) {
+	    fprintf(stderr, "%s: __pmEncodeResult failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	    return sts;
+	}
+	if ((sts = __pmLogPutResult2(&archctl, pdp)) < 0) {
+	    fprintf(stderr, "%s: __pmLogPutResult2 failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	    return sts;
+	}
+	__pmUnpinPDUBuf(pdp);
+    }
+    __pmLogPutIndex(&archctl, &stamp);
+
+    __pmFclose(archctl.ac_mfp);
+    __pmFclose(logctl.l_mdfp);
+    __pmFclose(logctl.l_tifp);
+    printf("created %d records, %d index entries\n",
+	    nrec, 2 + (nrec - 1) / interval);
+    return 0;
+}
+
+/*
+ * Position at t (in tenths of a second from the start) in the given
+ * direction, and return the value of the next record, or -1 for none.
+ */
+static int
+probe(int t, int mode)
+{
+    struct timeval	when;
+    pmResult		*rp;
+    int			sec, sts, value = -1;
+
+    sec = t >= 0 ? t / 10 : -((9 - t) / 10);
+    when.tv_sec = START + sec;
+    when.tv_usec = (t - sec * 10) * 100000;
+    if ((sts = pmSetMode(mode, &when, 0)) < 0) {
+	fprintf(stderr, "%s: pmSetMode failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	return -2;
+    }
+    if ((sts = pmFetchArchive(&rp)) < 0)
+	return sts == PM_ERR_EOL ? -1 : -2;
+    if (rp->numpmid == 1 && rp->vset[0]->numval == 1)
+	value = rp->vset[0]->vlist[0].value.lval;
+    else
+	value = -2;
+    pmFreeResult(rp);
+    return value;
+}
+
+static int
+check(const char *archive)
+{
+    struct timeval	start, end;
+    int			ctx = -1, i, t, want, got;
+    int			nprobe = 0, errors = 0;
+
+    pmtimevalNow(&start);
+    for (i = 0; i < repeat; i++) {
+	if (ctx >= 0)
+	    pmDestroyContext(ctx);
+	if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	    fprintf(stderr, "%s: pmNewContext(%s): %s\n",
+		    pmGetProgname(), archive, pmErrStr(ctx));
+	    return 1;
+	}
+    }
+    pmtimevalNow(&end);
+    if (!quiet)
+	printf("open: %.6f sec\n", pmtimevalSub(&end, &start) / repeat);
+
+    pmtimevalNow(&start);
+    /* from before the start to after the end, at and between records */
+    for (t = -15; t <= nrec * 10 + 5; t += 5) {
+	/* forwards, the first record at or after t */
+	want = t <= 0 ? 0 : (t + 9) / 10;
+	if (want >= nrec)
+	    want = -1;
+	got = probe(t, PM_MODE_FORW);
+	if (got != want && errors++ < 10)
+	    printf("forw from %.1f: got %d, expected %d\n", t / 10.0, got, want);
+	nprobe++;
+
+	/* backwards, the last record at or before t */
+	want = t < 0 ? -1 : t / 10;
+	if (want >= nrec)
+	    want = nrec - 1;
+	got = probe(t, PM_MODE_BACK);
+	if (got != want && errors++ < 10)
+	    printf("back from %.1f: got %d, expected %d\n", t / 10.0, got, want);
+	nprobe++;
+    }
+    pmtimevalNow(&end);
+    printf("%d probes, %d errors\n", nprobe, errors);
+    if (!quiet)
+	printf("probes: %.6f sec\n", pmtimevalSub(&end, &start));
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		cflag = 0;
+    int		errflag = 0;
+    char	*endnum;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "cD:i:n:qr:")) != EOF) {
+	switch (c) {
+	case 'c':
+	    cflag = 1;
+	    break;
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case 'i':
+	    interval = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || interval < 1) {
+		fprintf(stderr, "%s: -i requires a positive interval\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 'n':
+	    nrec = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || nrec < 1) {
+		fprintf(stderr, "%s: -n requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 'q':
+	    quiet = 1;
+	    break;
+	case 'r':
+	    repeat = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || repeat < 1) {
+		fprintf(stderr, "%s: -r requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc - 1) {
+	fprintf(stderr,
+"Usage: %s -c [-D debug] [-i interval] [-n nrec] archive\n\
+       %s [-q] [-D debug] [-n nrec] [-r repeat] archive\n",
+		pmGetProgname(), pmGetProgname());
+	exit(1);
+    }
+
+    if (cflag)
+	exit(create(argv[optind]) < 0 ? 1 : 0);
+    exit(check(argv[optind]));
+}
@@ -0,0 +1,258 @@
+/*
+ * Exercise bulk value insertion in libpcp_import, with many instances
+ *
+ * Copyright (c) 2020 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/import.h>
+
+static void
+check(int sts, char *name)
+{
+    if (sts < 0) fprintf(stderr, "%s: Error: %s\n", name, pmiErrStr(sts));
+    else {
+	fprintf(stderr, "%s: OK", name);
+	if (sts != 0) fprintf(stderr, " ->%d", sts);
+	fputc('\n', stderr);
+    }
+}
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval	now;
+
+    pmtimevalNow(&now);
+    return pmtimevalSub(&now, start);
+}
+
+/* expected value for each instance of the big metric, in each record */
+static long long
+expected(int row, int inst)
+{
+    return row * 1000000LL + inst;
+}
+
+static int
+verify(const char *archive, int ninst)
+{
+    pmID	pmids[2];
+    const char	*names[] = { "bulk.big", "bulk.single" };
+    pmResult	*rp;
+    int		row;
+    int		ctx;
+    int		sts;
+    int		i;
+    int		j;
+    int		bad;
+
+    if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	fprintf(stderr, "pmNewContext(%s): %s\n", archive, pmErrStr(ctx));
+	return ctx;
+    }
+    if ((sts = pmLookupName(2, (char **)names, pmids)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	return sts;
+    }
+    for (row = 1; (sts = pmFetchArchive(&rp)) >= 0; row++) {
+	bad = 0;
+	for (i = 0; i < rp->numpmid; i++) {
+	    pmValueSet	*vsp = rp->vset[i];
+
+	    if (vsp->pmid != pmids[0])
+		continue;
+	    for (j = 0; j < vsp->numval; j++) {
+		pmValue	*vp = &vsp->vlist[j];
+		__int64_t	ll;
+
+		memcpy(&ll, vp->value.pval->vbuf, sizeof(ll));	/* may be unaligned */
+		if (vp->value.pval->vlen != PM_VAL_HDR_SIZE + sizeof(__int64_t) ||
+		    ll != expected(row, vp->inst))
+		    bad++;
+	    }
+	}
+	printf("record %d: numpmid %d", row, rp->numpmid);
+	for (i = 0; i < rp->numpmid; i++)
+	    printf(" %s:%d", rp->vset[i]->pmid == pmids[0] ? "big" : "single",
+			rp->vset[i]->numval);
+	printf(" bad values %d\n", bad);
+	pmFreeResult(rp);
+    }
+    pmDestroyContext(ctx);
+    return sts == PM_ERR_EOL ? 0 : sts;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct timeval	start;
+    const char	**names;
+    const char	**insts;
+    const char	**values;
+    const char	*single = "bulk.single";
+    char	*archive;
+    char	*buf;
+    char	*valbuf;
+    int		*handles;
+    int		ninst = 50000;
+    int		row = 0;
+    int		sts;
+    int		c;
+    int		i;
+    int		errflag = 0;
+    static char	*usage = "[-D debugspec] [-n instances] archive";
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:n:")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'n':	/* number of instances */
+	    ninst = atoi(optarg);
+	    if (ninst < 2) {
+		fprintf(stderr, "%s: bad instance count (%s)\n", pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc-1) {
+	printf("Usage: %s %s\n", pmGetProgname(), usage);
+	exit(1);
+    }
+    archive = argv[optind];
+
+    names = (const char **)malloc((ninst+1) * sizeof(char *));
+    insts = (const char **)malloc((ninst+1) * sizeof(char *));
+    values = (const char **)malloc((ninst+1) * sizeof(char *));
+    handles = (int *)malloc((ninst+1) * sizeof(int));
+    buf = (char *)malloc(ninst * 32);
+    valbuf = (char *)malloc((ninst+1) * 32);
+    if (names == NULL || insts == NULL || values == NULL ||
+	handles == NULL || buf == NULL || valbuf == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	exit(1);
+    }
+
+    sts = pmiStart(archive, 0);
+    check(sts, "pmiStart");
+    sts = pmiSetHostname("bulk.host");
+    check(sts, "pmiSetHostname");
+    sts = pmiSetTimezone("UTC");
+    check(sts, "pmiSetTimezone");
+    sts = pmiAddMetric("bulk.big", PM_ID_NULL, PM_TYPE_64, pmInDom_build(245,1), PM_SEM_INSTANT, pmiUnits(0,0,0,0,0,0));
+    check(sts, "pmiAddMetric");
+    sts = pmiAddMetric("bulk.single", PM_ID_NULL, PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, pmiUnits(0,0,0,0,0,0));
+    check(sts, "pmiAddMetric");
+
+    /* instance names are unique to the first space, lookups use "inst-N x" */
+    pmtimevalNow(&start);
+    for (i = 0; i < ninst; i++) {
+	pmsprintf(&buf[i*32], 32, "inst-%d number %d", i, i);
+	if ((sts = pmiAddInstance(pmInDom_build(245,1), &buf[i*32], i)) < 0) {
+	    check(sts, "pmiAddInstance");
+	    exit(1);
+	}
+	pmsprintf(&buf[i*32], 32, "inst-%d x", i);
+	names[i] = "bulk.big";
+	insts[i] = &buf[i*32];
+    }
+    fprintf(stderr, "pmiAddInstance x %d: %.3f sec\n", ninst, elapsed(&start));
+    sts = pmiAddInstance(pmInDom_build(245,1), "inst-7 again", ninst);
+    check(sts, "pmiAddInstance");
+    sts = pmiAddInstance(pmInDom_build(245,1), "inst-again", 7);
+    check(sts, "pmiAddInstance");
+
+    /* record 1: pmiPutValues with a whole row */
+    row++;
+    for (i = 0; i < ninst; i++) {
+	pmsprintf(&valbuf[i*32], 32, "%lld", expected(row, i));
+	values[i] = &valbuf[i*32];
+    }
+    names[ninst] = single;
+    insts[ninst] = NULL;
+    values[ninst] = "1";
+    pmtimevalNow(&start);
+    sts = pmiPutValues(ninst+1, names, insts, values);
+    fprintf(stderr, "pmiPutValues x %d: %.3f sec\n", ninst+1, elapsed(&start));
+    check(sts, "pmiPutValues");
+    sts = pmiWrite(row, 0);
+    check(sts, "pmiWrite");
+
+    /* record 2: pmiPutValueHandles with a whole row */
+    row++;
+    pmtimevalNow(&start);
+    for (i = 0; i < ninst; i++) {
+	if ((handles[i] = pmiGetHandle("bulk.big", insts[i])) < 0) {
+	    check(handles[i], "pmiGetHandle");
+	    exit(1);
+	}
+	pmsprintf(&valbuf[i*32], 32, "%lld", expected(row, i));
+    }
+    fprintf(stderr, "pmiGetHandle x %d: %.3f sec\n", ninst, elapsed(&start));
+    pmtimevalNow(&start);
+    sts = pmiPutValueHandles(ninst, handles, values);
+    fprintf(stderr, "pmiPutValueHandles x %d: %.3f sec\n", ninst, elapsed(&start));
+    check(sts, "pmiPutValueHandles");
+    sts = pmiWrite(row, 0);
+    check(sts, "pmiWrite");
+
+    /* record 3: one value at a time, in reverse order */
+    row++;
+    pmtimevalNow(&start);
+    for (i = ninst-1; i >= 0; i--) {
+	pmsprintf(&valbuf[i*32], 32, "%lld", expected(row, i));
+	if ((sts = pmiPutValueHandle(handles[i], values[i])) < 0) {
+	    check(sts, "pmiPutValueHandle");
+	    exit(1);
+	}
+    }
+    fprintf(stderr, "pmiPutValueHandle x %d: %.3f sec\n", ninst, elapsed(&start));
+    sts = pmiPutValueHandle(handles[0], values[0]);
+    check(sts, "pmiPutValueHandle");
+    sts = pmiWrite(row, 0);
+    check(sts, "pmiWrite");
+
+    /* nothing is stored if any name or handle is bad */
+    row++;
+    pmsprintf(&valbuf[0], 32, "%lld", expected(row, 0));
+    pmsprintf(&valbuf[32], 32, "%lld", expected(row, 1));
+    insts[1] = "no-such-instance";
+    sts = pmiPutValues(2, names, insts, values);
+    check(sts, "pmiPutValues");
+    insts[1] = &buf[32];
+    handles[1] = -1;
+    sts = pmiPutValueHandles(2, handles, values);
+    check(sts, "pmiPutValueHandles");
+    sts = pmiWrite(row, 0);
+    check(sts, "pmiWrite");
+
+    /* values before a rejected one are kept: record 4 has two values */
+    handles[1] = handles[0] + 1;
+    handles[2] = handles[0];
+    sts = pmiPutValueHandles(3, handles, values);
+    check(sts, "pmiPutValueHandles");
+    sts = pmiWrite(row, 0);
+    check(sts, "pmiWrite");
+
+    sts = pmiEnd();
+    check(sts, "pmiEnd");
+
+    return verify(archive, ninst) < 0;
+}
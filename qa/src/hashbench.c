@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * Compare chained (__pmHashCtl), inline (__pmHashInlineCtl) and pooled
+ * (__pmHashPoolCtl) libpcp hash tables.
+ *
+ * Usage: hashbench [-v] [-D debug] [-n nkeys] [-i iter] [-s stride]
+ *
+ * With -v, exercise all representations with the same sequence of
+ * add, search, delete and walk operations and report any differences
+ * (output is deterministic, suitable for QA).  Otherwise, report the
+ * time taken for each operation class in each representation.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static int	nkeys = 100000;
+static int	iter = 10;
+static int	stride = 1;
+static int	verify;
+
+static unsigned int
+keyof(int i)
+{
+    return (unsigned int)i * stride;
+}
+
+static __pmHashWalkState
+delete_odd(const __pmHashNode *hp, void *arg)
+{
+    (void)arg;
+    if (hp->key & 1)
+	return PM_HASH_WALK_DELETE_NEXT;
+    return PM_HASH_WALK_NEXT;
+}
+
+static __pmHashWalkState
+delete_all(const __pmHashNode *hp, void *arg)
+{
+    (void)hp;
+    (void)arg;
+    return PM_HASH_WALK_DELETE_NEXT;
+}
+
+enum { CHAINED, INLINE, POOL };
+
+typedef struct {
+    int			type;
+    const char		*name;
+    __pmHashCtl		chained;
+    __pmHashInlineCtl	inline_hc;
+    __pmHashPoolCtl	pool;
+} table_t;
+
+static void
+t_init(table_t *tp, int type)
+{
+    static const char	*names[] = { "chained", "inline", "pool" };
+
+    tp->type = type;
+    tp->name = names[type];
+    if (type == CHAINED)
+	__pmHashInit(&tp->chained);
+    else if (type == INLINE)
+	__pmHashInlineInit(&tp->inline_hc);
+    else
+	__pmHashPoolInit(&tp->pool);
+}
+
+static int
+t_add(table_t *tp, unsigned int key, void *data)
+{
+    if (tp->type == CHAINED)
+	return __pmHashAdd(key, data, &tp->chained);
+    if (tp->type == INLINE)
+	return __pmHashInlineAdd(key, data, &tp->inline_hc);
+    return __pmHashPoolAdd(key, data, &tp->pool);
+}
+
+static int
+t_del(table_t *tp, unsigned int key, void *data)
+{
+    if (tp->type == CHAINED)
+	return __pmHashDel(key, data, &tp->chained);
+    if (tp->type == INLINE)
+	return __pmHashInlineDel(key, data, &tp->inline_hc);
+    return __pmHashPoolDel(key, data, &tp->pool);
+}
+
+static __pmHashNode *
+t_search(table_t *tp, unsigned int key)
+{
+    if (tp->type == CHAINED)
+	return __pmHashSearch(key, &tp->chained);
+    if (tp->type == INLINE)
+	return __pmHashInlineSearch(key, &tp->inline_hc);
+    return __pmHashSearch(key, &tp->pool.hc);
+}
+
+static __pmHashNode *
+t_walk(table_t *tp, __pmHashWalkState state)
+{
+    if (tp->type == CHAINED)
+	return __pmHashWalk(&tp->chained, state);
+    if (tp->type == INLINE)
+	return __pmHashInlineWalk(&tp->inline_hc, state);
+    return __pmHashWalk(&tp->pool.hc, state);
+}
+
+static void
+t_walkcb(table_t *tp, __pmHashWalkCallback cb)
+{
+    if (tp->type == CHAINED)
+	__pmHashWalkCB(cb, NULL, &tp->chained);
+    else if (tp->type == INLINE)
+	__pmHashInlineWalkCB(cb, NULL, &tp->inline_hc);
+    else
+	__pmHashPoolWalkCB(cb, NULL, &tp->pool);
+}
+
+static void
+t_clear(table_t *tp)
+{
+    if (tp->type == CHAINED) {
+	__pmHashWalkCB(delete_all, NULL, &tp->chained);
+	__pmHashClear(&tp->chained);
+    }
+    else if (tp->type == INLINE)
+	__pmHashInlineClear(&tp->inline_hc);
+    else
+	__pmHashPoolClear(&tp->pool);
+}
+
+static int
+compare(table_t *a, table_t *b, const char *what)
+{
+    __pmHashNode	*hp, *xp;
+    int			na = 0, nb = 0;
+    int			bad = 0;
+
+    for (hp = t_walk(a, PM_HASH_WALK_START);
+	 hp != NULL;
+	 hp = t_walk(a, PM_HASH_WALK_NEXT)) {
+	na++;
+	if ((xp = t_search(b, hp->key)) == NULL) {
+	    if (bad++ < 10)
+		printf("%s: key %u missing from %s table\n", what, hp->key, b->name);
+	}
+	else if (xp->data != hp->data) {
+	    if (bad++ < 10)
+		printf("%s: key %u data mismatch\n", what, hp->key);
+	}
+    }
+    for (hp = t_walk(b, PM_HASH_WALK_START);
+	 hp != NULL;
+	 hp = t_walk(b, PM_HASH_WALK_NEXT)) {
+	nb++;
+	if (t_search(a, hp->key) == NULL) {
+	    if (bad++ < 10)
+		printf("%s: key %u missing from chained table\n", what, hp->key);
+	}
+    }
+    /* NB: chained tables do not maintain nodes on delete or clear */
+    if (na != nb || (b->type == INLINE && nb != b->inline_hc.nodes)) {
+	printf("%s: walked %d chained, %d %s\n", what, na, nb, b->name);
+	bad++;
+    }
+    printf("%s %s: %d entries, %s\n", what, b->name, na, bad ? "differ" : "same");
+    return bad;
+}
+
+static int
+doverify(void)
+{
+    table_t	chained, other;
+    int		i, k, bad = 0;
+
+    for (k = INLINE; k <= POOL; k++) {
+	t_init(&chained, CHAINED);
+	t_init(&other, k);
+
+	for (i = 0; i < nkeys; i++) {
+	    t_add(&chained, keyof(i), (void *)(__psint_t)i);
+	    t_add(&other, keyof(i), (void *)(__psint_t)i);
+	}
+	bad += compare(&chained, &other, "add");
+
+	for (i = 0; i < nkeys; i += 3) {
+	    t_del(&chained, keyof(i), (void *)(__psint_t)i);
+	    t_del(&other, keyof(i), (void *)(__psint_t)i);
+	}
+	bad += compare(&chained, &other, "del");
+
+	/* re-add some deleted keys, and some beyond the original range */
+	for (i = 0; i < nkeys; i += 6) {
+	    t_add(&chained, keyof(i), (void *)(__psint_t)i);
+	    t_add(&other, keyof(i), (void *)(__psint_t)i);
+	    t_add(&chained, keyof(nkeys + i), (void *)(__psint_t)(nkeys + i));
+	    t_add(&other, keyof(nkeys + i), (void *)(__psint_t)(nkeys + i));
+	}
+	bad += compare(&chained, &other, "readd");
+
+	t_walkcb(&chained, delete_odd);
+	t_walkcb(&other, delete_odd);
+	bad += compare(&chained, &other, "walkcb");
+
+	t_clear(&chained);
+	t_clear(&other);
+	bad += compare(&chained, &other, "clear");
+    }
+
+    return bad;
+}
+
+static double
+since(struct timeval *start)
+{
+    struct timeval	now;
+
+    pmtimevalNow(&now);
+    return pmtimevalSub(&now, start);
+}
+
+static void
+bench(table_t *tp)
+{
+    struct timeval	start;
+    __pmHashNode	*hp;
+    double		add = 0, search = 0, walk = 0, del = 0;
+    long		found = 0;
+    int			i, n;
+
+    for (n = 0; n < iter; n++) {
+	pmtimevalNow(&start);
+	for (i = 0; i < nkeys; i++)
+	    t_add(tp, keyof(i), (void *)(__psint_t)i);
+	add += since(&start);
+
+	pmtimevalNow(&start);
+	for (i = 0; i < 2 * nkeys; i++)
+	    if (t_search(tp, keyof(i)) != NULL)
+		found++;
+	search += since(&start);
+
+	pmtimevalNow(&start);
+	for (hp = t_walk(tp, PM_HASH_WALK_START);
+	     hp != NULL;
+	     hp = t_walk(tp, PM_HASH_WALK_NEXT))
+	    found++;
+	walk += since(&start);
+
+	pmtimevalNow(&start);
+	for (i = 0; i < nkeys; i++)
+	    t_del(tp, keyof(i), (void *)(__psint_t)i);
+	del += since(&start);
+
+	t_clear(tp);
+    }
+
+    printf("%-8s add %.6f search %.6f walk %.6f del %.6f (%ld)\n",
+	    tp->name, add / iter, search / iter, walk / iter, del / iter, found);
+}
+
+int
+main(int argc, char **argv)
+{
+    table_t	table;
+    int		c;
+    int		sts;
+    int		errflag = 0;
+    char	*endnum;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:i:n:s:v")) != EOF) {
+	switch (c) {
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case 'i':
+	    iter = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || iter < 1) {
+		fprintf(stderr, "%s: -i requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 'n':
+	    nkeys = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || nkeys < 1) {
+		fprintf(stderr, "%s: -n requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 's':
+	    stride = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || stride < 1) {
+		fprintf(stderr, "%s: -s requires a positive stride\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 'v':
+	    verify = 1;
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-v] [-D debug] [-i iter] [-n nkeys] [-s stride]\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    if (verify)
+	exit(doverify() ? 1 : 0);
+
+    for (c = CHAINED; c <= POOL; c++) {
+	t_init(&table, c);
+	bench(&table);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * Instance domain history exerciser and lookup benchmark.
+ *
+ * Usage: indomhist -c [-n nver] archive
+ *	  indomhist [-q] [-n nver] archive
+ *
+ * With -c, create an archive with nver versions of one instance domain,
+ * one second apart, and one record of one metric per version.  Version
+ * i has 1 + i % 7 instances, numbered from i / 3, and instance j is
+ * always named "inst-j".
+ *
+ * Otherwise, position at and between every version, forwards, backwards
+ * and in a scattered order, checking that the instance domain returned
+ * is the right version.  With -q the elapsed time is not reported
+ * (output is deterministic, suitable for QA).
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+#define START	1000000000	/* archive start time, in seconds */
+
+static int	nver = 5000;
+static int	quiet;
+static pmInDom	indom;
+
+static int
+create(const char *archive)
+{
+    __pmLogCtl		logctl;
+    __pmArchCtl		archctl;
+    __pmPDU		*pdp;
+    pmResult		*rp;
+    pmValueSet		*vsp;
+    pmDesc		desc;
+    pmTimeval		stamp;
+    char		*name = "indomhist.value";
+    char		**namelist;
+    int			*instlist;
+    int			i, j, numinst, sts;
+
+    memset(&logctl, 0, sizeof(logctl));
+    memset(&archctl, 0, sizeof(archctl));
+    archctl.ac_log = &logctl;
+    if ((sts = __pmLogCreate("qatest", archive, PM_LOG_VERS02, &archctl)) != 0) {
+	fprintf(stderr, "%s: __pmLogCreate failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	return sts;
+    }
+    logctl.l_state = PM_LOG_STATE_INIT;
+    logctl.l_label.ill_pid = 1234;
+    logctl.l_label.ill_start.tv_sec = START;
+    logctl.l_label.ill_start.tv_usec = 0;
+    strcpy(logctl.l_label.ill_hostname, "happycamper");
+    strcpy(logctl.l_label.ill_tz, "UTC");
+    logctl.l_label.ill_vol = PM_LOG_VOL_TI;
+    __pmLogWriteLabel(logctl.l_tifp, &logctl.l_label);
+    logctl.l_label.ill_vol = PM_LOG_VOL_META;
+    __pmLogWriteLabel(logctl.l_mdfp, &logctl.l_label);
+    logctl.l_label.ill_vol = 0;
+    __pmLogWriteLabel(archctl.ac_mfp, &logctl.l_label);
+
+    memset(&desc, 0, sizeof(desc));
+    desc.pmid = pmID_build(245, 0, 1);
+    desc.type = PM_TYPE_32;
+    desc.indom = indom;
+    desc.sem = PM_SEM_INSTANT;
+    if ((sts = __pmLogPutDesc(&archctl, &desc, 1, &name)) < 0) {
+	fprintf(stderr, "%s: __pmLogPutDesc failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	return sts;
+    }
+
+    rp = (pmResult *)calloc(1, sizeof(pmResult));
+    vsp = (pmValueSet *)calloc(1, sizeof(pmValueSet));
+    if (rp == NULL || vsp == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	return -ENOMEM;
+    }
+    rp->numpmid = 1;
+    rp->vset[0] = vsp;
+    vsp->pmid = desc.pmid;
+    vsp->numval = 1;
+    vsp->valfmt = PM_VAL_INSITU;
+
+    for (i = 0; i < nver; i++) {
+	stamp.tv_sec = START + i;
+	stamp.tv_usec = 0;
+	/* libpcp keeps these, so a new allocation for each version */
+	numinst = 1 + i % 7;
+	instlist = (int *)malloc(numinst * sizeof(int));
+	namelist = (char **)malloc(numinst * sizeof(char *));
+	if (instlist == NULL || namelist == NULL) {
+	    fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	    return -ENOMEM;
+	}
+	for (j = 0; j < numinst; j++) {
+	    instlist[j] = i / 3 + j;
+	    if (asprintf(&namelist[j], "inst-%d", instlist[j]) < 0) {
+		fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+		return -ENOMEM;
+	    }
+	}
+	if ((sts = __pmLogPutInDom(&archctl, indom, &stamp, numinst, instlist, namelist)) < 0) {
+	    fprintf(stderr, "%s: __pmLogPutInDom failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	    return sts;
+	}
+
+	rp->timestamp.tv_sec = stamp.tv_sec;
+	rp->timestamp.tv_usec = stamp.tv_usec;
+	vsp->vlist[0].inst = i / 3;
+	vsp->vlist[0].value.lval = i;
+	__pmLogPutIndex(&archctl, &stamp);
+	__pmOverrideLastFd(__pmFileno(archctl.ac_mfp));
+	if ((sts = __pmEncodeResult(__pmFileno(archctl.ac_mfp), rp, &pdp)) < 0) {
+	    fprintf(stderr, "%s: __pmEncodeResult failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	    return sts;
+	}
+	if ((sts = __pmLogPutResult2(&archctl, pdp)) < 0) {
+	    fprintf(stderr, "%s: __pmLogPutResult2 failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	    return sts;
+	}
+	__pmUnpinPDUBuf(pdp);
+    }
+    __pmLogPutIndex(&archctl, &stamp);
+
+    __pmFclose(archctl.ac_mfp);
+    __pmFclose(logctl.l_mdfp);
+    __pmFclose(logctl.l_tifp);
+    printf("created %d instance domain versions\n", nver);
+    return 0;
+}
+
+/*
+ * Position at t (in tenths of a second from the start) and check the
+ * instance domain is version t / 10, or that there is none before the
+ * start.  Return 0 if correct.
+ */
+static int
+probe(int t)
+{
+    struct timeval	when;
+    char		**namelist;
+    char		buf[32];
+    char		*name;
+    int			*instlist;
+    int			i, sec, sts, ver, errors = 0;
+
+    sec = t >= 0 ? t / 10 : -((9 - t) / 10);
+    when.tv_sec = START + sec;
+    when.tv_usec = (t - sec * 10) * 100000;
+    if ((sts = pmSetMode(PM_MODE_INTERP, &when, 0)) < 0) {
+	fprintf(stderr, "%s: pmSetMode failed: %s\n", pmGetProgname(), pmErrStr(sts));
+	return 1;
+    }
+    sts = pmGetInDom(indom, &instlist, &namelist);
+    if (t < 0)
+	return sts != PM_ERR_INDOM_LOG;
+    ver = sec < nver ? sec : nver - 1;
+    if (sts != 1 + ver % 7) {
+	printf("at %.1f: numinst %d, expected %d\n", t / 10.0, sts, 1 + ver % 7);
+	if (sts > 0) {
+	    free(instlist);
+	    free(namelist);
+	}
+	return 1;
+    }
+    for (i = 0; i < sts; i++) {
+	pmsprintf(buf, sizeof(buf), "inst-%d", ver / 3 + i);
+	if (instlist[i] != ver / 3 + i || strcmp(namelist[i], buf) != 0) {
+	    printf("at %.1f: inst[%d] %d \"%s\", expected %d \"%s\"\n",
+		    t / 10.0, i, instlist[i], namelist[i], ver / 3 + i, buf);
+	    errors++;
+	}
+    }
+    free(instlist);
+    free(namelist);
+
+    /* and one lookup by name and identifier, for the newest instance */
+    i = ver / 3 + ver % 7;
+    pmsprintf(buf, sizeof(buf), "inst-%d", i);
+    if ((sts = pmLookupInDom(indom, buf)) != i) {
+	printf("at %.1f: pmLookupInDom(%s) -> %d\n", t / 10.0, buf, sts);
+	errors++;
+    }
+    if ((sts = pmNameInDom(indom, i, &name)) < 0) {
+	printf("at %.1f: pmNameInDom(%d) -> %s\n", t / 10.0, i, pmErrStr(sts));
+	errors++;
+    }
+    else {
+	if (strcmp(name, buf) != 0) {
+	    printf("at %.1f: pmNameInDom(%d) -> \"%s\"\n", t / 10.0, i, name);
+	    errors++;
+	}
+	free(name);
+    }
+    return errors != 0;
+}
+
+static int
+check(const char *archive)
+{
+    struct timeval	start, end;
+    int			ctx, t, last = nver * 10 + 5;
+    int			nprobe = 0, errors = 0;
+
+    if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	fprintf(stderr, "%s: pmNewContext(%s): %s\n",
+		pmGetProgname(), archive, pmErrStr(ctx));
+	return 1;
+    }
+
+    pmtimevalNow(&start);
+    /* forwards, at and between versions */
+    for (t = -15; t <= last; t += 5, nprobe++)
+	errors += probe(t);
+    /* backwards */
+    for (t = last; t >= -15; t -= 5, nprobe++)
+	errors += probe(t);
+    /* scattered, stepping by a prime number of tenths */
+    for (t = 0; t < nver * 10; t += 997, nprobe++)
+	errors += probe((t * 7) % (nver * 10));
+    pmtimevalNow(&end);
+
+    printf("%d probes, %d errors\n", nprobe, errors);
+    if (!quiet)
+	printf("probes: %.6f sec\n", pmtimevalSub(&end, &start));
+    pmDestroyContext(ctx);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		cflag = 0;
+    int		errflag = 0;
+    char	*endnum;
+
+    pmSetProgname(argv[0]);
+    indom = pmInDom_build(245, 1);
+
+    while ((c = getopt(argc, argv, "cD:n:q")) != EOF) {
+	switch (c) {
+	case 'c':
+	    cflag = 1;
+	    break;
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case 'n':
+	    nver = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || nver < 1) {
+		fprintf(stderr, "%s: -n requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 'q':
+	    quiet = 1;
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc - 1) {
+	fprintf(stderr,
+"Usage: %s -c [-D debug] [-n nver] archive\n\
+       %s [-q] [-D debug] [-n nver] archive\n",
+		pmGetProgname(), pmGetProgname());
+	exit(1);
+    }
+
+    if (cflag)
+	exit(create(argv[optind]) < 0 ? 1 : 0);
+    exit(check(argv[optind]));
+}
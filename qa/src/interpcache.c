@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * Interpolate metrics across an archive, forwards then backwards, and
+ * report every value, so that results with and without the interpolation
+ * read cache ($PCP_INTERP_CACHE_SIZE) can be compared.
+ *
+ * Usage: interpcache [-D debug] [-t delta] archive metric ...
+ *
+ * With -D interp, the read cache statistics are reported on stderr when
+ * the context is destroyed.
+ */
+
+#include <pcp/pmapi.h>
+
+static void
+report(pmResult *rp, pmDesc *desc, double t)
+{
+    pmValueSet	*vsp;
+    int		i, j;
+
+    printf("t=%.3f", t);
+    for (i = 0; i < rp->numpmid; i++) {
+	vsp = rp->vset[i];
+	if (vsp->numval <= 0) {
+	    printf(" [%d] -", i);
+	    continue;
+	}
+	for (j = 0; j < vsp->numval; j++) {
+	    if (desc[i].indom == PM_INDOM_NULL)
+		printf(" [%d] ", i);
+	    else
+		printf(" [%d:%d] ", i, vsp->vlist[j].inst);
+	    pmPrintValue(stdout, vsp->valfmt, desc[i].type, &vsp->vlist[j], 1);
+	}
+    }
+    putchar('\n');
+}
+
+static int
+scan(pmID *pmids, pmDesc *desc, int n, struct timeval *start,
+	struct timeval *origin, double delta)
+{
+    pmResult	*rp;
+    double	t;
+    int		msec = (int)(delta * 1000);
+    int		nfetch = 0;
+    int		sts;
+
+    if ((sts = pmSetMode(PM_MODE_INTERP, start, msec)) < 0) {
+	fprintf(stderr, "%s: pmSetMode: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    while ((sts = pmFetch(n, pmids, &rp)) >= 0) {
+	t = pmtimevalSub(&rp->timestamp, origin);
+	report(rp, desc, t);
+	pmFreeResult(rp);
+	nfetch++;
+    }
+    if (sts != PM_ERR_EOL)
+	fprintf(stderr, "%s: pmFetch: %s\n", pmGetProgname(), pmErrStr(sts));
+    return nfetch;
+}
+
+int
+main(int argc, char **argv)
+{
+    pmLogLabel	label;
+    struct timeval	end;
+    pmID	*pmids;
+    pmDesc	*desc;
+    double	delta = 10.0;
+    char	*endnum;
+    int		c, i, n, sts;
+    int		nfetch;
+    int		errflag = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:t:")) != EOF) {
+	switch (c) {
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case 't':	/* interpolation interval, in seconds */
+	    delta = strtod(optarg, &endnum);
+	    if (*endnum != '\0' || delta <= 0) {
+		fprintf(stderr, "%s: -t requires a positive interval\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind > argc - 2) {
+	fprintf(stderr, "Usage: %s [-D debug] [-t delta] archive metric ...\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, argv[optind])) < 0) {
+	fprintf(stderr, "%s: pmNewContext(%s): %s\n",
+		pmGetProgname(), argv[optind], pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmGetArchiveLabel(&label)) < 0 ||
+	(sts = pmGetArchiveEnd(&end)) < 0) {
+	fprintf(stderr, "%s: archive bounds: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    optind++;
+
+    n = argc - optind;
+    if ((pmids = (pmID *)malloc(n * sizeof(pmID))) == NULL ||
+	(desc = (pmDesc *)malloc(n * sizeof(pmDesc))) == NULL) {
+	fprintf(stderr, "%s: malloc failed\n", pmGetProgname());
+	exit(1);
+    }
+    if ((sts = pmLookupName(n, &argv[optind], pmids)) < 0) {
+	fprintf(stderr, "%s: pmLookupName: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    for (i = 0; i < n; i++) {
+	if ((sts = pmLookupDesc(pmids[i], &desc[i])) < 0) {
+	    fprintf(stderr, "%s: pmLookupDesc(%s): %s\n",
+		    pmGetProgname(), argv[optind + i], pmErrStr(sts));
+	    exit(1);
+	}
+    }
+
+    printf("== forwards\n");
+    nfetch = scan(pmids, desc, n, &label.ll_start, &label.ll_start, delta);
+    printf("%d fetches\n", nfetch);
+    printf("== backwards\n");
+    nfetch = scan(pmids, desc, n, &end, &label.ll_start, -delta);
+    printf("%d fetches\n", nfetch);
+
+    pmDestroyContext(pmWhichContext());
+    free(pmids);
+    free(desc);
+
+    exit(0);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * Replay an archive, looking up the instance domain of each metric
+ * in each record, and report the largest number of archive metadata
+ * files open at any time.
+ *
+ * Usage: lazyfds [-D debug] archive
+ *
+ * With $PCP_LAZY_METADATA set, the instance domains are decoded on
+ * first use, and for a multi-archive context this should not need
+ * the metadata file of every archive to be kept open.
+ */
+
+#include <pcp/pmapi.h>
+#include <dirent.h>
+
+static int	maxopen;
+
+static void
+countmeta(void)
+{
+    DIR			*dirp;
+    struct dirent	*dp;
+    char		path[MAXPATHLEN];
+    char		link[MAXPATHLEN];
+    ssize_t		len;
+    int			n = 0;
+
+    if ((dirp = opendir("/proc/self/fd")) == NULL) {
+	fprintf(stderr, "%s: opendir: %s\n", pmGetProgname(), osstrerror());
+	exit(1);
+    }
+    while ((dp = readdir(dirp)) != NULL) {
+	pmsprintf(path, sizeof(path), "/proc/self/fd/%s", dp->d_name);
+	if ((len = readlink(path, link, sizeof(link) - 1)) < 0)
+	    continue;
+	link[len] = '\0';
+	if (strstr(link, ".meta") != NULL)
+	    n++;
+    }
+    closedir(dirp);
+    if (n > maxopen)
+	maxopen = n;
+}
+
+int
+main(int argc, char **argv)
+{
+    pmResult	*rp;
+    pmDesc	desc;
+    int		*instlist;
+    char	**namelist;
+    int		nrecs = 0, ninst = 0;
+    int		c, i, sts;
+    int		errflag = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:")) != EOF) {
+	switch (c) {
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc - 1) {
+	fprintf(stderr, "Usage: %s [-D debug] archive\n", pmGetProgname());
+	exit(1);
+    }
+
+    if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, argv[optind])) < 0) {
+	fprintf(stderr, "%s: pmNewContext(%s): %s\n",
+		pmGetProgname(), argv[optind], pmErrStr(sts));
+	exit(1);
+    }
+    countmeta();
+
+    while ((sts = pmFetchArchive(&rp)) >= 0) {
+	nrecs++;
+	for (i = 0; i < rp->numpmid; i++) {
+	    if (pmLookupDesc(rp->vset[i]->pmid, &desc) < 0 ||
+		desc.indom == PM_INDOM_NULL)
+		continue;
+	    if ((sts = pmGetInDomArchive(desc.indom, &instlist, &namelist)) > 0) {
+		ninst += sts;
+		free(instlist);
+		free(namelist);
+	    }
+	    countmeta();
+	}
+	pmFreeResult(rp);
+    }
+    if (sts != PM_ERR_EOL)
+	fprintf(stderr, "%s: pmFetchArchive: %s\n", pmGetProgname(), pmErrStr(sts));
+
+    printf("%d records, %d instances found\n", nrecs, ninst);
+    printf("metadata files open at once: %d\n", maxopen);
+
+    exit(0);
+}
@@ -0,0 +1,111 @@
+/*
+ * Create many small, interleaved archives for pmlogextract merging
+ *
+ * Archive i has records at base + r*interval + i msec, so a merge
+ * of all of them has to pick from a different input on every record.
+ *
+ * Copyright (c) 2020 Red Hat.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/import.h>
+
+static void
+check(int sts, char *name)
+{
+    if (sts < 0) {
+	fprintf(stderr, "%s: Error: %s\n", name, pmiErrStr(sts));
+	exit(1);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    char	archive[MAXPATHLEN];
+    char	inst[32];
+    char	value[32];
+    pmInDom	indom = pmInDom_build(245,2);
+    int		narch = 500;
+    int		nrec = 100;
+    int		ninst = 4;
+    int		base = 1577836800;	/* 2020-01-01 00:00:00 UTC */
+    int		interval = 10;
+    int		stamp;
+    int		a;
+    int		r;
+    int		i;
+    int		c;
+    int		errflag = 0;
+    static char	*usage = "[-i instances] [-n archives] [-r records] prefix";
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "i:n:r:")) != EOF) {
+	switch (c) {
+
+	case 'i':	/* instances per archive */
+	    ninst = atoi(optarg);
+	    if (ninst < 1) {
+		fprintf(stderr, "%s: bad instance count (%s)\n", pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'n':	/* number of archives */
+	    narch = atoi(optarg);
+	    if (narch < 1 || narch > 999) {
+		fprintf(stderr, "%s: bad archive count (%s)\n", pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'r':	/* records per archive */
+	    nrec = atoi(optarg);
+	    if (nrec < 1) {
+		fprintf(stderr, "%s: bad record count (%s)\n", pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc-1) {
+	printf("Usage: %s %s\n", pmGetProgname(), usage);
+	exit(1);
+    }
+
+    for (a = 0; a < narch; a++) {
+	pmsprintf(archive, sizeof(archive), "%s.%03d", argv[optind], a);
+	check(pmiStart(archive, 0), "pmiStart");
+	check(pmiSetHostname("merge.host"), "pmiSetHostname");
+	check(pmiSetTimezone("UTC"), "pmiSetTimezone");
+	check(pmiAddMetric("merge.count", PM_ID_NULL, PM_TYPE_U64, PM_INDOM_NULL,
+		PM_SEM_COUNTER, pmiUnits(0,0,1,0,0,PM_COUNT_ONE)), "pmiAddMetric");
+	check(pmiAddMetric("merge.value", PM_ID_NULL, PM_TYPE_32, indom,
+		PM_SEM_INSTANT, pmiUnits(0,0,0,0,0,0)), "pmiAddMetric");
+	for (i = 0; i < ninst; i++) {
+	    pmsprintf(inst, sizeof(inst), "inst-%d", i);
+	    check(pmiAddInstance(indom, inst, i), "pmiAddInstance");
+	}
+	for (r = 0; r < nrec; r++) {
+	    pmsprintf(value, sizeof(value), "%d", a * nrec + r);
+	    check(pmiPutValue("merge.count", NULL, value), "pmiPutValue");
+	    for (i = 0; i < ninst; i++) {
+		pmsprintf(inst, sizeof(inst), "inst-%d", i);
+		pmsprintf(value, sizeof(value), "%d", r * ninst + i);
+		check(pmiPutValue("merge.value", inst, value), "pmiPutValue");
+	    }
+	    stamp = base + r * interval;
+	    check(pmiWrite(stamp, a * 1000), "pmiWrite");
+	}
+	check(pmiEnd(), "pmiEnd");
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * Create a large MMV file for fetch benchmarks - nmetrics metrics over
+ * one indom with ninst instances, plus one singular metric.  Every value
+ * is set from its item and internal instance identifier, as
+ *	item * 1000000 + instance
+ * so that fetched values can be checked.
+ *
+ * Usage: mmv_bigstats [-1] [-m nmetrics] [-i ninst] name
+ *
+ * With -1, a version 1 MMV file is created (via mmv_stats_init),
+ * otherwise the registry interface is used.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/mmv_stats.h>
+#include <pcp/mmv_dev.h>
+
+static int	nmetrics = 20;
+static int	ninst = 1000;
+
+static void *
+create_v1(const char *name)
+{
+    mmv_instances_t	*instances;
+    mmv_metric_t	*metrics;
+    mmv_indom_t		indom;
+    int			i;
+
+    instances = (mmv_instances_t *)calloc(ninst, sizeof(mmv_instances_t));
+    metrics = (mmv_metric_t *)calloc(nmetrics + 1, sizeof(mmv_metric_t));
+    if (instances == NULL || metrics == NULL)
+	return NULL;
+    for (i = 0; i < ninst; i++) {
+	instances[i].internal = i * 3;
+	pmsprintf(instances[i].external, MMV_NAMEMAX, "inst%d", i * 3);
+    }
+    memset(&indom, 0, sizeof(indom));
+    indom.serial = 1;
+    indom.count = ninst;
+    indom.instances = instances;
+
+    for (i = 0; i <= nmetrics; i++) {
+	pmsprintf(metrics[i].name, MMV_NAMEMAX, "metric%d", i + 1);
+	metrics[i].item = i + 1;
+	metrics[i].type = MMV_TYPE_U64;
+	metrics[i].semantics = MMV_SEM_INSTANT;
+	metrics[i].indom = i < nmetrics ? 1 : 0;
+    }
+    return mmv_stats_init(name, 0, 0, metrics, nmetrics + 1, &indom, 1);
+}
+
+static void *
+create_registry(const char *name)
+{
+    mmv_registry_t	*registry;
+    pmUnits		units = MMV_UNITS(0,0,0,0,0,0);
+    char		buf[MMV_NAMEMAX];
+    int			i;
+
+    if ((registry = mmv_stats_registry(name, 0, 0)) == NULL)
+	return NULL;
+    mmv_stats_add_indom(registry, 1, NULL, NULL);
+    for (i = 0; i < ninst; i++) {
+	pmsprintf(buf, sizeof(buf), "inst%d", i * 3);
+	/* registry keeps the name pointers, not copies */
+	mmv_stats_add_instance(registry, 1, i * 3, strdup(buf));
+    }
+    for (i = 0; i <= nmetrics; i++) {
+	pmsprintf(buf, sizeof(buf), "metric%d", i + 1);
+	mmv_stats_add_metric(registry, strdup(buf), i + 1, MMV_TYPE_U64,
+			MMV_SEM_INSTANT, units, i < nmetrics ? 1 : 0, NULL, NULL);
+    }
+    return mmv_stats_start(registry);
+}
+
+int
+main(int argc, char **argv)
+{
+    mmv_disk_header_t	*hdr;
+    mmv_disk_toc_t	*toc;
+    mmv_disk_value_t	*v;
+    void		*addr;
+    char		*base, *endnum;
+    __uint32_t		item;
+    __int32_t		inst;
+    int			c, i, j, version1 = 0, errflag = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "1i:m:")) != EOF) {
+	switch (c) {
+	case '1':
+	    version1 = 1;
+	    break;
+	case 'i':
+	    ninst = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || ninst < 1) {
+		fprintf(stderr, "%s: -i requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 'm':
+	    nmetrics = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || nmetrics < 1 || nmetrics > 1000) {
+		fprintf(stderr, "%s: -m requires a count between 1 and 1000\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc - 1) {
+	fprintf(stderr, "Usage: %s [-1] [-m nmetrics] [-i ninst] name\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    if (version1)
+	addr = create_v1(argv[optind]);
+    else
+	addr = create_registry(argv[optind]);
+    if (addr == NULL) {
+	fprintf(stderr, "%s: failed to create MMV file %s: %s\n",
+		pmGetProgname(), argv[optind], osstrerror());
+	exit(1);
+    }
+
+    /* set every value directly, avoiding per-value lookups by name */
+    base = (char *)addr;
+    hdr = (mmv_disk_header_t *)base;
+    toc = (mmv_disk_toc_t *)(base + sizeof(mmv_disk_header_t));
+    for (i = 0; i < hdr->tocs; i++) {
+	if (toc[i].type != MMV_TOC_VALUES)
+	    continue;
+	v = (mmv_disk_value_t *)(base + toc[i].offset);
+	for (j = 0; j < toc[i].count; j++) {
+	    if (hdr->version == MMV_VERSION1) {
+		item = ((mmv_disk_metric_t *)(base + v[j].metric))->item;
+		inst = v[j].instance ?
+		    ((mmv_disk_instance_t *)(base + v[j].instance))->internal : 0;
+	    } else {
+		item = ((mmv_disk_metric2_t *)(base + v[j].metric))->item;
+		inst = v[j].instance ?
+		    ((mmv_disk_instance2_t *)(base + v[j].instance))->internal : 0;
+	    }
+	    v[j].value.ull = (__uint64_t)item * 1000000 + inst;
+	}
+    }
+
+    printf("%s: %d metrics x %d instances\n", argv[optind], nmetrics, ninst);
+    exit(0);
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * Stress the libpcp PDU buffer allocator with many threads exchanging
+ * PDUs.  Each pair of threads is connected by a socketpair; the sender
+ * transmits PDU_TEXT PDUs of varying sizes, and the receiver checks
+ * each PDU, pins and unpins it via an interior address, and releases
+ * it.  The receiver also churns some buffers larger than any size
+ * class.  A second phase has every thread allocate, pin and unpin
+ * buffers with no I/O, to isolate the cost of buffer management.
+ *
+ * Usage: pdubufstress [-q] [-D debug] [-n count] [-s maxsize] [-t npairs]
+ *
+ * With -q, only report errors and the final pinned buffer count (output
+ * is deterministic, suitable for QA).  Otherwise also report the time
+ * taken.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <sys/socket.h>
+#include <pthread.h>
+
+static int	count = 20000;
+static int	maxsize = 48000;
+static int	npairs = 4;
+static int	quiet;
+
+typedef struct {
+    int		fd;
+    int		pair;
+    int		errors;
+} worker_t;
+
+static int
+lenof(int i)
+{
+    /* mostly small PDUs, with an occasional big one */
+    if (i % 64 == 0)
+	return maxsize - (i % 1000);
+    if (i % 8 == 0)
+	return 1000 + (i * 37) % 3000;
+    return (i * 13) % 200;
+}
+
+static void *
+sender(void *arg)
+{
+    worker_t	*wp = (worker_t *)arg;
+    char	*text;
+    int		i, len, sts;
+
+    if ((text = (char *)malloc(maxsize + 1)) == NULL) {
+	wp->errors++;
+	close(wp->fd);
+	return NULL;
+    }
+    for (i = 0; i < count; i++) {
+	len = lenof(i);
+	memset(text, 'a' + (i + wp->pair) % 26, len);
+	text[len] = '\0';
+	if ((sts = __pmSendText(wp->fd, FROM_ANON, i, text)) < 0) {
+	    fprintf(stderr, "pair %d: __pmSendText[%d]: %s\n",
+		    wp->pair, i, pmErrStr(sts));
+	    wp->errors++;
+	    break;
+	}
+    }
+    free(text);
+    close(wp->fd);
+    return NULL;
+}
+
+static void *
+receiver(void *arg)
+{
+    worker_t	*wp = (worker_t *)arg;
+    __pmPDU	*pb;
+    char	*text, *big;
+    int		i, j, len, ident, sts;
+
+    for (i = 0; ; i++) {
+	if ((sts = __pmGetPDU(wp->fd, ANY_SIZE, TIMEOUT_NEVER, &pb)) <= 0) {
+	    if (sts < 0) {
+		fprintf(stderr, "pair %d: __pmGetPDU[%d]: %s\n",
+			wp->pair, i, pmErrStr(sts));
+		wp->errors++;
+	    }
+	    break;
+	}
+	if (sts != PDU_TEXT) {
+	    fprintf(stderr, "pair %d: PDU[%d] type %s\n",
+		    wp->pair, i, __pmPDUTypeStr(sts));
+	    wp->errors++;
+	    __pmUnpinPDUBuf(pb);
+	    continue;
+	}
+	/* extra pin via an interior address, as pmFreeResult would */
+	__pmPinPDUBuf(&pb[2]);
+	if ((sts = __pmDecodeText(pb, &ident, &text)) < 0) {
+	    fprintf(stderr, "pair %d: __pmDecodeText[%d]: %s\n",
+		    wp->pair, i, pmErrStr(sts));
+	    wp->errors++;
+	}
+	else {
+	    len = lenof(i);
+	    if (ident != i || (int)strlen(text) != len) {
+		fprintf(stderr, "pair %d: PDU[%d] ident %d len %d, expected len %d\n",
+			wp->pair, i, ident, (int)strlen(text), len);
+		wp->errors++;
+	    }
+	    for (j = 0; j < len; j++) {
+		if (text[j] != 'a' + (i + wp->pair) % 26) {
+		    fprintf(stderr, "pair %d: PDU[%d] corrupt at byte %d\n",
+			    wp->pair, i, j);
+		    wp->errors++;
+		    break;
+		}
+	    }
+	    free(text);
+	}
+	if (__pmUnpinPDUBuf(&pb[2]) != 1 || __pmUnpinPDUBuf(pb) != 1) {
+	    fprintf(stderr, "pair %d: PDU[%d] unpin failed\n", wp->pair, i);
+	    wp->errors++;
+	}
+
+	if (i % 16 == 0) {
+	    if ((big = (char *)__pmFindPDUBuf(100000 + i % 1000)) == NULL) {
+		fprintf(stderr, "pair %d: large __pmFindPDUBuf failed\n", wp->pair);
+		wp->errors++;
+		continue;
+	    }
+	    memset(big, 0, 100000);
+	    __pmPinPDUBuf(&big[99996]);
+	    if (__pmUnpinPDUBuf(&big[99996]) != 1 || __pmUnpinPDUBuf(big) != 1) {
+		fprintf(stderr, "pair %d: large unpin failed\n", wp->pair);
+		wp->errors++;
+	    }
+	}
+    }
+    if (i != count) {
+	fprintf(stderr, "pair %d: received %d PDUs, expected %d\n",
+		wp->pair, i, count);
+	wp->errors++;
+    }
+    close(wp->fd);
+    return NULL;
+}
+
+static void *
+churner(void *arg)
+{
+    worker_t	*wp = (worker_t *)arg;
+    __pmPDU	*pb;
+    int		i;
+
+    for (i = 0; i < 10 * count; i++) {
+	if ((pb = __pmFindPDUBuf(lenof(i) + 16)) == NULL) {
+	    wp->errors++;
+	    break;
+	}
+	__pmPinPDUBuf(&pb[1]);
+	if (__pmUnpinPDUBuf(&pb[1]) != 1 || __pmUnpinPDUBuf(pb) != 1) {
+	    fprintf(stderr, "thread %d: churn unpin failed\n", wp->pair);
+	    wp->errors++;
+	}
+    }
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t		*tid;
+    worker_t		*wp;
+    struct timeval	start, end;
+    int			fds[2];
+    int			alloc, nfree;
+    int			c, i, sts;
+    int			errors = 0;
+    int			errflag = 0;
+    char		*endnum;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:n:qs:t:")) != EOF) {
+	switch (c) {
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case 'n':
+	    count = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || count < 1) {
+		fprintf(stderr, "%s: -n requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 'q':
+	    quiet = 1;
+	    break;
+	case 's':
+	    maxsize = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || maxsize < 1000 || maxsize > 60000) {
+		fprintf(stderr, "%s: -s requires a size between 1000 and 60000\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case 't':
+	    npairs = (int)strtol(optarg, &endnum, 10);
+	    if (*endnum != '\0' || npairs < 1) {
+		fprintf(stderr, "%s: -t requires a positive count\n", pmGetProgname());
+		errflag++;
+	    }
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-q] [-D debug] [-n count] [-s maxsize] [-t npairs]\n",
+		pmGetProgname());
+	exit(1);
+    }
+
+    tid = (pthread_t *)calloc(2 * npairs, sizeof(pthread_t));
+    wp = (worker_t *)calloc(2 * npairs, sizeof(worker_t));
+    if (tid == NULL || wp == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	exit(1);
+    }
+
+    pmtimevalNow(&start);
+    for (i = 0; i < npairs; i++) {
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+	    fprintf(stderr, "%s: socketpair: %s\n", pmGetProgname(), osstrerror());
+	    exit(1);
+	}
+	wp[2*i].fd = fds[0];
+	wp[2*i].pair = wp[2*i+1].pair = i;
+	wp[2*i+1].fd = fds[1];
+	if ((sts = pthread_create(&tid[2*i], NULL, sender, &wp[2*i])) != 0 ||
+	    (sts = pthread_create(&tid[2*i+1], NULL, receiver, &wp[2*i+1])) != 0) {
+	    fprintf(stderr, "%s: pthread_create: %s\n", pmGetProgname(), strerror(sts));
+	    exit(1);
+	}
+    }
+    for (i = 0; i < 2 * npairs; i++) {
+	pthread_join(tid[i], NULL);
+	errors += wp[i].errors;
+    }
+    pmtimevalNow(&end);
+
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("%d pairs x %d PDUs: %d errors, %d pinned buffers\n",
+	    npairs, count, errors, alloc);
+    if (!quiet)
+	printf("exchange elapsed %.3f sec, %d free buffers\n",
+		pmtimevalSub(&end, &start), nfree);
+
+    pmtimevalNow(&start);
+    for (i = 0; i < 2 * npairs; i++) {
+	wp[i].pair = i;
+	wp[i].errors = 0;
+	if ((sts = pthread_create(&tid[i], NULL, churner, &wp[i])) != 0) {
+	    fprintf(stderr, "%s: pthread_create: %s\n", pmGetProgname(), strerror(sts));
+	    exit(1);
+	}
+    }
+    for (i = 0; i < 2 * npairs; i++) {
+	pthread_join(tid[i], NULL);
+	errors += wp[i].errors;
+    }
+    pmtimevalNow(&end);
+
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("%d threads x %d buffers: %d errors, %d pinned buffers\n",
+	    2 * npairs, 10 * count, errors, alloc);
+    if (!quiet)
+	printf("churn elapsed %.3f sec, %d free buffers\n",
+		pmtimevalSub(&end, &start), nfree);
+
+    exit(errors || alloc ? 1 : 0);
+}
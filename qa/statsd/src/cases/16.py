@@ -0,0 +1,115 @@
+#!/usr/bin/env pmpython
+# -*- coding: utf-8 -*-
+
+# Compares duration aggregation backends (basic, hdr histogram, ddsketch):
+# - quantile error relative to exact values, checked against accuracy of each backend
+# - aggregation time per datagram, from statsd.pmda.time_spent_aggregating (to stderr)
+# - agent memory growth, from VmRSS of pmdastatsd (to stderr)
+
+import sys
+import socket
+import os
+import math
+import random
+import time
+
+utils_path = os.path.abspath(os.path.join("utils"))
+sys.path.append(utils_path)
+
+import pmdastatsd_test_utils as utils
+
+utils.print_test_file_separator()
+print(os.path.basename(__file__))
+
+ip = "0.0.0.0"
+port = 8125
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+metric_count = 10
+values_per_metric = 10000
+max_payload_size = 1400
+
+backends = [
+    ("basic", utils.configs["duration_aggregation_type"][0], 0.0),
+    ("hdr histogram", utils.configs["duration_aggregation_type"][1], 0.001),
+    ("ddsketch", utils.configs["duration_aggregation_type"][2], 0.01),
+]
+
+quantiles = [
+    ("/median", lambda n: int(math.ceil(n / 2.0 - 1))),
+    ("/percentile90", lambda n: int(math.floor(0.90 * n + 0.5)) - 1),
+    ("/percentile95", lambda n: int(math.floor(0.95 * n + 0.5)) - 1),
+    ("/percentile99", lambda n: int(math.floor(0.99 * n + 0.5)) - 1),
+]
+
+def generate_values():
+    # long tailed latency-like distribution, same for every run
+    rng = random.Random(1729)
+    values = {}
+    for m in range(metric_count):
+        values["bench_duration_{}".format(m)] = [int(rng.lognormvariate(4, 1.5)) + 1 for i in range(values_per_metric)]
+    return values
+
+def send_values(values):
+    lines = []
+    for i in range(values_per_metric):
+        for name in sorted(values.keys()):
+            lines.append("{}:{}|ms".format(name, values[name][i]))
+    payload = ""
+    for line in lines:
+        if len(payload) + len(line) + 1 > max_payload_size:
+            sock.sendto(payload.encode("utf-8"), (ip, port))
+            time.sleep(0.001)
+            payload = ""
+        payload = line if not payload else payload + "\n" + line
+    if payload:
+        sock.sendto(payload.encode("utf-8"), (ip, port))
+
+def get_rss_kb():
+    pid = utils.get_pmdastatsd_pids()[0]
+    f = open("/proc/{}/status".format(pid), "r")
+    rss = 0
+    for line in f:
+        if line.startswith("VmRSS:"):
+            rss = int(line.split()[1])
+    f.close()
+    return rss
+
+def get_value(metric_name):
+    output = utils.request_metric(metric_name)
+    return float(output.split("value ")[-1])
+
+def run_test():
+    values = generate_values()
+    for (name, config, accuracy) in backends:
+        utils.print_test_section_separator()
+        utils.pmdastatsd_install(config)
+        rss_before = get_rss_kb()
+        send_values(values)
+        time.sleep(2)
+        rss_after = get_rss_kb()
+        aggregated = get_value("statsd.pmda.aggregated")
+        time_spent = get_value("statsd.pmda.time_spent_aggregating")
+        print("backend: {}".format(name))
+        print("aggregated all: {}".format(int(aggregated) == metric_count * values_per_metric))
+        worst = {}
+        for metric_name in sorted(values.keys()):
+            instances = utils.get_instances(utils.request_metric("statsd." + metric_name))
+            exact = sorted(values[metric_name])
+            if float(instances["/count"]) != len(exact):
+                print("{}: count {} expected {}".format(metric_name, instances["/count"], len(exact)))
+            for (instance, index) in quantiles:
+                expected = exact[index(len(exact))]
+                error = abs(float(instances[instance]) - expected) / expected
+                worst[instance] = max(worst.get(instance, 0), error)
+        for (instance, index) in quantiles:
+            print("{} within {}% of exact: {}".format(instance, accuracy * 100, worst[instance] <= accuracy + 1e-9))
+        sys.stderr.write("{}: {:.1f} nsec aggregating per datagram, RSS grew by {} KB, worst quantile error {:.4f}%\n".format(
+            name,
+            time_spent / aggregated if aggregated else 0,
+            rss_after - rss_before,
+            max(worst.values()) * 100))
+        utils.pmdastatsd_remove()
+        utils.restore_config()
+
+run_test()
@@ -0,0 +1,106 @@
+#!/usr/bin/env pmpython
+# -*- coding: utf-8 -*-
+
+# Exercises several listener and parser threads (listener_threads, parser_threads):
+# - datagrams from several sockets, spread over the listeners by the kernel
+# - counter, gauge and duration totals must match exact sums, and those of a single threaded agent
+
+import sys
+import socket
+import os
+import time
+
+utils_path = os.path.abspath(os.path.join("utils"))
+sys.path.append(utils_path)
+
+import pmdastatsd_test_utils as utils
+
+utils.print_test_file_separator()
+print(os.path.basename(__file__))
+
+ip = "0.0.0.0"
+port = 8125
+
+sender_count = 8
+datagrams_per_sender = 250
+counter_count = 8
+
+testconfigs = [
+    ("single threaded", utils.configs["worker_threads"][0]),
+    ("4 listeners, 4 parsers", utils.configs["worker_threads"][1]),
+]
+
+def generate_datagrams():
+    # three messages per datagram, same for every run
+    datagrams = []
+    for i in range(datagrams_per_sender):
+        for s in range(sender_count):
+            value = (s + i) % 10 + 1
+            lines = [
+                "test_threads_counter_{}:{}|c".format((s * datagrams_per_sender + i) % counter_count, value),
+                "test_threads_gauge:+{}|g".format(value),
+                "test_threads_duration:{}|ms".format(value),
+            ]
+            datagrams.append((s, "\n".join(lines)))
+    return datagrams
+
+def expected_totals(datagrams):
+    totals = {}
+    for (s, payload) in datagrams:
+        for line in payload.split("\n"):
+            (name, rest) = line.split(":")
+            value = float(rest.split("|")[0])
+            if name == "test_threads_duration":
+                totals[name + "/count"] = totals.get(name + "/count", 0) + 1
+            else:
+                totals[name] = totals.get(name, 0) + value
+    return totals
+
+def send_datagrams(datagrams):
+    socks = [socket.socket(socket.AF_INET, socket.SOCK_DGRAM) for s in range(sender_count)]
+    for (s, payload) in datagrams:
+        socks[s].sendto(payload.encode("utf-8"), (ip, port))
+        time.sleep(0.0005)
+    for sock in socks:
+        sock.close()
+
+def get_value(metric_name):
+    output = utils.request_metric(metric_name)
+    return float(output.split("value ")[-1])
+
+def fetch_totals():
+    totals = {}
+    for c in range(counter_count):
+        name = "test_threads_counter_{}".format(c)
+        totals[name] = float(utils.get_instances(utils.request_metric("statsd." + name))["/"])
+    name = "test_threads_gauge"
+    totals[name] = float(utils.get_instances(utils.request_metric("statsd." + name))["/"])
+    name = "test_threads_duration"
+    totals[name + "/count"] = float(utils.get_instances(utils.request_metric("statsd." + name))["/count"])
+    return totals
+
+def run_test():
+    datagrams = generate_datagrams()
+    expected = expected_totals(datagrams)
+    results = []
+    for (name, config) in testconfigs:
+        utils.print_test_section_separator()
+        utils.pmdastatsd_install(config)
+        send_datagrams(datagrams)
+        time.sleep(2)
+        aggregated = get_value("statsd.pmda.aggregated")
+        totals = fetch_totals()
+        print("threads: {}".format(name))
+        print("aggregated all: {}".format(int(aggregated) == len(datagrams) * 3))
+        print("dropped on full queue: {}".format(int(get_value("statsd.pmda.dropped_queue_full"))))
+        for key in sorted(expected.keys()):
+            if totals[key] != expected[key]:
+                print("{}: {} expected {}".format(key, totals[key], expected[key]))
+        print("totals exact: {}".format(totals == expected))
+        results.append(totals)
+        utils.pmdastatsd_remove()
+        utils.restore_config()
+    utils.print_test_section_separator()
+    print("same totals as single threaded agent: {}".format(results[0] == results[1]))
+
+run_test()
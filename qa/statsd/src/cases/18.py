@@ -0,0 +1,115 @@
+#!/usr/bin/env pmpython
+# -*- coding: utf-8 -*-
+
+# Exercises several aggregator threads over the sharded metrics table (aggregator_threads):
+# - many labelled metrics, so every shard and aggregator is used, fetched from while they are updated
+# - counter totals must match exact sums, and those of a single aggregator
+
+import sys
+import socket
+import os
+import time
+import threading
+
+utils_path = os.path.abspath(os.path.join("utils"))
+sys.path.append(utils_path)
+
+import pmdastatsd_test_utils as utils
+
+utils.print_test_file_separator()
+print(os.path.basename(__file__))
+
+ip = "0.0.0.0"
+port = 8125
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+metric_count = 64
+sender_count = 4
+rounds = 32
+max_payload_size = 1400
+
+testconfigs = [
+    ("1 aggregator", utils.configs["aggregator_threads"][0]),
+    ("4 aggregators", utils.configs["aggregator_threads"][1]),
+]
+
+def generate_lines():
+    # same for every run
+    lines = []
+    for r in range(rounds):
+        for m in range(metric_count):
+            for s in range(sender_count):
+                value = (r + m + s) % 10 + 1
+                lines.append("test_shards_counter_{},sender=s{}:{}|c".format(m, s, value))
+    return lines
+
+def expected_totals(lines):
+    totals = {}
+    for line in lines:
+        (name, rest) = line.split(",")
+        (label, rest) = rest.split(":")
+        key = (name, "/" + label)
+        totals[key] = totals.get(key, 0) + float(rest.split("|")[0])
+    return totals
+
+def send_lines(lines):
+    payload = ""
+    for line in lines:
+        if len(payload) + len(line) + 1 > max_payload_size:
+            sock.sendto(payload.encode("utf-8"), (ip, port))
+            time.sleep(0.001)
+            payload = ""
+        payload = line if not payload else payload + "\n" + line
+    if payload:
+        sock.sendto(payload.encode("utf-8"), (ip, port))
+
+def fetch_while(done):
+    # whole subtree fetches walk every shard while aggregators update them
+    while not done.is_set():
+        try:
+            utils.request_metric("statsd")
+        except Exception:
+            pass
+
+def get_value(metric_name):
+    output = utils.request_metric(metric_name)
+    return float(output.split("value ")[-1])
+
+def fetch_totals():
+    totals = {}
+    for m in range(metric_count):
+        name = "test_shards_counter_{}".format(m)
+        instances = utils.get_instances(utils.request_metric("statsd." + name))
+        for (instance, value) in instances.items():
+            totals[(name, instance)] = float(value)
+    return totals
+
+def run_test():
+    lines = generate_lines()
+    expected = expected_totals(lines)
+    results = []
+    for (name, config) in testconfigs:
+        utils.print_test_section_separator()
+        utils.pmdastatsd_install(config)
+        done = threading.Event()
+        fetcher = threading.Thread(target=fetch_while, args=(done,))
+        fetcher.start()
+        send_lines(lines)
+        time.sleep(2)
+        done.set()
+        fetcher.join()
+        aggregated = get_value("statsd.pmda.aggregated")
+        totals = fetch_totals()
+        print("threads: {}".format(name))
+        print("aggregated all: {}".format(int(aggregated) == len(lines)))
+        for key in sorted(expected.keys()):
+            if totals.get(key) != expected[key]:
+                print("{}{}: {} expected {}".format(key[0], key[1], totals.get(key), expected[key]))
+        print("totals exact: {}".format(totals == expected))
+        results.append(totals)
+        utils.pmdastatsd_remove()
+        utils.restore_config()
+    utils.print_test_section_separator()
+    print("same totals as single aggregator: {}".format(results[0] == results[1]))
+
+run_test()
@@ -53,6 +53,10 @@ duration_aggregation_type = 0
 """
 [global]
 duration_aggregation_type = 1
+""",
+"""
+[global]
+duration_aggregation_type = 2
 """],
 	"max_udp_packet_size": [
 """
@@ -106,6 +110,28 @@ verbose = 1
 """
 [global]
 verbose = 2
+"""],
+	"worker_threads": [
+"""
+[global]
+listener_threads = 1
+parser_threads = 1
+""",
+"""
+[global]
+listener_threads = 4
+parser_threads = 4
+"""],
+	"aggregator_threads": [
+"""
+[global]
+parser_threads = 1
+aggregator_threads = 1
+""",
+"""
+[global]
+parser_threads = 4
+aggregator_threads = 4
 """]
 }
 
@@ -40,6 +40,8 @@ PMI_CALL extern int pmiAddInstance(pmInDom, const char *, int);
 PMI_CALL extern int pmiPutValue(const char *, const char *, const char *);
 PMI_CALL extern int pmiGetHandle(const char *, const char *);
 PMI_CALL extern int pmiPutValueHandle(int, const char *);
+PMI_CALL extern int pmiPutValues(int, const char **, const char **, const char **);
+PMI_CALL extern int pmiPutValueHandles(int, const int *, const char **);
 PMI_CALL extern int pmiWrite(int, int);
 PMI_CALL extern int pmiPutResult(const pmResult *);
 PMI_CALL extern int pmiPutMark(void);
@@ -362,6 +362,8 @@ PCP_CALL extern int __pmDecodeXtendError(__pmPDU *, int *, int *);
 PCP_CALL extern int __pmSendResult(int, int, const pmResult *);
 PCP_CALL extern int __pmEncodeResult(int, const pmResult *, __pmPDU **);
 PCP_CALL extern int __pmDecodeResult(__pmPDU *, pmResult **);
+PCP_CALL extern int __pmDecodeResultPinned(__pmPDU *, pmResult **);
+PCP_CALL extern void __pmFreeResultPinned(pmResult *);
 PCP_CALL extern int __pmSendProfile(int, int, int, pmProfile *);
 PCP_CALL extern int __pmDecodeProfile(__pmPDU *, int *, pmProfile **);
 PCP_CALL extern int __pmSendFetch(int, int, int, pmTimeval *, int, pmID *);
@@ -502,6 +504,42 @@ PCP_CALL extern int __pmHashAdd(unsigned int, void *, __pmHashCtl *);
 PCP_CALL extern int __pmHashDel(unsigned int, void *, __pmHashCtl *);
 PCP_CALL extern void __pmHashClear(__pmHashCtl *);
 
+/*
+ * Chained hash table with nodes allocated from a per-table pool, all
+ * released together by __pmHashPoolClear.  hc may be searched and walked
+ * with the __pmHash* routines above, but entries must only be added and
+ * deleted with these.
+ */
+typedef struct __pmHashPoolCtl {
+    __pmHashCtl		hc;
+    void		*pool;		/* node allocator */
+} __pmHashPoolCtl;
+PCP_CALL extern void __pmHashPoolInit(__pmHashPoolCtl *);
+PCP_CALL extern int __pmHashPoolAdd(unsigned int, void *, __pmHashPoolCtl *);
+PCP_CALL extern int __pmHashPoolDel(unsigned int, void *, __pmHashPoolCtl *);
+PCP_CALL extern void __pmHashPoolWalkCB(__pmHashWalkCallback, void *, __pmHashPoolCtl *);
+PCP_CALL extern void __pmHashPoolClear(__pmHashPoolCtl *);
+
+/*
+ * Open addressing hash table with nodes held inline, in one array.
+ * Node pointers are only valid until the next add or delete.
+ */
+typedef struct __pmHashInlineCtl {
+    int			nodes;
+    int			hsize;		/* power of two, or zero */
+    __pmHashNode	*slots;
+    unsigned short	*probe;		/* 1 + distance from home, 0 if empty */
+    unsigned int	index;
+} __pmHashInlineCtl;
+PCP_CALL extern void __pmHashInlineInit(__pmHashInlineCtl *);
+PCP_CALL extern void __pmHashInlineWalkCB(__pmHashWalkCallback, void *, __pmHashInlineCtl *);
+PCP_CALL extern __pmHashNode *__pmHashInlineWalk(__pmHashInlineCtl *, __pmHashWalkState);
+PCP_CALL extern __pmHashNode *__pmHashInlineSlot(int, __pmHashInlineCtl *);
+PCP_CALL extern __pmHashNode *__pmHashInlineSearch(unsigned int, __pmHashInlineCtl *);
+PCP_CALL extern int __pmHashInlineAdd(unsigned int, void *, __pmHashInlineCtl *);
+PCP_CALL extern int __pmHashInlineDel(unsigned int, void *, __pmHashInlineCtl *);
+PCP_CALL extern void __pmHashInlineClear(__pmHashInlineCtl *);
+
 /*
  * Host specification allowing one or more pmproxy host, and port numbers
  * within the one string, i.e. pmcd host specifications of the form:
@@ -793,7 +831,7 @@ typedef struct {
     void		*ac_want;	/* used in interp.c */
     void		*ac_unbound;	/* used in interp.c */
     void		*ac_cache;	/* used in interp.c */
-    int			ac_cache_idx;	/* used in interp.c */
+    int			ac_cache_idx;	/* unused, keeps the ABI layout */
     /*
      * These were added to the ABI in order to support multiple archives
      * in a single context.
@@ -846,6 +884,7 @@ PCP_CALL extern int __pmLogPutText(__pmArchCtl *, unsigned int , unsigned int, c
 PCP_CALL extern int __pmLogWriteLabel(__pmFILE *, const __pmLogLabel *);
 PCP_CALL extern int __pmLogLoadLabel(__pmArchCtl *, const char *);
 PCP_CALL extern int __pmLogLoadMeta(__pmArchCtl *);
+PCP_CALL extern int __pmLogLoadLazyMeta(__pmArchCtl *);
 PCP_CALL extern int __pmLogAddDesc(__pmArchCtl *, const pmDesc *);
 PCP_CALL extern int __pmLogAddInDom(__pmArchCtl *, const pmTimespec *, const pmInResult *, int *, int);
 PCP_CALL extern int __pmLogAddPMNSNode(__pmArchCtl *, pmID, const char *);
@@ -890,6 +929,7 @@ PCP_CALL extern int __pmFetchLocal(__pmContext *, int, pmID *, pmResult **);
 
 /* safely insert an atom value into a pmValue */
 PCP_CALL extern int __pmStuffValue(const pmAtomValue *, pmValue *, int);
+PCP_CALL extern int __pmStuffPoolValue(const pmAtomValue *, pmValue *, int);
 
 /* Archive context helper. */
 int __pmFindOrOpenArchive(__pmContext *, const char *, int);
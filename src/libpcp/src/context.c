@@ -525,6 +525,7 @@ __pmFindOrOpenArchive(__pmContext *ctxp, const char *name, int multi_arch)
     if (! multi_arch) {
 	__pmArchCtl	*acp2;
 	__pmLogCtl	*lcp2 = NULL;
+	__pmLogPriv	*lpp;
 
 	PM_LOCK(contexts_lock);
 	for (i = 0; i < contexts_len; i++) {
@@ -535,13 +536,16 @@ __pmFindOrOpenArchive(__pmContext *ctxp, const char *name, int multi_arch)
 
 	    /*
 	     * See if there is already an archive opened with this name and
-	     * not part of a multi-archive context.
+	     * not part of a multi-archive context.  Nor with metadata being
+	     * loaded lazily, which changes the hashed metadata on lookups.
 	     */
 	    ctxp2 = contexts[i];
 	    if (ctxp2->c_type == PM_CONTEXT_ARCHIVE) {
 		acp2 = ctxp2->c_archctl;
 		PM_LOCK(acp2->ac_log->l_lock);
 		if (! acp2->ac_log->l_multi &&
+		    ((lpp = __pmLogGetPriv(acp2->ac_log, 0)) == NULL ||
+		     lpp->lp_lazy == NULL) &&
 		    strcmp (name, acp2->ac_log->l_name) == 0) {
 		    lcp2 = acp2->ac_log;
 		    break;
@@ -560,6 +564,7 @@ __pmFindOrOpenArchive(__pmContext *ctxp, const char *name, int multi_arch)
 #ifdef PM_MULTI_THREAD
 		__pmDestroyMutex(&lcp->l_lock);
 #endif
+		__pmLogFreePriv(lcp);
 		free(lcp);
 	    }
 	    ++lcp2->l_refcnt;
@@ -606,6 +611,7 @@ __pmFindOrOpenArchive(__pmContext *ctxp, const char *name, int multi_arch)
 #ifdef PM_MULTI_THREAD
 	__pmDestroyMutex(&lcp->l_lock);
 #endif
+	__pmLogFreePriv(lcp);
 	free(lcp);
 	acp->ac_log = NULL;
     }
@@ -804,6 +810,8 @@ initarchive(__pmContext	*ctxp, const char *name)
     acp->ac_log_list = NULL;
     acp->ac_log = NULL;
     acp->ac_mark_done = 0;
+    __pmHashInit(&acp->ac_pmid_hc);	/* empty hash list */
+    acp->ac_cache = NULL;
 
     /*
      * The list of names may contain one or more directories. Examine the
@@ -943,8 +951,6 @@ initarchive(__pmContext	*ctxp, const char *name)
     acp->ac_offset = sizeof(__pmLogLabel) + 2*sizeof(int);
     acp->ac_vol = acp->ac_curvol;
     acp->ac_serial = 0;		/* not serial access, yet */
-    acp->ac_pmid_hc.nodes = 0;	/* empty hash list */
-    acp->ac_pmid_hc.hsize = 0;
     acp->ac_end = 0.0;
     acp->ac_want = NULL;
     acp->ac_unbound = NULL;
@@ -977,8 +983,10 @@ initarchive(__pmContext	*ctxp, const char *name)
 	    }
 	    free(acp->ac_log_list);
 	}
-	if (acp->ac_log && --acp->ac_log->l_refcnt == 0)
+	if (acp->ac_log && --acp->ac_log->l_refcnt == 0) {
+	    __pmLogFreePriv(acp->ac_log);
 	    free(acp->ac_log);
+	}
 	free(acp);
     }
     ctxp->c_archctl = NULL;
@@ -1458,8 +1466,7 @@ pmDupContext(void)
 	 * __pmFreeInterpData() to trash our hash list and read cache.
 	 * Start with an empty hash list and read cache for the dup'd context.
 	 */
-	newcon->c_archctl->ac_pmid_hc.nodes = 0;
-	newcon->c_archctl->ac_pmid_hc.hsize = 0;
+	__pmHashInit(&newcon->c_archctl->ac_pmid_hc);
 	newcon->c_archctl->ac_cache = NULL;
 
 	/*
@@ -46,7 +46,7 @@ typedef struct {			/* for instance filtering */
     regex_t		regex;		/* compiled regex if ftype = F_REGEX */
 
     int			invert;		/* 0 for regex match, 1 for not regex match */
-    __pmHashCtl		hash;		/* instance hash table for ftype == F_REGEX */
+    __pmHashPoolCtl	hash;		/* instance hash table for ftype == F_REGEX */
     int			used;		/* node fetch counter for garbage collection */
 } pattern_t;
 
@@ -628,16 +628,16 @@ regex_inst_gc(pattern_t *pp)
     instctl_t		*icp;
     if (pmDebugOptions.derive && pmDebugOptions.appl2)
 	fprintf(stderr, "regex_inst_gc(" PRINTF_P_PFX "%p)", pp);
-    for (hnp = __pmHashWalk(&pp->hash, PM_HASH_WALK_START);
+    for (hnp = __pmHashWalk(&pp->hash.hc, PM_HASH_WALK_START);
 	 hnp != NULL;
-	 hnp = __pmHashWalk(&pp->hash, PM_HASH_WALK_NEXT)) {
+	 hnp = __pmHashWalk(&pp->hash.hc, PM_HASH_WALK_NEXT)) {
 	numinst++;
 	icp = (instctl_t *)hnp->data;
 	if (icp->used < REGEX_INST_COMPACT / 2) {
 	    int		sts;
-	    sts = __pmHashDel(icp->inst, hnp->data, &pp->hash);
+	    sts = __pmHashPoolDel(icp->inst, hnp->data, &pp->hash);
 	    if (sts < 0) {
-		fprintf(stderr, "botch: __pmHashDel: failed for inst=%d\n", icp->inst);
+		fprintf(stderr, "botch: __pmHashPoolDel: failed for inst=%d\n", icp->inst);
 	    }
 	    free(icp);
 	    numcull++;
@@ -1483,7 +1483,7 @@ eval_expr(__pmContext *ctxp, node_t *np, pmResult *rp, int level)
 		    instctl_t		*ip;
 		    char		*iname;
 		    char		*q;
-		    if ((hp = __pmHashSearch(np->right->data.info->ivlist[i].inst, &np->left->data.pattern->hash)) == NULL) {
+		    if ((hp = __pmHashSearch(np->right->data.info->ivlist[i].inst, &np->left->data.pattern->hash.hc)) == NULL) {
 			/* first time we've seen this inst for this expr node */
 			if ((ip = (instctl_t *)malloc(sizeof(instctl_t))) == NULL) {
 			    pmNoMem("eval_expr: inst_ctl", sizeof(instctl_t), PM_FATAL_ERR);
@@ -1530,12 +1530,12 @@ eval_expr(__pmContext *ctxp, node_t *np, pmResult *rp, int level)
 			    }
 			    ip->match = 0;
 			}
-			if ((sts = __pmHashAdd(np->right->data.info->ivlist[i].inst, (void *)ip, &np->left->data.pattern->hash)) < 0) {
+			if ((sts = __pmHashPoolAdd(np->right->data.info->ivlist[i].inst, (void *)ip, &np->left->data.pattern->hash)) < 0) {
 			    /* also, should not happen */
 			    if (pmDebugOptions.derive && pmDebugOptions.appl2) {
 				char	errmsg[PM_MAXERRMSGLEN];
 				fprintf(stderr, "eval_expr: expr node " PRINTF_P_PFX "%p type=%s", np, __dmnode_type_str(np->type));
-				fprintf(stderr, " __pmHashAdd(%d, ...) failed:",
+				fprintf(stderr, " __pmHashPoolAdd(%d, ...) failed:",
 				    np->right->data.info->ivlist[i].inst);
 				fprintf(stderr, " %s\n", pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 			    }
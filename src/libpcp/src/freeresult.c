@@ -15,6 +15,7 @@
 
 #include "pmapi.h"
 #include "libpcp.h"
+#include "internal.h"
 
 /* Free result buffer routines */
 
@@ -44,7 +45,8 @@ __pmFreeResultValueSets(pmValueSet **ppvstart, pmValueSet **ppvsend)
 			pvs->vlist[j].value.pval,
 			pmIDStr_r(pvs->pmid, strbuf, sizeof(strbuf)),
 			pvs->vlist[j].inst);
-		free(pvs->vlist[j].value.pval);
+		if (!__pmFreePoolValue(pvs->vlist[j].value.pval))
+		    free(pvs->vlist[j].value.pval);
 	    }
 	}
 	if (pmDebugOptions.pdubuf)
@@ -15,7 +15,45 @@
 
 #include "pmapi.h"
 #include "libpcp.h"
+#include "internal.h"
 #include <stddef.h>
+#include <limits.h>
+
+/*
+ * Besides the chained __pmHashCtl tables, there are two variants with
+ * their own types (so the layout of __pmHashCtl, which is embedded in
+ * many other structures, is unchanged) and entry points.
+ *
+ * __pmHashPoolCtl tables are chained, but their nodes come from a
+ * per-table pool rather than malloc, and are all released at once by
+ * __pmHashPoolClear().  Clients must not free() nodes of these tables.
+ *
+ * __pmHashInlineCtl tables use open addressing with Robin Hood insertion
+ * and backward-shift deletion, holding every __pmHashNode inline in one
+ * array (slots) - no per-entry allocation, and lookups touch adjacent
+ * memory.  probe[i] is one more than the distance of slot i from its
+ * home slot, or zero if empty, and node pointers are only stable until
+ * the next add or delete.
+ */
+#define INLINE_MINSIZE	8
+#define INLINE_DELETED(hp)	((hp)->next != NULL)
+
+static __pmHashNode *
+node_alloc(__pmPool *pp)
+{
+    if (pp == NULL)
+	return (__pmHashNode *)malloc(sizeof(__pmHashNode));
+    return (__pmHashNode *)__pmPoolAlloc(pp);
+}
+
+static void
+node_free(__pmPool *pp, __pmHashNode *hp)
+{
+    if (pp == NULL)
+	free(hp);
+    else
+	__pmPoolFree(pp, hp);
+}
 
 void
 __pmHashInit(__pmHashCtl *hcp)
@@ -54,8 +92,8 @@ __pmHashSearch(unsigned int key, __pmHashCtl *hcp)
     return NULL;
 }
 
-int
-__pmHashAdd(unsigned int key, void *data, __pmHashCtl *hcp)
+static int
+hash_add(unsigned int key, void *data, __pmHashCtl *hcp, __pmPool *pp)
 {
     __pmHashNode    *hp;
     int		k;
@@ -98,7 +136,7 @@ __pmHashAdd(unsigned int key, void *data, __pmHashCtl *hcp)
 	free(old);
     }
 
-    if ((hp = (__pmHashNode *)malloc(sizeof(__pmHashNode))) == NULL)
+    if ((hp = node_alloc(pp)) == NULL)
 	return -oserror();
 
     k = key % hcp->hsize;
@@ -111,7 +149,13 @@ __pmHashAdd(unsigned int key, void *data, __pmHashCtl *hcp)
 }
 
 int
-__pmHashDel(unsigned int key, void *data, __pmHashCtl *hcp)
+__pmHashAdd(unsigned int key, void *data, __pmHashCtl *hcp)
+{
+    return hash_add(key, data, hcp, NULL);
+}
+
+static int
+hash_del(unsigned int key, void *data, __pmHashCtl *hcp, __pmPool *pp)
 {
     __pmHashNode    *hp;
     __pmHashNode    *lhp = NULL;
@@ -125,7 +169,7 @@ __pmHashDel(unsigned int key, void *data, __pmHashCtl *hcp)
 		hcp->hash[key % hcp->hsize] = hp->next;
 	    else
 		lhp->next = hp->next;
-	    free(hp);
+	    node_free(pp, hp);
 	    return 1;
 	}
 	lhp = hp;
@@ -134,6 +178,12 @@ __pmHashDel(unsigned int key, void *data, __pmHashCtl *hcp)
     return 0;
 }
 
+int
+__pmHashDel(unsigned int key, void *data, __pmHashCtl *hcp)
+{
+    return hash_del(key, data, hcp, NULL);
+}
+
 void
 __pmHashClear(__pmHashCtl *hcp)
 {
@@ -144,14 +194,9 @@ __pmHashClear(__pmHashCtl *hcp)
     }
 }
 
-/*
- * Iterate over the entire hash table.  For each entry, call *cb,
- * passing *cdata and the current key/value pair.  The function's
- * return value decides how to continue or abort iteration.  The
- * callback function must not modify the hash table.
- */
-void
-__pmHashWalkCB(__pmHashWalkCallback cb, void *cdata, const __pmHashCtl *hcp)
+static void
+hash_walk_cb(__pmHashWalkCallback cb, void *cdata, const __pmHashCtl *hcp,
+		__pmPool *pp)
 {
     int n;
 
@@ -165,7 +210,7 @@ __pmHashWalkCB(__pmHashWalkCallback cb, void *cdata, const __pmHashCtl *hcp)
             switch (state) {
             case PM_HASH_WALK_DELETE_STOP:
                 *tpp = tp->next;  /* unlink */
-                free(tp);         /* delete */
+                node_free(pp, tp); /* delete */
                 return;           /* & stop */
 
             case PM_HASH_WALK_NEXT:
@@ -178,7 +223,7 @@ __pmHashWalkCB(__pmHashWalkCallback cb, void *cdata, const __pmHashCtl *hcp)
                 /* NB: do not change tpp.  It will still point at the previous
                  * node's "next" pointer.  Consider consecutive CONTINUE_DELETEs.
                  */
-                free(tp);         /* delete */
+                node_free(pp, tp); /* delete */
                 tp = *tpp; /* == tp->next, except that tp is already freed. */
                 break;            /* & next */
 
@@ -190,6 +235,18 @@ __pmHashWalkCB(__pmHashWalkCallback cb, void *cdata, const __pmHashCtl *hcp)
     }
 }
 
+/*
+ * Iterate over the entire hash table.  For each entry, call *cb,
+ * passing *cdata and the current key/value pair.  The function's
+ * return value decides how to continue or abort iteration.  The
+ * callback function must not modify the hash table.
+ */
+void
+__pmHashWalkCB(__pmHashWalkCallback cb, void *cdata, const __pmHashCtl *hcp)
+{
+    hash_walk_cb(cb, cdata, hcp, NULL);
+}
+
 /*
  * Walk a hash table; state flow is START ... NEXT ... NEXT ...
  */
@@ -217,3 +274,301 @@ __pmHashWalk(__pmHashCtl *hcp, __pmHashWalkState state)
     hcp->next = node->next;
     return node;
 }
+
+void
+__pmHashPoolInit(__pmHashPoolCtl *hpp)
+{
+    memset(hpp, 0, sizeof(*hpp));
+}
+
+int
+__pmHashPoolAdd(unsigned int key, void *data, __pmHashPoolCtl *hpp)
+{
+    __pmPool	*pp = (__pmPool *)hpp->pool;
+
+    if (pp == NULL) {
+	if ((pp = (__pmPool *)malloc(sizeof(__pmPool))) == NULL)
+	    return -oserror();
+	__pmPoolInit(pp, "__pmHashNode", sizeof(__pmHashNode));
+	hpp->pool = (void *)pp;
+    }
+    return hash_add(key, data, &hpp->hc, pp);
+}
+
+int
+__pmHashPoolDel(unsigned int key, void *data, __pmHashPoolCtl *hpp)
+{
+    return hash_del(key, data, &hpp->hc, (__pmPool *)hpp->pool);
+}
+
+void
+__pmHashPoolWalkCB(__pmHashWalkCallback cb, void *cdata, __pmHashPoolCtl *hpp)
+{
+    hash_walk_cb(cb, cdata, &hpp->hc, (__pmPool *)hpp->pool);
+}
+
+/* Release the table and all of its nodes */
+void
+__pmHashPoolClear(__pmHashPoolCtl *hpp)
+{
+    __pmHashClear(&hpp->hc);
+    hpp->hc.nodes = 0;
+    if (hpp->pool != NULL) {
+	__pmPoolClear((__pmPool *)hpp->pool);
+	free(hpp->pool);
+	hpp->pool = NULL;
+    }
+}
+
+void
+__pmHashInlineInit(__pmHashInlineCtl *hcp)
+{
+    memset(hcp, 0, sizeof(*hcp));
+}
+
+static unsigned int
+inline_home(unsigned int key, int hsize)
+{
+    /* small keys map to themselves, keeping dense instance ids in order */
+    return (key ^ (key >> 10) ^ (key >> 22)) & (hsize - 1);
+}
+
+/*
+ * Insert key/data, displacing entries closer to their home slot.
+ * Returns 0 if a probe sequence became too long, in which case
+ * *key and *data hold the entry still to be placed.
+ */
+static int
+inline_insert(unsigned int *key, void **data, __pmHashInlineCtl *hcp)
+{
+    __pmHashNode	tmp;
+    unsigned int	i = inline_home(*key, hcp->hsize);
+    unsigned int	dist = 1, d;
+
+    for (;;) {
+	if (hcp->probe[i] == 0) {
+	    hcp->slots[i].next = NULL;
+	    hcp->slots[i].key = *key;
+	    hcp->slots[i].data = *data;
+	    hcp->probe[i] = dist;
+	    return 1;
+	}
+	if (hcp->probe[i] < dist) {
+	    tmp = hcp->slots[i];
+	    hcp->slots[i].key = *key;
+	    hcp->slots[i].data = *data;
+	    *key = tmp.key;
+	    *data = tmp.data;
+	    d = hcp->probe[i];
+	    hcp->probe[i] = dist;
+	    dist = d;
+	}
+	i = (i + 1) & (hcp->hsize - 1);
+	if (++dist == USHRT_MAX)
+	    return 0;
+    }
+}
+
+static int
+inline_resize(int hsize, __pmHashInlineCtl *hcp)
+{
+    __pmHashNode	*oldslots = hcp->slots;
+    unsigned short	*oldprobe = hcp->probe;
+    int			oldsize = hcp->hsize;
+    unsigned int	key;
+    void		*data;
+    char		*p;
+    int			i;
+
+    if ((p = calloc(hsize, sizeof(__pmHashNode) + sizeof(unsigned short))) == NULL)
+	return -oserror();
+    hcp->slots = (__pmHashNode *)p;
+    hcp->probe = (unsigned short *)(p + hsize * sizeof(__pmHashNode));
+    hcp->hsize = hsize;
+
+    for (i = 0; i < oldsize; i++) {
+	if (oldprobe[i] == 0)
+	    continue;
+	key = oldslots[i].key;
+	data = oldslots[i].data;
+	if (inline_insert(&key, &data, hcp) == 0) {
+	    /* pathological keys, try again with a larger table */
+	    free(hcp->slots);
+	    hcp->slots = oldslots;
+	    hcp->probe = oldprobe;
+	    hcp->hsize = oldsize;
+	    return inline_resize(hsize * 2, hcp);
+	}
+    }
+    free(oldslots);
+    return 0;
+}
+
+int
+__pmHashInlinePreAlloc(int hsize, __pmHashInlineCtl *hcp)
+{
+    int		size = INLINE_MINSIZE;
+
+    while (size < INT_MAX / 2 && size * 7 < hsize * 8)
+	size *= 2;
+    return size > hcp->hsize ? inline_resize(size, hcp) : 0;
+}
+
+__pmHashNode *
+__pmHashInlineSearch(unsigned int key, __pmHashInlineCtl *hcp)
+{
+    unsigned int	i, dist = 1;
+
+    if (hcp->hsize == 0)
+	return NULL;
+
+    /* stop at an empty slot, or one nearer its home than we are to ours */
+    i = inline_home(key, hcp->hsize);
+    while (hcp->probe[i] >= dist) {
+	if (hcp->slots[i].key == key)
+	    return &hcp->slots[i];
+	i = (i + 1) & (hcp->hsize - 1);
+	dist++;
+    }
+    return NULL;
+}
+
+int
+__pmHashInlineAdd(unsigned int key, void *data, __pmHashInlineCtl *hcp)
+{
+    int		sts;
+
+    if (hcp->hsize == 0)
+	sts = inline_resize(INLINE_MINSIZE, hcp);
+    else if ((hcp->nodes + 1) * 8 > hcp->hsize * 7)	/* load factor 7/8 */
+	sts = inline_resize(hcp->hsize * 2, hcp);
+    else
+	sts = 0;
+    if (sts < 0)
+	return sts;
+
+    while (inline_insert(&key, &data, hcp) == 0) {
+	if ((sts = inline_resize(hcp->hsize * 2, hcp)) < 0)
+	    return sts;
+    }
+    hcp->nodes++;
+    return 1;
+}
+
+static void
+inline_remove(unsigned int i, __pmHashInlineCtl *hcp)
+{
+    unsigned int	next;
+
+    for (;;) {
+	next = (i + 1) & (hcp->hsize - 1);
+	if (hcp->probe[next] <= 1)
+	    break;
+	hcp->slots[i] = hcp->slots[next];
+	hcp->probe[i] = hcp->probe[next] - 1;
+	i = next;
+    }
+    memset(&hcp->slots[i], 0, sizeof(__pmHashNode));
+    hcp->probe[i] = 0;
+    hcp->nodes--;
+}
+
+int
+__pmHashInlineDel(unsigned int key, void *data, __pmHashInlineCtl *hcp)
+{
+    unsigned int	i, dist = 1;
+
+    if (hcp->hsize == 0)
+	return 0;
+
+    i = inline_home(key, hcp->hsize);
+    while (hcp->probe[i] >= dist) {
+	if (hcp->slots[i].key == key && hcp->slots[i].data == data) {
+	    inline_remove(i, hcp);
+	    return 1;
+	}
+	i = (i + 1) & (hcp->hsize - 1);
+	dist++;
+    }
+    return 0;
+}
+
+/*
+ * The node held in slot i, if any - the counterpart of hash[i] for a
+ * chained table, so the same loops work for both (next is NULL here).
+ */
+__pmHashNode *
+__pmHashInlineSlot(int i, __pmHashInlineCtl *hcp)
+{
+    return hcp->probe[i] != 0 ? &hcp->slots[i] : NULL;
+}
+
+void
+__pmHashInlineClear(__pmHashInlineCtl *hcp)
+{
+    if (hcp->slots != NULL)
+	free(hcp->slots);	/* probe[] is in the same allocation */
+    hcp->slots = NULL;
+    hcp->probe = NULL;
+    hcp->hsize = hcp->nodes = 0;
+}
+
+/*
+ * Deletions during __pmHashInlineWalkCB are deferred until the walk
+ * completes, as backward-shift deletion would otherwise move unvisited
+ * entries into visited slots (and vice versa, at the wrap point).
+ * Entries only ever move to a lower slot, or wrap from slot zero to the
+ * last slot, so one ascending pass finds all marked entries.  The mark
+ * (a non-NULL next, which is otherwise unused here) is carried along as
+ * entries shift.
+ */
+void
+__pmHashInlineWalkCB(__pmHashWalkCallback cb, void *cdata, __pmHashInlineCtl *hcp)
+{
+    __pmHashWalkState	state = PM_HASH_WALK_NEXT;
+    int			deleted = 0;
+    int			i;
+
+    for (i = 0; i < hcp->hsize && state != PM_HASH_WALK_STOP; i++) {
+	if (hcp->probe[i] == 0)
+	    continue;
+	state = (*cb)(&hcp->slots[i], cdata);
+	switch (state) {
+	case PM_HASH_WALK_DELETE_STOP:
+	    state = PM_HASH_WALK_STOP;
+	    /* FALLTHROUGH */
+	case PM_HASH_WALK_DELETE_NEXT:
+	    hcp->slots[i].next = &hcp->slots[i];
+	    deleted++;
+	    break;
+	case PM_HASH_WALK_NEXT:
+	    break;
+	case PM_HASH_WALK_STOP:
+	default:
+	    state = PM_HASH_WALK_STOP;
+	    break;
+	}
+    }
+
+    for (i = 0; deleted > 0 && i < hcp->hsize; i++) {
+	while (hcp->probe[i] != 0 && INLINE_DELETED(&hcp->slots[i])) {
+	    inline_remove(i, hcp);
+	    deleted--;
+	}
+    }
+}
+
+/*
+ * Walk an inline hash table; state flow is START ... NEXT ... NEXT ...
+ */
+__pmHashNode *
+__pmHashInlineWalk(__pmHashInlineCtl *hcp, __pmHashWalkState state)
+{
+    if (state == PM_HASH_WALK_START)
+	hcp->index = 0;
+    while (hcp->index < (unsigned int)hcp->hsize) {
+	if (hcp->probe[hcp->index++] != 0)
+	    return &hcp->slots[hcp->index - 1];
+    }
+    return NULL;
+}
@@ -149,6 +149,7 @@ extern int __pmIsConfigLock(void *) _PCP_HIDDEN;
 extern int __pmIsFaultLock(void *) _PCP_HIDDEN;
 extern int __pmIsPduLock(void *) _PCP_HIDDEN;
 extern int __pmIsPdubufLock(void *) _PCP_HIDDEN;
+extern int __pmIsStuffvalueLock(void *) _PCP_HIDDEN;
 extern int __pmIsUtilLock(void *) _PCP_HIDDEN;
 extern int __pmIsContextsLock(void *) _PCP_HIDDEN;
 extern int __pmIsIpcLock(void *) _PCP_HIDDEN;
@@ -388,6 +389,7 @@ extern __pmSockAddr *__pmSockAddrFirstSubnetAddr(const __pmSockAddr *, int) _PCP
 extern __pmSockAddr *__pmSockAddrNextSubnetAddr(__pmSockAddr *, int) _PCP_HIDDEN;
 
 extern int __pmHashPreAlloc(int, __pmHashCtl *) _PCP_HIDDEN;
+extern int __pmHashInlinePreAlloc(int, __pmHashInlineCtl *) _PCP_HIDDEN;
 
 extern int __pmConnectPMCD(pmHostSpec *, int, int, __pmHashCtl *) _PCP_HIDDEN;
 
@@ -413,6 +415,25 @@ extern int __pmLogChangeArchive(__pmContext *, int) _PCP_HIDDEN;
 extern int __pmLogChangeToNextArchive(__pmLogCtl **) _PCP_HIDDEN;
 extern int __pmLogChangeToPreviousArchive(__pmLogCtl **) _PCP_HIDDEN;
 
+/*
+ * Archive reading state private to libpcp, kept out of __pmLogCtl so
+ * that its layout is unchanged.  Found from the __pmLogCtl with
+ * __pmLogGetPriv() and, once found, protected by that l_lock.
+ */
+typedef struct {
+    __pmLogCtl		*lp_lcp;	/* owner */
+    int			lp_tiorder;	/* l_ti[] is in time, volume and */
+					/*   offset order */
+    struct __pmLogLazy	*lp_lazy;	/* metadata records not yet decoded */
+    __pmHashCtl		lp_hashindomtime; /* time index for each indom in */
+					/*   l_hashindom */
+} __pmLogPriv;
+
+extern __pmLogPriv *__pmLogGetPriv(__pmLogCtl *, int) _PCP_HIDDEN;
+extern void __pmLogFreePriv(__pmLogCtl *) _PCP_HIDDEN;
+extern void __pmLogFreeLazyMeta(__pmLogPriv *) _PCP_HIDDEN;
+extern void __pmLogFreeInDomTime(__pmLogPriv *) _PCP_HIDDEN;
+
 /* DSO PMDA helpers */
 struct __pmDSO;			/* opaque, real definition in pmda.h */
 extern struct __pmDSO *__pmLookupDSO(int) _PCP_HIDDEN;
@@ -442,4 +463,29 @@ extern int __pmRecvLabel(int, __pmContext *, int, int *, int *,
 			 pmLabelSet **, int *) _PCP_HIDDEN;
 extern char *__pmLabelFlagString(int, char *, int) _PCP_HIDDEN;
 
+/* fixed-size object pools, see pool.c */
+typedef struct __pmPoolSlab {
+    char	*base;		/* slab address */
+    void	*free;		/* released objects, linked through first word */
+    int		inuse;		/* objects allocated from this slab */
+} __pmPoolSlab;
+typedef struct __pmPool {
+    const char	*name;		/* for diagnostics */
+    size_t	size;		/* object size, rounded up for alignment */
+    int		nper;		/* objects per slab */
+    int		nslab;		/* slabs allocated */
+    int		maxslab;	/* size of slab[] */
+    int		nempty;		/* slabs with no objects in use */
+    int		cur;		/* slab[] to allocate from, or -1 */
+    __pmPoolSlab *slab;		/* slabs, in address order */
+    unsigned long	nalloc;	/* allocations */
+    unsigned long	nhit;	/* allocations from the current slab */
+} __pmPool;
+extern void __pmPoolInit(__pmPool *, const char *, size_t) _PCP_HIDDEN;
+extern void *__pmPoolAlloc(__pmPool *) _PCP_HIDDEN;
+extern int __pmPoolFree(__pmPool *, void *) _PCP_HIDDEN;
+extern int __pmPoolOwns(const __pmPool *, const void *) _PCP_HIDDEN;
+extern void __pmPoolClear(__pmPool *) _PCP_HIDDEN;
+extern int __pmFreePoolValue(pmValueBlock *) _PCP_HIDDEN;
+
 #endif /* _LIBPCP_INTERNAL_H */
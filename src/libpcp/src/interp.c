@@ -18,9 +18,9 @@
  * non-atomic updates ... we've decided that it is acceptable for their
  * values to be subject to possible (but unlikely) missed updates
  *
- * the one-trip initialization of ignore_mark_records and ignore_mark_gap
- * is not guarded as the same value would result from concurrent repeated
- * execution
+ * the one-trip initialization of ignore_mark_records, ignore_mark_gap and
+ * numcache is not guarded as the same value would result from concurrent
+ * repeated execution
  */
 
 /*
@@ -102,21 +102,49 @@ typedef struct pmidcntl {		/* metric control */
     int			valfmt;		/* used to build result */
     int			numval;		/* number of instances in this result */
     int			last_numval;	/* number of instances in previous result */
-    __pmHashCtl		hc;		/* metric-instances */
+    __pmHashInlineCtl	hc;		/* metric-instances */
 } pmidcntl_t;
 
+/*
+ * Read cache of recent __pmLogRead results, so that the backwards and
+ * forwards scans around the requested time do not repeatedly re-read
+ * and decode the same records.  Entries are found via hash chains on
+ * (archive, volume, offset) - keyed by the offset before the record
+ * for forward reads and after it for backward reads - and are recycled
+ * in least recently used order.
+ */
 typedef struct {
     pmResult	*rp;		/* cached pmResult from __pmLogRead */
     int		sts;		/* from __pmLogRead */
-    char	*c_name;	/* log name */
+    int		valid;		/* entry is in the hash chains */
+    int		arch;		/* archive index (ac_cur_log) */
     int		vol;		/* log volume */
     long	head_posn;	/* posn in file before forwards __pmLogRead */
     long	tail_posn;	/* posn in file after forwards __pmLogRead */
     int		mode;		/* PM_MODE_FORW or PM_MODE_BACK */
-    int		used;		/* used count for LFU replacement */
+    int		next[2];	/* hash chains, on head_posn and tail_posn */
+    int		lru_prev;	/* more recently used entry */
+    int		lru_next;	/* less recently used entry */
 } cache_t;
 
-#define NUMCACHE 4
+typedef struct {
+    int		nentry;		/* number of cache entries */
+    int		nbucket;	/* number of hash buckets (power of 2) */
+    int		lru_head;	/* most recently used entry */
+    int		lru_tail;	/* least recently used entry */
+    long	hits;		/* hit/miss/reuse counters for this context */
+    long	misses;
+    long	evicts;
+    long	bypass;		/* misses not worth caching */
+    pmResult	*uncached;	/* result of the last bypassed read */
+    cache_t	*entry;		/* [nentry] */
+    int		*bucket[2];	/* [nbucket] chain heads, head/tail posn */
+} cachectl_t;
+
+#define CACHE_HEAD	0
+#define CACHE_TAIL	1
+#define DEF_NUMCACHE	16
+#define MIN_NUMCACHE	4
 
 /*
  * diagnostic counters ... indexed by PM_MODE_FORW (2) and
@@ -125,6 +153,140 @@ typedef struct {
 static long	nr_cache[PM_MODE_BACK+1];
 static long	nr[PM_MODE_BACK+1];
 
+static int	numcache = -1;	/* read cache entries per context */
+
+static unsigned int
+cache_hash(cachectl_t *ccp, int arch, int vol, long posn)
+{
+    __uint64_t	key;
+
+    key = ((__uint64_t)posn << 16) ^ ((__uint64_t)vol << 8) ^ arch;
+    key *= 0x9e3779b97f4a7c15ULL;
+    return (unsigned int)(key >> 32) & (ccp->nbucket - 1);
+}
+
+static void
+cache_unlink_lru(cachectl_t *ccp, int i)
+{
+    cache_t	*cp = &ccp->entry[i];
+
+    if (cp->lru_prev >= 0)
+	ccp->entry[cp->lru_prev].lru_next = cp->lru_next;
+    else
+	ccp->lru_head = cp->lru_next;
+    if (cp->lru_next >= 0)
+	ccp->entry[cp->lru_next].lru_prev = cp->lru_prev;
+    else
+	ccp->lru_tail = cp->lru_prev;
+}
+
+/* make entry i the most recently used */
+static void
+cache_touch(cachectl_t *ccp, int i)
+{
+    cache_t	*cp = &ccp->entry[i];
+
+    if (ccp->lru_head == i)
+	return;
+    cache_unlink_lru(ccp, i);
+    cp->lru_prev = -1;
+    cp->lru_next = ccp->lru_head;
+    ccp->entry[ccp->lru_head].lru_prev = i;
+    ccp->lru_head = i;
+}
+
+static void
+cache_unhash(cachectl_t *ccp, int i)
+{
+    cache_t	*cp = &ccp->entry[i];
+    long	posn;
+    int		*np;
+    int		k;
+
+    for (k = CACHE_HEAD; k <= CACHE_TAIL; k++) {
+	posn = (k == CACHE_HEAD) ? cp->head_posn : cp->tail_posn;
+	np = &ccp->bucket[k][cache_hash(ccp, cp->arch, cp->vol, posn)];
+	while (*np >= 0 && *np != i)
+	    np = &ccp->entry[*np].next[k];
+	if (*np == i)
+	    *np = cp->next[k];
+    }
+    cp->valid = 0;
+}
+
+static void
+cache_hash_add(cachectl_t *ccp, int i)
+{
+    cache_t	*cp = &ccp->entry[i];
+    unsigned int h;
+
+    h = cache_hash(ccp, cp->arch, cp->vol, cp->head_posn);
+    cp->next[CACHE_HEAD] = ccp->bucket[CACHE_HEAD][h];
+    ccp->bucket[CACHE_HEAD][h] = i;
+    h = cache_hash(ccp, cp->arch, cp->vol, cp->tail_posn);
+    cp->next[CACHE_TAIL] = ccp->bucket[CACHE_TAIL][h];
+    ccp->bucket[CACHE_TAIL][h] = i;
+    cp->valid = 1;
+}
+
+/*
+ * Cache size comes from $PCP_INTERP_CACHE_SIZE if set, else the default;
+ * zero disables caching, so every read is bypassed.
+ * The control structure, entries and hash buckets are one allocation.
+ */
+static cachectl_t *
+cache_alloc(void)
+{
+    cachectl_t	*ccp;
+    size_t	need;
+    int		nbucket;
+    int		i;
+
+    if (numcache == -1) {
+	/* one-trip initialization */
+	char	*str;
+	int	n = DEF_NUMCACHE;
+
+	PM_LOCK(__pmLock_extcall);
+	str = getenv("PCP_INTERP_CACHE_SIZE");		/* THREADSAFE */
+	if (str != NULL) {
+	    char	*end;
+	    long	val = strtol(str, &end, 10);
+	    if (*end != '\0' || end == str ||
+		(val != 0 && val < MIN_NUMCACHE) ||
+		val > INT_MAX / 4)
+		fprintf(stderr, "%s: Warning: bad $PCP_INTERP_CACHE_SIZE (%s), using %d\n",
+			pmGetProgname(), str, n);
+	    else
+		n = (int)val;
+	}
+	PM_UNLOCK(__pmLock_extcall);
+	numcache = n;
+    }
+
+    for (nbucket = 1; nbucket < 2 * numcache; nbucket <<= 1)
+	;
+    need = sizeof(cachectl_t) + numcache * sizeof(cache_t) +
+	   2 * nbucket * sizeof(int);
+    if ((ccp = (cachectl_t *)calloc(1, need)) == NULL)
+	return NULL;
+    ccp->nentry = numcache;
+    ccp->nbucket = nbucket;
+    ccp->entry = (cache_t *)&ccp[1];
+    ccp->bucket[CACHE_HEAD] = (int *)&ccp->entry[numcache];
+    ccp->bucket[CACHE_TAIL] = &ccp->bucket[CACHE_HEAD][nbucket];
+    for (i = 0; i < nbucket; i++)
+	ccp->bucket[CACHE_HEAD][i] = ccp->bucket[CACHE_TAIL][i] = -1;
+    for (i = 0; i < numcache; i++) {
+	ccp->entry[i].next[CACHE_HEAD] = ccp->entry[i].next[CACHE_TAIL] = -1;
+	ccp->entry[i].lru_prev = i - 1;
+	ccp->entry[i].lru_next = (i == numcache - 1) ? -1 : i + 1;
+    }
+    ccp->lru_head = 0;
+    ccp->lru_tail = numcache - 1;
+    return ccp;
+}
+
 /*
  * called with the context lock held
  */
@@ -134,12 +296,14 @@ cache_read(__pmContext *ctxp, int mode, pmResult **rp)
     __pmArchCtl	*acp = ctxp->c_archctl;
     long	posn;
     cache_t	*cp;
-    cache_t	*lfup;
-    cache_t	*cache;
-    char	*save_curlog_name;
+    cache_t	*lrup;
+    cachectl_t	*ccp;
+    pmResult	*logrp;
+    int		key = (mode == PM_MODE_FORW) ? CACHE_HEAD : CACHE_TAIL;
     int		sts;
+    int		i;
     int		save_curvol;
-    int		archive_changed;
+    int		save_curlog;
 
     /*
      * If the previous __pmLogRead generated a virtual MARK record and we have
@@ -161,13 +325,11 @@ cache_read(__pmContext *ctxp, int mode, pmResult **rp)
 
     if (acp->ac_cache == NULL) {
 	/* cache initialization */
-	acp->ac_cache = cache = (cache_t *)calloc(NUMCACHE, sizeof(cache_t));
-	if (!cache)
+	if ((acp->ac_cache = ccp = cache_alloc()) == NULL)
 	    return -ENOMEM;
-	acp->ac_cache_idx = 0;
     }
     else
-	cache = acp->ac_cache;
+	ccp = (cachectl_t *)acp->ac_cache;
 
     if (pmDebugOptions.log && pmDebugOptions.desperate) {
 	fprintf(stderr, "cache_read: fd=%d mode=%s vol=%d (curvol=%d) %s_posn=%ld ",
@@ -178,16 +340,15 @@ cache_read(__pmContext *ctxp, int mode, pmResult **rp)
 	    (long)posn);
     }
 
-    acp->ac_cache_idx = (acp->ac_cache_idx + 1) % NUMCACHE;
-    lfup = &cache[acp->ac_cache_idx];
-    for (cp = cache; cp < &cache[NUMCACHE]; cp++) {
-	if (cp->c_name != NULL && strcmp(cp->c_name, acp->ac_log->l_name) == 0 &&
-	    cp->vol == acp->ac_vol &&
+    i = ccp->bucket[key][cache_hash(ccp, acp->ac_cur_log, acp->ac_vol, posn)];
+    for ( ; i >= 0; i = cp->next[key]) {
+	cp = &ccp->entry[i];
+	if (cp->arch == acp->ac_cur_log && cp->vol == acp->ac_vol &&
 	    ((mode == PM_MODE_FORW && cp->head_posn == posn) ||
 	     (mode == PM_MODE_BACK && cp->tail_posn == posn)) &&
 	    cp->rp != NULL) {
 	    *rp = cp->rp;
-	    cp->used++;
+	    cache_touch(ccp, i);
 	    if (mode == PM_MODE_FORW)
 		__pmFseek(acp->ac_mfp, cp->tail_posn, SEEK_SET);
 	    else
@@ -198,10 +359,10 @@ cache_read(__pmContext *ctxp, int mode, pmResult **rp)
 		tmp.tv_sec = (__int32_t)cp->rp->timestamp.tv_sec;
 		tmp.tv_usec = (__int32_t)cp->rp->timestamp.tv_usec;
 		t_this = __pmTimevalSub(&tmp, __pmLogStartTime(acp));
-		fprintf(stderr, "hit cache[%d] t=%.6f\n",
-		    (int)(cp - cache), t_this);
-		nr_cache[mode]++;
+		fprintf(stderr, "hit cache[%d] t=%.6f\n", i, t_this);
 	    }
+	    nr_cache[mode]++;
+	    ccp->hits++;
 	    acp->ac_mark_done = 0;
 	    sts = cp->sts;
 	    return sts;
@@ -211,84 +372,71 @@ cache_read(__pmContext *ctxp, int mode, pmResult **rp)
     if (pmDebugOptions.log && pmDebugOptions.desperate)
 	fprintf(stderr, "miss\n");
     nr[mode]++;
-
-    if (lfup->rp != NULL)
-	pmFreeResult(lfup->rp);
+    ccp->misses++;
 
     /*
      * We need to know when we cross archive or volume boundaries.
-     * The only way to know if the archive has changed is to check whether the
-     * archive name has changed.
      */
-    if ((save_curlog_name = strdup(acp->ac_log->l_name)) == NULL) {
-	pmNoMem("__pmLogFetchInterp.save_curlog_name",
-		  strlen(acp->ac_log->l_name) + 1, PM_FATAL_ERR);
-    }
+    save_curlog = acp->ac_cur_log;
     save_curvol = acp->ac_curvol;
 
-    lfup->sts = __pmLogRead_ctx(ctxp, mode, NULL, &lfup->rp, PMLOGREAD_NEXT);
-    if (lfup->sts < 0)
-	lfup->rp = NULL;
-    *rp = lfup->rp;
-
-    archive_changed = strcmp(save_curlog_name, acp->ac_log->l_name) != 0;
-    free(save_curlog_name);
+    sts = __pmLogRead_ctx(ctxp, mode, NULL, &logrp, PMLOGREAD_NEXT);
+    if (sts < 0)
+	logrp = NULL;
 
     /*
-     * vol/arch switch since last time, or vol/arch switch or virtual mark
-     * record generated in __pmLogRead_ctx() ...
+     * error, vol/arch switch since last time, or vol/arch switch or
+     * virtual mark record generated in __pmLogRead_ctx() ...
      * new vol/arch, stdio stream and we don't know where we started from
-     * ... don't cache
+     * ... don't cache, just hold the result until the next bypassed read
      */
-    if (posn == 0 || save_curvol != acp->ac_curvol || archive_changed ||
-	acp->ac_mark_done) {
-	if (lfup->c_name) {
-	    free(lfup->c_name);
-	    lfup->c_name = NULL;
-	}
+    if (sts < 0 || ccp->nentry == 0 || posn == 0 ||
+	save_curvol != acp->ac_curvol ||
+	save_curlog != acp->ac_cur_log || acp->ac_mark_done) {
 	if (pmDebugOptions.log && pmDebugOptions.desperate)
-	    fprintf(stderr, "cache_read: reload vol switch, mark cache[%d] unused\n",
-		(int)(lfup - cache));
+	    fprintf(stderr, "cache_read: not cached\n");
+	if (ccp->uncached != NULL)
+	    pmFreeResult(ccp->uncached);
+	ccp->uncached = logrp;
+	ccp->bypass++;
+	*rp = logrp;
+	return sts;
+    }
+
+    /* recycle the least recently used entry */
+    i = ccp->lru_tail;
+    lrup = &ccp->entry[i];
+    if (lrup->valid) {
+	cache_unhash(ccp, i);
+	ccp->evicts++;
+    }
+    if (lrup->rp != NULL)
+	pmFreeResult(lrup->rp);
+    cache_touch(ccp, i);
+
+    lrup->rp = *rp = logrp;
+    lrup->sts = sts;
+    lrup->mode = mode;
+    lrup->arch = acp->ac_cur_log;
+    lrup->vol = acp->ac_vol;
+    if (mode == PM_MODE_FORW) {
+	lrup->head_posn = posn;
+	lrup->tail_posn = __pmFtell(acp->ac_mfp);
+	assert(lrup->tail_posn >= 0);
     }
     else {
-	lfup->mode = mode;
-	lfup->vol = acp->ac_vol;
-	lfup->used = 1;
-	/* Try to avoid excessive copying/freeing of the archive name. */
-	if (lfup->c_name != NULL && strcmp(lfup->c_name, acp->ac_log->l_name) != 0) {
-	    free(lfup->c_name);
-	    lfup->c_name = NULL;
-	}
-	if (lfup->c_name == NULL) {
-	    if ((lfup->c_name = strdup(acp->ac_log->l_name)) == NULL) {
-		pmNoMem("__pmLogFetchInterp.l_name",
-			  strlen(acp->ac_log->l_name) + 1, PM_FATAL_ERR);
-	    }
-	}
-	if (mode == PM_MODE_FORW) {
-	    lfup->head_posn = posn;
-	    lfup->tail_posn = __pmFtell(acp->ac_mfp);
-	    assert(lfup->tail_posn >= 0);
-	}
-	else {
-	    lfup->tail_posn = posn;
-	    lfup->head_posn = __pmFtell(acp->ac_mfp);
-	    assert(lfup->head_posn >= 0);
-	}
-	if (pmDebugOptions.log && pmDebugOptions.desperate) {
-	    fprintf(stderr, "cache_read: reload cache[%d] vol=%d (curvol=%d) head=%ld tail=%ld ",
-		(int)(lfup - cache), lfup->vol, acp->ac_curvol,
-		(long)lfup->head_posn, (long)lfup->tail_posn);
-	    if (lfup->sts == 0)
-		fprintf(stderr, "sts=%d\n", lfup->sts);
-	    else {
-		char	errmsg[PM_MAXERRMSGLEN];
-		fprintf(stderr, "sts=%s\n", pmErrStr_r(lfup->sts, errmsg, sizeof(errmsg)));
-	    }
-	}
+	lrup->tail_posn = posn;
+	lrup->head_posn = __pmFtell(acp->ac_mfp);
+	assert(lrup->head_posn >= 0);
+    }
+    cache_hash_add(ccp, i);
+    if (pmDebugOptions.log && pmDebugOptions.desperate) {
+	fprintf(stderr, "cache_read: reload cache[%d] vol=%d (curvol=%d) head=%ld tail=%ld sts=%d\n",
+	    i, lrup->vol, acp->ac_curvol,
+	    (long)lrup->head_posn, (long)lrup->tail_posn, lrup->sts);
     }
 
-    return lfup->sts;
+    return lrup->sts;
 }
 
 /*
@@ -700,9 +848,9 @@ check:
 	for (i = 0; i < logrp->vset[k]->numval; i++) {
 	    pmInDom vlistIndom = logrp->vset[k]->vlist[i].inst;
 
-	    ihp = __pmHashSearch((int)vlistIndom, &pcp->hc);
+	    ihp = __pmHashInlineSearch((int)vlistIndom, &pcp->hc);
 	    if (ihp == NULL) {
-		ihp = __pmHashSearch(PM_IN_NULL, &pcp->hc);
+		ihp = __pmHashInlineSearch(PM_IN_NULL, &pcp->hc);
 		if (ihp == NULL)
 		    continue;
 	    }
@@ -980,7 +1128,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], pmResult **r
 	    }
 	    pcp->valfmt = -1;
 	    pcp->last_numval = -1;
-	    __pmHashInit(&pcp->hc);
+	    __pmHashInlineInit(&pcp->hc);
 	    sts = __pmHashAdd((int)pmidlist[j], (void *)pcp, hcp);
 	    if (sts < 0) {
 		free(pcp);
@@ -1007,7 +1155,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], pmResult **r
 		    sts = pmGetInDomArchive_ctx(ctxp, pcp->desc.indom, &instlist, &namelist);
 		    if (sts > 0) {
 			/* Pre allocate enough space for the instance domain. */
-			hsts = __pmHashPreAlloc(sts, &pcp->hc);
+			hsts = __pmHashInlinePreAlloc(sts, &pcp->hc);
 			if (hsts < 0) {
 			    free(pcp);
 			    goto done_icp;
@@ -1025,7 +1173,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], pmResult **r
 		    SET_UNDEFINED(icp->s_prior);
 		    SET_UNDEFINED(icp->s_next);
 		    icp->v_prior.pval = icp->v_next.pval = NULL;
-		    hsts = __pmHashAdd((int)instlist[i], (void *)icp, &pcp->hc);
+		    hsts = __pmHashInlineAdd((int)instlist[i], (void *)icp, &pcp->hc);
 		    if (hsts < 0) {
 			free(icp);
 			goto done_icp;
@@ -1051,7 +1199,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], pmResult **r
 	else if (pcp->desc.indom != PM_INDOM_NULL) {
 	    /* use the profile to filter the instances to be returned */
 	    for (i = 0; i < pcp->hc.hsize; i++) {
-		for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
+		for (ihp = __pmHashInlineSlot(i, &pcp->hc); ihp != NULL; ihp = ihp->next) {
 		    icp = (instcntl_t *)ihp->data;
 		    icp->search = 0;
 		    if (__pmInProfile(pcp->desc.indom, ctxp->c_instprof, icp->inst)) {
@@ -1067,7 +1215,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], pmResult **r
 	}
 	else {
 	    /* There will be only one instance */
-	    ihp = __pmHashWalk(&pcp->hc, PM_HASH_WALK_START);
+	    ihp = __pmHashInlineWalk(&pcp->hc, PM_HASH_WALK_START);
 	    assert(ihp);
 	    icp = (instcntl_t *)ihp->data;
 	    icp->inresult = 1;
@@ -1075,7 +1223,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], pmResult **r
 	    icp->want = (instcntl_t *)ctxp->c_archctl->ac_want;
 	    ctxp->c_archctl->ac_want = icp;
 	    pcp->numval = 1;
-	    ihp = __pmHashWalk(&pcp->hc, PM_HASH_WALK_NEXT);
+	    ihp = __pmHashInlineWalk(&pcp->hc, PM_HASH_WALK_NEXT);
 	    assert(!ihp);
 	}
     }
@@ -1525,7 +1673,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], pmResult **r
 	i = 0;
 	if (pcp->numval > 0) {
 	    for (k = 0; k < pcp->hc.hsize; k++) {
-		for (ihp = pcp->hc.hash[k]; ihp != NULL; ihp = ihp->next) {
+		for (ihp = __pmHashInlineSlot(k, &pcp->hc); ihp != NULL; ihp = ihp->next) {
 		    icp = (instcntl_t *)ihp->data;
 		    if (!icp->inresult)
 			continue;
@@ -1991,7 +2139,7 @@ __pmLogResetInterp(__pmContext *ctxp)
 	for (hp = hcp->hash[k]; hp != NULL; hp = hp->next) {
 	    pcp = (pmidcntl_t *)hp->data;
 	    for (i = 0; i < pcp->hc.hsize; i++) {
-		for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
+		for (ihp = __pmHashInlineSlot(i, &pcp->hc); ihp != NULL; ihp = ihp->next) {
 		    icp = (instcntl_t *)ihp->data;
 		    if (icp->t_prior > t_req || icp->t_next < t_req) {
 			icp->t_prior = icp->t_next = -1;
@@ -2036,14 +2184,12 @@ __pmFreeInterpData(__pmContext *ctxp)
 	    /*
 	     * Don't free __pmHashNode until hp->next has been traversed,
 	     * hence free lags one node in the chain (last_hp used for free).
-	     * Same for linked list of instcntl_t structs (use last_ihp
-	     * for free in this case).
+	     * The instance nodes are inline, and freed with their table.
 	     */
 	    for (hp = hcp->hash[j]; hp != NULL; hp = hp->next) {
 		pcp = (pmidcntl_t *)hp->data;
 		for (i = 0; i < pcp->hc.hsize; i++) {
-		    __pmHashNode	*last_ihp = NULL;
-		    for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
+		    for (ihp = __pmHashInlineSlot(i, &pcp->hc); ihp != NULL; ihp = ihp->next) {
 			icp = (instcntl_t *)ihp->data;
 			if (pcp->valfmt != PM_VAL_INSITU) {
 			    /*
@@ -2068,25 +2214,10 @@ __pmFreeInterpData(__pmContext *ctxp)
 				__pmUnpinPDUBuf((void *)icp->v_next.pval);
 			    }
 			}
-			if (last_ihp != NULL) {
-			    if (last_ihp->data != NULL)
-				free(last_ihp->data);
-			    free(last_ihp);
-			}
-			last_ihp = ihp;
-		    }
-		    if (last_ihp != NULL) {
-			if (last_ihp->data != NULL)
-			    free(last_ihp->data);
-			free(last_ihp);
+			free(icp);
 		    }
 		}
-		if (pcp->hc.hash) {
-		    free(pcp->hc.hash);
-		    /* just being paranoid here */
-		    pcp->hc.hash = NULL;
-		}
-		pcp->hc.hsize = 0;
+		__pmHashInlineClear(&pcp->hc);
 		if (last_hp != NULL) {
 		    if (last_hp->data != NULL)
 			free(last_hp->data);
@@ -2105,31 +2236,33 @@ __pmFreeInterpData(__pmContext *ctxp)
 	    /* just being paranoid here */
 	    hcp->hash = NULL;
 	}
-	hcp->hsize = 0;
+	__pmHashInit(hcp);
     }
 
     if (ctxp->c_archctl->ac_cache != NULL) {
 	/* read cache allocated, work to be done */
-	cache_t		*cache = (cache_t *)ctxp->c_archctl->ac_cache;
+	cachectl_t	*ccp = (cachectl_t *)ctxp->c_archctl->ac_cache;
 	cache_t		*cp;
 
-	for (cp = cache; cp < &cache[NUMCACHE]; cp++) {
+	if (pmDebugOptions.interp) {
+	    fprintf(stderr, "read cache: %d entries, hits %ld misses %ld evictions %ld not cached %ld\n",
+		    ccp->nentry, ccp->hits, ccp->misses, ccp->evicts, ccp->bypass);
+	}
+	if (ccp->uncached != NULL)
+	    pmFreeResult(ccp->uncached);
+	for (cp = ccp->entry; cp < &ccp->entry[ccp->nentry]; cp++) {
 	    if (pmDebugOptions.log && pmDebugOptions.interp) {
 		fprintf(stderr, "read cache entry "
-			PRINTF_P_PFX "%p: c_name=%s rp="
+			PRINTF_P_PFX "%p: arch=%d vol=%d rp="
 			PRINTF_P_PFX "%p\n",
-			cp, cp->c_name ? cp->c_name : "(none)",
-			cp->rp);
-	    }
-	    if (cp->c_name != NULL) {
-		free(cp->c_name);
-		cp->c_name = NULL;
+			cp, cp->valid ? cp->arch : -1, cp->vol, cp->rp);
 	    }
 	    if (cp->rp != NULL) {
 		pmFreeResult(cp->rp);
 		cp->rp = NULL;
 	    }
-	    cp->used = 0;
 	}
+	free(ccp);
+	ctxp->c_archctl->ac_cache = NULL;
     }
 }
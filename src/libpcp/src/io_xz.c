@@ -30,6 +30,17 @@
  * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  *
+ * Thread-safe notes
+ *
+ * A __pmFILE is only ever used by one thread at a time, but when a
+ * sequential scan is detected the following blocks are decompressed
+ * ahead of time by per-file worker threads.  The cache slots are then
+ * shared with the workers, and guarded by the xzfile lock.  All reads
+ * of the compressed file use pread(2), so there is no shared file offset.
+ *
+ * The one-trip initialization of cache_blocks and readahead_blocks is not
+ * guarded as the same values would result from concurrent repeated
+ * execution.
  */
 #include "config.h"
 #if HAVE_LZMA_DECOMPRESSION
@@ -44,10 +55,18 @@
 #include <lzma.h>
 #include "pmapi.h"
 #include "libpcp.h"
+#include "internal.h"
 
 #ifndef PCP_XZ_CACHE_BLOCKS
-#define PCP_XZ_CACHE_BLOCKS 4 /* 4 blocks in the cache, for now */
+#define PCP_XZ_CACHE_BLOCKS 4 /* default blocks in the cache */
+#endif
+#ifndef PCP_XZ_READAHEAD
+#define PCP_XZ_READAHEAD 2 /* default blocks decompressed ahead of a scan */
 #endif
+#define XZ_MAX_READAHEAD 16
+
+static int	cache_blocks = -1;	/* $PCP_XZ_CACHE_BLOCKS */
+static int	readahead_blocks = -1;	/* $PCP_XZ_READAHEAD */
 
 #define XZ_HEADER_MAGIC     "\xfd" "7zXZ\0"
 #define XZ_HEADER_MAGIC_LEN 6
@@ -55,12 +74,21 @@
 #define XZ_FOOTER_MAGIC_LEN 2
 
 /* A block cache. Implemented as a very simple LRU list with a fixed depth. */
-#if 0 /* not used yet */
 typedef struct blkcache_stats {
     size_t hits;
     size_t misses;
+    size_t readahead;		/* blocks queued for read-ahead */
+    size_t readahead_hits;	/* ... and later used */
+    size_t waits;		/* ... but still being decompressed when needed */
 } blkcache_stats;
-#endif
+
+/* Cache slot states */
+enum {
+    BLK_EMPTY = 0,
+    BLK_QUEUED,		/* start and size known, waiting for a worker */
+    BLK_BUSY,		/* being decompressed */
+    BLK_READY		/* data is valid */
+};
 
 /* A buffer of uncompressed blocks */
 typedef struct block {
@@ -68,14 +96,14 @@ typedef struct block {
     uint64_t size;
     uint64_t current_offset;
     char *data;
+    int state;
+    int prefetched;	/* decompressed by read-ahead, not yet used */
 } block;
 
 typedef struct blkcache {
     int maxdepth;
     block *blocks;
-#if 0 /* not used yet */
     blkcache_stats stats;
-#endif
 } blkcache;
 
 /* The file handle */
@@ -89,8 +117,26 @@ typedef struct xzfile {
     off_t uncompressed_offset;
   __uint64_t uncompressed_size;
   __uint64_t max_uncompressed_block_size;
+    uint64_t last_start;	/* block most recently moved to */
+    uint64_t last_size;
+    int readahead;		/* blocks to decompress ahead of a scan */
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_t lock;	/* guards the cache once workers start */
+    pthread_cond_t cond;	/* slot queued or completed, or shutdown */
+    pthread_t *workers;
+    int nworkers;
+    int shutdown;
+#endif
 } xzfile;
 
+#ifdef PM_MULTI_THREAD
+#define XZ_LOCK(xz)	do { if ((xz)->nworkers) PM_LOCK((xz)->lock); } while (0)
+#define XZ_UNLOCK(xz)	do { if ((xz)->nworkers) PM_UNLOCK((xz)->lock); } while (0)
+#else
+#define XZ_LOCK(xz)	do { } while (0)
+#define XZ_UNLOCK(xz)	do { } while (0)
+#endif
+
 static void
 xz_debug(const char *fmt, ...)
 {
@@ -120,9 +166,7 @@ new_blkcache(size_t maxdepth)
     return NULL;
   }
   c->maxdepth = maxdepth;
-#if 0 /* not used yet */
-  c->stats.hits = c->stats.misses = 0;
-#endif
+  memset(&c->stats, 0, sizeof(c->stats));
 
   return c;
 }
@@ -138,13 +182,59 @@ free_blkcache(blkcache *c)
   free(c);
 }
 
-#if 0 /* not used yet */
 void
 blkcache_get_stats(blkcache *c, blkcache_stats *ret)
 {
   memcpy(ret, &c->stats, sizeof(c->stats));
 }
+
+/*
+ * One-trip initialization of the cache depth and read-ahead from
+ * the environment.
+ */
+static void
+xz_config(void)
+{
+    char	*str, *end;
+    long	val;
+    int		n;
+
+    if (cache_blocks != -1)
+	return;
+
+    PM_LOCK(__pmLock_extcall);
+    /* read-ahead only helps if another CPU can decompress meanwhile */
+    n = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? PCP_XZ_READAHEAD : 0;
+    str = getenv("PCP_XZ_READAHEAD");		/* THREADSAFE */
+    if (str != NULL) {
+	val = strtol(str, &end, 10);
+	if (*end != '\0' || val < 0 || val > XZ_MAX_READAHEAD)
+	    fprintf(stderr, "%s: Warning: bad $PCP_XZ_READAHEAD (%s), using %d\n",
+		    pmGetProgname(), str, n);
+	else
+	    n = (int)val;
+    }
+#ifndef PM_MULTI_THREAD
+    n = 0;
 #endif
+    readahead_blocks = n;
+
+    n = PCP_XZ_CACHE_BLOCKS;
+    str = getenv("PCP_XZ_CACHE_BLOCKS");		/* THREADSAFE */
+    if (str != NULL) {
+	val = strtol(str, &end, 10);
+	if (*end != '\0' || val < 1 || val > 1024)
+	    fprintf(stderr, "%s: Warning: bad $PCP_XZ_CACHE_BLOCKS (%s), using %d\n",
+		    pmGetProgname(), str, n);
+	else
+	    n = (int)val;
+    }
+    /* room for the current block, the read-ahead blocks and one behind */
+    if (n < readahead_blocks + 2)
+	n = readahead_blocks + 2;
+    PM_UNLOCK(__pmLock_extcall);
+    cache_blocks = n;
+}
 
 static int
 xz_feof(__pmFILE *f)
@@ -428,8 +518,29 @@ init(xzfile *xz)
 
   xz->uncompressed_size = lzma_index_uncompressed_size(xz->idx);
   xz->uncompressed_offset = 0;
-  xz->cache = new_blkcache(PCP_XZ_CACHE_BLOCKS);
-  
+  xz_config();
+  xz->cache = new_blkcache(cache_blocks);
+  if (xz->cache == NULL) {
+      lzma_index_end(xz->idx, NULL);
+      return 1; /* error */
+  }
+  xz->last_start = xz->last_size = 0;
+  /* no point reading ahead in a single block file */
+  xz->readahead = xz->nr_blocks > 1 ? readahead_blocks : 0;
+#ifdef PM_MULTI_THREAD
+  __pmInitMutex(&xz->lock);
+  pthread_cond_init(&xz->cond, NULL);
+  xz->workers = NULL;
+  xz->nworkers = 0;
+  xz->shutdown = 0;
+#endif
+
+  if (pmDebugOptions.log)
+      fprintf(stderr, "xz init: %d blocks (max %llu bytes), cache %d, readahead %d\n",
+		(int)xz->nr_blocks,
+		(unsigned long long)xz->max_uncompressed_block_size,
+		xz->cache->maxdepth, xz->readahead);
+
   return 0; /* ok */
 }
 
@@ -546,18 +657,55 @@ xz_tell(__pmFILE *f)
     return xz->uncompressed_offset;
 }
 
+/* Move the block in slot to position to in the LRU order. */
+static block *
+cache_block_move(blkcache *cache, int slot, int to)
+{
+    block tmp;
+    int i;
+
+    if (slot != to) {
+	tmp = cache->blocks[slot];
+	for (i = slot; i > to; --i)
+	    cache->blocks[i] = cache->blocks[i - 1];
+	for (i = slot; i < to; ++i)
+	    cache->blocks[i] = cache->blocks[i + 1];
+	cache->blocks[to] = tmp;
+    }
+    return &cache->blocks[to];
+}
+
 static block *
 cache_block_used(blkcache *cache, int slot)
 {
     /* Move this block into the first slot, if it is not already there */
-    if (slot != 0) {
-	block used = cache->blocks[slot];
-	int i;
-	for (i = slot; i > 0; --i)
-	    cache->blocks[i] = cache->blocks[i - 1];
-	cache->blocks[0] = used;
+    return cache_block_move(cache, slot, 0);
+}
+
+/*
+ * Choose a slot to (re)use: an empty one, else the least recently used
+ * decompressed block, else the least recently used block still queued
+ * for read-ahead.  Blocks being decompressed are never chosen, and the
+ * current block in slot 0 only if there is no alternative.
+ */
+static int
+cache_victim(blkcache *cache)
+{
+    int slot;
+
+    for (slot = 0; slot < cache->maxdepth; ++slot) {
+	if (cache->blocks[slot].state == BLK_EMPTY)
+	    return slot;
+    }
+    for (slot = cache->maxdepth - 1; slot > 0; --slot) {
+	if (cache->blocks[slot].state == BLK_READY)
+	    return slot;
+    }
+    for (slot = cache->maxdepth - 1; slot > 0; --slot) {
+	if (cache->blocks[slot].state != BLK_BUSY)
+	    break;
     }
-    return &cache->blocks[0];
+    return slot;
 }
 
 static char *
@@ -573,6 +721,7 @@ read_block(xzfile *xz, uint64_t offset,
   char *data;
   ssize_t n;
   size_t i;
+  off_t pos;
 
   /* Locate the block containing the uncompressed offset. */
   lzma_index_iter_init(&iter, xz->idx);
@@ -588,15 +737,13 @@ read_block(xzfile *xz, uint64_t offset,
                 (int) iter.block.number_in_file,
                 (uint64_t) iter.block.compressed_file_offset);
 
-  if (lseek(xz->fd, iter.block.compressed_file_offset, SEEK_SET) == -1) {
-    xz_debug("lseek: %m");
-    return NULL;
-  }
+  /* Read-ahead workers share the fd, so only pread(2) from here on. */
+  pos = iter.block.compressed_file_offset;
 
   /* Read the block header.  Start by reading a single byte which
    * tell us how big the block header is.
    */
-  n = read(xz->fd, header, 1);
+  n = pread(xz->fd, header, 1, pos);
   if (n == 0) {
     xz_debug("read: unexpected end of file reading block header byte");
     return NULL;
@@ -617,7 +764,7 @@ read_block(xzfile *xz, uint64_t offset,
   block.header_size = lzma_block_header_size_decode(header[0]);
 
   /* Now read and decode the block header. */
-  n = read(xz->fd, &header[1], block.header_size-1);
+  n = pread(xz->fd, &header[1], block.header_size-1, pos + 1);
   if (n >= 0 && n != block.header_size-1) {
     xz_debug("read: unexpected end of file reading block header");
     return NULL;
@@ -626,6 +773,7 @@ read_block(xzfile *xz, uint64_t offset,
     xz_debug("read: %m");
     return NULL;
   }
+  pos += block.header_size;
 
   r = lzma_block_header_decode(&block, NULL, header);
   if (r != LZMA_OK) {
@@ -668,11 +816,12 @@ read_block(xzfile *xz, uint64_t offset,
 
     if (strm.avail_in == 0) {
       strm.next_in = buf;
-      n = read(xz->fd, buf, sizeof buf);
+      n = pread(xz->fd, buf, sizeof buf, pos);
       if (n == -1) {
         xz_debug("read: %m");
         goto err2;
       }
+      pos += n;
       strm.avail_in = n;
       if (n == 0)
         action = LZMA_FINISH;
@@ -705,33 +854,209 @@ read_block(xzfile *xz, uint64_t offset,
   return NULL;
 }
 
+/*
+ * Decompress the block whose start and size are already set in the slot,
+ * which the caller has marked BLK_BUSY so that it will not be reused.
+ * Called with the cache locked (if there are workers), the lock is
+ * dropped while decompressing.  Only this thread ever moves slots, so
+ * the slot number is still valid afterwards.
+ */
 static block *
-read_new_block(xzfile *xz, int slot)
+decode_slot(xzfile *xz, int slot)
 {
-    blkcache *cache;
+    block *blk = &xz->cache->blocks[slot];
+    uint64_t start = blk->start, size = 0; /* silence coverity */
+    char *data;
+
+    XZ_UNLOCK(xz);
+    data = read_block(xz, start, &start, &size);
+    XZ_LOCK(xz);
+
+    blk = &xz->cache->blocks[slot];
+    if (data == NULL) {
+	blk->state = BLK_EMPTY;
+	blk->prefetched = 0;
+	blk = NULL;
+    }
+    else {
+	blk->data = data;
+	blk->state = BLK_READY;
+    }
+#ifdef PM_MULTI_THREAD
+    if (xz->nworkers)
+	pthread_cond_broadcast(&xz->cond);
+#endif
+    return blk;
+}
+
+#ifdef PM_MULTI_THREAD
+/*
+ * Read-ahead worker, decompresses queued blocks, nearest to the
+ * current block first.
+ */
+static void *
+xz_worker(void *arg)
+{
+    xzfile *xz = (xzfile *)arg;
+    blkcache *cache = xz->cache;
     block *blk;
+    uint64_t start, bstart = 0, bsize = 0;
     char *data;
-    uint64_t start = 0, size = 0; /* silence coverity */
+    int slot;
 
-    /* Decompress a new block into the given slot. */
-    data = read_block(xz, xz->uncompressed_offset, &start, &size);
-    if (data == NULL)
-	return NULL;
+    PM_LOCK(xz->lock);
+    while (!xz->shutdown) {
+	for (slot = 0; slot < cache->maxdepth; ++slot) {
+	    if (cache->blocks[slot].state == BLK_QUEUED)
+		break;
+	}
+	if (slot == cache->maxdepth) {
+	    pthread_cond_wait(&xz->cond, &xz->lock);
+	    continue;
+	}
+	blk = &cache->blocks[slot];
+	blk->state = BLK_BUSY;
+	start = blk->start;
+
+	PM_UNLOCK(xz->lock);
+	data = read_block(xz, start, &bstart, &bsize);
+	PM_LOCK(xz->lock);
+
+	/* the slot may have moved in the LRU order meanwhile, but not been reused */
+	for (slot = 0; slot < cache->maxdepth; ++slot) {
+	    blk = &cache->blocks[slot];
+	    if (blk->state == BLK_BUSY && blk->start == start)
+		break;
+	}
+	if (data == NULL) {
+	    /* leave it to the reader to retry, and report the error */
+	    blk->state = BLK_EMPTY;
+	    blk->prefetched = 0;
+	}
+	else {
+	    blk->data = data;
+	    blk->state = BLK_READY;
+	}
+	pthread_cond_broadcast(&xz->cond);
+    }
+    PM_UNLOCK(xz->lock);
+    return NULL;
+}
 
-    /* Add the data to this block */
-    cache = xz->cache;
-    blk = &cache->blocks[slot];
-    if (blk->data != NULL)
-	free(blk->data);
-    blk->data = data;
-    blk->start = start;
-    blk->size = size;
-    blk->current_offset = xz->uncompressed_offset - blk->start;
+/*
+ * Start the read-ahead workers.  On success the cache is shared from
+ * here on, so return with it locked, as the caller expects.
+ */
+static int
+start_workers(xzfile *xz)
+{
+    sigset_t all, save;
+    int i;
+
+    if ((xz->workers = (pthread_t *)calloc(xz->readahead, sizeof(pthread_t))) == NULL)
+	return -ENOMEM;
+
+    /* workers must not take signals meant for the application */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &save);
+    for (i = 0; i < xz->readahead; i++) {
+	if (pthread_create(&xz->workers[i], NULL, xz_worker, xz) != 0)
+	    break;
+    }
+    pthread_sigmask(SIG_SETMASK, &save, NULL);
 
-    /* Mark this block as most recently used */
-    blk = cache_block_used(cache, slot);
-	    
-    return blk;
+    if (i == 0) {
+	free(xz->workers);
+	xz->workers = NULL;
+	return -EAGAIN;
+    }
+    xz->nworkers = i;
+    PM_LOCK(xz->lock);
+
+    if (pmDebugOptions.log)
+	fprintf(stderr, "xz readahead: started %d workers\n", i);
+    return 0;
+}
+#endif
+
+/*
+ * Called when the current block changes.  If the new block follows the
+ * previous one in either direction, this is a sequential scan, so queue
+ * the next blocks in the same direction for the workers.
+ */
+static void
+readahead_check(xzfile *xz, const block *cur)
+{
+    blkcache *cache = xz->cache;
+    lzma_index_iter iter;
+    uint64_t start = cur->start, size = cur->size;
+    block *blk;
+    int dir, n, slot;
+
+    if (xz->last_size == 0)
+	dir = 0; /* first block, no history yet */
+    else if (start == xz->last_start + xz->last_size)
+	dir = 1;
+    else if (start + size == xz->last_start)
+	dir = -1;
+    else
+	dir = 0;
+    xz->last_start = start;
+    xz->last_size = size;
+    if (dir == 0 || xz->readahead == 0)
+	return;
+
+#ifdef PM_MULTI_THREAD
+    if (xz->nworkers == 0 && start_workers(xz) < 0) {
+	xz->readahead = 0;
+	return;
+    }
+#endif
+
+    for (n = 0; n < xz->readahead; n++) {
+	lzma_index_iter_init(&iter, xz->idx);
+	if (dir > 0) {
+	    if (start + size >= xz->uncompressed_size ||
+		lzma_index_iter_locate(&iter, start + size))
+		break;
+	}
+	else {
+	    if (start == 0 || lzma_index_iter_locate(&iter, start - 1))
+		break;
+	}
+	start = iter.block.uncompressed_file_offset;
+	size = iter.block.uncompressed_size;
+
+	/*
+	 * Keep the blocks ahead in scan order right behind the current
+	 * block, so the blocks already passed are the ones reused.
+	 */
+	for (slot = 1; slot < cache->maxdepth; ++slot) {
+	    blk = &cache->blocks[slot];
+	    if (blk->state != BLK_EMPTY && blk->start == start)
+		break;
+	}
+	if (slot < cache->maxdepth) {
+	    /* already cached or queued */
+	    cache_block_move(cache, slot, n + 1);
+	    continue;
+	}
+
+	if ((slot = cache_victim(cache)) == 0)
+	    break;
+	blk = &cache->blocks[slot];
+	free(blk->data);
+	blk->data = NULL;
+	blk->start = start;
+	blk->size = size;
+	blk->state = BLK_QUEUED;
+	blk->prefetched = 1;
+	cache_block_move(cache, slot, n + 1);
+	cache->stats.readahead++;
+    }
+#ifdef PM_MULTI_THREAD
+    pthread_cond_broadcast(&xz->cond);
+#endif
 }
 
 /*
@@ -742,7 +1067,8 @@ static block *
 reposition(xzfile *xz)
 {
     blkcache *cache;
-    block *blk;
+    block *blk = NULL;
+    lzma_index_iter iter;
     int slot;
 
     /*
@@ -752,30 +1078,74 @@ reposition(xzfile *xz)
      * first.
      */
     cache = xz->cache;
+    XZ_LOCK(xz);
+ again:
     for (slot = 0; slot < cache->maxdepth; ++slot) {
 	blk = &cache->blocks[slot];
-	if (blk->data == NULL)
-	    break; /* end of cache */
-
+	if (blk->state == BLK_EMPTY)
+	    continue;
 	if (xz->uncompressed_offset >= blk->start &&
-	    xz->uncompressed_offset < blk->start + blk->size) {
-	    /* found it */
-	    blk->current_offset = xz->uncompressed_offset - blk->start;
-	    blk = cache_block_used(cache, slot);
-	    return blk;
-	}
+	    xz->uncompressed_offset < blk->start + blk->size)
+	    break; /* found it */
     }
 
-    /*
-     * No cached block contains the uncompressed offset that we want.
-     * Decompress a new block into an empty slot, or into the least recently
-     * used slot, which is the last one.
-     */
-    if (slot >= cache->maxdepth)
-	slot = cache->maxdepth - 1;
-    blk = read_new_block(xz, slot);
+    if (slot < cache->maxdepth) {
+	if (blk->state == BLK_BUSY) {
+	    /* a read-ahead worker is decompressing it, wait for that */
+	    cache->stats.waits++;
+#ifdef PM_MULTI_THREAD
+	    pthread_cond_wait(&xz->cond, &xz->lock);
+#endif
+	    goto again;
+	}
+	if (blk->state == BLK_QUEUED) {
+	    /* no worker has started on it yet, so do it here */
+	    blk->state = BLK_BUSY;
+	    if ((blk = decode_slot(xz, slot)) == NULL)
+		goto fail;
+	}
+	cache->stats.hits++;
+	if (blk->prefetched) {
+	    cache->stats.readahead_hits++;
+	    blk->prefetched = 0;
+	}
+    }
+    else {
+	/*
+	 * No cached block contains the uncompressed offset that we want.
+	 * Decompress a new block into an empty slot, or into the least
+	 * recently used slot.
+	 */
+	cache->stats.misses++;
+	lzma_index_iter_init(&iter, xz->idx);
+	if (lzma_index_iter_locate(&iter, xz->uncompressed_offset)) {
+	    xz_debug("cannot find offset %lld in the xz file",
+		     (long long)xz->uncompressed_offset);
+	    goto fail;
+	}
+	slot = cache_victim(cache);
+	blk = &cache->blocks[slot];
+	free(blk->data);
+	blk->data = NULL;
+	blk->start = iter.block.uncompressed_file_offset;
+	blk->size = iter.block.uncompressed_size;
+	blk->prefetched = 0;
+	blk->state = BLK_BUSY;
+	if ((blk = decode_slot(xz, slot)) == NULL)
+	    goto fail;
+    }
 
+    blk->current_offset = xz->uncompressed_offset - blk->start;
+    /* Mark this block as most recently used */
+    blk = cache_block_used(cache, slot);
+    if (blk->start != xz->last_start || xz->last_size == 0)
+	readahead_check(xz, blk);
+    XZ_UNLOCK(xz);
     return blk;
+
+ fail:
+    XZ_UNLOCK(xz);
+    return NULL;
 }
 
 static int
@@ -891,8 +1261,34 @@ static int
 xz_close(__pmFILE *f)
 {
     xzfile *xz = f->priv;
+    blkcache_stats stats;
     int sts;
-    
+#ifdef PM_MULTI_THREAD
+    int i;
+
+    if (xz->nworkers) {
+	PM_LOCK(xz->lock);
+	xz->shutdown = 1;
+	pthread_cond_broadcast(&xz->cond);
+	PM_UNLOCK(xz->lock);
+	for (i = 0; i < xz->nworkers; i++)
+	    pthread_join(xz->workers[i], NULL);
+	free(xz->workers);
+    }
+    pthread_cond_destroy(&xz->cond);
+    pthread_mutex_destroy(&xz->lock);
+#endif
+
+    if (pmDebugOptions.log) {
+	blkcache_get_stats(xz->cache, &stats);
+	fprintf(stderr, "xz close: cache hits %lu misses %lu, readahead %lu "
+		"used %lu waits %lu\n",
+		(unsigned long)stats.hits, (unsigned long)stats.misses,
+		(unsigned long)stats.readahead,
+		(unsigned long)stats.readahead_hits,
+		(unsigned long)stats.waits);
+    }
+
     lzma_index_end (xz->idx, NULL);
     sts = fclose(xz->f);
     free_blkcache(xz->cache);
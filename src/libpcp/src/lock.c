@@ -135,6 +135,8 @@ static char
 	return "pdu";
     else if (__pmIsPdubufLock(lock))
 	return "pdubuf";
+    else if (__pmIsStuffvalueLock(lock))
+	return "stuffvalue";
     else if (__pmIsUtilLock(lock))
 	return "util";
     else if (__pmIsContextsLock(lock))
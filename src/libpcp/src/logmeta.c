@@ -23,6 +23,65 @@
 /* bytes for a length field in a header/trailer, or a string length field */
 #define LENSIZE	4
 
+/*
+ * Lazy metadata loading, enabled with $PCP_LAZY_METADATA.  __pmLogLoadMeta
+ * still decodes every metric descriptor and name (the PMNS is needed from
+ * the outset), but for instance domain, label set and help text records
+ * only the location is noted, and each is decoded into the usual hashed
+ * structures the first time it is asked for.  Only the metadata file of
+ * the current archive stays open, those of other archives in the context
+ * are reopened when records from them are decoded, one at a time.  This
+ * state is kept in the __pmLogPriv for the __pmLogCtl.
+ */
+typedef struct lazyrec {
+    struct lazyrec	*next;
+    int			file;		/* index into lz_file[] */
+    unsigned int	type;		/* label set or help text type */
+    long		offset;		/* start of record body */
+    int			rlen;		/* length of record body */
+} lazyrec_t;
+
+typedef struct {
+    lazyrec_t		*head;		/* records in file order */
+    lazyrec_t		*tail;
+} lazylist_t;
+
+typedef struct {
+    char		*name;		/* archive base name */
+    long		end;		/* offset past the last record seen */
+    int			numpmid;	/* metric descriptors seen */
+} lazyfile_t;
+
+struct __pmLogLazy {
+    int			lz_nfile;
+    lazyfile_t		*lz_file;	/* one per archive */
+    __pmFILE		*lz_f;		/* metadata file reopened, or NULL */
+    int			lz_fnum;	/* lz_file[] index for lz_f */
+    __pmHashPoolCtl	lz_indom;	/* pmInDom -> lazylist_t */
+    __pmHashPoolCtl	lz_labels;	/* ident -> lazylist_t, any type */
+    __pmHashPoolCtl	lz_text;	/* ident -> lazylist_t, any type */
+};
+
+/*
+ * Time index for the versions of one instance domain.  The versions are
+ * kept in a list, newest first, which is what the tools that traverse
+ * l_hashindom expect; this is a time-ordered array of the same versions
+ * for binary search, with a cursor at the last version returned so that
+ * sequential replay does not need to search at all.  It is built on the
+ * first timed lookup, and rebuilt after the list changes.  The indexes
+ * are kept in the __pmLogPriv for the __pmLogCtl, so there are none for
+ * archives being written, and those lookups use a linear search.
+ */
+typedef struct {
+    __pmLogInDom	*head;		/* list head when built, NULL if stale */
+    int			count;
+    int			size;
+    int			last;		/* cursor, last version returned */
+    __pmLogInDom	**vers;		/* oldest first */
+} indomtime_t;
+
+static int lazyload(__pmArchCtl *, int, unsigned int, unsigned int);
+
 static void
 StrTimeval(const pmTimeval *tp)
 {
@@ -103,6 +162,7 @@ addindom(__pmLogCtl *lcp, pmInDom indom, const pmTimeval *tp, int numinst,
 {
     __pmLogInDom	*idp, *idp_prev;
     __pmLogInDom	*idp_cached, *idp_time;
+    __pmLogPriv		*lpp;
     __pmHashNode	*hp;
     int			timecmp;
     int			sts;
@@ -122,6 +182,10 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_ALLOC);
 	fprintf(stderr, ", numinst=%d)\n", numinst);
     }
 
+    if ((lpp = __pmLogGetPriv(lcp, 0)) != NULL &&
+	(hp = __pmHashSearch((unsigned int)indom, &lpp->lp_hashindomtime)) != NULL)
+	((indomtime_t *)hp->data)->head = NULL;
+
     if ((hp = __pmHashSearch((unsigned int)indom, &lcp->l_hashindom)) == NULL) {
 	idp->next = NULL;
 	sts = __pmHashAdd((unsigned int)indom, (void *)idp, &lcp->l_hashindom);
@@ -241,6 +305,52 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_ALLOC);
     return sts;
 }
 
+static int
+lookuplabel(__pmLogCtl *lcp, unsigned int type, unsigned int ident,
+		pmLabelSet **label, const pmTimeval *tp)
+{
+    __pmHashCtl		*label_hash;
+    __pmHashNode	*hp;
+    __pmLogLabelSet	*ls;
+
+    if ((hp = __pmHashSearch(type, &lcp->l_hashlabels)) == NULL)
+	return PM_ERR_NOLABELS;
+
+    label_hash = (__pmHashCtl *)hp->data;
+    if ((hp = __pmHashSearch(ident, label_hash)) == NULL)
+	return PM_ERR_NOLABELS;
+
+    ls = (__pmLogLabelSet *)hp->data;
+    if (tp != NULL) {
+	for ( ; ls != NULL; ls = ls->next) {
+	    if (__pmTimevalCmp(&ls->stamp, tp) <= 0)
+		break;
+	}
+	if (ls == NULL)
+	    return 0;
+    }
+    *label = ls->labelsets;
+    return ls->nsets;
+}
+
+static int
+lookuptext(__pmLogCtl *lcp, unsigned int ident, unsigned int type,
+		char **buffer)
+{
+    __pmHashCtl		*text_hash;
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch(type, &lcp->l_hashtext)) == NULL)
+	return PM_ERR_NOTHOST;	/* back-compat error code */
+
+    text_hash = (__pmHashCtl *)hp->data;
+    if ((hp = __pmHashSearch(ident, text_hash)) == NULL)
+	return PM_ERR_TEXT;
+
+    *buffer = (char *)hp->data;
+    return 0;
+}
+
 static int
 addlabel(__pmArchCtl *acp, unsigned int type, unsigned int ident, int nsets,
 		pmLabelSet *labelsets, const pmTimeval *tp)
@@ -269,7 +379,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":13", PM_FAULT_ALLOC);
 	fprintf(stderr, ", nsets=%d)\n", nsets);
     }
 
-    if ((sts = __pmLogLookupLabel(acp, type, ident, &label, NULL)) <= 0) {
+    if ((sts = lookuplabel(lcp, type, ident, &label, NULL)) <= 0) {
 
 	idp->next = NULL;
 
@@ -437,11 +547,44 @@ discard_dup_labelsets(__pmLogLabelSet *idp, const __pmLogLabelSet *idp_next)
  * has been read. At this point we know that the label sets are stored in reverse
  * chronological order.
  */
+static void
+check_dup_labelsets(__pmHashNode *hptype)
+{
+    __pmLogLabelSet	*idp, *idp_prev, *idp_next;
+
+    idp_prev = NULL;
+    for (idp = (__pmLogLabelSet *)hptype->data; idp; idp = idp_next) {
+	idp_next = idp->next;
+	if (idp_next == NULL)
+	    break; /* done */
+
+	/*
+	 * idp and idp_next each hold sets of label sets. Since idp is
+	 * later in time, we want to discard any label sets within
+	 * idp which are the same as any label sets in idp_next.
+	 */
+	discard_dup_labelsets(idp, idp_next);
+	if (idp->nsets == 0) {
+	    /*
+	     * All label sets within idp were discarded.
+	     * unlink it and free it.
+	     */
+	    if (idp_prev)
+		idp_prev->next = idp_next;
+	    else
+		hptype->data = idp_next;
+	    free(idp->labelsets);
+	    free(idp);
+	}
+	else
+	    idp_prev = idp;
+    }
+}
+
 static void
 check_dup_labels(const __pmArchCtl *acp)
 {
     __pmLogCtl		*lcp;
-    __pmLogLabelSet	*idp, *idp_prev, *idp_next;
     __pmHashCtl		*l_hashlabels;
     __pmHashCtl		*l_hashtype;
     __pmHashNode	*hplabels, *hptype;
@@ -455,35 +598,8 @@ check_dup_labels(const __pmArchCtl *acp)
         for (hplabels = l_hashlabels->hash[type]; hplabels; hplabels = hplabels->next) {
 	    l_hashtype = (__pmHashCtl *)hplabels->data;
 	    for (ident = 0; ident < l_hashtype->hsize; ++ident) {
-		for (hptype = l_hashtype->hash[ident]; hptype; hptype = hptype->next) {
-		    idp_prev = NULL;
-		    for (idp = (__pmLogLabelSet *)hptype->data; idp; idp = idp_next) {
-			idp_next = idp->next;
-			if (idp_next == NULL)
-			    break; /* done */
-
-			/*
-			 * idp and idp_next each hold sets of label sets. Since idp is
-			 * later in time, we want to discard any label sets within
-			 * idp which are the same as any label sets in idp_next.
-			 */
-			discard_dup_labelsets(idp, idp_next);
-			if (idp->nsets == 0) {
-			    /*
-			     * All label sets within idp were discarded.
-			     * unlink it and free it.
-			     */
-			    if (idp_prev)
-				idp_prev->next = idp_next;
-			    else
-				hptype->data = idp_next;
-			    free(idp->labelsets);
-			    free(idp);
-			}
-			else
-			    idp_prev = idp;
-		    }
-		}
+		for (hptype = l_hashtype->hash[ident]; hptype; hptype = hptype->next)
+		    check_dup_labelsets(hptype);
 	    }
 	}
     }
@@ -502,7 +618,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":15", PM_FAULT_ALLOC);
     if (pmDebugOptions.logmeta)
 	fprintf(stderr, "addtext( ..., %u, %u)\n", ident, type);
 
-    if ((sts = __pmLogLookupText(acp, ident, type, &text)) < 0) {
+    if ((sts = lookuptext(lcp, ident, type, &text)) < 0) {
 	/* This is a new help text record. Add it to the hash structure. */
 	if ((hp = __pmHashSearch(type, &lcp->l_hashtext)) == NULL) {
 	    if ((l_hashtype = (__pmHashCtl *)calloc(1, sizeof(__pmHashCtl))) == NULL)
@@ -533,7 +649,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":15", PM_FAULT_ALLOC);
     if (strcmp(buffer, text) != 0) {
 	/*
 	 * Find the hash table entry. We know it's there because
-	 * __pmLogLookupText() succeeded above.
+	 * lookuptext() succeeded above.
 	 */
 	hp = __pmHashSearch(type, &lcp->l_hashtext);
 	assert(hp != NULL);
@@ -639,21 +755,467 @@ __pmLogAddText(__pmArchCtl *acp, unsigned int ident, unsigned int type, const ch
     return addtext(acp, ident, type, buffer);
 }
 
+/*
+ * Instance names rarely change from one version of an instance domain
+ * to the next.  When decoding an instance domain record, share the names
+ * of instances that are unchanged from the latest version already loaded,
+ * and replace the record buffer (*bufp) by one holding only the instance
+ * identifiers and the names that are new.  All versions of an instance
+ * domain are freed together, so the shared names outlive their users.
+ *
+ * On success the namelist is always allocated separately from the
+ * buffer.  Failure to allocate is not an error, the record is kept.
+ */
+static void
+shareinsts(__pmLogCtl *lcp, pmInResult *in, int **bufp, int *allinbuf)
+{
+    __pmHashNode	*hp;
+    __pmLogInDom	*prev;
+    char		**shared;
+    char		*p;
+    int			*buf;
+    int			i, lo, hi, mid;
+    int			nshared = 0;
+    size_t		need = 0;
+
+    if ((hp = __pmHashSearch((unsigned int)in->indom, &lcp->l_hashindom)) == NULL)
+	return;
+    if ((prev = (__pmLogInDom *)hp->data) == NULL || prev->numinst <= 0)
+	return;
+    if ((shared = (char **)calloc(in->numinst, sizeof(char *))) == NULL)
+	return;
+
+    for (i = 0; i < in->numinst; i++) {
+	/* prev->instlist[] is sorted, see addinsts() */
+	lo = 0;
+	hi = prev->numinst - 1;
+	while (lo <= hi) {
+	    mid = lo + (hi - lo) / 2;
+	    if (prev->instlist[mid] < in->instlist[i])
+		lo = mid + 1;
+	    else if (prev->instlist[mid] > in->instlist[i])
+		hi = mid - 1;
+	    else {
+		if (strcmp(prev->namelist[mid], in->namelist[i]) == 0) {
+		    shared[i] = prev->namelist[mid];
+		    nshared++;
+		}
+		break;
+	    }
+	}
+	if (shared[i] == NULL)
+	    need += strlen(in->namelist[i]) + 1;
+    }
+    if (nshared == 0)
+	goto done;
+
+    if ((buf = (int *)malloc(in->numinst * sizeof(int) + need)) == NULL)
+	goto done;
+    memcpy(buf, in->instlist, in->numinst * sizeof(int));
+    in->instlist = buf;
+    p = (char *)&buf[in->numinst];
+    for (i = 0; i < in->numinst; i++) {
+	if (shared[i] == NULL) {
+	    need = strlen(in->namelist[i]) + 1;
+	    memcpy(p, in->namelist[i], need);
+	    shared[i] = p;
+	    p += need;
+	}
+    }
+    if (*allinbuf) {
+	/* namelist[] was in the old buffer, shared[] replaces it */
+	in->namelist = shared;
+	*allinbuf = 0;
+	shared = NULL;
+    }
+    else
+	memcpy(in->namelist, shared, in->numinst * sizeof(char *));
+    free(*bufp);
+    *bufp = buf;
+
+    if (pmDebugOptions.logmeta) {
+	char	strbuf[20];
+	fprintf(stderr, "shareinsts( ..., %s) -> %d of %d names shared\n",
+		pmInDomStr_r(in->indom, strbuf, sizeof(strbuf)),
+		nshared, in->numinst);
+    }
+
+done:
+    free(shared);
+}
+
+/*
+ * Decode the body of an instance domain record, read into tbuf, and add
+ * it to the hashed instance domains.  tbuf is either kept (referenced by
+ * the __pmLogInDom) or freed here.
+ */
+static int
+decodeindom(__pmArchCtl *acp, int *tbuf, int rlen)
+{
+    pmTimeval		*tv;
+    pmTimespec		when;
+    pmInResult		in;
+    char		*namebase;
+    int			*stridx;
+    int			i, k, allinbuf = 0;
+    int			sts = 0;
+
+    k = 0;
+    tv = (pmTimeval *)&tbuf[k];
+    when.tv_sec = ntohl(tv->tv_sec);
+    when.tv_nsec = ntohl(tv->tv_usec) * 1000;
+    k += sizeof(*tv)/sizeof(int);
+    in.indom = __ntohpmInDom((unsigned int)tbuf[k++]);
+    in.numinst = ntohl(tbuf[k++]);
+    if (in.numinst > 0) {
+	in.instlist = &tbuf[k];
+	k += in.numinst;
+	stridx = &tbuf[k];
+#if defined(HAVE_32BIT_PTR)
+	in.namelist = (char **)stridx;
+	allinbuf = 1; /* allocation is all in tbuf */
+#else
+	allinbuf = 0; /* allocation for namelist + tbuf */
+	/* need to allocate to hold the pointers */
+PM_FAULT_POINT("libpcp/" __FILE__ ":4", PM_FAULT_ALLOC);
+	in.namelist = (char **)malloc(in.numinst * sizeof(char*));
+	if (in.namelist == NULL) {
+	    sts = -oserror();
+	    free(tbuf);
+	    return sts;
+	}
+#endif
+	k += in.numinst;
+	namebase = (char *)&tbuf[k];
+	for (i = 0; i < in.numinst; i++) {
+	    in.instlist[i] = ntohl(in.instlist[i]);
+	    in.namelist[i] = &namebase[ntohl(stridx[i])];
+	}
+	shareinsts(acp->ac_log, &in, &tbuf, &allinbuf);
+	if ((sts = __pmLogAddInDom(acp, &when, &in, tbuf, allinbuf)) < 0)
+	    return sts;
+	/* If this indom was a duplicate, then we need to free tbuf and
+	   namelist, as appropriate. */
+	if (sts == PMLOGPUTINDOM_DUP) {
+	    free(tbuf);
+	    if (in.namelist != NULL && !allinbuf)
+		free(in.namelist);
+	}
+    }
+    else {
+	/* no instances, or an error */
+	free(tbuf);
+    }
+    return sts;
+}
+
+/*
+ * Decode the body of a label set record, read into tbuf, and add it
+ * to the hashed label sets.
+ */
+static int
+decodelabel(__pmArchCtl *acp, char *tbuf, int rlen)
+{
+    int			i, j, k;
+    int			type;
+    int			ident;
+    int			nsets;
+    int			inst;
+    int			jsonlen;
+    int			nlabels;
+    pmTimeval		stamp;
+    pmLabelSet		*labelsets = NULL;
+
+    k = 0;
+    stamp = *((pmTimeval *)&tbuf[k]);
+    stamp.tv_sec = ntohl(stamp.tv_sec);
+    stamp.tv_usec = ntohl(stamp.tv_usec);
+    k += sizeof(stamp);
+
+    type = ntohl(*((unsigned int*)&tbuf[k]));
+    k += sizeof(type);
+
+    ident = ntohl(*((unsigned int*)&tbuf[k]));
+    k += sizeof(ident);
+
+    nsets = *((unsigned int *)&tbuf[k]);
+    nsets = ntohl(nsets);
+    k += sizeof(nsets);
+
+    if (nsets > 0 &&
+	(labelsets = (pmLabelSet *)calloc(nsets, sizeof(pmLabelSet))) == NULL)
+	return -oserror();
+
+    for (i = 0; i < nsets; i++) {
+	inst = *((unsigned int*)&tbuf[k]);
+	inst = ntohl(inst);
+	k += sizeof(inst);
+	labelsets[i].inst = inst;
+
+	jsonlen = ntohl(*((unsigned int*)&tbuf[k]));
+	k += sizeof(jsonlen);
+	labelsets[i].jsonlen = jsonlen;
+
+	if (jsonlen < 0 || jsonlen > PM_MAXLABELJSONLEN) {
+	    if (pmDebugOptions.logmeta)
+		fprintf(stderr, "%s: corrupted json in labelset. jsonlen=%d\n",
+				"__pmLogLoadMeta", jsonlen);
+	    free(labelsets);
+	    return PM_ERR_LOGREC;
+	}
+
+	if ((labelsets[i].json = (char *)malloc(jsonlen+1)) == NULL) {
+	    free(labelsets);
+	    return -oserror();
+	}
+
+	memcpy((void *)labelsets[i].json, (void *)&tbuf[k], jsonlen);
+	labelsets[i].json[jsonlen] = '\0';
+	k += jsonlen;
+
+	/* label nlabels */
+	nlabels = ntohl(*((unsigned int *)&tbuf[k]));
+	k += sizeof(nlabels);
+	labelsets[i].nlabels = nlabels;
+
+	if (nlabels > 0) { /* nlabels < 0 is an error code. skip it here */
+	    if (nlabels > PM_MAXLABELS || k + nlabels * sizeof(pmLabel) > rlen) {
+		/* corrupt archive metadata detected. GH #475 */
+		if (pmDebugOptions.logmeta)
+		    fprintf(stderr, "%s: corrupted labelset. nlabels=%d\n",
+				    "__pmLogLoadMeta", nlabels);
+		free(labelsets);
+		return PM_ERR_LOGREC;
+	    }
+
+	    if ((labelsets[i].labels = (pmLabel *)calloc(nlabels, sizeof(pmLabel))) == NULL) {
+		free(labelsets);
+		return -oserror();
+	    }
+
+	    /* label pmLabels */
+	    for (j = 0; j < nlabels; j++) {
+		labelsets[i].labels[j] = *((pmLabel *)&tbuf[k]);
+		__ntohpmLabel(&labelsets[i].labels[j]);
+		k += sizeof(pmLabel);
+	    }
+	}
+    }
+
+    return addlabel(acp, type, ident, nsets, labelsets, &stamp);
+}
+
+/*
+ * Decode the type and identifier at the start of a help text record,
+ * return 0 if the record is to be ignored.
+ */
+static int
+textident(const char *tbuf, unsigned int *type, unsigned int *ident)
+{
+    *type = ntohl(*((unsigned int *)tbuf));
+    if (!(*type & (PM_TEXT_ONELINE|PM_TEXT_HELP))) {
+	if (pmDebugOptions.logmeta) {
+	    fprintf(stderr, "__pmLogLoadMeta: bad text type -> %x\n",
+		    *type);
+	}
+	return 0;
+    }
+    else if (*type & PM_TEXT_INDOM)
+	*ident = __ntohpmInDom(*((unsigned int *)&tbuf[sizeof(*type)]));
+    else if (*type & PM_TEXT_PMID)
+	*ident = __ntohpmID(*((unsigned int *)&tbuf[sizeof(*type)]));
+    else {
+	if (pmDebugOptions.logmeta) {
+	    fprintf(stderr, "%s: bad text ident -> %x\n",
+			    "__pmLogLoadMeta", *type);
+	}
+	return 0;
+    }
+    return 1;
+}
+
+/*
+ * Decode the body of a help text record, read into tbuf, and add it
+ * to the hashed help text.
+ */
+static int
+decodetext(__pmArchCtl *acp, char *tbuf)
+{
+    unsigned int	type;
+    unsigned int	ident;
+
+    if (!textident(tbuf, &type, &ident))
+	return 0;
+    return addtext(acp, ident, type, &tbuf[sizeof(type) + sizeof(ident)]);
+}
+
+/*
+ * Lazy loading state for lcp, or NULL if metadata is not loaded lazily.
+ */
+static struct __pmLogLazy *
+lazyctl(__pmLogCtl *lcp)
+{
+    __pmLogPriv		*lpp = __pmLogGetPriv(lcp, 0);
+
+    return lpp != NULL ? lpp->lp_lazy : NULL;
+}
+
+/*
+ * Note the location of an instance domain, label set or help text record
+ * for decoding later, consuming the record body from f.  Only enough of
+ * the body is read to determine the hash key for the record.
+ */
+static int
+lazyadd(__pmLogCtl *lcp, struct __pmLogLazy *lzp, int file, __pmFILE *f,
+	int htype, int rlen)
+{
+    __pmHashPoolCtl	*hpp;
+    __pmHashCtl		*hcp;
+    __pmHashNode	*hp;
+    lazylist_t		*lp;
+    lazyrec_t		*rp;
+    unsigned int	buf[4];
+    unsigned int	type = 0;
+    unsigned int	key;
+    long		offset = __pmFtell(f);
+    int			need, n, sts;
+
+    /* indom: stamp, indom, numinst - label: stamp, type, ident - text: type, ident */
+    need = (htype == TYPE_TEXT ? 2 : 4) * sizeof(int);
+    if (rlen < need) {
+	if (pmDebugOptions.logmeta) {
+	    fprintf(stderr, "%s: type %d record len=%d: too short\n",
+			    "__pmLogLoadMeta", htype, rlen);
+	}
+	return PM_ERR_LOGREC;
+    }
+    if ((n = (int)__pmFread(buf, 1, need, f)) != need) {
+	if (pmDebugOptions.logmeta) {
+	    fprintf(stderr, "%s: type %d record read -> %d: expected: %d\n",
+			    "__pmLogLoadMeta", htype, n, need);
+	}
+	if (__pmFerror(f)) {
+	    __pmClearerr(f);
+	    return -oserror();
+	}
+	return PM_ERR_LOGREC;
+    }
+    __pmFseek(f, (long)(rlen - need), SEEK_CUR);
+
+    if (htype == TYPE_INDOM) {
+	if ((int)ntohl(buf[3]) <= 0)
+	    return 0;		/* no instances, never used */
+	key = __ntohpmInDom(buf[2]);
+	hpp = &lzp->lz_indom;
+    }
+    else if (htype == TYPE_LABEL) {
+	type = ntohl(buf[2]);
+	key = ntohl(buf[3]);
+	hpp = &lzp->lz_labels;
+    }
+    else {
+	if (!textident((char *)buf, &type, &key))
+	    return 0;
+	hpp = &lzp->lz_text;
+	/*
+	 * Lookups distinguish no help text of this type at all from none
+	 * for this identifier, so the per-type hash table is needed now.
+	 */
+	if (__pmHashSearch(type, &lcp->l_hashtext) == NULL) {
+	    if ((hcp = (__pmHashCtl *)calloc(1, sizeof(__pmHashCtl))) == NULL)
+		return -oserror();
+	    if ((sts = __pmHashAdd(type, (void *)hcp, &lcp->l_hashtext)) < 0) {
+		free(hcp);
+		return sts;
+	    }
+	}
+    }
+
+    if ((rp = (lazyrec_t *)malloc(sizeof(lazyrec_t))) == NULL)
+	return -oserror();
+    rp->next = NULL;
+    rp->file = file;
+    rp->type = type;
+    rp->offset = offset;
+    rp->rlen = rlen;
+
+    if ((hp = __pmHashSearch(key, &hpp->hc)) != NULL)
+	lp = (lazylist_t *)hp->data;
+    else {
+	if ((lp = (lazylist_t *)calloc(1, sizeof(lazylist_t))) == NULL) {
+	    sts = -oserror();
+	    free(rp);
+	    return sts;
+	}
+	if ((sts = __pmHashPoolAdd(key, (void *)lp, hpp)) < 0) {
+	    free(lp);
+	    free(rp);
+	    return sts;
+	}
+    }
+    if (lp->tail)
+	lp->tail->next = rp;
+    else
+	lp->head = rp;
+    lp->tail = rp;
+    return 0;
+}
+
+/*
+ * Find, or add, the lazy loading state for the archive being loaded.
+ * Returns the index into lz_file[].
+ */
+static int
+lazyfile(__pmLogCtl *lcp, struct __pmLogLazy *lzp)
+{
+    lazyfile_t		*lfp;
+    int			i;
+
+    for (i = 0; i < lzp->lz_nfile; i++) {
+	if (strcmp(lzp->lz_file[i].name, lcp->l_name) == 0)
+	    break;
+    }
+    if (i == lzp->lz_nfile) {
+	lfp = (lazyfile_t *)realloc(lzp->lz_file, (i + 1) * sizeof(lazyfile_t));
+	if (lfp == NULL)
+	    return -oserror();
+	lzp->lz_file = lfp;
+	lfp = &lfp[i];
+	if ((lfp->name = strdup(lcp->l_name)) == NULL)
+	    return -oserror();
+	lfp->end = (long)(sizeof(__pmLogLabel) + 2*sizeof(int));
+	lfp->numpmid = 0;
+	lzp->lz_nfile++;
+    }
+    /*
+     * else an archive re-opened in a multi-archive context, and only
+     * records beyond those already seen need to be noted.
+     */
+    return i;
+}
+
 /*
  * Load _all_ of the hashed pmDesc and __pmLogInDom structures from the metadata
  * log file -- used at the initialization (NewContext) of an archive.
  * Also load all the metric names from the metadata log file and create l_pmns,
  * if it does not already exist.
+ *
+ * With lazy loading, records other than pmDescs are only indexed here.
  */
 int
 __pmLogLoadMeta(__pmArchCtl *acp)
 {
     __pmLogCtl		*lcp = acp->ac_log;
+    __pmLogPriv		*lpp;
+    struct __pmLogLazy	*lzp = NULL;
     int			rlen;
     int			check;
     int			sts = 0;
     __pmLogHdr		h;
     __pmFILE		*f = lcp->l_mdfp;
+    long		start = (long)(sizeof(__pmLogLabel) + 2*sizeof(int));
+    long		offset;
+    int			file = -1;
     int			numpmid = 0;
     int			n;
     int			numnames;
@@ -664,10 +1226,30 @@ __pmLogLoadMeta(__pmArchCtl *acp)
     if (lcp->l_pmns == NULL) {
 	if ((sts = __pmNewPMNS(&(lcp->l_pmns))) < 0)
 	    goto end;
+	if (getenv("PCP_LAZY_METADATA") != NULL) {		/* THREADSAFE */
+	    if ((lpp = __pmLogGetPriv(lcp, 1)) == NULL ||
+		(lzp = (struct __pmLogLazy *)calloc(1, sizeof(*lzp))) == NULL) {
+		sts = -oserror();
+		goto end;
+	    }
+	    __pmHashPoolInit(&lzp->lz_indom);
+	    __pmHashPoolInit(&lzp->lz_labels);
+	    __pmHashPoolInit(&lzp->lz_text);
+	    lpp->lp_lazy = lzp;
+	}
     }
+    if ((lzp = lazyctl(lcp)) != NULL) {
+	if ((file = lazyfile(lcp, lzp)) < 0) {
+	    sts = file;
+	    goto end;
+	}
+	__pmFseek(f, lzp->lz_file[file].end, SEEK_SET);
+    }
+    else
+	__pmFseek(f, start, SEEK_SET);
 
-    __pmFseek(f, (long)(sizeof(__pmLogLabel) + 2*sizeof(int)), SEEK_SET);
     for ( ; ; ) {
+	offset = __pmFtell(f);
 	n = (int)__pmFread(&h, 1, sizeof(__pmLogHdr), f);
 
 	/* swab hdr */
@@ -677,6 +1259,8 @@ __pmLogLoadMeta(__pmArchCtl *acp)
 	if (n != sizeof(__pmLogHdr) || h.len <= 0) {
             if (__pmFeof(f)) {
 		__pmClearerr(f);
+		if (lzp != NULL)
+		    lzp->lz_file[file].end = offset;
                 sts = 0;
 		goto end;
             }
@@ -694,7 +1278,7 @@ __pmLogLoadMeta(__pmArchCtl *acp)
 	}
 	if (pmDebugOptions.logmeta) {
 	    fprintf(stderr, "__pmLogLoadMeta: record len=%d, type=%d @ offset=%d\n",
-		h.len, h.type, (int)(__pmFtell(f) - sizeof(__pmLogHdr)));
+		h.len, h.type, (int)offset);
 	}
 	rlen = h.len - (int)sizeof(__pmLogHdr) - (int)sizeof(int);
 	if (h.type == TYPE_DESC) {
@@ -791,13 +1375,13 @@ __pmLogLoadMeta(__pmArchCtl *acp)
 		    goto end;
 	    }/*for*/
 	}
+	else if (lzp != NULL &&
+		 (h.type == TYPE_INDOM || h.type == TYPE_LABEL || h.type == TYPE_TEXT)) {
+	    if ((sts = lazyadd(lcp, lzp, file, f, h.type, rlen)) < 0)
+		goto end;
+	}
 	else if (h.type == TYPE_INDOM) {
-	    pmTimeval		*tv;
-	    pmTimespec		when;
-	    pmInResult		in;
-	    char		*namebase;
-	    int			*tbuf, *stridx;
-	    int			i, k, allinbuf = 0;
+	    int			*tbuf;
 
 PM_FAULT_POINT("libpcp/" __FILE__ ":3", PM_FAULT_ALLOC);
 	    if ((tbuf = (int *)malloc(rlen)) == NULL) {
@@ -818,65 +1402,11 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":3", PM_FAULT_ALLOC);
 		free(tbuf);
 		goto end;
 	    }
-
-	    k = 0;
-	    tv = (pmTimeval *)&tbuf[k];
-	    when.tv_sec = ntohl(tv->tv_sec);
-	    when.tv_nsec = ntohl(tv->tv_usec) * 1000;
-	    k += sizeof(*tv)/sizeof(int);
-	    in.indom = __ntohpmInDom((unsigned int)tbuf[k++]);
-	    in.numinst = ntohl(tbuf[k++]);
-	    if (in.numinst > 0) {
-		in.instlist = &tbuf[k];
-		k += in.numinst;
-		stridx = &tbuf[k];
-#if defined(HAVE_32BIT_PTR)
-		in.namelist = (char **)stridx;
-		allinbuf = 1; /* allocation is all in tbuf */
-#else
-		allinbuf = 0; /* allocation for namelist + tbuf */
-		/* need to allocate to hold the pointers */
-PM_FAULT_POINT("libpcp/" __FILE__ ":4", PM_FAULT_ALLOC);
-		in.namelist = (char **)malloc(in.numinst * sizeof(char*));
-		if (in.namelist == NULL) {
-		    sts = -oserror();
-		    free(tbuf);
-		    goto end;
-		}
-#endif
-		k += in.numinst;
-		namebase = (char *)&tbuf[k];
-	        for (i = 0; i < in.numinst; i++) {
-		    in.instlist[i] = ntohl(in.instlist[i]);
-	            in.namelist[i] = &namebase[ntohl(stridx[i])];
-		}
-		if ((sts = __pmLogAddInDom(acp, &when, &in, tbuf, allinbuf)) < 0)
-		    goto end;
-		/* If this indom was a duplicate, then we need to free tbuf and
-		   namelist, as appropriate. */
-		if (sts == PMLOGPUTINDOM_DUP) {
-		    free(tbuf);
-		    if (in.namelist != NULL && !allinbuf)
-			free(in.namelist);
-		}
-	    }
-	    else {
-		/* no instances, or an error */
-		free(tbuf);
-	    }
-	}
-	else if (h.type == TYPE_LABEL) {
-	    char		*tbuf;
-	    int			k;
-	    int			j;
-	    int			type;
-	    int			ident;
-	    int			nsets;
-	    int			inst;
-	    int			jsonlen;
-	    int			nlabels;
-	    pmTimeval		stamp;
-	    pmLabelSet		*labelsets = NULL;
+	    if ((sts = decodeindom(acp, tbuf, rlen)) < 0)
+		goto end;
+	}
+	else if (h.type == TYPE_LABEL) {
+	    char		*tbuf;
 
 PM_FAULT_POINT("libpcp/" __FILE__ ":11", PM_FAULT_ALLOC);
 	    if ((tbuf = (char *)malloc(rlen)) == NULL) {
@@ -897,103 +1427,13 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":11", PM_FAULT_ALLOC);
 		free(tbuf);
 		goto end;
 	    }
-
-	    k = 0;
-	    stamp = *((pmTimeval *)&tbuf[k]);
-	    stamp.tv_sec = ntohl(stamp.tv_sec);
-	    stamp.tv_usec = ntohl(stamp.tv_usec);
-	    k += sizeof(stamp);
-
-	    type = ntohl(*((unsigned int*)&tbuf[k]));
-	    k += sizeof(type);
-
-	    ident = ntohl(*((unsigned int*)&tbuf[k]));
-	    k += sizeof(ident);
-
-	    nsets = *((unsigned int *)&tbuf[k]);
-	    nsets = ntohl(nsets);
-	    k += sizeof(nsets);
-
-	    if (nsets > 0 &&
-		(labelsets = (pmLabelSet *)calloc(nsets, sizeof(pmLabelSet))) == NULL) {
-		sts = -oserror();
-		free(tbuf);
-		goto end;
-	    }
-
-	    for (i = 0; i < nsets; i++) {
-		inst = *((unsigned int*)&tbuf[k]);
-		inst = ntohl(inst);
-		k += sizeof(inst);
-		labelsets[i].inst = inst;
-
-		jsonlen = ntohl(*((unsigned int*)&tbuf[k]));
-		k += sizeof(jsonlen);
-		labelsets[i].jsonlen = jsonlen;
-
-		if (jsonlen < 0 || jsonlen > PM_MAXLABELJSONLEN) {
-		    if (pmDebugOptions.logmeta)
-			fprintf(stderr, "%s: corrupted json in labelset. jsonlen=%d\n",
-					"__pmLogLoadMeta", jsonlen);
-		    sts = PM_ERR_LOGREC;
-		    free(labelsets);
-		    free(tbuf);
-		    goto end;
-		}
-
-		if ((labelsets[i].json = (char *)malloc(jsonlen+1)) == NULL) {
-		    sts = -oserror();
-		    free(labelsets);
-		    free(tbuf);
-		    goto end;
-		}
-
-		memcpy((void *)labelsets[i].json, (void *)&tbuf[k], jsonlen);
-		labelsets[i].json[jsonlen] = '\0';
-		k += jsonlen;
-
-		/* label nlabels */
-		nlabels = ntohl(*((unsigned int *)&tbuf[k]));
-		k += sizeof(nlabels);
-		labelsets[i].nlabels = nlabels;
-
-		if (nlabels > 0) { /* nlabels < 0 is an error code. skip it here */
-		    if (nlabels > PM_MAXLABELS || k + nlabels * sizeof(pmLabel) > rlen) {
-			/* corrupt archive metadata detected. GH #475 */
-			if (pmDebugOptions.logmeta)
-			    fprintf(stderr, "%s: corrupted labelset. nlabels=%d\n",
-					    "__pmLogLoadMeta", nlabels);
-			sts = PM_ERR_LOGREC;
-			free(labelsets);
-			free(tbuf);
-			goto end;
-		    }
-
-		    if ((labelsets[i].labels = (pmLabel *)calloc(nlabels, sizeof(pmLabel))) == NULL) {
-			sts = -oserror();
-			free(labelsets);
-			free(tbuf);
-			goto end;
-		    }
-
-		    /* label pmLabels */
-		    for (j = 0; j < nlabels; j++) {
-			labelsets[i].labels[j] = *((pmLabel *)&tbuf[k]);
-			__ntohpmLabel(&labelsets[i].labels[j]);
-			k += sizeof(pmLabel);
-		    }
-		}
-	    }
+	    sts = decodelabel(acp, tbuf, rlen);
 	    free(tbuf);
-
-	    if ((sts = addlabel(acp, type, ident, nsets, labelsets, &stamp)) < 0)
+	    if (sts < 0)
 		goto end;
 	}
 	else if (h.type == TYPE_TEXT) {
 	    char		*tbuf;
-	    int			type;
-	    int			ident;
-	    int			k;
 
 PM_FAULT_POINT("libpcp/" __FILE__ ":16", PM_FAULT_ALLOC);
 	    if ((tbuf = (char *)malloc(rlen)) == NULL) {
@@ -1014,33 +1454,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":16", PM_FAULT_ALLOC);
 		free(tbuf);
 		goto end;
 	    }
-
-	    k = 0;
-	    type = ntohl(*((unsigned int *)&tbuf[k]));
-	    k += sizeof(type);
-	    if (!(type & (PM_TEXT_ONELINE|PM_TEXT_HELP))) {
-		if (pmDebugOptions.logmeta) {
-		    fprintf(stderr, "__pmLogLoadMeta: bad text type -> %x\n",
-			    type);
-		}
-		free(tbuf);
-		continue;
-	    }
-	    else if (type & PM_TEXT_INDOM)
-		ident = __ntohpmInDom(*((unsigned int *)&tbuf[k]));
-	    else if (type & PM_TEXT_PMID)
-		ident = __ntohpmID(*((unsigned int *)&tbuf[k]));
-	    else {
-		if (pmDebugOptions.logmeta) {
-		    fprintf(stderr, "%s: bad text ident -> %x\n",
-				    "__pmLogLoadMeta", type);
-		}
-		free(tbuf);
-		continue;
-	    }
-	    k += sizeof(ident);
-
-	    sts = addtext(acp, ident, type, (char *)&tbuf[k]);
+	    sts = decodetext(acp, tbuf);
 	    free(tbuf);
 	    if (sts < 0)
 		goto end;
@@ -1066,10 +1480,16 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":16", PM_FAULT_ALLOC);
     }/*for*/
 end:
 
-    /* Check for duplicate label sets. */
-    check_dup_labels(acp);
+    if (lzp == NULL) {
+	/* Check for duplicate label sets. */
+	check_dup_labels(acp);
+    }
+    else if (file >= 0) {
+	lzp->lz_file[file].numpmid += numpmid;
+	numpmid = lzp->lz_file[file].numpmid;
+    }
     
-    __pmFseek(f, (long)(sizeof(__pmLogLabel) + 2*sizeof(int)), SEEK_SET);
+    __pmFseek(f, start, SEEK_SET);
 
     if (sts == 0) {
 	if (numpmid == 0) {
@@ -1084,6 +1504,325 @@ end:
     return sts;
 }
 
+/*
+ * Return the metadata file for lz_file[file].  That of the archive
+ * currently open is shared, any other is reopened, closing the one
+ * reopened previously.
+ */
+static __pmFILE *
+lazyopen(__pmLogCtl *lcp, struct __pmLogLazy *lzp, int file)
+{
+    const char		*name = lzp->lz_file[file].name;
+    char		fname[MAXPATHLEN];
+
+    if (lcp->l_mdfp != NULL && strcmp(name, lcp->l_name) == 0)
+	return lcp->l_mdfp;
+    if (lzp->lz_f != NULL) {
+	if (lzp->lz_fnum == file)
+	    return lzp->lz_f;
+	__pmResetIPC(__pmFileno(lzp->lz_f));
+	__pmFclose(lzp->lz_f);
+    }
+    __pmLogName_r(name, PM_LOG_VOL_META, fname, sizeof(fname));
+    if ((lzp->lz_f = __pmFopen(fname, "r")) == NULL) {
+	if (pmDebugOptions.logmeta) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    fprintf(stderr, "%s: %s: %s\n", "lazyopen", fname,
+			    pmErrStr_r(-oserror(), errmsg, sizeof(errmsg)));
+	}
+	return NULL;
+    }
+    lzp->lz_fnum = file;
+    return lzp->lz_f;
+}
+
+/*
+ * Read the body of a lazily loaded record, leaving the position in the
+ * metadata file unchanged.
+ */
+static int
+lazyread(__pmLogCtl *lcp, struct __pmLogLazy *lzp, const lazyrec_t *rp,
+	char **bufp)
+{
+    __pmFILE		*f;
+    char		*buf;
+    long		posn;
+    int			n, sts = 0;
+
+    if ((f = lazyopen(lcp, lzp, rp->file)) == NULL)
+	return -oserror();
+    if ((buf = (char *)malloc(rp->rlen)) == NULL)
+	return -oserror();
+    posn = __pmFtell(f);
+    __pmFseek(f, rp->offset, SEEK_SET);
+    if ((n = (int)__pmFread(buf, 1, rp->rlen, f)) != rp->rlen) {
+	if (pmDebugOptions.logmeta) {
+	    fprintf(stderr, "%s: %s record read -> %d: expected: %d @ offset=%ld\n",
+			    "lazyread", lzp->lz_file[rp->file].name, n, rp->rlen,
+			    rp->offset);
+	}
+	if (__pmFerror(f)) {
+	    __pmClearerr(f);
+	    sts = -oserror();
+	}
+	else
+	    sts = PM_ERR_LOGREC;
+	free(buf);
+    }
+    __pmFseek(f, posn, SEEK_SET);
+    if (sts == 0)
+	*bufp = buf;
+    return sts;
+}
+
+/*
+ * Read and decode one lazily loaded record.
+ */
+static int
+lazydecode(__pmArchCtl *acp, struct __pmLogLazy *lzp, int htype,
+	const lazyrec_t *rp)
+{
+    char		*buf = NULL;
+    int			sts;
+
+    if ((sts = lazyread(acp->ac_log, lzp, rp, &buf)) < 0)
+	return sts;
+    if (htype == TYPE_INDOM)
+	return decodeindom(acp, (int *)buf, rp->rlen);
+    if (htype == TYPE_LABEL)
+	sts = decodelabel(acp, buf, rp->rlen);
+    else
+	sts = decodetext(acp, buf);
+    free(buf);
+    return sts;
+}
+
+/*
+ * Decode any lazily loaded records for the given instance domain, or
+ * label set or help text type and identifier.  The records are unlinked
+ * before they are decoded, so they are only ever decoded once.
+ */
+static int
+lazyload(__pmArchCtl *acp, int htype, unsigned int type, unsigned int key)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+    struct __pmLogLazy	*lzp = lazyctl(lcp);
+    __pmHashPoolCtl	*hpp;
+    __pmHashNode	*hp;
+    lazylist_t		*lp;
+    lazyrec_t		*rp, *prev, *next;
+    lazyrec_t		*todo = NULL, **tail = &todo;
+    int			sts = 0;
+
+    if (lzp == NULL)
+	return 0;
+
+    if (htype == TYPE_INDOM)
+	hpp = &lzp->lz_indom;
+    else if (htype == TYPE_LABEL)
+	hpp = &lzp->lz_labels;
+    else
+	hpp = &lzp->lz_text;
+
+    PM_LOCK(lcp->l_lock);
+    if ((hp = __pmHashSearch(key, &hpp->hc)) == NULL) {
+	PM_UNLOCK(lcp->l_lock);
+	return 0;
+    }
+    lp = (lazylist_t *)hp->data;
+    prev = NULL;
+    for (rp = lp->head; rp != NULL; rp = next) {
+	next = rp->next;
+	if (htype != TYPE_INDOM && rp->type != type) {
+	    prev = rp;
+	    continue;
+	}
+	if (prev)
+	    prev->next = next;
+	else
+	    lp->head = next;
+	if (lp->tail == rp)
+	    lp->tail = prev;
+	rp->next = NULL;
+	*tail = rp;
+	tail = &rp->next;
+    }
+    if (todo == NULL) {
+	PM_UNLOCK(lcp->l_lock);
+	return 0;
+    }
+
+    if (pmDebugOptions.logmeta) {
+	fprintf(stderr, "lazyload( ..., type=%d, %u, %u)\n", htype, type, key);
+    }
+    for (rp = todo; rp != NULL; rp = next) {
+	next = rp->next;
+	if (sts >= 0)
+	    sts = lazydecode(acp, lzp, htype, rp);
+	free(rp);
+    }
+
+    if (htype == TYPE_LABEL &&
+	(hp = __pmHashSearch(type, &lcp->l_hashlabels)) != NULL &&
+	(hp = __pmHashSearch(key, (__pmHashCtl *)hp->data)) != NULL)
+	check_dup_labelsets(hp);
+
+    PM_UNLOCK(lcp->l_lock);
+    return sts < 0 ? sts : 0;
+}
+
+typedef struct {
+    int			htype;
+    lazyrec_t		*rp;
+} lazyent_t;
+
+typedef struct {
+    int			htype;
+    int			count;
+    int			size;
+    lazyent_t		*ents;
+    int			sts;
+} lazywalk_t;
+
+static __pmHashWalkState
+lazyall_cb(const __pmHashNode *hp, void *cdata)
+{
+    lazywalk_t		*lwp = (lazywalk_t *)cdata;
+    lazylist_t		*lp = (lazylist_t *)hp->data;
+    lazyent_t		*ents;
+    lazyrec_t		*rp, *next;
+
+    for (rp = lp->head; rp != NULL; rp = next) {
+	next = rp->next;
+	if (lwp->count == lwp->size) {
+	    lwp->size = lwp->size ? 2 * lwp->size : 256;
+	    ents = (lazyent_t *)realloc(lwp->ents, lwp->size * sizeof(lazyent_t));
+	    if (ents == NULL) {
+		lwp->sts = -oserror();
+		return PM_HASH_WALK_STOP;
+	    }
+	    lwp->ents = ents;
+	}
+	lwp->ents[lwp->count].htype = lwp->htype;
+	lwp->ents[lwp->count].rp = rp;
+	lwp->count++;
+	lp->head = next;
+    }
+    lp->tail = NULL;
+    return PM_HASH_WALK_NEXT;
+}
+
+static int
+lazycmp(const void *a, const void *b)
+{
+    const lazyrec_t	*ra = ((const lazyent_t *)a)->rp;
+    const lazyrec_t	*rb = ((const lazyent_t *)b)->rp;
+
+    if (ra->file != rb->file)
+	return ra->file - rb->file;
+    return ra->offset < rb->offset ? -1 : (ra->offset > rb->offset);
+}
+
+/*
+ * Decode all of the records not yet decoded after a lazy __pmLogLoadMeta,
+ * for callers that traverse the hashed metadata structures directly.
+ * This is done in file order, so the result is exactly as if the
+ * metadata had not been loaded lazily.
+ */
+int
+__pmLogLoadLazyMeta(__pmArchCtl *acp)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+    struct __pmLogLazy	*lzp = lazyctl(lcp);
+    lazywalk_t		walk;
+    int			i, sts;
+
+    if (lzp == NULL)
+	return 0;
+
+    memset(&walk, 0, sizeof(walk));
+    PM_LOCK(lcp->l_lock);
+    walk.htype = TYPE_INDOM;
+    __pmHashPoolWalkCB(lazyall_cb, &walk, &lzp->lz_indom);
+    walk.htype = TYPE_LABEL;
+    __pmHashPoolWalkCB(lazyall_cb, &walk, &lzp->lz_labels);
+    walk.htype = TYPE_TEXT;
+    __pmHashPoolWalkCB(lazyall_cb, &walk, &lzp->lz_text);
+    qsort(walk.ents, walk.count, sizeof(lazyent_t), lazycmp);
+
+    for (i = 0; i < walk.count; i++) {
+	if (walk.sts >= 0 &&
+	    (sts = lazydecode(acp, lzp, walk.ents[i].htype,
+				walk.ents[i].rp)) < 0)
+	    walk.sts = sts;
+	free(walk.ents[i].rp);
+    }
+    free(walk.ents);
+    check_dup_labels(acp);
+    PM_UNLOCK(lcp->l_lock);
+
+    return walk.sts;
+}
+
+static __pmHashWalkState
+lazyfree_cb(const __pmHashNode *hp, void *cdata)
+{
+    lazylist_t		*lp = (lazylist_t *)hp->data;
+    lazyrec_t		*rp, *next;
+
+    for (rp = lp->head; rp != NULL; rp = next) {
+	next = rp->next;
+	free(rp);
+    }
+    free(lp);
+    return PM_HASH_WALK_NEXT;
+}
+
+void
+__pmLogFreeLazyMeta(__pmLogPriv *lpp)
+{
+    struct __pmLogLazy	*lzp = lpp->lp_lazy;
+    int			i;
+
+    if (lzp == NULL)
+	return;
+    if (lzp->lz_f != NULL) {
+	__pmResetIPC(__pmFileno(lzp->lz_f));
+	__pmFclose(lzp->lz_f);
+    }
+    for (i = 0; i < lzp->lz_nfile; i++)
+	free(lzp->lz_file[i].name);
+    free(lzp->lz_file);
+    __pmHashPoolWalkCB(lazyfree_cb, NULL, &lzp->lz_indom);
+    __pmHashPoolClear(&lzp->lz_indom);
+    __pmHashPoolWalkCB(lazyfree_cb, NULL, &lzp->lz_labels);
+    __pmHashPoolClear(&lzp->lz_labels);
+    __pmHashPoolWalkCB(lazyfree_cb, NULL, &lzp->lz_text);
+    __pmHashPoolClear(&lzp->lz_text);
+    free(lzp);
+    lpp->lp_lazy = NULL;
+}
+
+static __pmHashWalkState
+indomtimefree_cb(const __pmHashNode *hp, void *cdata)
+{
+    indomtime_t		*itp = (indomtime_t *)hp->data;
+
+    free(itp->vers);
+    free(itp);
+    return PM_HASH_WALK_NEXT;
+}
+
+/*
+ * Free the instance domain time indexes.
+ */
+void
+__pmLogFreeInDomTime(__pmLogPriv *lpp)
+{
+    __pmHashWalkCB(indomtimefree_cb, NULL, &lpp->lp_hashindomtime);
+    __pmHashClear(&lpp->lp_hashindomtime);
+}
+
 /*
  * scan the hashed data structures to find a pmDesc, given a pmid
  */
@@ -1187,11 +1926,102 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":5", PM_FAULT_ALLOC);
     return __pmHashAdd((int)dp->pmid, (void *)tdp, &lcp->l_hashpmid);
 }
 
+/*
+ * (Re)build the time index for an instance domain, given the head of
+ * its list of versions.  Called with l_lock held.
+ */
+static indomtime_t *
+indomtime(__pmLogPriv *lpp, pmInDom indom, __pmLogInDom *head)
+{
+    __pmHashNode	*hp;
+    __pmLogInDom	*idp;
+    __pmLogInDom	**vers;
+    indomtime_t		*itp;
+    int			n;
+
+    if ((hp = __pmHashSearch((unsigned int)indom, &lpp->lp_hashindomtime)) != NULL) {
+	itp = (indomtime_t *)hp->data;
+	if (itp->head == head)
+	    return itp;
+    }
+    else {
+	if ((itp = (indomtime_t *)calloc(1, sizeof(indomtime_t))) == NULL)
+	    return NULL;
+	if (__pmHashAdd((unsigned int)indom, (void *)itp, &lpp->lp_hashindomtime) < 0) {
+	    free(itp);
+	    return NULL;
+	}
+    }
+
+    for (n = 0, idp = head; idp != NULL; idp = idp->next)
+	n++;
+    if (n > itp->size) {
+	if ((vers = (__pmLogInDom **)realloc(itp->vers, n * sizeof(vers[0]))) == NULL) {
+	    itp->head = NULL;
+	    return NULL;
+	}
+	itp->vers = vers;
+	itp->size = n;
+    }
+    itp->count = n;
+    for (idp = head; idp != NULL; idp = idp->next)
+	itp->vers[--n] = idp;
+    itp->head = head;
+    itp->last = itp->count - 1;
+
+    if (pmDebugOptions.logmeta) {
+	char	strbuf[20];
+	fprintf(stderr, "indomtime( ..., %s) -> %d versions\n",
+		pmInDomStr_r(indom, strbuf, sizeof(strbuf)), itp->count);
+    }
+    return itp;
+}
+
+/*
+ * Find the newest version at or before the requested time.  For versions
+ * with the same time stamp the one nearest the head of the list wins, as
+ * it is the last of them in the time index.  Called with l_lock held.
+ */
+static __pmLogInDom *
+indomtime_search(indomtime_t *itp, const pmTimeval *tp)
+{
+    int			lo, hi, mid;
+
+    /* sequential replay: the same version as last time, or the next one */
+    for (lo = itp->last; lo < itp->count && lo <= itp->last + 1; lo++) {
+	if (__pmTimevalCmp(&itp->vers[lo]->stamp, tp) > 0)
+	    break;
+	if (lo == itp->count - 1 ||
+	    __pmTimevalCmp(&itp->vers[lo+1]->stamp, tp) > 0) {
+	    itp->last = lo;
+	    return itp->vers[lo];
+	}
+    }
+
+    lo = 0;
+    hi = itp->count - 1;
+    if (__pmTimevalCmp(&itp->vers[0]->stamp, tp) > 0)
+	return NULL;
+    /* invariant: vers[lo] is at or before tp, vers[hi+1] is after tp */
+    while (lo < hi) {
+	mid = lo + (hi - lo + 1) / 2;
+	if (__pmTimevalCmp(&itp->vers[mid]->stamp, tp) <= 0)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    itp->last = lo;
+    return itp->vers[lo];
+}
+
 static __pmLogInDom *
-searchindom(__pmLogCtl *lcp, pmInDom indom, pmTimeval *tp)
+searchindom(__pmArchCtl *acp, pmInDom indom, pmTimeval *tp)
 {
+    __pmLogCtl		*lcp = acp->ac_log;
+    __pmLogPriv		*lpp;
     __pmHashNode	*hp;
     __pmLogInDom	*idp;
+    indomtime_t		*itp;
 
     if (pmDebugOptions.logmeta) {
 	char	strbuf[20];
@@ -1200,27 +2030,34 @@ searchindom(__pmLogCtl *lcp, pmInDom indom, pmTimeval *tp)
 	fprintf(stderr, ")\n");
     }
 
+    if (lazyload(acp, TYPE_INDOM, 0, (unsigned int)indom) < 0)
+	return NULL;
     if ((hp = __pmHashSearch((unsigned int)indom, &lcp->l_hashindom)) == NULL)
 	return NULL;
 
     idp = (__pmLogInDom *)hp->data;
-    if (tp != NULL) {
-	for ( ; idp != NULL; idp = idp->next) {
-	    /*
-	     * need first one at or earlier than the requested time
-	     */
-	    if (__pmTimevalCmp(&idp->stamp, tp) <= 0)
-		break;
+    if (tp != NULL && idp != NULL && __pmTimevalCmp(&idp->stamp, tp) > 0) {
+	/* not the latest version, use the time index */
+	lpp = __pmLogGetPriv(lcp, 0);
+	PM_LOCK(lcp->l_lock);
+	if (lpp != NULL && (itp = indomtime(lpp, indom, idp)) != NULL)
+	    idp = indomtime_search(itp, tp);
+	else {
+	    /* no index, fall back to a linear search */
+	    for ( ; idp != NULL; idp = idp->next) {
+		if (__pmTimevalCmp(&idp->stamp, tp) <= 0)
+		    break;
+	    }
+	}
+	PM_UNLOCK(lcp->l_lock);
+	if (idp == NULL) {
 	    if (pmDebugOptions.logmeta) {
 		fprintf(stderr, "request @ ");
 		StrTimeval(tp);
-		fprintf(stderr, " is too early for indom @ ");
-		StrTimeval(&idp->stamp);
-		fputc('\n', stderr);
+		fprintf(stderr, " is too early for any indom\n");
 	    }
-	}
-	if (idp == NULL)
 	    return NULL;
+	}
     }
 
     if (pmDebugOptions.logmeta) {
@@ -1239,8 +2076,7 @@ searchindom(__pmLogCtl *lcp, pmInDom indom, pmTimeval *tp)
 int
 __pmLogGetInDom(__pmArchCtl *acp, pmInDom indom, pmTimeval *tp, int **instlist, char ***namelist)
 {
-    __pmLogCtl		*lcp = acp->ac_log;
-    __pmLogInDom	*idp = searchindom(lcp, indom, tp);
+    __pmLogInDom	*idp = searchindom(acp, indom, tp);
 
     if (idp == NULL)
 	return PM_ERR_INDOM_LOG;
@@ -1255,8 +2091,7 @@ int
 __pmLogLookupInDom(__pmArchCtl *acp, pmInDom indom, pmTimeval *tp, 
 		   const char *name)
 {
-    __pmLogCtl		*lcp = acp->ac_log;
-    __pmLogInDom	*idp = searchindom(lcp, indom, tp);
+    __pmLogInDom	*idp = searchindom(acp, indom, tp);
     int			i;
 
     if (idp == NULL)
@@ -1288,8 +2123,7 @@ __pmLogLookupInDom(__pmArchCtl *acp, pmInDom indom, pmTimeval *tp,
 int
 __pmLogNameInDom(__pmArchCtl *acp, pmInDom indom, pmTimeval *tp, int inst, char **name)
 {
-    __pmLogCtl		*lcp = acp->ac_log;
-    __pmLogInDom	*idp = searchindom(lcp, indom, tp);
+    __pmLogInDom	*idp = searchindom(acp, indom, tp);
     int			i;
 
     if (idp == NULL)
@@ -1316,29 +2150,11 @@ int
 __pmLogLookupLabel(__pmArchCtl *acp, unsigned int type, unsigned int ident,
 		pmLabelSet **label, const pmTimeval *tp)
 {
-    __pmLogCtl		*lcp = acp->ac_log;
-    __pmHashCtl		*label_hash;
-    __pmHashNode	*hp;
-    __pmLogLabelSet	*ls;
-
-    if ((hp = __pmHashSearch(type, &lcp->l_hashlabels)) == NULL)
-	return PM_ERR_NOLABELS;
-
-    label_hash = (__pmHashCtl *)hp->data;
-    if ((hp = __pmHashSearch(ident, label_hash)) == NULL)
-	return PM_ERR_NOLABELS;
+    int			sts;
 
-    ls = (__pmLogLabelSet *)hp->data;
-    if (tp != NULL) {
-	for ( ; ls != NULL; ls = ls->next) {
-	    if (__pmTimevalCmp(&ls->stamp, tp) <= 0)
-		break;
-	}
-	if (ls == NULL)
-	    return 0;
-    }
-    *label = ls->labelsets;
-    return ls->nsets;
+    if ((sts = lazyload(acp, TYPE_LABEL, type, ident)) < 0)
+	return sts;
+    return lookuplabel(acp->ac_log, type, ident, label, tp);
 }
 
 int
@@ -1444,19 +2260,11 @@ int
 __pmLogLookupText(__pmArchCtl *acp, unsigned int ident, unsigned int type,
 		char **buffer)
 {
-    __pmLogCtl		*lcp = acp->ac_log;
-    __pmHashCtl		*text_hash;
-    __pmHashNode	*hp;
-
-    if ((hp = __pmHashSearch(type, &lcp->l_hashtext)) == NULL)
-	return PM_ERR_NOTHOST;	/* back-compat error code */
-
-    text_hash = (__pmHashCtl *)hp->data;
-    if ((hp = __pmHashSearch(ident, text_hash)) == NULL)
-	return PM_ERR_TEXT;
+    int			sts;
 
-    *buffer = (char *)hp->data;
-    return 0;
+    if ((sts = lazyload(acp, TYPE_TEXT, type, ident)) < 0)
+	return sts;
+    return lookuptext(acp->ac_log, ident, type, buffer);
 }
 
 int
@@ -1603,6 +2411,10 @@ pmLookupInDomArchive(pmInDom indom, const char *name)
 	    return PM_ERR_NOTARCHIVE;
 	}
 
+	if ((n = lazyload(ctxp->c_archctl, TYPE_INDOM, 0, (unsigned int)indom)) < 0) {
+	    PM_UNLOCK(ctxp->c_lock);
+	    return n;
+	}
 	if ((hp = __pmHashSearch((unsigned int)indom, &ctxp->c_archctl->ac_log->l_hashindom)) == NULL) {
 	    PM_UNLOCK(ctxp->c_lock);
 	    return PM_ERR_INDOM_LOG;
@@ -1657,6 +2469,10 @@ pmNameInDomArchive(pmInDom indom, int inst, char **name)
 	    return PM_ERR_NOTARCHIVE;
 	}
 
+	if ((n = lazyload(ctxp->c_archctl, TYPE_INDOM, 0, (unsigned int)indom)) < 0) {
+	    PM_UNLOCK(ctxp->c_lock);
+	    return n;
+	}
 	if ((hp = __pmHashSearch((unsigned int)indom, &ctxp->c_archctl->ac_log->l_hashindom)) == NULL) {
 	    PM_UNLOCK(ctxp->c_lock);
 	    return PM_ERR_INDOM_LOG;
@@ -1776,6 +2592,11 @@ pmGetInDomArchive_ctx(__pmContext *ctxp, pmInDom indom, int **instlist, char ***
 	return PM_ERR_NOTARCHIVE;
     }
 
+    if ((n = lazyload(ctxp->c_archctl, TYPE_INDOM, 0, (unsigned int)indom)) < 0) {
+	if (need_unlock)
+	    PM_UNLOCK(ctxp->c_lock);
+	return n;
+    }
     if ((hp = __pmHashSearch((unsigned int)indom, &ctxp->c_archctl->ac_log->l_hashindom)) == NULL) {
 	if (need_unlock)
 	    PM_UNLOCK(ctxp->c_lock);
@@ -48,6 +48,15 @@ typedef struct {
  */
 static __pmHashCtl	pc_hc;
 
+/*
+ * Private reading state for each __pmLogCtl, see __pmLogGetPriv().
+ * Keyed by the __pmLogCtl address, entries with the same key are told
+ * apart by lp_lcp.
+ *
+ * Note, this hash table is also global across all contexts.
+ */
+static __pmHashCtl	lp_hc;
+
 static int LogCheckForNextArchive(__pmContext *, int, pmResult **);
 static int LogChangeToNextArchive(__pmContext *);
 static int LogChangeToPreviousArchive(__pmContext *);
@@ -328,60 +337,97 @@ __pmLogChangeVol(__pmArchCtl *acp, int vol)
     return sts;
 }
 
+/*
+ * Load the temporal index.  The whole file is read with one __pmFread()
+ * into an array sized from __pmFstat() (which reports the uncompressed
+ * size for compressed indexes), growing only if the index is still being
+ * written.  Any partial record at the end of the file is ignored.
+ */
 static int
 __pmLogLoadIndex(__pmLogCtl *lcp)
 {
     int		sts = 0;
     __pmFILE	*f = lcp->l_tifp;
-    int		n;
     __pmLogTI	*tip;
+    __pmLogTI	*prev;
+    __pmLogPriv	*lpp;
+    struct stat	sbuf;
+    size_t	bytes;
+    size_t	n;
+    long	start = (long)(sizeof(__pmLogLabel) + 2*sizeof(int));
+    int		maxti;
+    int		tiorder = 1;
+    int		i;
 
     lcp->l_numti = 0;
     lcp->l_ti = NULL;
 
     if (lcp->l_tifp != NULL) {
-	__pmFseek(f, (long)(sizeof(__pmLogLabel) + 2*sizeof(int)), SEEK_SET);
+	__pmFseek(f, start, SEEK_SET);
+	maxti = 0;
+	if (__pmFstat(f, &sbuf) >= 0 && sbuf.st_size > start)
+	    maxti = (int)((sbuf.st_size - start) / sizeof(__pmLogTI));
+	/* one spare, so a complete index ends with a short read at EOF */
+	maxti++;
 	for ( ; ; ) {
-	    lcp->l_ti = (__pmLogTI *)realloc(lcp->l_ti, (1 + lcp->l_numti) * sizeof(__pmLogTI));
-	    if (lcp->l_ti == NULL) {
+	    if ((tip = (__pmLogTI *)realloc(lcp->l_ti, maxti * sizeof(__pmLogTI))) == NULL) {
 		sts = -oserror();
 		break;
 	    }
-	    tip = &lcp->l_ti[lcp->l_numti];
-	    n = (int)__pmFread(tip, 1, sizeof(__pmLogTI), f);
-
-            if (n != sizeof(__pmLogTI)) {
-		if (__pmFeof(f)) {
-		    __pmClearerr(f);
-		    sts = 0; 
-		    break;
-		}
-	  	if (pmDebugOptions.log)
-	    	    fprintf(stderr, "__pmLogLoadIndex: bad TI entry len=%d: expected %d\n",
-		            n, (int)sizeof(__pmLogTI));
-		if (__pmFerror(f)) {
-		    __pmClearerr(f);
-		    sts = -oserror();
-		    break;
-		}
-		else {
-		    sts = PM_ERR_LOGREC;
-		    break;
-		}
+	    lcp->l_ti = tip;
+	    bytes = (maxti - lcp->l_numti) * sizeof(__pmLogTI);
+	    n = __pmFread(&lcp->l_ti[lcp->l_numti], 1, bytes, f);
+	    lcp->l_numti += (int)(n / sizeof(__pmLogTI));
+	    if (n == bytes) {
+		/* index has grown since __pmFstat(), keep going */
+		maxti *= 2;
+		continue;
 	    }
-	    else {
-		/* swab the temporal index record */
-		tip->ti_stamp.tv_sec = ntohl(tip->ti_stamp.tv_sec);
-		tip->ti_stamp.tv_usec = ntohl(tip->ti_stamp.tv_usec);
-		tip->ti_vol = ntohl(tip->ti_vol);
-		tip->ti_meta = ntohl(tip->ti_meta);
-		tip->ti_log = ntohl(tip->ti_log);
+	    if (__pmFeof(f)) {
+		__pmClearerr(f);
+		sts = 0;
+		break;
 	    }
+	    if (pmDebugOptions.log)
+		fprintf(stderr, "__pmLogLoadIndex: bad TI entry len=%d: expected %d\n",
+			(int)(n % sizeof(__pmLogTI)), (int)sizeof(__pmLogTI));
+	    if (__pmFerror(f)) {
+		__pmClearerr(f);
+		sts = -oserror();
+	    }
+	    else
+		sts = PM_ERR_LOGREC;
+	    break;
+	}
 
-	    lcp->l_numti++;
-	}/*for*/
+	/*
+	 * swab the temporal index records, and note if they are ordered
+	 * so __pmLogSetTime() can use a binary search
+	 */
+	for (i = 0, tip = lcp->l_ti, prev = NULL; i < lcp->l_numti; i++, tip++) {
+	    tip->ti_stamp.tv_sec = ntohl(tip->ti_stamp.tv_sec);
+	    tip->ti_stamp.tv_usec = ntohl(tip->ti_stamp.tv_usec);
+	    tip->ti_vol = ntohl(tip->ti_vol);
+	    tip->ti_meta = ntohl(tip->ti_meta);
+	    tip->ti_log = ntohl(tip->ti_log);
+	    if (prev != NULL && tiorder) {
+		if (tip->ti_stamp.tv_sec < prev->ti_stamp.tv_sec ||
+		    (tip->ti_stamp.tv_sec == prev->ti_stamp.tv_sec &&
+		     tip->ti_stamp.tv_usec < prev->ti_stamp.tv_usec) ||
+		    tip->ti_vol < prev->ti_vol ||
+		    (tip->ti_vol == prev->ti_vol && tip->ti_log < prev->ti_log))
+		    tiorder = 0;
+	    }
+	    prev = tip;
+	}
+	if (pmDebugOptions.log && !tiorder)
+	    fprintf(stderr, "__pmLogLoadIndex: %d TI entries, not in order\n",
+			lcp->l_numti);
     }/*not null*/
 
+    if ((lpp = __pmLogGetPriv(lcp, 0)) != NULL)
+	lpp->lp_tiorder = tiorder;
+
     return sts;
 }
 
@@ -501,10 +547,11 @@ __pmLogCreate(const char *host, const char *base, int log_version,
     char	fname[MAXPATHLEN];
 
     lcp->l_minvol = lcp->l_maxvol = acp->ac_curvol = 0;
-    lcp->l_hashpmid.nodes = lcp->l_hashpmid.hsize = 0;
-    lcp->l_hashindom.nodes = lcp->l_hashindom.hsize = 0;
-    lcp->l_hashlabels.nodes = lcp->l_hashlabels.hsize = 0;
-    lcp->l_hashtext.nodes = lcp->l_hashtext.hsize = 0;
+    __pmHashInit(&lcp->l_hashpmid);
+    __pmHashInit(&lcp->l_hashindom);
+    __pmHashInit(&lcp->l_hashrange);
+    __pmHashInit(&lcp->l_hashlabels);
+    __pmHashInit(&lcp->l_hashtext);
     lcp->l_tifp = lcp->l_mdfp = acp->ac_mfp = NULL;
 
     if ((lcp->l_tifp = __pmLogNewFile(base, PM_LOG_VOL_TI)) != NULL) {
@@ -718,6 +765,75 @@ logFreeMeta(__pmLogCtl *lcp)
 
     if (lcp->l_hashtext.hsize != 0)
 	logFreeHashText(&lcp->l_hashtext);
+
+    __pmLogFreePriv(lcp);
+}
+
+static unsigned int
+logpriv_key(const __pmLogCtl *lcp)
+{
+    return (unsigned int)((__psint_t)lcp >> 4);
+}
+
+/*
+ * Return the libpcp private reading state for lcp.  If there is none,
+ * allocate it if create is set, else return NULL.
+ */
+__pmLogPriv *
+__pmLogGetPriv(__pmLogCtl *lcp, int create)
+{
+    __pmHashNode	*hp;
+    __pmLogPriv		*lpp = NULL;
+    unsigned int	key = logpriv_key(lcp);
+
+    PM_LOCK(logutil_lock);
+    for (hp = __pmHashSearch(key, &lp_hc); hp != NULL; hp = hp->next) {
+	if (((__pmLogPriv *)hp->data)->lp_lcp == lcp) {
+	    lpp = (__pmLogPriv *)hp->data;
+	    break;
+	}
+    }
+    if (lpp == NULL && create) {
+	if ((lpp = (__pmLogPriv *)calloc(1, sizeof(*lpp))) != NULL) {
+	    lpp->lp_lcp = lcp;
+	    if (__pmHashAdd(key, (void *)lpp, &lp_hc) < 0) {
+		free(lpp);
+		lpp = NULL;
+	    }
+	}
+    }
+    PM_UNLOCK(logutil_lock);
+    return lpp;
+}
+
+/*
+ * Release the private reading state for lcp, before lcp is freed or
+ * its metadata is discarded.
+ */
+void
+__pmLogFreePriv(__pmLogCtl *lcp)
+{
+    __pmHashNode	*hp;
+    __pmLogPriv		*lpp = NULL;
+    unsigned int	key = logpriv_key(lcp);
+
+    PM_LOCK(logutil_lock);
+    for (hp = __pmHashSearch(key, &lp_hc); hp != NULL; hp = hp->next) {
+	if (((__pmLogPriv *)hp->data)->lp_lcp == lcp) {
+	    lpp = (__pmLogPriv *)hp->data;
+	    __pmHashDel(key, (void *)lpp, &lp_hc);
+	    break;
+	}
+    }
+    PM_UNLOCK(logutil_lock);
+    if (lpp == NULL)
+	return;
+
+    if (lpp->lp_lazy != NULL)
+	__pmLogFreeLazyMeta(lpp);
+    if (lpp->lp_hashindomtime.hsize != 0)
+	__pmLogFreeInDomTime(lpp);
+    free(lpp);
 }
 
 /*
@@ -994,6 +1110,12 @@ __pmLogOpen(const char *name, __pmContext *ctxp)
     if ((sts = checkLabelConsistency(ctxp, &lcp->l_label)) < 0)
 	goto cleanup;
 
+    /* private reading state, see __pmLogGetPriv() */
+    if (__pmLogGetPriv(lcp, 1) == NULL) {
+	sts = -oserror();
+	goto cleanup;
+    }
+
     if ((sts = __pmLogLoadMeta(acp)) < 0)
 	goto cleanup;
 
@@ -2230,6 +2352,132 @@ VolSkip(__pmArchCtl *acp, int mode,  int j)
     return PM_ERR_EOL;
 }
 
+/*
+ * Physical size of the last volume, for the truncated volume checks
+ * against the temporal index.
+ */
+static off_t
+LastVolSize(__pmArchCtl *acp)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    __pmFILE	*f;
+    struct stat	sbuf;
+    int		vol = lcp->l_maxvol;
+
+    sbuf.st_size = 0;
+    if (vol >= 0 && vol < lcp->l_numseen && lcp->l_seen[vol])
+	__pmFstat(acp->ac_mfp, &sbuf);
+    else if ((f = _logpeek(acp, lcp->l_maxvol)) != NULL) {
+	__pmFstat(f, &sbuf);
+	__pmFclose(f);
+    }
+    return sbuf.st_size;
+}
+
+/*
+ * Find the first temporal index entry at or after origin, skipping
+ * missing preliminary volumes.  An entry beyond the physical end of
+ * the last volume (truncated or incomplete archive) stops the search
+ * with *toobig set.  Returns l_numti if there is no such entry.
+ */
+static int
+IndexScan(__pmArchCtl *acp, const pmTimeval *origin, int *toobig, int *match)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    __pmLogTI	*tip = lcp->l_ti;
+    off_t	size = -1;
+    double	t_hi;
+    int		i;
+
+    for (i = 0; i < lcp->l_numti; i++, tip++) {
+	if (tip->ti_vol < lcp->l_minvol)
+	    /* skip missing preliminary volumes */
+	    continue;
+	if (tip->ti_vol == lcp->l_maxvol) {
+	    /* truncated check for last volume */
+	    if (size < 0)
+		size = LastVolSize(acp);
+	    if (tip->ti_log > size) {
+		*toobig = 1;
+		return i;
+	    }
+	}
+	t_hi = __pmTimevalSub(&tip->ti_stamp, origin);
+	if (t_hi >= 0) {
+	    if (t_hi == 0)
+		*match = 1;
+	    return i;
+	}
+    }
+    return lcp->l_numti;
+}
+
+/*
+ * As for IndexScan(), but for an index in time, volume and offset
+ * order (the usual case), so binary searches can be used.
+ */
+static int
+IndexSearch(__pmArchCtl *acp, const pmTimeval *origin, int *toobig, int *match)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    __pmLogTI	*ti = lcp->l_ti;
+    int		numti = lcp->l_numti;
+    int		lo, hi, mid;
+    int		first;		/* first entry not in a missing volume */
+    int		j;		/* first entry at or after origin */
+    int		last;
+    off_t	size;
+
+    for (lo = 0, hi = numti; lo < hi; ) {
+	mid = lo + (hi - lo) / 2;
+	if (ti[mid].ti_vol < lcp->l_minvol)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    first = lo;
+
+    for (hi = numti; lo < hi; ) {
+	mid = lo + (hi - lo) / 2;
+	if (__pmTimevalSub(&ti[mid].ti_stamp, origin) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    j = lo;
+
+    /*
+     * truncated check for last volume, only needed if the entries up
+     * to and including [j] reach into the last volume
+     */
+    last = j < numti ? j : numti - 1;
+    if (last >= first && ti[last].ti_vol == lcp->l_maxvol) {
+	size = LastVolSize(acp);
+	for (lo = first, hi = last; lo < hi; ) {
+	    mid = lo + (hi - lo) / 2;
+	    if (ti[mid].ti_vol < lcp->l_maxvol)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	for (hi = last + 1; lo < hi; ) {
+	    mid = lo + (hi - lo) / 2;
+	    if (ti[mid].ti_log <= size)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	if (lo <= last) {
+	    *toobig = 1;
+	    return lo;
+	}
+    }
+
+    if (j < numti && __pmTimevalSub(&ti[j].ti_stamp, origin) == 0)
+	*match = 1;
+    return j;
+}
+
 void
 __pmLogSetTime(__pmContext *ctxp)
 {
@@ -2286,53 +2534,17 @@ __pmLogSetTime(__pmContext *ctxp)
 
     if (lcp->l_numti) {
 	/* we have a temporal index, use it! */
-	int		j = -1;
+	__pmLogPriv	*lpp = __pmLogGetPriv(lcp, 0);
+	int		j;
 	int		toobig = 0;
 	int		match = 0;
-	int		vol;
 	int		numti = lcp->l_numti;
-	__pmFILE	*f;
-	__pmLogTI	*tip = lcp->l_ti;
 	double		t_lo;
-	struct stat	sbuf;
-
-	sbuf.st_size = -1;
 
-	for (i = 0; i < numti; i++, tip++) {
-	    if (tip->ti_vol < lcp->l_minvol)
-		/* skip missing preliminary volumes */
-		continue;
-	    if (tip->ti_vol == lcp->l_maxvol) {
-		/* truncated check for last volume */
-		if (sbuf.st_size < 0) {
-		    sbuf.st_size = 0;
-		    vol = lcp->l_maxvol;
-		    if (vol >= 0 && vol < lcp->l_numseen && lcp->l_seen[vol])
-			__pmFstat(acp->ac_mfp, &sbuf);
-		    else if ((f = _logpeek(acp, lcp->l_maxvol)) != NULL) {
-			__pmFstat(f, &sbuf);
-			__pmFclose(f);
-		    }
-		}
-		if (tip->ti_log > sbuf.st_size) {
-		    j = i;
-		    toobig++;
-		    break;
-		}
-	    }
-	    t_hi = __pmTimevalSub(&tip->ti_stamp, &ctxp->c_origin);
-	    if (t_hi > 0) {
-		j = i;
-		break;
-	    }
-	    else if (t_hi == 0) {
-		j = i;
-		match = 1;
-		break;
-	    }
-	}
-	if (i == numti)
-	    j = numti;
+	if (lpp != NULL && lpp->lp_tiorder)
+	    j = IndexSearch(acp, &ctxp->c_origin, &toobig, &match);
+	else
+	    j = IndexScan(acp, &ctxp->c_origin, &toobig, &match);
 
 	acp->ac_serial = 1;
 
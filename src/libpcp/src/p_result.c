@@ -30,6 +30,12 @@
  * pointers back into the input PDU buffer, this will be pinned _twice_
  * so the pmFreeResult() and __pmUnpinPDUBuf() calls will still be
  * required.
+ *
+ * __pmDecodeResultPinned() is the same, except that on 64-bit pointer
+ * platforms the pmValueBlocks are not copied - the result points at
+ * them in the input PDU buffer, and holds an extra pin on that buffer.
+ * Such a result must be released with __pmFreeResultPinned(), and the
+ * caller still unpins the input PDU buffer as usual.
  */
 
 #include <ctype.h>
@@ -182,13 +188,12 @@ __pmSendResult(int fd, int from, const pmResult *result)
 }
 
 /*
- * Internal variant of __pmDecodeResult() with current context.
- *
  * Enter here with pdubuf already pinned ... result may point into
- * _another_ pdu buffer that is pinned on exit
+ * _another_ pdu buffer that is pinned on exit.  Unless copy is set,
+ * pmValueBlocks are left in pdubuf, which is then pinned again.
  */
-int
-__pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, pmResult **result)
+static int
+DecodeResult(__pmContext *ctxp, __pmPDU *pdubuf, pmResult **result, int copy)
 {
     int		numpmid;	/* number of metrics */
     int		i;		/* range of metrics */
@@ -355,7 +360,7 @@ __pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, pmResult **result)
 	}
     }
 
-    need = nvsize + vbsize;
+    need = copy ? nvsize + vbsize : nvsize;
     offset = sizeof(result_t) - sizeof(__pmPDU) + vsize;
 
     if (pmDebugOptions.pdu && pmDebugOptions.desperate) {
@@ -407,7 +412,7 @@ __pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, pmResult **result)
      *         bytes                  bytes
      */
 
-    if (vbsize) {
+    if (vbsize && copy) {
 	/* pmValueBlocks (if any) are copied across "as is" */
 	index = vsize / sizeof(__pmPDU);
 	memcpy((void *)&newbuf[nvsize], (void *)&pp->data[index], vbsize);
@@ -460,8 +465,12 @@ __pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, pmResult **result)
 		     * in the input PDU buffer, lval is an index to the
 		     * start of the pmValueBlock, in units of __pmPDU
 		     */
-		    index = sizeof(__pmPDU) * ntohl(vp->value.lval) + offset;
-		    nvp->value.pval = (pmValueBlock *)&newbuf[index];
+		    if (copy) {
+			index = sizeof(__pmPDU) * ntohl(vp->value.lval) + offset;
+			nvp->value.pval = (pmValueBlock *)&newbuf[index];
+		    }
+		    else
+			nvp->value.pval = (pmValueBlock *)&pdubuf[ntohl(vp->value.lval)];
 		    if (pmDebugOptions.pdu && pmDebugOptions.desperate) {
 			int		k, len;
 			len = nvp->value.pval->vlen - PM_VAL_HDR_SIZE;
@@ -485,6 +494,9 @@ __pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, pmResult **result)
     }
     if (numpmid == 0)
 	__pmUnpinPDUBuf(newbuf);
+    else if (vbsize && !copy)
+	/* result points into pdubuf, see __pmFreeResultPinned() */
+	__pmPinPDUBuf(pdubuf);
 
 #elif defined(HAVE_32BIT_PTR)
 
@@ -620,6 +632,15 @@ corrupt:
     return PM_ERR_IPC;
 }
 
+/*
+ * Internal variant of __pmDecodeResult() with current context.
+ */
+int
+__pmDecodeResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, pmResult **result)
+{
+    return DecodeResult(ctxp, pdubuf, result, 1);
+}
+
 int
 __pmDecodeResult(__pmPDU *pdubuf, pmResult **result)
 {
@@ -627,3 +648,31 @@ __pmDecodeResult(__pmPDU *pdubuf, pmResult **result)
     sts = __pmDecodeResult_ctx(NULL, pdubuf, result);
     return sts;
 }
+
+int
+__pmDecodeResultPinned(__pmPDU *pdubuf, pmResult **result)
+{
+    return DecodeResult(NULL, pdubuf, result, 0);
+}
+
+/*
+ * Release a pmResult from __pmDecodeResultPinned(), including its pin
+ * on the input PDU buffer (found via any pmValueBlock pointer).
+ */
+void
+__pmFreeResultPinned(pmResult *result)
+{
+#if defined(HAVE_64BIT_PTR)
+    pmValueSet	*vsp;
+    int		i;
+
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	if (vsp->numval > 0 && vsp->valfmt != PM_VAL_INSITU) {
+	    __pmUnpinPDUBuf(vsp->vlist[0].value.pval);
+	    break;
+	}
+    }
+#endif
+    pmFreeResult(result);
+}
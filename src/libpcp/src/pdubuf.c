@@ -1,41 +1,98 @@
 /*
  * Copyright (c) 1995 Silicon Graphics, Inc.  All Rights Reserved.
- * Copyright (c) 2015 Red Hat, Inc.
- * 
+ * Copyright (c) 2015,2020 Red Hat, Inc.
+ *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
  * by the Free Software Foundation; either version 2.1 of the License, or
  * (at your option) any later version.
- * 
+ *
  * This library is distributed in the hope that it will be useful, but
  * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
  * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
  * License for more details.
  *
+ * PDU buffers come from power-of-two size classes (128 bytes up to
+ * CHUNK_SIZE), carved from CHUNK_SIZE-aligned chunks and recycled via
+ * a free list per size class.  Requests larger than CHUNK_SIZE get a
+ * dedicated aligned allocation; a few of these are kept for reuse when
+ * the last pin is released, the rest are returned to the heap.  Chunk
+ * memory for the size classes is retained once allocated, so the
+ * footprint tracks the high-water mark of concurrently pinned buffers.
+ *
+ * Because chunks are aligned, any address maps to its chunk number
+ * with a shift, and a small open-addressing table from chunk number
+ * to chunk descriptor finds the buffer header (pin count and size)
+ * for any address inside a buffer in O(1), and rejects addresses that
+ * are not ours.
+ *
  * Thread-safe notes
  *
  * To avoid buffer trampling, on success __pmFindPDUBuf() now returns
  * a pinned PDU buffer.  It is the caller's responsibility to unpin the
  * PDU buffer when safe to do so.
+ *
+ * The chunk table, free lists and pin counts are guarded by pdubuf_lock.
+ * When __thread is available, each thread also keeps a short cache of
+ * free buffers for the smaller size classes; a buffer in a thread cache
+ * is visible to no other thread, so __pmFindPDUBuf() can claim it without
+ * taking pdubuf_lock.  The cache is returned to the shared free lists
+ * when the thread exits.
  */
 
 #include "pmapi.h"
 #include "libpcp.h"
 #include "compiler.h"
 #include <assert.h>
-#include <search.h>
 #include <stdint.h>
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
 
-typedef struct bufctl
-{
-    int		bc_pincnt;
-    int		bc_size;
-    char	*bc_buf;
-    /* The actual buffer happens to follow this struct. */
+#define CHUNK_SHIFT	16
+#define CHUNK_SIZE	(1 << CHUNK_SHIFT)
+#define CLASS_SHIFT	7		/* smallest size class is 128 bytes */
+#define NCLASS		(CHUNK_SHIFT - CLASS_SHIFT + 1)
+#define LARGE_KEEP	4		/* free large buffers kept for reuse */
+
+typedef struct bufctl {
+    int		bc_pincnt;	/* 0 => buffer is free */
+    int		bc_size;	/* size requested from __pmFindPDUBuf */
 } bufctl_t;
 
+typedef struct chunk {
+    char	*base;		/* CHUNK_SIZE aligned */
+    size_t	size;		/* bytes from base */
+    void	*raw;		/* what to pass to free() */
+    int		class;		/* size class, -1 for a single large buffer */
+    int		shift;		/* log2 of buffer size for size classes */
+    int		nbuf;
+    struct chunk	*next;		/* large buffer free list */
+    bufctl_t	bc[1];		/* nbuf buffer headers */
+} chunk_t;
+
+/*
+ * A free buffer holds its own free list link, and a pointer back to
+ * its header so that it can be handed out without a chunk lookup.
+ */
+typedef struct freebuf {
+    struct freebuf	*next;
+    bufctl_t		*bcp;
+} freebuf_t;
+
+/* chunk number to chunk descriptor, linear probing */
+typedef struct {
+    uintptr_t	key;
+    chunk_t	*chunk;		/* NULL => empty slot */
+} regent_t;
+
 /* Protected by the pdubuf_lock mutex. */
-static void *buf_tree;
+static regent_t		*reg;
+static unsigned int	reg_size;
+static unsigned int	reg_count;
+static freebuf_t	*freelist[NCLASS];
+static chunk_t		*large_free;
+static int		nlarge_free;
 
 #ifdef PM_MULTI_THREAD
 static pthread_mutex_t	pdubuf_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -54,56 +111,349 @@ __pmIsPdubufLock(void *lock)
 }
 #endif
 
+#if defined(PM_MULTI_THREAD) && defined(HAVE___THREAD)
+#define TCACHE_NCLASS	6		/* size classes up to 4Kbytes */
+#define TCACHE_MAX	8		/* buffers per size class */
+
+typedef struct {
+    freebuf_t	*head[TCACHE_NCLASS];
+    int		count[TCACHE_NCLASS];
+    int		state;		/* 0 new, 1 exit handler armed, -1 disabled */
+} tcache_t;
+
+static __thread tcache_t	tcache;
+static pthread_key_t		tcache_key;
+static pthread_once_t		tcache_once = PTHREAD_ONCE_INIT;
+static int			tcache_key_ok;
+#endif
+
+static unsigned int
+reg_hash(uintptr_t key)
+{
+    return (unsigned int)key * 2654435761U;
+}
+
+static chunk_t *
+reg_find(uintptr_t key)
+{
+    unsigned int	mask = reg_size - 1;
+    unsigned int	i;
+
+    if (reg_size == 0)
+	return NULL;
+    for (i = reg_hash(key) & mask; reg[i].chunk != NULL; i = (i + 1) & mask) {
+	if (reg[i].key == key)
+	    return reg[i].chunk;
+    }
+    return NULL;
+}
+
+static int
+reg_insert(uintptr_t key, chunk_t *cp)
+{
+    unsigned int	mask;
+    unsigned int	i, j;
+    regent_t		*tmp;
+
+    if (2 * (reg_count + 1) > reg_size) {
+	/* keep the load factor at or below 1/2 */
+	unsigned int	size = reg_size == 0 ? 64 : 2 * reg_size;
+
+	if ((tmp = (regent_t *)calloc(size, sizeof(regent_t))) == NULL)
+	    return -oserror();
+	mask = size - 1;
+	for (j = 0; j < reg_size; j++) {
+	    if (reg[j].chunk == NULL)
+		continue;
+	    for (i = reg_hash(reg[j].key) & mask; tmp[i].chunk != NULL; i = (i + 1) & mask)
+		;
+	    tmp[i] = reg[j];
+	}
+	if (reg != NULL)
+	    free(reg);
+	reg = tmp;
+	reg_size = size;
+    }
+    mask = reg_size - 1;
+    for (i = reg_hash(key) & mask; reg[i].chunk != NULL; i = (i + 1) & mask)
+	;
+    reg[i].key = key;
+    reg[i].chunk = cp;
+    reg_count++;
+    return 0;
+}
+
 static void
-pdubufdump1(const void *nodep, const VISIT which, const int depth)
+reg_delete(uintptr_t key)
+{
+    unsigned int	mask = reg_size - 1;
+    unsigned int	i, j, k;
+
+    for (i = reg_hash(key) & mask; reg[i].chunk != NULL; i = (i + 1) & mask) {
+	if (reg[i].key == key)
+	    break;
+    }
+    if (reg[i].chunk == NULL)
+	return;
+    reg[i].chunk = NULL;
+    reg_count--;
+
+    /* close the gap, so later entries in this probe sequence stay reachable */
+    for (j = (i + 1) & mask; reg[j].chunk != NULL; j = (j + 1) & mask) {
+	k = reg_hash(reg[j].key) & mask;
+	if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+	    continue;
+	reg[i] = reg[j];
+	reg[j].chunk = NULL;
+	i = j;
+    }
+}
+
+/*
+ * Allocate a chunk descriptor, and size bytes of CHUNK_SIZE-aligned memory.
+ */
+static chunk_t *
+chunk_alloc(int class, size_t size)
+{
+    chunk_t	*cp;
+    int		nbuf = class < 0 ? 1 : CHUNK_SIZE >> (class + CLASS_SHIFT);
+
+    if ((cp = (chunk_t *)calloc(1, sizeof(*cp) + (nbuf - 1) * sizeof(bufctl_t))) == NULL)
+	return NULL;
+#ifdef HAVE_POSIX_MEMALIGN
+    if (posix_memalign(&cp->raw, CHUNK_SIZE, size) != 0)
+	cp->raw = NULL;
+    cp->base = (char *)cp->raw;
+#else
+#ifdef HAVE_MEMALIGN
+    cp->raw = memalign(CHUNK_SIZE, size);
+    cp->base = (char *)cp->raw;
+#else
+    /* no aligned allocator, so over-allocate and align by hand */
+    if ((cp->raw = malloc(size + CHUNK_SIZE - 1)) != NULL)
+	cp->base = (char *)(((uintptr_t)cp->raw + CHUNK_SIZE - 1) &
+			    ~(uintptr_t)(CHUNK_SIZE - 1));
+#endif
+#endif
+    if (cp->raw == NULL) {
+	free(cp);
+	return NULL;
+    }
+    cp->size = size;
+    cp->class = class;
+    cp->shift = class < 0 ? 0 : class + CLASS_SHIFT;
+    cp->nbuf = nbuf;
+    return cp;
+}
+
+static void
+chunk_free(chunk_t *cp)
+{
+    free(cp->raw);
+    free(cp);
+}
+
+/*
+ * Enter every CHUNK_SIZE unit covered by the chunk into the table.
+ * Caller holds pdubuf_lock.
+ */
+static int
+chunk_register(chunk_t *cp)
+{
+    uintptr_t	key = (uintptr_t)cp->base >> CHUNK_SHIFT;
+    size_t	n;
+    int		sts;
+
+    for (n = 0; n < cp->size >> CHUNK_SHIFT; n++) {
+	if ((sts = reg_insert(key + n, cp)) < 0) {
+	    while (n-- > 0)
+		reg_delete(key + n);
+	    return sts;
+	}
+    }
+    return 0;
+}
+
+/* Caller holds pdubuf_lock. */
+static void
+chunk_unregister(chunk_t *cp)
+{
+    uintptr_t	key = (uintptr_t)cp->base >> CHUNK_SHIFT;
+    size_t	n;
+
+    for (n = 0; n < cp->size >> CHUNK_SHIFT; n++)
+	reg_delete(key + n);
+}
+
+/*
+ * Map an address to the header of the pinned buffer containing it,
+ * or NULL if the address is not inside a pinned PDU buffer.
+ * Caller holds pdubuf_lock.
+ */
+static bufctl_t *
+bufctl_find(const void *handle, chunk_t **cpp)
+{
+    const char	*p = (const char *)handle;
+    chunk_t	*cp;
+    bufctl_t	*bcp;
+    size_t	i;
+
+    if ((cp = reg_find((uintptr_t)p >> CHUNK_SHIFT)) == NULL)
+	return NULL;
+    i = cp->class < 0 ? 0 : (size_t)(p - cp->base) >> cp->shift;
+    bcp = &cp->bc[i];
+    if (bcp->bc_pincnt == 0 ||
+	p >= cp->base + (i << cp->shift) + bcp->bc_size)
+	return NULL;
+    *cpp = cp;
+    return bcp;
+}
+
+static char *
+bufctl_buf(const chunk_t *cp, const bufctl_t *bcp)
+{
+    return cp->base + ((size_t)(bcp - cp->bc) << cp->shift);
+}
+
+static int
+size_class(int need)
 {
-    const bufctl_t	*pcp = *(bufctl_t **)nodep;
+    int		class = 0;
 
-    if (which == postorder || which == leaf)	/* called once per node */
-	fprintf(stderr, " " PRINTF_P_PFX "%p...%p[%d](%d)",
-		pcp->bc_buf, &pcp->bc_buf[pcp->bc_size - 1], pcp->bc_size,
-		pcp->bc_pincnt);
+    while (need > (1 << (class + CLASS_SHIFT))) {
+	if (++class == NCLASS)
+	    return -1;
+    }
+    return class;
 }
 
 static void
 pdubufdump(void)
 {
+    chunk_t	*cp;
+    bufctl_t	*bcp;
+    char	*buf;
+    unsigned int	i;
+    int		j, first = 1;
+
     /*
-     * There is no longer a pdubuf free list, ergo no
-     * fprintf(stderr, "   free pdubuf[size]:\n");
+     * Free buffers are recycled through the size class free lists,
+     * only pinned buffers are reported.
      */
     PM_LOCK(pdubuf_lock);
-    if (buf_tree != NULL) {
-	fprintf(stderr, "   pinned pdubuf[size](pincnt):");
-	/* THREADSAFE - no locks acquired in pdubufdump1() */
-	twalk(buf_tree, &pdubufdump1);
+    for (i = 0; i < reg_size; i++) {
+	if ((cp = reg[i].chunk) == NULL ||
+	    reg[i].key != (uintptr_t)cp->base >> CHUNK_SHIFT)
+	    continue;
+	for (j = 0; j < cp->nbuf; j++) {
+	    bcp = &cp->bc[j];
+	    if (bcp->bc_pincnt == 0)
+		continue;
+	    if (first) {
+		fprintf(stderr, "   pinned pdubuf[size](pincnt):");
+		first = 0;
+	    }
+	    buf = bufctl_buf(cp, bcp);
+	    fprintf(stderr, " " PRINTF_P_PFX "%p...%p[%d](%d)",
+		    buf, &buf[bcp->bc_size - 1], bcp->bc_size, bcp->bc_pincnt);
+	}
+    }
+    if (!first)
 	fprintf(stderr, "\n");
+    PM_UNLOCK(pdubuf_lock);
+}
+
+#if defined(PM_MULTI_THREAD) && defined(HAVE___THREAD)
+/*
+ * Thread exit handler, return this thread's cached buffers to the
+ * shared free lists.
+ */
+static void
+tcache_flush(void *arg)
+{
+    tcache_t	*tcp = (tcache_t *)arg;
+    freebuf_t	*fbp;
+    int		class;
+
+    PM_LOCK(pdubuf_lock);
+    for (class = 0; class < TCACHE_NCLASS; class++) {
+	while ((fbp = tcp->head[class]) != NULL) {
+	    tcp->head[class] = fbp->next;
+	    fbp->next = freelist[class];
+	    freelist[class] = fbp;
+	}
+	tcp->count[class] = 0;
     }
+    tcp->state = -1;
     PM_UNLOCK(pdubuf_lock);
 }
 
+static void
+tcache_init(void)
+{
+    tcache_key_ok = (pthread_key_create(&tcache_key, tcache_flush) == 0);
+}
+
 /*
- * A tsearch(3) comparison function for the buffer-segments used here.
+ * Return true if this thread's cache may be used, arming the thread
+ * exit handler on first use.
  */
 static int
-bufctl_t_compare(const void *a, const void *b)
+tcache_ready(void)
 {
-    const bufctl_t *aa = (const bufctl_t *)a;
-    const bufctl_t *bb = (const bufctl_t *)b;
-
-    /* NB: valid range is bc_buf[0 .. bc_size-1] */
-    if ((uintptr_t)&aa->bc_buf[aa->bc_size-1] < (uintptr_t)&bb->bc_buf[0])
-	return -1;
-    if ((uintptr_t)&bb->bc_buf[bb->bc_size-1] < (uintptr_t)&aa->bc_buf[0])
-	return 1;
-    return 0;		/* overlap */
+    if (likely(tcache.state != 0))
+	return tcache.state > 0;
+    pthread_once(&tcache_once, tcache_init);
+    if (tcache_key_ok && pthread_setspecific(tcache_key, &tcache) == 0)
+	tcache.state = 1;
+    else
+	tcache.state = -1;
+    return tcache.state > 0;
+}
+#endif
+
+static __pmPDU *
+large_alloc(int need)
+{
+    chunk_t	*cp, **cpp;
+    size_t	size = ((size_t)need + CHUNK_SIZE - 1) & ~(size_t)(CHUNK_SIZE - 1);
+
+    PM_LOCK(pdubuf_lock);
+    for (cpp = &large_free; (cp = *cpp) != NULL; cpp = &cp->next) {
+	/* reuse a kept buffer, if it is not too much bigger than needed */
+	if (cp->size >= size && cp->size <= 2 * size) {
+	    *cpp = cp->next;
+	    nlarge_free--;
+	    cp->bc[0].bc_pincnt = 1;
+	    cp->bc[0].bc_size = need;
+	    PM_UNLOCK(pdubuf_lock);
+	    return (__pmPDU *)cp->base;
+	}
+    }
+    PM_UNLOCK(pdubuf_lock);
+
+    if ((cp = chunk_alloc(-1, size)) == NULL)
+	return NULL;
+    cp->bc[0].bc_pincnt = 1;
+    cp->bc[0].bc_size = need;
+    PM_LOCK(pdubuf_lock);
+    if (unlikely(chunk_register(cp) < 0)) {
+	PM_UNLOCK(pdubuf_lock);
+	chunk_free(cp);
+	return NULL;
+    }
+    PM_UNLOCK(pdubuf_lock);
+    return (__pmPDU *)cp->base;
 }
 
 __pmPDU *
 __pmFindPDUBuf(int need)
 {
-    bufctl_t	*pcp;
-    void	*bcp;
+    freebuf_t	*fbp;
+    chunk_t	*cp;
+    __pmPDU	*buf;
+    int		class;
+    int		i;
 
     if (unlikely(need < 0)) {
 	/* special diagnostic case ... dump buffer state */
@@ -112,61 +462,74 @@ __pmFindPDUBuf(int need)
 	return NULL;
     }
 
-    if ((pcp = (bufctl_t *)malloc(sizeof(*pcp) + need)) == NULL) {
-	return NULL;
+    if ((class = size_class(need)) < 0) {
+	if ((buf = large_alloc(need)) == NULL)
+	    return NULL;
+	goto done;
     }
 
-    pcp->bc_pincnt = 1;
-    pcp->bc_size = need;
-    pcp->bc_buf = ((char *)pcp) + sizeof(*pcp);
+#if defined(PM_MULTI_THREAD) && defined(HAVE___THREAD)
+    if (class < TCACHE_NCLASS && (fbp = tcache.head[class]) != NULL) {
+	tcache.head[class] = fbp->next;
+	tcache.count[class]--;
+	fbp->bcp->bc_pincnt = 1;
+	fbp->bcp->bc_size = need;
+	buf = (__pmPDU *)fbp;
+	goto done;
+    }
+#endif
 
     PM_LOCK(pdubuf_lock);
-    /* Insert the node in the tree. */
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tsearch((void *)pcp, &buf_tree, &bufctl_t_compare);
-    if (unlikely(bcp == NULL)) {	/* ENOMEM */
-	PM_UNLOCK(pdubuf_lock);
-	free(pcp);
-	return NULL;
+    if (freelist[class] == NULL) {
+	if ((cp = chunk_alloc(class, CHUNK_SIZE)) == NULL) {
+	    PM_UNLOCK(pdubuf_lock);
+	    return NULL;
+	}
+	if (unlikely(chunk_register(cp) < 0)) {
+	    PM_UNLOCK(pdubuf_lock);
+	    chunk_free(cp);
+	    return NULL;
+	}
+	/* carve the chunk, lowest addresses at the head of the free list */
+	for (i = cp->nbuf - 1; i >= 0; i--) {
+	    fbp = (freebuf_t *)bufctl_buf(cp, &cp->bc[i]);
+	    fbp->bcp = &cp->bc[i];
+	    fbp->next = freelist[class];
+	    freelist[class] = fbp;
+	}
     }
+    fbp = freelist[class];
+    freelist[class] = fbp->next;
+    fbp->bcp->bc_pincnt = 1;
+    fbp->bcp->bc_size = need;
     PM_UNLOCK(pdubuf_lock);
+    buf = (__pmPDU *)fbp;
 
+done:
     if (unlikely(pmDebugOptions.pdubuf)) {
 	fprintf(stderr, "__pmFindPDUBuf(%d) -> " PRINTF_P_PFX "%p\n",
-		need, pcp->bc_buf);
+		need, buf);
 	pdubufdump();
     }
 
-    return (__pmPDU *)pcp->bc_buf;
+    return buf;
 }
 
 void
 __pmPinPDUBuf(void *handle)
 {
-    bufctl_t	*pcp, pcp_search;
-    void	*bcp;
+    bufctl_t	*bcp;
+    chunk_t	*cp;
 
     assert(((__psint_t)handle % sizeof(int)) == 0);
-    /*
-     * Initialize a dummy bufctl_t to use only as search key;
-     * only its bc_buf & bc_size fields need to be set, as that's
-     * all that bufctl_t_compare will look at.
-     */
-    pcp_search.bc_buf = handle;
-    pcp_search.bc_size = 1;
 
     PM_LOCK(pdubuf_lock);
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tfind(&pcp_search, &buf_tree, &bufctl_t_compare);
     /*
      * NB: don't release the lock until final disposition of this object;
      * we don't want to play TOCTOU.
      */
-    if (likely(bcp != NULL)) {
-	pcp = *(bufctl_t **)bcp;
-	assert((&pcp->bc_buf[0] <= (char *)handle) &&
-	       ((char *)handle < &pcp->bc_buf[pcp->bc_size]));
-	pcp->bc_pincnt++;
+    if (likely((bcp = bufctl_find(handle, &cp)) != NULL)) {
+	bcp->bc_pincnt++;
     } else {
 	PM_UNLOCK(pdubuf_lock);
 	pmNotifyErr(LOG_WARNING, "__pmPinPDUBuf: " PRINTF_P_PFX "%p not in pool!", handle);
@@ -178,7 +541,7 @@ __pmPinPDUBuf(void *handle)
     if (unlikely(pmDebugOptions.pdubuf))
 	fprintf(stderr, "__pmPinPDUBuf(" PRINTF_P_PFX "%p) -> pdubuf="
 			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
-		pcp->bc_buf, pcp->bc_pincnt);
+		bufctl_buf(cp, bcp), bcp->bc_pincnt);
 
     PM_UNLOCK(pdubuf_lock);
 }
@@ -186,29 +549,18 @@ __pmPinPDUBuf(void *handle)
 int
 __pmUnpinPDUBuf(void *handle)
 {
-    bufctl_t	*pcp, pcp_search;
-    void	*bcp;
+    bufctl_t	*bcp;
+    chunk_t	*cp;
+    freebuf_t	*fbp;
 
     assert(((__psint_t)handle % sizeof(int)) == 0);
     PM_LOCK(pdubuf_lock);
 
-    /*
-     * Initialize a dummy bufctl_t to use only as search key;
-     * only its bc_buf & bc_size fields need to be set, as that's
-     * all that bufctl_t_compare will look at.
-     */
-    pcp_search.bc_buf = handle;
-    pcp_search.bc_size = 1;
-
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tfind(&pcp_search, &buf_tree, &bufctl_t_compare);
     /*
      * NB: don't release the lock until final disposition of this object;
      * we don't want to play TOCTOU.
      */
-    if (likely(bcp != NULL)) {
-	pcp = *(bufctl_t **)bcp;
-    } else {
+    if (unlikely((bcp = bufctl_find(handle, &cp)) == NULL)) {
 	PM_UNLOCK(pdubuf_lock);
 	if (pmDebugOptions.pdubuf) {
 	    fprintf(stderr, "__pmUnpinPDUBuf(" PRINTF_P_PFX "%p) -> fails\n",
@@ -221,53 +573,72 @@ __pmUnpinPDUBuf(void *handle)
     if (unlikely(pmDebugOptions.pdubuf))
 	fprintf(stderr, "__pmUnpinPDUBuf(" PRINTF_P_PFX "%p) -> pdubuf="
 			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
-		pcp->bc_buf, pcp->bc_pincnt - 1);
-
-    assert((&pcp->bc_buf[0] <= (char*)handle) &&
-	   ((char*)handle < &pcp->bc_buf[pcp->bc_size]));
-
-    if (likely(--pcp->bc_pincnt == 0)) {
-	/* THREADSAFE - no locks acquired in bufctl_t_compare() */
-	tdelete(pcp, &buf_tree, &bufctl_t_compare);
-	PM_UNLOCK(pdubuf_lock);
-	free(pcp);
-    }
-    else {
-	PM_UNLOCK(pdubuf_lock);
+		bufctl_buf(cp, bcp), bcp->bc_pincnt - 1);
+
+    if (likely(--bcp->bc_pincnt == 0)) {
+	if (cp->class < 0) {
+	    if (nlarge_free < LARGE_KEEP) {
+		/* stays in the chunk table, unpinned */
+		cp->next = large_free;
+		large_free = cp;
+		nlarge_free++;
+		PM_UNLOCK(pdubuf_lock);
+		return 1;
+	    }
+	    chunk_unregister(cp);
+	    PM_UNLOCK(pdubuf_lock);
+	    chunk_free(cp);
+	    return 1;
+	}
+	fbp = (freebuf_t *)bufctl_buf(cp, bcp);
+	fbp->bcp = bcp;
+#if defined(PM_MULTI_THREAD) && defined(HAVE___THREAD)
+	if (cp->class < TCACHE_NCLASS &&
+	    tcache.count[cp->class] < TCACHE_MAX && tcache_ready()) {
+	    /* now unreachable from other threads, no lock needed */
+	    PM_UNLOCK(pdubuf_lock);
+	    fbp->next = tcache.head[cp->class];
+	    tcache.head[cp->class] = fbp;
+	    tcache.count[cp->class]++;
+	    return 1;
+	}
+#endif
+	fbp->next = freelist[cp->class];
+	freelist[cp->class] = fbp;
     }
+    PM_UNLOCK(pdubuf_lock);
 
     return 1;
 }
 
 /*
- * Used to pass context from __pmCountPDUBuf to the pdubufcount callback.
- * They are protected by the pdubuf_lock mutex.
+ * Report the number of pinned (alloc) and free buffers that could
+ * satisfy a request for need bytes.  A buffer claimed from a thread
+ * cache may be seen in either state, these are only statistics.
  */
-static int	pdu_bufcnt_need;
-static unsigned	pdu_bufcnt;
-
-static void
-pdubufcount(const void *nodep, const VISIT which, const int depth)
-{
-    const bufctl_t	*pcp = *(bufctl_t **)nodep;
-
-    if (which == postorder || which == leaf)	/* called once per node */
-	if (pcp->bc_size >= pdu_bufcnt_need)
-	    pdu_bufcnt++;
-}
-
 void
 __pmCountPDUBuf(int need, int *alloc, int *free)
 {
-    PM_LOCK(pdubuf_lock);
-
-    pdu_bufcnt_need = need;
-    pdu_bufcnt = 0;
-    /* THREADSAFE - no locks acquired in pdubufcount() */
-    twalk(buf_tree, &pdubufcount);
-    *alloc = pdu_bufcnt;
-
-    *free = 0;			/* We don't retain freed nodes. */
+    chunk_t	*cp;
+    unsigned int	i;
+    int		j;
+    int		nalloc = 0, nfree = 0;
 
+    PM_LOCK(pdubuf_lock);
+    for (i = 0; i < reg_size; i++) {
+	if ((cp = reg[i].chunk) == NULL ||
+	    reg[i].key != (uintptr_t)cp->base >> CHUNK_SHIFT)
+	    continue;
+	for (j = 0; j < cp->nbuf; j++) {
+	    if (cp->bc[j].bc_pincnt > 0) {
+		if (cp->bc[j].bc_size >= need)
+		    nalloc++;
+	    }
+	    else if ((cp->class < 0 ? cp->size : (size_t)1 << cp->shift) >= need)
+		nfree++;
+	}
+    }
+    *alloc = nalloc;
+    *free = nfree;
     PM_UNLOCK(pdubuf_lock);
 }
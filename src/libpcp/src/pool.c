@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Fixed-size object pools.
+ *
+ * Objects are carved from slabs of POOL_SLABSIZE bytes and recycled
+ * through a free list in each slab, so in steady state an allocation
+ * or release is a pointer pop or push rather than a trip through
+ * malloc/free.  When the last object in a slab is released the slab
+ * is returned to the heap, except that up to POOL_KEEP empty slabs
+ * are kept so a pool that is repeatedly filled and emptied (like the
+ * values of successive fetches) does not malloc and free its slabs
+ * every time.  __pmPoolClear() releases every object in one operation.
+ *
+ * Thread-safe notes
+ *
+ * Pools do no locking of their own, callers are expected to serialize
+ * access to each pool.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+#define POOL_SLABSIZE	(16 * 1024)
+#define POOL_KEEP	1		/* empty slabs kept for reuse */
+
+void
+__pmPoolInit(__pmPool *pp, const char *name, size_t size)
+{
+    memset(pp, 0, sizeof(*pp));
+    pp->name = name;
+    /* room for the free list link, and pointer alignment for each object */
+    if (size < sizeof(void *))
+	size = sizeof(void *);
+    pp->size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    pp->nper = POOL_SLABSIZE / pp->size;
+    if (pp->nper < 1)
+	pp->nper = 1;
+    pp->cur = -1;
+}
+
+/*
+ * Add a slab with all of its objects on its free list, keeping slab[]
+ * in address order for pool_find().  Returns the index of the new slab.
+ */
+static int
+pool_grow(__pmPool *pp)
+{
+    __pmPoolSlab	*sp;
+    char		*base;
+    char		*obj;
+    int			i;
+
+    if (pp->nslab == pp->maxslab) {
+	i = pp->maxslab == 0 ? 4 : pp->maxslab * 2;
+	if ((sp = (__pmPoolSlab *)realloc(pp->slab, i * sizeof(*sp))) == NULL)
+	    return -oserror();
+	pp->slab = sp;
+	pp->maxslab = i;
+    }
+    if ((base = (char *)malloc(pp->nper * pp->size)) == NULL)
+	return -oserror();
+    for (i = pp->nslab; i > 0 && pp->slab[i-1].base > base; i--)
+	pp->slab[i] = pp->slab[i-1];
+    sp = &pp->slab[i];
+    sp->base = base;
+    sp->free = NULL;
+    sp->inuse = 0;
+    for (obj = base + (pp->nper - 1) * pp->size; obj >= base; obj -= pp->size) {
+	*(void **)obj = sp->free;
+	sp->free = obj;
+    }
+    pp->nslab++;
+    pp->nempty++;
+
+    if (pmDebugOptions.alloc)
+	fprintf(stderr, "__pmPoolAlloc: %s pool: slab[%d] " PRINTF_P_PFX "%p "
+		"(%d x %d bytes), %d slabs, %lu allocs, %lu hits\n",
+		pp->name, i, base, pp->nper, (int)pp->size,
+		pp->nslab, pp->nalloc, pp->nhit);
+    return i;
+}
+
+/*
+ * Return the index of the slab holding obj, else -1.
+ */
+static int
+pool_find(const __pmPool *pp, const void *obj)
+{
+    const char	*p = (const char *)obj;
+    int		lo = 0, hi = pp->nslab - 1, mid;
+    size_t	span = pp->nper * pp->size;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if (p < pp->slab[mid].base)
+	    hi = mid - 1;
+	else if (p >= pp->slab[mid].base + span)
+	    lo = mid + 1;
+	else
+	    return mid;
+    }
+    return -1;
+}
+
+void *
+__pmPoolAlloc(__pmPool *pp)
+{
+    __pmPoolSlab	*sp;
+    void		*obj;
+    int			i;
+
+    pp->nalloc++;
+    if (pp->cur < 0 || pp->slab[pp->cur].free == NULL) {
+	/* current slab is full, prefer any other slab with room */
+	for (i = 0; i < pp->nslab; i++) {
+	    if (pp->slab[i].free != NULL)
+		break;
+	}
+	if (i == pp->nslab && (i = pool_grow(pp)) < 0) {
+	    pp->nalloc--;
+	    return NULL;
+	}
+	pp->cur = i;
+    }
+    else
+	pp->nhit++;
+    sp = &pp->slab[pp->cur];
+    obj = sp->free;
+    sp->free = *(void **)obj;
+    if (sp->inuse++ == 0)
+	pp->nempty--;
+    return obj;
+}
+
+/*
+ * Release obj back to the pool, returning 1, or return 0 (and do
+ * nothing) if obj was not allocated from this pool.
+ */
+int
+__pmPoolFree(__pmPool *pp, void *obj)
+{
+    __pmPoolSlab	*sp;
+    int			i;
+
+    if ((i = pool_find(pp, obj)) < 0)
+	return 0;
+    sp = &pp->slab[i];
+    *(void **)obj = sp->free;
+    sp->free = obj;
+    if (--sp->inuse > 0)
+	return 1;
+    if (pp->nempty < POOL_KEEP) {
+	pp->nempty++;
+	return 1;
+    }
+
+    /* release the empty slab */
+    if (pmDebugOptions.alloc)
+	fprintf(stderr, "__pmPoolFree: %s pool: release slab[%d] " PRINTF_P_PFX "%p, "
+		"%d slabs left\n", pp->name, i, sp->base, pp->nslab - 1);
+    free(sp->base);
+    pp->nslab--;
+    memmove(sp, sp + 1, (pp->nslab - i) * sizeof(*sp));
+    if (pp->cur == i)
+	pp->cur = -1;
+    else if (pp->cur > i)
+	pp->cur--;
+    return 1;
+}
+
+/*
+ * Return 1 if obj was allocated from this pool, else 0.
+ */
+int
+__pmPoolOwns(const __pmPool *pp, const void *obj)
+{
+    return pool_find(pp, obj) >= 0;
+}
+
+/*
+ * Release all objects, and the slabs holding them.
+ */
+void
+__pmPoolClear(__pmPool *pp)
+{
+    int		i;
+
+    if (pmDebugOptions.alloc && pp->nalloc > 0)
+	fprintf(stderr, "__pmPoolClear: %s pool: %d slabs, %lu allocs, %lu hits\n",
+		pp->name, pp->nslab, pp->nalloc, pp->nhit);
+    for (i = 0; i < pp->nslab; i++)
+	free(pp->slab[i].base);
+    if (pp->slab != NULL)
+	free(pp->slab);
+    __pmPoolInit(pp, pp->name, pp->size);
+}
@@ -14,6 +14,7 @@
 
 #include "pmapi.h"
 #include "libpcp.h"
+#include "internal.h"
 #include <ctype.h>
 #include <limits.h>
 #ifdef HAVE_VALUES_H
@@ -184,8 +185,82 @@ __pmStringValue(const char *buf, pmAtomValue *avp, int type)
     return 0;
 }
 
+/*
+ * Small pmValueBlocks (64-bit and floating point values, short strings)
+ * from __pmStuffPoolValue() come from vbpool, and are returned there by
+ * __pmFreeResultValues() via __pmFreePoolValue().
+ */
+#define VBPOOL_SIZE	(sizeof(pmValueBlock) + sizeof(__int64_t))
+
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	stuffvalue_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*stuffvalue_lock;
+#endif
+
+/* Protected by the stuffvalue_lock mutex. */
+static __pmPool		vbpool;
+
+/*
+ * Set (under stuffvalue_lock) before the first pool value is built and
+ * never cleared, so it may be read without the lock by anyone freeing
+ * a value that was built earlier.
+ */
+static int		vbpool_used;
+
+#if defined(PM_MULTI_THREAD) && defined(PM_MULTI_THREAD_DEBUG)
+/*
+ * return true if lock == stuffvalue_lock
+ */
 int
-__pmStuffValue(const pmAtomValue *avp, pmValue *vp, int type)
+__pmIsStuffvalueLock(void *lock)
+{
+    return lock == (void *)&stuffvalue_lock;
+}
+#endif
+
+static pmValueBlock *
+alloc_value(size_t need, int pool)
+{
+    pmValueBlock	*vbp;
+
+    if (pool && need <= VBPOOL_SIZE) {
+	PM_LOCK(stuffvalue_lock);
+	if (vbpool.size == 0) {
+	    __pmPoolInit(&vbpool, "pmValueBlock", VBPOOL_SIZE);
+	    vbpool_used = 1;
+	}
+	vbp = (pmValueBlock *)__pmPoolAlloc(&vbpool);
+	PM_UNLOCK(stuffvalue_lock);
+	return vbp;
+    }
+    return (pmValueBlock *)malloc(
+	    (need < sizeof(pmValueBlock)) ? sizeof(pmValueBlock) : need);
+}
+
+/*
+ * If vbp came from __pmStuffPoolValue(), return it to the pool and
+ * return 1, else return 0 and leave it for the caller to free().
+ *
+ * Only PMDAs (and PM_CONTEXT_LOCAL clients, which are handed pmdaFetch
+ * values directly) ever build pool values, so most processes never
+ * set vbpool_used and do not pay for the lock or the slab search here.
+ */
+int
+__pmFreePoolValue(pmValueBlock *vbp)
+{
+    int		sts;
+
+    if (!vbpool_used)
+	return 0;
+    PM_LOCK(stuffvalue_lock);
+    sts = __pmPoolFree(&vbpool, vbp);
+    PM_UNLOCK(stuffvalue_lock);
+    return sts;
+}
+
+static int
+stuff_value(const pmAtomValue *avp, pmValue *vp, int type, int pool)
 {
     void	*src;
     size_t	need, body;
@@ -242,12 +317,28 @@ __pmStuffValue(const pmAtomValue *avp, pmValue *vp, int type)
 	    return PM_ERR_TYPE;
     }
     need = body + PM_VAL_HDR_SIZE;
-    vp->value.pval = (pmValueBlock *)malloc( 
-	    (need < sizeof(pmValueBlock)) ? sizeof(pmValueBlock) : need);
-    if (vp->value.pval == NULL)
+    if ((vp->value.pval = alloc_value(need, pool)) == NULL)
 	return -oserror();
     vp->value.pval->vlen = (int)need;
     vp->value.pval->vtype = type;
     memcpy((void *)vp->value.pval->vbuf, (void *)src, body);
     return PM_VAL_DPTR;
 }
+
+int
+__pmStuffValue(const pmAtomValue *avp, pmValue *vp, int type)
+{
+    return stuff_value(avp, vp, type, 0);
+}
+
+/*
+ * As for __pmStuffValue(), but small pmValueBlocks come from a pool
+ * rather than malloc(), so the containing pmResult must be released
+ * with pmFreeResult() or __pmFreeResultValues(), never by calling
+ * free() on the pmValueBlock directly.
+ */
+int
+__pmStuffPoolValue(const pmAtomValue *avp, pmValue *vp, int type)
+{
+    return stuff_value(avp, vp, type, 1);
+}
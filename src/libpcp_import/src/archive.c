@@ -105,23 +105,20 @@ check_metric(pmi_context *current, pmID pmid, int *needti)
     int		sts = 0;
     __pmArchCtl	*acp = &current->archctl;
 
-    for (m = 0; m < current->nmetric; m++) {
-	if (pmid != current->metric[m].pmid)
-	    continue;
-	if (current->metric[m].meta_done == 0) {
-	    char	**namelist = &current->metric[m].name;
+    if ((m = _pmi_find_metric(current, pmid)) < 0)
+	return 0;
+    if (current->metric[m].meta_done == 0) {
+	char	**namelist = &current->metric[m].name;
 
-	    if ((sts = __pmLogPutDesc(acp, &current->metric[m].desc, 1, namelist)) < 0)
-		return sts;
+	if ((sts = __pmLogPutDesc(acp, &current->metric[m].desc, 1, namelist)) < 0)
+	    return sts;
 
-	    current->metric[m].meta_done = 1;
-	    *needti = 1;
-	}
-	if (current->metric[m].desc.indom != PM_INDOM_NULL) {
-	    if ((sts = check_indom(current, current->metric[m].desc.indom, needti)) < 0)
-		return sts;
-	}
-	break;
+	current->metric[m].meta_done = 1;
+	*needti = 1;
+    }
+    if (current->metric[m].desc.indom != PM_INDOM_NULL) {
+	if ((sts = check_indom(current, current->metric[m].desc.indom, needti)) < 0)
+	    return sts;
     }
 
     return sts;
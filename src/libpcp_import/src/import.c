@@ -34,7 +34,139 @@ printstamp(FILE *f, const struct timeval *tp)
     pmLocaltime(&now, &tmp);
     fprintf(f, "%4d-%02d-%02d %02d:%02d:%02d.%06d", 1900+tmp.tm_year, tmp.tm_mon, tmp.tm_mday, tmp.tm_hour, tmp.tm_min, tmp.tm_sec, (int)(tp->tv_usec));
 }
- 
+
+/* FNV-1a, for the metric name and instance name hashes */
+static unsigned int
+hash_name(const char *name, size_t len)
+{
+    unsigned int	h = 2166136261U;
+    size_t		i;
+
+    for (i = 0; i < len; i++) {
+	h ^= (unsigned char)name[i];
+	h *= 16777619U;
+    }
+    return h;
+}
+
+/*
+ * External instance names need only be unique up to the first space,
+ * so instances are hashed and matched on that prefix, including the
+ * space itself (or the whole name if there is no space).
+ */
+static size_t
+instance_name_len(const char *name)
+{
+    const char	*p;
+
+    for (p = name; *p && *p != ' '; p++)
+	;
+    return (*p == ' ') ? p - name + 1 : p - name;
+}
+
+static int
+find_metric_name(pmi_context *cp, const char *name)
+{
+    __pmHashNode	*hp;
+    unsigned int	key = hash_name(name, strlen(name));
+    int			m;
+
+    for (hp = __pmHashSearch(key, &cp->metric_names.hc); hp != NULL; hp = hp->next) {
+	if (hp->key != key)
+	    continue;
+	m = (int)(__psint_t)hp->data;
+	if (strcmp(name, cp->metric[m].name) == 0)
+	    return m;
+    }
+    return -1;
+}
+
+int
+_pmi_find_metric(pmi_context *cp, pmID pmid)
+{
+    __pmHashNode	*hp;
+    int			m;
+
+    for (hp = __pmHashSearch(pmid, &cp->metric_ids.hc); hp != NULL; hp = hp->next) {
+	if (hp->key != pmid)
+	    continue;
+	m = (int)(__psint_t)hp->data;
+	if (cp->metric[m].pmid == pmid)
+	    return m;
+    }
+    return -1;
+}
+
+static void
+index_metric(pmi_context *cp, int m)
+{
+    const char	*name = cp->metric[m].name;
+
+    if (__pmHashPoolAdd(hash_name(name, strlen(name)), (void *)(__psint_t)m, &cp->metric_names) < 0 ||
+	__pmHashPoolAdd(cp->metric[m].pmid, (void *)(__psint_t)m, &cp->metric_ids) < 0) {
+	pmNoMem("index_metric: hash", sizeof(__pmHashNode), PM_FATAL_ERR);
+    }
+    cp->metric[m].vset = -1;
+    cp->metric[m].vmax = 0;
+}
+
+static int
+find_indom(pmi_context *cp, pmInDom indom)
+{
+    int		i;
+
+    for (i = 0; i < cp->nindom; i++) {
+	if (cp->indom[i].indom == indom)
+	    return i;
+    }
+    return -1;
+}
+
+static int
+find_instance_name(pmi_indom *idp, const char *instance)
+{
+    __pmHashNode	*hp;
+    size_t		len = instance_name_len(instance);
+    unsigned int	key = hash_name(instance, len);
+    int			j;
+
+    for (hp = __pmHashSearch(key, &idp->names.hc); hp != NULL; hp = hp->next) {
+	if (hp->key != key)
+	    continue;
+	j = (int)(__psint_t)hp->data;
+	if (strncmp(instance, idp->name[j], len) == 0 &&
+	    ((len > 0 && instance[len-1] == ' ') || idp->name[j][len] == '\0'))
+	    return j;
+    }
+    return -1;
+}
+
+static int
+find_instance_id(pmi_indom *idp, int inst)
+{
+    __pmHashNode	*hp;
+    int			j;
+
+    for (hp = __pmHashSearch((unsigned int)inst, &idp->insts.hc); hp != NULL; hp = hp->next) {
+	if (hp->key != (unsigned int)inst)
+	    continue;
+	j = (int)(__psint_t)hp->data;
+	if (idp->inst[j] == inst)
+	    return j;
+    }
+    return -1;
+}
+
+static void
+index_instance(pmi_indom *idp, int j)
+{
+    const char	*name = idp->name[j];
+
+    if (__pmHashPoolAdd(hash_name(name, instance_name_len(name)), (void *)(__psint_t)j, &idp->names) < 0 ||
+	__pmHashPoolAdd((unsigned int)idp->inst[j], (void *)(__psint_t)j, &idp->insts) < 0) {
+	pmNoMem("index_instance: hash", sizeof(__pmHashNode), PM_FATAL_ERR);
+    }
+}
 
 void
 pmiDump(void)
@@ -329,6 +461,10 @@ pmiStart(const char *archive, int inherit)
     current->hostname = NULL;
     current->timezone = NULL;
     current->result = NULL;
+    current->maxpmid = 0;
+    __pmHashPoolInit(&current->values);
+    __pmHashPoolInit(&current->metric_names);
+    __pmHashPoolInit(&current->metric_ids);
     memset((void *)&current->logctl, 0, sizeof(current->logctl));
     memset((void *)&current->archctl, 0, sizeof(current->archctl));
     current->archctl.ac_log = &current->logctl;
@@ -345,6 +481,7 @@ pmiStart(const char *archive, int inherit)
 		current->metric[m].pmid = old_current->metric[m].pmid;
 		current->metric[m].desc = old_current->metric[m].desc;
 		current->metric[m].meta_done = 0;
+		index_metric(current, m);
 	    }
 	}
 	else
@@ -360,7 +497,10 @@ pmiStart(const char *archive, int inherit)
 		int		j;
 		current->indom[i].indom = old_current->indom[i].indom;
 		current->indom[i].ninstance = old_current->indom[i].ninstance;
+		current->indom[i].maxinstance = old_current->indom[i].ninstance;
 		current->indom[i].meta_done = 0;
+		__pmHashPoolInit(&current->indom[i].names);
+		__pmHashPoolInit(&current->indom[i].insts);
 		if (old_current->indom[i].ninstance > 0) {
 		    current->indom[i].name = (char **)malloc(current->indom[i].ninstance*sizeof(char *));
 		    if (current->indom[i].name == NULL) {
@@ -371,6 +511,7 @@ pmiStart(const char *archive, int inherit)
 			pmNoMem("pmiStart: inst", current->indom[i].ninstance*sizeof(int), PM_FATAL_ERR);
 		    }
 		    current->indom[i].namebuflen = old_current->indom[i].namebuflen;
+		    current->indom[i].namebufsize = old_current->indom[i].namebuflen;
 		    current->indom[i].namebuf = (char *)malloc(old_current->indom[i].namebuflen);
 		    if (current->indom[i].namebuf == NULL) {
 			pmNoMem("pmiStart: namebuf", old_current->indom[i].namebuflen, PM_FATAL_ERR);
@@ -381,12 +522,14 @@ pmiStart(const char *archive, int inherit)
 			current->indom[i].name[j] = np;
 			np += strlen(np)+1;
 			current->indom[i].inst[j] = old_current->indom[i].inst[j];
+			index_instance(&current->indom[i], j);
 		    }
 		}
 		else {
 		    current->indom[i].name = NULL;
 		    current->indom[i].inst = NULL;
 		    current->indom[i].namebuflen = 0;
+		    current->indom[i].namebufsize = 0;
 		    current->indom[i].namebuf = NULL;
 		}
 	    }
@@ -545,7 +688,6 @@ valid_pmns_name(const char *name)
 int
 pmiAddMetric(const char *name, pmID pmid, int type, pmInDom indom, int sem, pmUnits units)
 {
-    int		m;
     int		item;
     int		cluster;
     size_t	size;
@@ -557,15 +699,13 @@ pmiAddMetric(const char *name, pmID pmid, int type, pmInDom indom, int sem, pmUn
     if (valid_pmns_name(name) == 0)
 	return current->last_sts = PMI_ERR_BADMETRICNAME;
 
-    for (m = 0; m < current->nmetric; m++) {
-	if (strcmp(name, current->metric[m].name) == 0) {
-	    /* duplicate metric name is not good */
-	    return current->last_sts = PMI_ERR_DUPMETRICNAME;
-	}
-	if (pmid == current->metric[m].pmid) {
-	    /* duplicate metric pmID is not good */
-	    return current->last_sts = PMI_ERR_DUPMETRICID;
-	}
+    if (find_metric_name(current, name) >= 0) {
+	/* duplicate metric name is not good */
+	return current->last_sts = PMI_ERR_DUPMETRICNAME;
+    }
+    if (pmid != PM_ID_NULL && _pmi_find_metric(current, pmid) >= 0) {
+	/* duplicate metric pmID is not good */
+	return current->last_sts = PMI_ERR_DUPMETRICID;
     }
 
     /*
@@ -623,6 +763,7 @@ pmiAddMetric(const char *name, pmID pmid, int type, pmInDom indom, int sem, pmUn
     mp->desc.sem = sem;
     mp->desc.units = units;
     mp->meta_done = 0;
+    index_metric(current, current->nmetric-1);
 
     return current->last_sts = 0;
 }
@@ -631,32 +772,32 @@ int
 pmiAddInstance(pmInDom indom, const char *instance, int inst)
 {
     pmi_indom	*idp;
-    const char	*p;
     char	*np;
-    int		spaced;
+    size_t	len;
+    size_t	size;
     int		i;
     int		j;
 
     if (current == NULL)
 	return PM_ERR_NOCONTEXT;
 
-    for (i = 0; i < current->nindom; i++) {
-	if (current->indom[i].indom == indom)
-	    break;
-    }
-    if (i == current->nindom) {
+    if ((i = find_indom(current, indom)) < 0) {
 	/* extend indom table */
-	current->nindom++;
+	i = current->nindom++;
 	current->indom = (pmi_indom *)realloc(current->indom, current->nindom*sizeof(pmi_indom));
 	if (current->indom == NULL) {
 	    pmNoMem("pmiAddInstance: pmi_indom", current->nindom*sizeof(pmi_indom), PM_FATAL_ERR);
 	}
 	current->indom[i].indom = indom;
 	current->indom[i].ninstance = 0;
+	current->indom[i].maxinstance = 0;
 	current->indom[i].name = NULL;
 	current->indom[i].inst = NULL;
 	current->indom[i].namebuflen = 0;
+	current->indom[i].namebufsize = 0;
 	current->indom[i].namebuf = NULL;
+	__pmHashPoolInit(&current->indom[i].names);
+	__pmHashPoolInit(&current->indom[i].insts);
     }
     idp = &current->indom[i];
     /*
@@ -664,45 +805,48 @@ pmiAddInstance(pmInDom indom, const char *instance, int inst)
      * to honour unique to first space rule ...
      * duplicate instance internal identifier is also not allowed
      */
-    for (p = instance; *p && *p != ' '; p++)
-	;
-    spaced = (*p == ' ') ? p - instance + 1: 0;	/* +1 => *must* compare the space too */
-    for (j = 0; j < idp->ninstance; j++) {
-	if (spaced) {
-	    if (strncmp(instance, idp->name[j], spaced) == 0)
-		return current->last_sts = PMI_ERR_DUPINSTNAME;
-	} else {
-	    if (strcmp(instance, idp->name[j]) == 0)
-		return current->last_sts = PMI_ERR_DUPINSTNAME;
-	}
-	if (inst == idp->inst[j]) {
-	    return current->last_sts = PMI_ERR_DUPINSTID;
-	}
-    }
+    if (find_instance_name(idp, instance) >= 0)
+	return current->last_sts = PMI_ERR_DUPINSTNAME;
+    if (find_instance_id(idp, inst) >= 0)
+	return current->last_sts = PMI_ERR_DUPINSTID;
+
     /* add instance marks whole indom as needing to be written */
     idp->meta_done = 0;
-    idp->ninstance++;
-    idp->name = (char **)realloc(idp->name, idp->ninstance*sizeof(char *));
-    if (idp->name == NULL) {
-	pmNoMem("pmiAddInstance: name", idp->ninstance*sizeof(char *), PM_FATAL_ERR);
-    }
-    idp->inst = (int *)realloc(idp->inst, idp->ninstance*sizeof(int));
-    if (idp->inst == NULL) {
-	pmNoMem("pmiAddInstance: inst", idp->ninstance*sizeof(int), PM_FATAL_ERR);
-    }
-    idp->namebuf = (char *)realloc(idp->namebuf, idp->namebuflen+strlen(instance)+1);
-    if (idp->namebuf == NULL) {
-	pmNoMem("pmiAddInstance: namebuf", idp->namebuflen+strlen(instance)+1, PM_FATAL_ERR);
+    if (idp->ninstance == idp->maxinstance) {
+	idp->maxinstance = idp->maxinstance ? idp->maxinstance * 2 : 16;
+	idp->name = (char **)realloc(idp->name, idp->maxinstance*sizeof(char *));
+	if (idp->name == NULL) {
+	    pmNoMem("pmiAddInstance: name", idp->maxinstance*sizeof(char *), PM_FATAL_ERR);
+	}
+	idp->inst = (int *)realloc(idp->inst, idp->maxinstance*sizeof(int));
+	if (idp->inst == NULL) {
+	    pmNoMem("pmiAddInstance: inst", idp->maxinstance*sizeof(int), PM_FATAL_ERR);
+	}
     }
-    strcpy(&idp->namebuf[idp->namebuflen], instance);
-    idp->namebuflen += strlen(instance)+1;
-    idp->inst[idp->ninstance-1] = inst;
-    /* in case namebuf moves, need to redo name[] pointers */
-    np = idp->namebuf;
-    for (j = 0; j < current->indom[i].ninstance; j++) {
-	idp->name[j] = np;
-	np += strlen(np)+1;
+    len = strlen(instance)+1;
+    if (idp->namebuflen + len > idp->namebufsize) {
+	/* grow geometrically, so names are rarely moved */
+	size = idp->namebufsize ? idp->namebufsize * 2 : 256;
+	while (size < idp->namebuflen + len)
+	    size *= 2;
+	idp->namebuf = (char *)realloc(idp->namebuf, size);
+	if (idp->namebuf == NULL) {
+	    pmNoMem("pmiAddInstance: namebuf", size, PM_FATAL_ERR);
+	}
+	idp->namebufsize = size;
+	/* in case namebuf moves, need to redo name[] pointers */
+	np = idp->namebuf;
+	for (j = 0; j < idp->ninstance; j++) {
+	    idp->name[j] = np;
+	    np += strlen(np)+1;
+	}
     }
+    j = idp->ninstance++;
+    idp->name[j] = &idp->namebuf[idp->namebuflen];
+    strcpy(idp->name[j], instance);
+    idp->namebuflen += len;
+    idp->inst[j] = inst;
+    index_instance(idp, j);
 
     return current->last_sts = 0;
 }
@@ -710,28 +854,16 @@ pmiAddInstance(pmInDom indom, const char *instance, int inst)
 static int
 make_handle(const char *name, const char *instance, pmi_handle *hp)
 {
-    static int	m = -1;
     int		i;
-    static int	j = -1;
-    int		found = 0;
-    int		spaced;
-    const char	*p;
+    int		j;
+    int		m;
     pmi_indom	*idp;
 
     if (instance != NULL && instance[0] == '\0')
 	/* map "" to NULL to help Perl callers */
 	instance = NULL;
 
-    if (m >= 0 && m < current->nmetric && strcmp(name, current->metric[m].name) == 0) {
-    	; /* optimization: same metric as last time */
-    }
-    else {
-	for (m = 0; m < current->nmetric; m++) {
-	    if (strcmp(name, current->metric[m].name) == 0)
-		break;
-	}
-    }
-    if (m == current->nmetric)
+    if ((m = find_metric_name(current, name)) < 0)
 	return current->last_sts = PM_ERR_NAME;
     hp->midx = m;
 
@@ -746,43 +878,12 @@ make_handle(const char *name, const char *instance, pmi_handle *hp)
 	if (instance == NULL)
 	    /* don't expect "instance" to be NULL */
 	    return current->last_sts = PMI_ERR_INSTNULL;
-	for (i = 0; i < current->nindom; i++) {
-	    if (current->metric[hp->midx].desc.indom == current->indom[i].indom)
-		break;
-	}
-	if (i == current->nindom)
+	if ((i = find_indom(current, current->metric[hp->midx].desc.indom)) < 0)
 	    return current->last_sts = PM_ERR_INDOM;
 	idp = &current->indom[i];
 
 	/* match to first space rule */
-
-	for (p = instance; *p && *p != ' '; p++)
-	    ;
-	spaced = (*p == ' ') ? p - instance + 1: 0;	/* +1 => *must* compare the space too */
-
-	if (j >= 0 && j < idp->ninstance) {
-	    /* optimization: same inst as last time? */
-	    if (spaced) {
-		if (strncmp(instance, idp->name[j], spaced) == 0)
-		    found = 1;
-	    } else {
-		if (strcmp(instance, idp->name[j]) == 0)
-		    found = 1;
-	    }
-	}
-
-	if (!found) {
-	    for (j = 0; j < idp->ninstance; j++) {
-		if (spaced) {
-		    if (strncmp(instance, idp->name[j], spaced) == 0)
-			break;
-		} else {
-		    if (strcmp(instance, idp->name[j]) == 0)
-			break;
-		}
-	    }
-	}
-	if (j == idp->ninstance)
+	if ((j = find_instance_name(idp, instance)) < 0)
 	    return current->last_sts = PM_ERR_INST;
 	hp->inst = idp->inst[j];
     }
@@ -843,6 +944,64 @@ pmiPutValueHandle(int handle, const char *value)
     return current->last_sts = _pmi_stuff_value(current, &current->handle[handle-1], value);
 }
 
+/*
+ * Bulk variants, for a whole row of values at a time.  Every name (or
+ * handle) is checked before any value is stored; after that, values are
+ * stored in order until the first one that fails, as if by successive
+ * calls to pmiPutValue (or pmiPutValueHandle).
+ */
+int
+pmiPutValues(int count, const char **names, const char **instances, const char **values)
+{
+    pmi_handle	*tmp;
+    int		sts = 0;
+    int		n;
+
+    if (current == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (count <= 0)
+	return current->last_sts = 0;
+
+    tmp = (pmi_handle *)malloc(count * sizeof(pmi_handle));
+    if (tmp == NULL) {
+	pmNoMem("pmiPutValues: pmi_handle", count * sizeof(pmi_handle), PM_FATAL_ERR);
+    }
+    for (n = 0; n < count; n++) {
+	if ((sts = make_handle(names[n], instances ? instances[n] : NULL, &tmp[n])) != 0)
+	    break;
+    }
+    if (sts == 0) {
+	for (n = 0; n < count; n++) {
+	    if ((sts = _pmi_stuff_value(current, &tmp[n], values[n])) != 0)
+		break;
+	}
+    }
+    free(tmp);
+
+    return current->last_sts = sts;
+}
+
+int
+pmiPutValueHandles(int count, const int *handles, const char **values)
+{
+    int		sts = 0;
+    int		n;
+
+    if (current == NULL)
+	return PM_ERR_NOCONTEXT;
+
+    for (n = 0; n < count; n++) {
+	if (handles[n] <= 0 || handles[n] > current->nhandle)
+	    return current->last_sts = PMI_ERR_BADHANDLE;
+    }
+    for (n = 0; n < count; n++) {
+	if ((sts = _pmi_stuff_value(current, &current->handle[handles[n]-1], values[n])) != 0)
+	    break;
+    }
+
+    return current->last_sts = sts;
+}
+
 int
 pmiPutText(unsigned int type, unsigned int class, unsigned int id, const char *content)
 {
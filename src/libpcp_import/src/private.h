@@ -20,15 +20,21 @@ typedef struct {
     pmID	pmid;
     pmDesc	desc;
     int		meta_done;
+    int		vset;		// index into result->vset[], if still current
+    int		vmax;		// pmValue slots allocated in that vset
 } pmi_metric;
 
 typedef struct {
     pmInDom	indom;
     int		ninstance;
+    int		maxinstance;	// slots allocated in name[] and inst[]
     char	**name;		// list of external instance names
     int		*inst;		// list of internal instance identifiers
     int		namebuflen;	// names are packed in namebuf[] as
     char	*namebuf;	// required by __pmLogPutInDom()
+    int		namebufsize;	// bytes allocated for namebuf[]
+    __pmHashPoolCtl	names;	// external name (to first space) -> index
+    __pmHashPoolCtl	insts;	// internal identifier -> index
     int		meta_done;
 } pmi_indom;
 
@@ -58,8 +64,12 @@ typedef struct {
     __pmLogCtl	logctl;
     __pmArchCtl	archctl;
     pmResult	*result;
+    int		maxpmid;	// vset[] slots allocated in result
+    __pmHashPoolCtl	values;	// (metric, instance) -> vlist[] index in result
     int		nmetric;
     pmi_metric	*metric;
+    __pmHashPoolCtl	metric_names;	// metric name -> index into metric[]
+    __pmHashPoolCtl	metric_ids;	// pmID -> index into metric[]
     int		nindom;
     pmi_indom	*indom;
     int		nhandle;
@@ -82,6 +92,7 @@ typedef struct {
 # define _PMI_HIDDEN
 #endif
 
+extern int _pmi_find_metric(pmi_context *, pmID) _PMI_HIDDEN;
 extern int _pmi_stuff_value(pmi_context *, pmi_handle *, const char *) _PMI_HIDDEN;
 extern int _pmi_put_result(pmi_context *, pmResult *) _PMI_HIDDEN;
 extern int _pmi_put_text(pmi_context *) _PMI_HIDDEN;
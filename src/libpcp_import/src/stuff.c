@@ -17,11 +17,25 @@
 #include "import.h"
 #include "private.h"
 
+/*
+ * Key for the values hash, not unique across metrics, so lookups must
+ * check the instance found in the vset of the metric at hand.  The
+ * multiplier spreads consecutive instance identifiers over the table.
+ */
+static unsigned int
+value_key(pmi_handle *hp)
+{
+    return ((unsigned int)hp->inst * 2654435761U) ^ (unsigned int)hp->midx;
+}
+
 int
 _pmi_stuff_value(pmi_context *current, pmi_handle *hp, const char *value)
 {
     pmResult	*rp;
+    __pmHashNode	*np;
+    unsigned int	key;
     int		i;
+    int		j;
     pmID	pmid;
     pmValueSet	*vsp;
     pmValue	*vp;
@@ -46,46 +60,65 @@ _pmi_stuff_value(pmi_context *current, pmi_handle *hp, const char *value)
 	current->result->numpmid = 0;
 	current->result->timestamp.tv_sec = 0;
 	current->result->timestamp.tv_usec = 0;
+	current->maxpmid = 1;
+	/* new result, forget values of the previous one */
+	__pmHashPoolClear(&current->values);
     }
     rp = current->result;
 
-    pmid = current->metric[hp->midx].pmid;
-    for (i = 0; i < rp->numpmid; i++) {
-	if (pmid == rp->vset[i]->pmid) {
-	    if (mp->desc.indom == PM_INDOM_NULL)
-		/* singular metric, cannot have more than one value */
+    /*
+     * vset[] and vlist[] are grown geometrically, and the vset[] slot of
+     * each metric and the vlist[] slot of each metric-instance are found
+     * through mp->vset and current->values, so that stuffing a row of
+     * values costs the same for every value, however wide the row.
+     */
+    pmid = mp->pmid;
+    i = mp->vset;
+    if (i >= 0 && i < rp->numpmid && rp->vset[i]->pmid == pmid) {
+	vsp = rp->vset[i];
+	if (mp->desc.indom == PM_INDOM_NULL)
+	    /* singular metric, cannot have more than one value */
+	    return PMI_ERR_DUPVALUE;
+	if (vsp->numval < 0)
+	    /* earlier value for this metric could not be converted */
+	    return vsp->numval;
+	key = value_key(hp);
+	for (np = __pmHashSearch(key, &current->values.hc); np != NULL; np = np->next) {
+	    if (np->key != key)
+		continue;
+	    j = (int)(__psint_t)np->data;
+	    if (j < vsp->numval && vsp->vlist[j].inst == hp->inst)
+		/* each metric-instance can appear at most once per pmResult */
 		return PMI_ERR_DUPVALUE;
-	    break;
-	}
-    }
-    if (i == rp->numpmid) {
-	rp->numpmid++;
-	size = sizeof(pmResult) + (rp->numpmid - 1)*sizeof(pmValueSet *);
-	rp = current->result = (pmResult *)realloc(current->result, size);
-	if (current->result == NULL) {
-	    pmNoMem("_pmi_stuff_value: result realloc:", size, PM_FATAL_ERR);
 	}
-	rp->vset[rp->numpmid-1] = (pmValueSet *)malloc(sizeof(pmValueSet));
-	if (rp->vset[rp->numpmid-1] == NULL) {
-	    pmNoMem("_pmi_stuff_value: vset alloc:", sizeof(pmValueSet), PM_FATAL_ERR);
+	if (vsp->numval == mp->vmax) {
+	    mp->vmax *= 2;
+	    size = sizeof(pmValueSet) + (mp->vmax-1)*sizeof(pmValue);
+	    vsp = rp->vset[i] = (pmValueSet *)realloc(rp->vset[i], size);
+	    if (rp->vset[i] == NULL) {
+		pmNoMem("_pmi_stuff_value: vset realloc:", size, PM_FATAL_ERR);
+	    }
 	}
-	vsp = rp->vset[rp->numpmid-1];
-	vsp->pmid = pmid;
-	vsp->numval = 1;
+	vsp->numval++;
     }
     else {
-	int		j;
-	for (j = 0; j < rp->vset[i]->numval; j++) {
-	    if (rp->vset[i]->vlist[j].inst == hp->inst)
-		/* each metric-instance can appear at most once per pmResult */
-		return PMI_ERR_DUPVALUE;
+	if (rp->numpmid == current->maxpmid) {
+	    current->maxpmid *= 2;
+	    size = sizeof(pmResult) + (current->maxpmid - 1)*sizeof(pmValueSet *);
+	    rp = current->result = (pmResult *)realloc(current->result, size);
+	    if (current->result == NULL) {
+		pmNoMem("_pmi_stuff_value: result realloc:", size, PM_FATAL_ERR);
+	    }
 	}
-	rp->vset[i]->numval++;
-	size = sizeof(pmValueSet) + (rp->vset[i]->numval-1)*sizeof(pmValue);
-	vsp = rp->vset[i] = (pmValueSet *)realloc(rp->vset[i], size);
+	i = mp->vset = rp->numpmid++;
+	mp->vmax = 1;
+	rp->vset[i] = (pmValueSet *)malloc(sizeof(pmValueSet));
 	if (rp->vset[i] == NULL) {
-	    pmNoMem("_pmi_stuff_value: vset realloc:", size, PM_FATAL_ERR);
+	    pmNoMem("_pmi_stuff_value: vset alloc:", sizeof(pmValueSet), PM_FATAL_ERR);
 	}
+	vsp = rp->vset[i];
+	vsp->pmid = pmid;
+	vsp->numval = 1;
     }
     vp = &vsp->vlist[vsp->numval-1];
     vp->inst = hp->inst;
@@ -177,5 +210,11 @@ _pmi_stuff_value(pmi_context *current, pmi_handle *hp, const char *value)
 	memcpy((void *)vp->value.pval->vbuf, data, dsize);
     }
 
+    if (mp->desc.indom != PM_INDOM_NULL) {
+	if (__pmHashPoolAdd(value_key(hp), (void *)(__psint_t)(vsp->numval-1), &current->values) < 0) {
+	    pmNoMem("_pmi_stuff_value: values hash", sizeof(__pmHashNode), PM_FATAL_ERR);
+	}
+    }
+
     return 0;
 }
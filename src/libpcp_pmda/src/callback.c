@@ -664,7 +664,7 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 		 */
 		if ((version == PMDA_INTERFACE_2) || (version >= PMDA_INTERFACE_3 && sts > 0)) {
 
-		    if ((lsts = __pmStuffValue(&atom, &vset->vlist[j], type)) == PM_ERR_TYPE) {
+		    if ((lsts = __pmStuffPoolValue(&atom, &vset->vlist[j], type)) == PM_ERR_TYPE) {
 			pmNotifyErr(LOG_ERR, "pmdaFetch: Descriptor type (%s) for metric %s is bad",
 				    pmTypeStr_r(type, strbuf, sizeof(strbuf)),
 				    pmIDStr_r(dp->pmid, idbuf, sizeof(idbuf)));
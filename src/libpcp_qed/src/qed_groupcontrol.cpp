@@ -42,6 +42,9 @@ void QedGroupControl::init(struct timeval *interval, struct timeval *position)
     my.position = *position;
     my.realDelta = QedApp::timevalToSeconds(*interval);
     my.realPosition = QedApp::timevalToSeconds(*position);
+    // the concurrent fetch deadline tracks the sample interval
+    if (concurrentFetch())
+	setConcurrentFetch(true, (int)(my.realDelta * 1000.0));
 }
 
 QmcTime::State QedGroupControl::pmtimeState(void)
@@ -97,6 +100,9 @@ void QedGroupControl::adjustWorldView(QmcTime::Packet *packet, bool vcrMode)
     my.position = packet->position;
     my.realDelta = QedApp::timevalToSeconds(packet->delta);
     my.realPosition = QedApp::timevalToSeconds(packet->position);
+    // the concurrent fetch deadline tracks the sample interval
+    if (concurrentFetch())
+	setConcurrentFetch(true, (int)(my.realDelta * 1000.0));
 
     console->post("QedGroupControl::adjustWorldView: "
 		  "delta=%.2f position=%.2f (%s) state=%s",
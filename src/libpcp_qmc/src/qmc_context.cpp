@@ -271,8 +271,25 @@ QmcContext::addMetric(QmcMetric *metric)
 int
 QmcContext::fetch(bool update)
 {
-    int i, sts;
-    pmResult *result;
+    pmResult *result = NULL;
+    int sts;
+
+    if ((sts = fetchPrepare()) < 0 || my.pmids.size() == 0) {
+	if (pmDebugOptions.optfetch) {
+	    QTextStream cerr(stderr);
+	    cerr << "QmcContext::fetch: nothing to fetch" << endl;
+	}
+	return sts;
+    }
+
+    sts = fetchResult(&result);
+    return fetchComplete(sts, result, update);
+}
+
+void
+QmcContext::newSample()
+{
+    int i;
 
     for (i = 0; i < my.metrics.size(); i++) {
 	QmcMetric *metric = my.metrics[i];
@@ -285,6 +302,14 @@ QmcContext::fetch(bool update)
     // indom changes are now irrelevant
     for (i = 0; i < my.indoms.size(); i++)
 	my.indoms[i]->newFetch();
+}
+
+int
+QmcContext::fetchPrepare()
+{
+    int i, sts;
+
+    newSample();
 
     sts = pmUseContext(my.context);
     if (sts >= 0) {
@@ -316,61 +341,111 @@ QmcContext::fetch(bool update)
 	}
     }
 
-    if (sts >= 0 && my.pmids.size()) {
+    if (sts >= 0)
+	my.fetchIDs = my.pmids.toVector();
+    return sts;
+}
+
+//
+// Issue the pmFetch for this context.  This does not touch any of the
+// metric or indom state, so it may be called from a thread other than
+// the one that owns the group - the current PMAPI context is per-thread.
+//
+int
+QmcContext::fetchResult(pmResult **result)
+{
+    int sts;
+
+    if ((sts = pmUseContext(my.context)) < 0)
+	return sts;
+
+    if (pmDebugOptions.optfetch) {
+	QTextStream cerr(stderr);
+	cerr << "QmcContext::fetch: fetching context " << *this << endl;
+    }
+
+    return pmFetch(my.fetchIDs.size(), my.fetchIDs.data(), result);
+}
+
+int
+QmcContext::fetchComplete(int sts, pmResult *result, bool update)
+{
+    int i;
+
+    if (sts >= 0) {
+	my.previousTime = my.currentTime;
+	my.currentTime = result->timestamp;
+	my.delta = pmtimevalSub(&my.currentTime, &my.previousTime);
+	for (i = 0; i < my.metrics.size(); i++) {
+	    QmcMetric *metric = my.metrics[i];
+	    if (metric->status() < 0)
+		continue;
+	    Q_ASSERT((int)metric->idIndex() < result->numpmid);
+	    metric->extractValues(result->vset[metric->idIndex()]);
+	}
+	pmFreeResult(result);
+    }
+    else {
 	if (pmDebugOptions.optfetch) {
 	    QTextStream cerr(stderr);
-	    cerr << "QmcContext::fetch: fetching context " << *this << endl;
+	    cerr << "QmcContext::fetch: pmFetch: " << pmErrStr(sts) << endl;
 	}
+	setFetchError(sts);
+	if (sts == PM_ERR_IPC || sts == PM_ERR_TIMEOUT)
+	    my.needReconnect = true;
+    }
 
-	sts = pmFetch(my.pmids.size(), 
-		      (pmID *)(my.pmids.toVector().data()), &result);
-	if (sts >= 0) {
-	    my.previousTime = my.currentTime;
-	    my.currentTime = result->timestamp;
-	    my.delta = pmtimevalSub(&my.currentTime, &my.previousTime);
-	    for (i = 0; i < my.metrics.size(); i++) {
-		QmcMetric *metric = my.metrics[i];
-		if (metric->status() < 0)
-		    continue;
-		Q_ASSERT((int)metric->idIndex() < result->numpmid);
-		metric->extractValues(result->vset[metric->idIndex()]);
-	    }
-	    pmFreeResult(result);
-	}
-	else {
-	    if (pmDebugOptions.optfetch) {
-		QTextStream cerr(stderr);
-		cerr << "QmcContext::fetch: pmFetch: " << pmErrStr(sts) << endl;
-	    }
-	    for (i = 0; i < my.metrics.size(); i++) {
-		QmcMetric *metric = my.metrics[i];
-		if (metric->status() < 0)
-		    continue;
-		metric->setError(sts);
-	    }
-	    if (sts == PM_ERR_IPC || sts == PM_ERR_TIMEOUT)
-		my.needReconnect = true;
-	}
+    if (update)
+	updateMetrics();
 
-	if (update) {
-	    if (pmDebugOptions.optfetch) {
-		QTextStream cerr(stderr);
-		cerr << "QmcContext::fetch: Updating metrics" << endl;
-	    }
-	    for (i = 0; i < my.metrics.size(); i++) {
-		QmcMetric *metric = my.metrics[i];
-		if (metric->status() < 0)
-		    continue;
-		metric->update();
-	    }
-	}
-    }
-    else if (pmDebugOptions.optfetch) {
+    return sts;
+}
+
+//
+// The group gave up waiting on this context for the current sample
+// (after newSample() or fetchPrepare()); the pmFetch may still be
+// outstanding, so no reconnect is attempted.
+//
+int
+QmcContext::fetchMissed(bool update)
+{
+    if (pmDebugOptions.optfetch) {
 	QTextStream cerr(stderr);
-	cerr << "QmcContext::fetch: nothing to fetch" << endl;
+	cerr << "QmcContext::fetch: missed deadline for context "
+	     << *this << endl;
     }
 
-    return sts;
+    setFetchError(PM_ERR_TIMEOUT);
+    if (update)
+	updateMetrics();
+
+    return PM_ERR_TIMEOUT;
+}
+
+void
+QmcContext::setFetchError(int sts)
+{
+    for (int i = 0; i < my.metrics.size(); i++) {
+	QmcMetric *metric = my.metrics[i];
+	if (metric->status() < 0)
+	    continue;
+	metric->setError(sts);
+    }
+}
+
+void
+QmcContext::updateMetrics()
+{
+    if (pmDebugOptions.optfetch) {
+	QTextStream cerr(stderr);
+	cerr << "QmcContext::fetch: Updating metrics" << endl;
+    }
+    for (int i = 0; i < my.metrics.size(); i++) {
+	QmcMetric *metric = my.metrics[i];
+	if (metric->status() < 0)
+	    continue;
+	metric->update();
+    }
 }
 
 void
@@ -25,6 +25,7 @@
 #include <qlist.h>
 #include <qstring.h>
 #include <qtextstream.h>
+#include <qvector.h>
 
 class QmcContext
 {
@@ -85,6 +86,15 @@ public:
 
     int fetch(bool update);		// Fetch metrics using this context
 
+    // The three phases of fetch(), separated so that a group can issue
+    // the pmFetch for many contexts concurrently.  Only fetchResult()
+    // may be called from a thread other than the group owner's.
+    void newSample();			// Shift values, reset indoms
+    int fetchPrepare();			// newSample(), send profile
+    int fetchResult(pmResult **result);	// pmFetch on this context
+    int fetchComplete(int sts, pmResult *result, bool update);
+    int fetchMissed(bool update);	// No result in time for this sample
+
     struct timeval const& timeStamp() const
 	{ return my.currentTime; }
 
@@ -106,6 +116,7 @@ private:
 	QHash<pmID, QString*> pmidCache;// Mapping between PMIDs and names
 	QHash<pmID, QmcDesc*> descCache;// Mapping between PMIDs and descs
 	QList<pmID> pmids;		// List of valid PMIDs to be fetched
+	QVector<pmID> fetchIDs;		// PMIDs passed to pmFetch
 	QList<QmcIndom*> indoms;	// List of requested indoms 
 	QList<QmcMetric*> metrics;	// List of metrics using this context
 	struct timeval currentTime;	// Time of current fetch
@@ -113,6 +124,9 @@ private:
 	double delta;			// Time between fetches
     } my;
 
+    void setFetchError(int sts);
+    void updateMetrics();
+
     static QStringList *theStringList;	// List of metric names in traversal
     static void dometric(const char *);
 };
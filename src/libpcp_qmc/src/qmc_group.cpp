@@ -24,6 +24,49 @@
 #include "qmc_context.h"
 #include "qmc_metric.h"
 
+#include <QElapsedTimer>
+#include <QRunnable>
+
+//
+// State shared between the group and a pool thread issuing the pmFetch
+// for one context - protected by the group fetchLock.
+//
+struct QmcFetchState {
+    bool busy;			// pmFetch issued, result not yet consumed
+    bool done;			// pmFetch has returned
+    int sts;			// pmFetch return code
+    pmResult *result;		// pmFetch result, if sts >= 0
+};
+
+class QmcFetchTask : public QRunnable
+{
+public:
+    QmcFetchTask(QmcContext *context, QmcFetchState *state,
+		 QMutex *lock, QWaitCondition *done)
+	{ my.context = context; my.state = state;
+	  my.lock = lock; my.done = done; }
+
+    void run()
+    {
+	pmResult *result = NULL;
+	int sts = my.context->fetchResult(&result);
+
+	QMutexLocker locker(my.lock);
+	my.state->sts = sts;
+	my.state->result = (sts >= 0) ? result : NULL;
+	my.state->done = true;
+	my.done->wakeAll();
+    }
+
+private:
+    struct {
+	QmcContext *context;
+	QmcFetchState *state;
+	QMutex *lock;
+	QWaitCondition *done;
+    } my;
+};
+
 int QmcGroup::tzLocal = -1;
 bool QmcGroup::tzLocalInit = false;
 QString	QmcGroup::tzLocalString;
@@ -40,6 +83,9 @@ QmcGroup::QmcGroup(bool restrictArchives)
     my.tzUser = -1;
     my.tzGroupIndex = 0;
     my.timeEndReal = 0.0;
+    my.concurrent = false;
+    my.deadline = 0;
+    my.fetchPool = NULL;
 
     // Get timezone from environment
     if (tzLocalInit == false) {
@@ -66,6 +112,16 @@ QmcGroup::QmcGroup(bool restrictArchives)
 
 QmcGroup::~QmcGroup()
 {
+    // Wait out any fetches still in flight before the contexts go away
+    if (my.fetchPool) {
+	my.fetchPool->waitForDone();
+	delete my.fetchPool;
+    }
+    for (int i = 0; i < my.fetchStates.size(); i++) {
+	if (my.fetchStates[i]->result)
+	    pmFreeResult(my.fetchStates[i]->result);
+	delete my.fetchStates[i];
+    }
     for (int i = 0; i < my.contexts.size(); i++)
 	if (my.contexts[i])
 	    delete my.contexts[i];
@@ -478,11 +534,21 @@ QmcGroup::fetch(bool update)
 	cerr << "QmcGroup::fetch: " << numContexts() << " contexts" << endl;
     }
 
-    for (unsigned int i = 0; i < numContexts(); i++)
-	my.contexts[i]->fetch(update);
+    if (my.concurrent && numContexts() > 1)
+	fetchConcurrent(update);
+    else {
+	for (unsigned int i = 0; i < numContexts(); i++)
+	    my.contexts[i]->fetch(update);
+    }
 
-    if (numContexts())
-	sts = useContext();
+    if (numContexts()) {
+	// Cannot switch to a context which is still mid-fetch
+	if (my.concurrent && my.use >= 0 && my.use < my.fetchStates.size() &&
+	    my.fetchStates[my.use]->busy)
+	    sts = PM_ERR_TIMEOUT;
+	else
+	    sts = useContext();
+    }
 
     if (pmDebugOptions.pmc) {
 	QTextStream cerr(stderr);
@@ -492,6 +558,133 @@ QmcGroup::fetch(bool update)
     return sts;
 }
 
+void
+QmcGroup::setConcurrentFetch(bool concurrent, int deadline)
+{
+    my.concurrent = concurrent;
+    my.deadline = deadline > 0 ? deadline : 0;
+}
+
+//
+// Prepare each context (profiles, reconnects) on this thread, then hand
+// the pmFetch calls to the pool and merge results as they arrive.  A
+// context whose previous fetch is still outstanding is not reissued, it
+// just misses this sample; a late result is discarded once it arrives.
+// Local contexts may only be used from the thread that created them, so
+// these are fetched here, while the pool works on the other contexts.
+//
+void
+QmcGroup::fetchConcurrent(bool update)
+{
+    QVector<int> issued, local;
+    QElapsedTimer timer;
+    unsigned int i;
+    int sts, pending;
+
+    if (my.fetchPool == NULL)
+	my.fetchPool = new QThreadPool();
+    if (my.fetchPool->maxThreadCount() < (int)numContexts())
+	my.fetchPool->setMaxThreadCount(numContexts());
+
+    while (my.fetchStates.size() < (int)numContexts()) {
+	QmcFetchState *state = new QmcFetchState;
+	state->busy = state->done = false;
+	state->sts = 0;
+	state->result = NULL;
+	my.fetchStates.append(state);
+    }
+
+    for (i = 0; i < numContexts(); i++) {
+	QmcContext *context = my.contexts[i];
+	QmcFetchState *state = my.fetchStates[i];
+	pmResult *stale = NULL;
+	bool busy;
+
+	my.fetchLock.lock();
+	if (state->busy && state->done) {
+	    stale = state->result;
+	    state->result = NULL;
+	    state->busy = false;
+	}
+	busy = state->busy;
+	my.fetchLock.unlock();
+
+	if (stale)
+	    pmFreeResult(stale);
+	if (busy) {
+	    context->newSample();
+	    context->fetchMissed(update);
+	    continue;
+	}
+	if (context->source().type() == PM_CONTEXT_LOCAL) {
+	    local.append(i);
+	    continue;
+	}
+	if (context->fetchPrepare() < 0 || context->numIDs() == 0)
+	    continue;
+
+	state->busy = true;
+	state->done = false;
+	issued.append(i);
+	my.fetchPool->start(new QmcFetchTask(context, state,
+				&my.fetchLock, &my.fetchDone));
+    }
+
+    if (pmDebugOptions.pmc) {
+	QTextStream cerr(stderr);
+	cerr << "QmcGroup::fetch: issued " << issued.size()
+	     << " concurrent fetches, " << local.size()
+	     << " local" << endl;
+    }
+
+    timer.start();
+    for (i = 0; i < (unsigned int)local.size(); i++)
+	my.contexts[local[i]]->fetch(update);
+
+    my.fetchLock.lock();
+    for (pending = issued.size(); pending > 0; ) {
+	QmcFetchState *state = NULL;
+	int index;
+
+	for (i = 0; i < (unsigned int)issued.size(); i++) {
+	    if ((index = issued[i]) < 0)
+		continue;
+	    if (my.fetchStates[index]->done) {
+		state = my.fetchStates[index];
+		issued[i] = -1;
+		break;
+	    }
+	}
+
+	if (state) {
+	    pmResult *result = state->result;
+
+	    sts = state->sts;
+	    state->result = NULL;
+	    state->busy = false;
+	    pending--;
+	    my.fetchLock.unlock();
+	    my.contexts[index]->fetchComplete(sts, result, update);
+	    my.fetchLock.lock();
+	}
+	else if (my.deadline == 0)
+	    my.fetchDone.wait(&my.fetchLock);
+	else if (timer.elapsed() >= my.deadline ||
+		 !my.fetchDone.wait(&my.fetchLock,
+				    my.deadline - timer.elapsed()))
+	    break;
+    }
+    my.fetchLock.unlock();
+
+    // Anything still outstanding has missed this sample
+    for (i = 0; pending > 0 && i < (unsigned int)issued.size(); i++) {
+	if (issued[i] < 0)
+	    continue;
+	my.contexts[issued[i]]->fetchMissed(update);
+	pending--;
+    }
+}
+
 int
 QmcGroup::setArchiveMode(int mode, const struct timeval *when, int interval)
 {
@@ -20,8 +20,14 @@
 #include "qmc_context.h"
 
 #include <qlist.h>
+#include <qmutex.h>
 #include <qstring.h>
 #include <qtextstream.h>
+#include <qthreadpool.h>
+#include <qvector.h>
+#include <qwaitcondition.h>
+
+struct QmcFetchState;
 
 class QmcGroup
 {
@@ -60,6 +66,14 @@ public:
     // By default, do all rate conversions and counter wraps
     int fetch(bool update = true);
 
+    // Issue the fetch for all contexts in parallel rather than in turn.
+    // With a positive deadline (milliseconds), any context that has not
+    // responded in time is marked as missed for this sample (its metrics
+    // report PM_ERR_TIMEOUT) rather than holding up the whole group.
+    void setConcurrentFetch(bool concurrent, int deadline = 0);
+    bool concurrentFetch() const { return my.concurrent; }
+    int fetchDeadline() const { return my.deadline; }
+
     // Set the archive position and mode
     int setArchiveMode(int mode, const struct timeval *when, int interval);
 
@@ -94,6 +108,13 @@ private:
 	struct timeval timeStart;	// Start of first archive
 	struct timeval timeEnd;		// End of last archive
 	double timeEndReal;		// End of last archive
+
+	bool concurrent;		// Fetch contexts in parallel
+	int deadline;			// Per-context fetch deadline (msec)
+	QThreadPool *fetchPool;		// Threads issuing pmFetch calls
+	QVector<QmcFetchState*> fetchStates;	// Per-context fetch state
+	QMutex fetchLock;		// Guards fetchStates contents
+	QWaitCondition fetchDone;	// Signalled as each fetch completes
     } my;
 
     // Timezone for localhost from environment
@@ -103,6 +124,7 @@ private:
     static QString localHost;	// name of localhost
 
     int useContext();
+    void fetchConcurrent(bool update);
 };
 
 #endif	// QMC_GROUP_H
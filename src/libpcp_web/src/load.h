@@ -19,8 +19,6 @@
 
 #ifdef HAVE_LIBUV
 #include <uv.h>
-#else
-typedef void *uv_timer_t;
 #endif
 
 typedef struct seriesname {
@@ -45,7 +43,8 @@ typedef struct context {
     unsigned int	updated : 1;	/* context labels are updated */
     unsigned int	padding : 21;	/* zero-filled struct padding */
     unsigned int	timeout;	/* context timeout in milliseconds */
-    uv_timer_t		timer;
+    unsigned int	inuse;		/* count of requests using context */
+    __uint64_t		expires;	/* idle timeout, uv_hrtime nanosec */
     int			context;	/* PMAPI context handle */
     int			randomid;	/* random number identifier */
     struct dict		*pmids;		/* metric pmID to metric struct */
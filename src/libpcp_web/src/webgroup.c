@@ -25,6 +25,7 @@
 
 #define DEFAULT_TIMEOUT 5000
 static unsigned int default_timeout;	/* timeout in milliseconds */
+#define MINIMUM_SWEEP 100		/* shortest context sweep interval */
 
 #define DEFAULT_BATCHSIZE 256
 static unsigned int default_batchsize;	/* for groups of metrics */
@@ -45,16 +46,33 @@ typedef struct webgroups {
     mmv_registry_t	*metrics;
     struct dict		*config;
     uv_loop_t		*events;
+    uv_timer_t		timer;		/* sweeps up timed out contexts */
+    uv_async_t		rescan;		/* new context, sweep sooner */
+    uv_mutex_t		mutex;		/* contexts, context use counts */
+    unsigned int	sweep;		/* msec until the next sweep */
+    unsigned int	handles;	/* loop handles not yet closed */
+    unsigned int	active;		/* sweep timer is initialized */
 } webgroups;
 
 static struct webgroups *
 webgroups_lookup(pmWebGroupModule *module)
 {
-    if (module->privdata == NULL)
-	module->privdata = calloc(1, sizeof(struct webgroups));
+    struct webgroups	*groups;
+
+    if (module->privdata == NULL) {
+	if ((groups = calloc(1, sizeof(struct webgroups))) == NULL)
+	    return NULL;
+	uv_mutex_init(&groups->mutex);
+	module->privdata = groups;
+    }
     return (struct webgroups *)module->privdata;
 }
 
+/*
+ * Contexts are created and used from worker threads (pmproxy runs each
+ * request through the libuv thread pool) but only ever freed here, once
+ * removed from the contexts dictionary and when no request is using it.
+ */
 static void
 webgroup_destroy_context(struct context *context, struct webgroups *groups)
 {
@@ -63,23 +81,94 @@ webgroup_destroy_context(struct context *context, struct webgroups *groups)
     if (pmDebugOptions.http)
 	fprintf(stderr, "freeing context %p\n", context);
 
-    uv_timer_stop(&context->timer);
-    if (groups)
-	dictUnlink(groups->contexts, &context->randomid);
+    if (groups) {
+	uv_mutex_lock(&groups->mutex);
+	dictDelete(groups->contexts, &context->randomid);
+	uv_mutex_unlock(&groups->mutex);
+    }
     pmwebapi_free_context(context);
 }
 
+/*
+ * Drop a request reference on a context - once no requests are using
+ * it, its idle timeout starts.
+ */
+static void
+webgroup_release_context(struct context *cp)
+{
+    struct webgroups	*groups = (struct webgroups *)cp->privdata;
+
+    uv_mutex_lock(&groups->mutex);
+    assert(cp->inuse > 0);
+    if (--cp->inuse == 0)
+	cp->expires = uv_hrtime() + (__uint64_t)cp->timeout * 1000000;
+    uv_mutex_unlock(&groups->mutex);
+}
+
+/*
+ * Periodically, on the event loop thread, free contexts that have not
+ * been used within their timeout.  Contexts are unlinked while holding
+ * the lock, so no worker can find them again, then freed after it.
+ *
+ * The next sweep is due when the first idle context expires, or after
+ * the shortest timeout of any context in use, so contexts with short
+ * timeouts are not kept for the whole default sweep interval.  A new
+ * context with a timeout shorter than that wakes the loop to rescan.
+ */
 static void
-webgroup_timeout_context(uv_timer_t *arg)
+webgroup_timeout_contexts(uv_timer_t *arg)
 {
     uv_handle_t		*handle = (uv_handle_t *)arg;
-    struct context	*cp = (struct context *)handle->data;
-    struct webgroups	*gp = (struct webgroups *)cp->privdata;
+    struct webgroups	*groups = (struct webgroups *)handle->data;
+    struct context	*cp, *expired = NULL;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    __uint64_t		now = uv_hrtime();
+    __uint64_t		wait;
+    unsigned int	sweep;
 
-    if (pmDebugOptions.http)
-	fprintf(stderr, "context %u timed out (%p)\n", cp->randomid, cp);
+    sweep = default_timeout ? default_timeout : DEFAULT_TIMEOUT;
+
+    uv_mutex_lock(&groups->mutex);
+    iterator = dictGetSafeIterator(groups->contexts);
+    while ((entry = dictNext(iterator)) != NULL) {
+	cp = (struct context *)dictGetVal(entry);
+	if (cp->inuse || cp->expires > now) {
+	    if (cp->inuse)
+		wait = cp->timeout;
+	    else
+		wait = (cp->expires - now + 999999) / 1000000;
+	    if (wait < sweep)
+		sweep = (unsigned int)wait;
+	    continue;
+	}
+	if (pmDebugOptions.http)
+	    fprintf(stderr, "context %u timed out (%p)\n", cp->randomid, cp);
+	cp->garbage = 1;
+	dictDelete(groups->contexts, &cp->randomid);
+	cp->privdata = expired;		/* chain for freeing, below */
+	expired = cp;
+    }
+    dictReleaseIterator(iterator);
+    if (sweep < MINIMUM_SWEEP)
+	sweep = MINIMUM_SWEEP;
+    groups->sweep = sweep;
+    uv_mutex_unlock(&groups->mutex);
+
+    uv_timer_start(&groups->timer, webgroup_timeout_contexts, sweep, 0);
+
+    while ((cp = expired) != NULL) {
+	expired = (struct context *)cp->privdata;
+	webgroup_destroy_context(cp, NULL);
+    }
+}
+
+static void
+webgroup_rescan_contexts(uv_async_t *arg)
+{
+    struct webgroups	*groups = (struct webgroups *)arg->data;
 
-    webgroup_destroy_context(cp, gp);
+    webgroup_timeout_contexts(&groups->timer);
 }
 
 static int
@@ -138,7 +227,6 @@ webgroup_new_context(pmWebGroupSettings *sp, dict *params,
     struct webgroups	*groups = webgroups_lookup(&sp->module);
     struct context	*cp;
     unsigned int	polltime = DEFAULT_TIMEOUT;
-    uv_handle_t		*handle;
     pmWebAccess		access;
     double		seconds;
     char		*endptr;
@@ -168,17 +256,16 @@ webgroup_new_context(pmWebGroupSettings *sp, dict *params,
     cp->context = -1;
     cp->timeout = polltime;
 
-    handle = (uv_handle_t *)&cp->timer;
-    handle->data = (void *)cp;
-    uv_timer_init(groups->events, &cp->timer);
-
+    uv_mutex_lock(&groups->mutex);
     if ((cp->randomid = random()) < 0 ||
 	dictFind(groups->contexts, &cp->randomid) != NULL) {
+	uv_mutex_unlock(&groups->mutex);
 	infofmt(*message, "random number failure on new web context");
 	pmwebapi_free_context(cp);
 	*status = -ESRCH;
 	return NULL;
     }
+    uv_mutex_unlock(&groups->mutex);
     cp->origin = sdscatfmt(sdsempty(), "%i", cp->randomid);
     cp->name.sds = sdsdup(hostspec ? hostspec : LOCALHOST);
     cp->realm = sdscatfmt(sdsempty(), "pmapi/%i", cp->randomid);
@@ -207,9 +294,16 @@ webgroup_new_context(pmWebGroupSettings *sp, dict *params,
 	pmwebapi_free_context(cp);
 	return NULL;
     }
-    dictAdd(groups->contexts, &cp->randomid, cp);
     cp->privdata = groups;
     cp->setup = 1;
+    cp->inuse = 1;
+    uv_mutex_lock(&groups->mutex);
+    dictAdd(groups->contexts, &cp->randomid, cp);
+    if (groups->active && cp->timeout < groups->sweep) {
+	groups->sweep = cp->timeout;	/* one wakeup is enough */
+	uv_async_send(&groups->rescan);
+    }
+    uv_mutex_unlock(&groups->mutex);
     return cp;
 }
 
@@ -220,17 +314,15 @@ webgroup_use_context(struct context *cp, int *status, sds *message, void *arg)
     int			sts;
 
     if (pmDebugOptions.http)
-	fprintf(stderr, "context %u timer set (%p) to %u msec\n",
+	fprintf(stderr, "context %u in use (%p), timeout %u msec\n",
 			cp->randomid, cp, cp->timeout);
 
-    /* if already started, uv_timer_start updates the timer */
-    uv_timer_start(&cp->timer, webgroup_timeout_context, cp->timeout, 0);
-
     if (cp->setup == 0) {
 	if ((sts = pmReconnectContext(cp->context)) < 0) {
 	    infofmt(*message, "cannot reconnect context: %s",
 			pmErrStr_r(sts, errbuf, sizeof(errbuf)));
 	    *status = sts;
+	    webgroup_release_context(cp);
 	    return NULL;
 	}
 	cp->setup = 1;
@@ -240,6 +332,7 @@ webgroup_use_context(struct context *cp, int *status, sds *message, void *arg)
 	infofmt(*message, "cannot use existing context: %s",
 			pmErrStr_r(sts, errbuf, sizeof(errbuf)));
 	*status = sts;
+	webgroup_release_context(cp);
 	return NULL;
     }
 
@@ -266,23 +359,31 @@ webgroup_lookup_context(pmWebGroupSettings *sp, sds *id, dict *params,
 	    *status = -EINVAL;
 	    return NULL;
 	}
+	uv_mutex_lock(&groups->mutex);
 	cp = (struct context *)dictFetchValue(groups->contexts, &key);
 	if (cp == NULL) {
+	    uv_mutex_unlock(&groups->mutex);
 	    infofmt(*message, "unknown context identifier: %u", key);
 	    *status = -ENOTCONN;
 	    return NULL;
 	}
 	if (cp->garbage) {
+	    uv_mutex_unlock(&groups->mutex);
 	    infofmt(*message, "expired context identifier: %u", key);
 	    *status = -ENOTCONN;
 	    return NULL;
 	}
+	cp->inuse++;	/* hold off the timeout sweep until released */
+	uv_mutex_unlock(&groups->mutex);
+
 	access.username = cp->username;
 	access.password = cp->password;
 	access.realm = cp->realm;
 	if (sp->callbacks.on_check &&
-	    sp->callbacks.on_check(*id, &access, status, message, arg) < 0)
+	    sp->callbacks.on_check(*id, &access, status, message, arg) < 0) {
+	    webgroup_release_context(cp);
 	    return NULL;
+	}
     }
 
     return webgroup_use_context(cp, status, message, arg);
@@ -291,7 +392,7 @@ webgroup_lookup_context(pmWebGroupSettings *sp, sds *id, dict *params,
 int
 pmWebGroupContext(pmWebGroupSettings *sp, sds id, dict *params, void *arg)
 {
-    struct context	*cp;
+    struct context	*cp = NULL;
     pmWebSource		context;
     sds			msg = NULL;
     int			sts = 0;
@@ -313,6 +414,8 @@ pmWebGroupContext(pmWebGroupSettings *sp, sds id, dict *params, void *arg)
     }
 
     sp->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
     return sts;
 }
@@ -708,7 +811,7 @@ webgroup_fetch_pmids(pmWebGroupSettings *settings, context_t *cp, int fail,
 void
 pmWebGroupFetch(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
-    struct context	*cp;
+    struct context	*cp = NULL;
     struct metric	**mplist = NULL;
     size_t		length;
     pmID		*pmidlist = NULL;
@@ -781,6 +884,8 @@ pmWebGroupFetch(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 
 done:
     settings->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
 }
 
@@ -969,7 +1074,7 @@ profile:
 extern void
 pmWebGroupProfile(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
-    struct context	*cp;
+    struct context	*cp = NULL;
     struct metric	*mp;
     struct indom	*ip;
     enum profile	profile = PROFILE_DEL;
@@ -1048,13 +1153,15 @@ pmWebGroupProfile(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 
 done:
     settings->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
 }
 
 void
 pmWebGroupChildren(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
-    struct context	*cp;
+    struct context	*cp = NULL;
     pmWebChildren	children = {0};
     char		errmsg[PM_MAXERRMSGLEN];
     char		**offspring;
@@ -1122,6 +1229,8 @@ pmWebGroupChildren(pmWebGroupSettings *settings, sds id, dict *params, void *arg
 
 done:
     settings->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
 }
 
@@ -1172,7 +1281,7 @@ webgroup_instances(pmWebGroupSettings *settings,
 void
 pmWebGroupInDom(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
-    struct context	*cp;
+    struct context	*cp = NULL;
     struct domain	*dp;
     struct metric	*mp;
     struct indom	*ip;
@@ -1272,6 +1381,8 @@ pmWebGroupInDom(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 
 done:
     settings->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
 }
 
@@ -1362,7 +1473,7 @@ void
 pmWebGroupMetric(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
     struct weblookup	lookup = {0};
-    struct context	*cp;
+    struct context	*cp = NULL;
     pmWebMetric		*metric = &lookup.metric;
     size_t		length;
     char		errmsg[PM_MAXERRMSGLEN];
@@ -1437,6 +1548,8 @@ pmWebGroupMetric(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 done:
     sdsfreesplitres(names, numnames);
     settings->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
 }
 
@@ -1713,7 +1826,7 @@ void
 pmWebGroupScrape(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
     struct webscrape	scrape = {0};
-    struct context	*cp;
+    struct context	*cp = NULL;
     size_t		length;
     int			sts = 0, i, numnames = 0;
     sds			msg = NULL, *names = NULL, metrics;
@@ -1756,6 +1869,8 @@ pmWebGroupScrape(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 
 done:
     settings->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
 }
 
@@ -1924,7 +2039,7 @@ webgroup_store(struct context *context, struct metric *metric,
 void
 pmWebGroupStore(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
-    struct context	*cp;
+    struct context	*cp = NULL;
     struct metric	*mp;
     size_t		length;
     char		err[PM_MAXERRMSGLEN];
@@ -1992,6 +2107,8 @@ pmWebGroupStore(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 
 done:
     settings->callbacks.on_done(id, sts, msg, arg);
+    if (cp)
+	webgroup_release_context(cp);
     sdsfree(msg);
 }
 
@@ -2046,9 +2163,28 @@ int
 pmWebGroupSetEventLoop(pmWebGroupModule *module, void *events)
 {
     struct webgroups	*webgroups = webgroups_lookup(module);
+    uv_handle_t		*handle;
 
     if (webgroups) {
 	webgroups->events = (uv_loop_t *)events;
+
+	/* one timer, on the loop thread, for all context timeouts */
+	handle = (uv_handle_t *)&webgroups->timer;
+	handle->data = (void *)webgroups;
+	uv_timer_init(webgroups->events, &webgroups->timer);
+	uv_unref(handle);	/* do not hold the loop open for this */
+	handle = (uv_handle_t *)&webgroups->rescan;
+	handle->data = (void *)webgroups;
+	uv_async_init(webgroups->events, &webgroups->rescan,
+			webgroup_rescan_contexts);
+	uv_unref(handle);
+	webgroups->handles = 2;
+	uv_mutex_lock(&webgroups->mutex);
+	webgroups->sweep = DEFAULT_TIMEOUT;
+	uv_mutex_unlock(&webgroups->mutex);
+	uv_timer_start(&webgroups->timer, webgroup_timeout_contexts,
+			DEFAULT_TIMEOUT, 0);
+	webgroups->active = 1;
 	return 0;
     }
     return -ENOMEM;
@@ -2078,6 +2214,8 @@ pmWebGroupSetConfiguration(pmWebGroupModule *module, dict *config)
     }
 
     if (webgroups) {
+	if (webgroups->active && default_timeout > 0)
+	    webgroup_timeout_contexts(&webgroups->timer);
 	webgroups->config = config;
 	return 0;
     }
@@ -2096,6 +2234,18 @@ pmWebGroupSetMetricRegistry(pmWebGroupModule *module, mmv_registry_t *registry)
     return -ENOMEM;
 }
 
+static void
+webgroup_free_groups(uv_handle_t *handle)
+{
+    struct webgroups	*groups = (struct webgroups *)handle->data;
+
+    if (groups->handles > 0 && --groups->handles > 0)
+	return;		/* wait for the last loop handle to close */
+    uv_mutex_destroy(&groups->mutex);
+    memset(groups, 0, sizeof(struct webgroups));
+    free(groups);
+}
+
 void
 pmWebGroupClose(pmWebGroupModule *module)
 {
@@ -2110,8 +2260,16 @@ pmWebGroupClose(pmWebGroupModule *module)
 	    webgroup_destroy_context((context_t *)dictGetVal(entry), NULL);
 	dictReleaseIterator(iterator);
 	dictRelease(groups->contexts);
-	memset(groups, 0, sizeof(struct webgroups));
-	free(groups);
+	groups->contexts = NULL;
+	module->privdata = NULL;
+	if (groups->active) {
+	    uv_timer_stop(&groups->timer);
+	    uv_close((uv_handle_t *)&groups->timer, webgroup_free_groups);
+	    uv_close((uv_handle_t *)&groups->rescan, webgroup_free_groups);
+	} else {
+	    groups->timer.data = (void *)groups;
+	    webgroup_free_groups((uv_handle_t *)&groups->timer);
+	}
     }
 
     sdsfree(PARAM_HOSTNAME);
@@ -33,9 +33,12 @@ NotifyEndContext(int ctx)
 {
     int i;
 
+    /*
+     * A daemon agent that is busy with a (pipelined) fetch reads this
+     * after sending its result, and no response is expected.
+     */
     for (i = 0; i < nAgents; i++) {
-	if (!agent[i].status.connected ||
-	    agent[i].status.busy || agent[i].status.notReady)
+	if (!agent[i].status.connected || agent[i].status.notReady)
 	    continue;
 	if (agent[i].ipcType == AGENT_DSO) {
 	    pmdaInterface	*dp = &agent[i].ipc.dso.dispatch;
@@ -116,6 +119,7 @@ AcceptNewClient(int reqfd)
     client[i].status.connected = 1;
     client[i].status.attributes = 0;
     client[i].status.changes = 0;
+    client[i].status.fetching = 0;
     memset(&client[i].attrs, 0, sizeof(__pmHashCtl));
 
     /*
@@ -223,6 +227,7 @@ DeleteClient(ClientInfo *cp)
     cp->status.connected = 0;
     cp->status.attributes = 0;
     cp->status.changes = 0;
+    cp->status.fetching = 0;	/* any fetch in progress is discarded */
     cp->fd = -1;
 
     NotifyEndContext(cp-client);
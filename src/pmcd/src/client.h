@@ -22,6 +22,7 @@ typedef struct {
 	unsigned int	connected : 1;	/* Client connected */
 	unsigned int	changes : 6;	/* PMCD_* bits for changes since last fetch */
 	unsigned int	attributes: 1;	/* Connection attributes have changed */
+	unsigned int	fetching : 1;	/* Pipelined fetch in progress (-a) */
     } status;
     /* There is a profile associated with each client context.
      * The context slot number (not the context number) sent with each
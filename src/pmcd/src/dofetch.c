@@ -354,6 +354,761 @@ ExtractState(pmResult *result)
     return (int)byte;
 }
 
+/*
+ * Note completion of the current fetch for an agent, and later fold
+ * its latency into the agent's pmcd.agent.fetch.* statistics.
+ */
+static void
+FetchDone(AgentInfo *ap)
+{
+    struct timeval	now;
+
+    pmtimevalNow(&now);
+    ap->fetchUsec = (__uint64_t)(pmtimevalSub(&now, &ap->fetchStart) * 1000000);
+}
+
+static void
+UpdateFetchStats(AgentInfo *ap)
+{
+    FetchStats		*fsp = &ap->fetchStats;
+    __uint64_t		bound = 100;
+    int			i;
+
+    for (i = 0; i < FETCH_NBUCKETS - 1; i++, bound *= 10) {
+	if (ap->fetchUsec <= bound)
+	    break;
+    }
+    fsp->hist[i]++;
+    fsp->usec += ap->fetchUsec;
+    fsp->count++;
+}
+
+/*
+ * Read an agent's reply to a fetch request for the pmIDs in dp.  On
+ * error a pmResult with no values is made, and the caller decides
+ * whether the agent must be cleaned up.
+ */
+static int
+RecvFetch(AgentInfo *ap, DomPmidList *dp, pmResult **resp)
+{
+    __pmPDU		*pb;
+    int			pinpdu;
+    int			sts;
+    int			k;
+
+    pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
+    FetchDone(ap);
+    if (sts > 0)
+	pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
+    if (sts == PDU_RESULT) {
+	if ((sts = __pmDecodeResult(pb, resp)) >= 0) {
+	    if ((*resp)->numpmid != dp->listSize) {
+		if (pmDebugOptions.appl0)
+		    pmNotifyErr(LOG_ERR, "DoFetch: \"%s\" agent given %d pmIDs, returned %d\n",
+				 ap->pmDomainLabel, dp->listSize, (*resp)->numpmid);
+		pmFreeResult(*resp);
+		sts = PM_ERR_IPC;
+	    }
+	}
+    }
+    else {
+	if (sts == PDU_ERROR) {
+	    int s;
+	    if ((s = __pmDecodeError(pb, &sts)) < 0)
+		sts = s;
+	    else if (sts >= 0)
+		sts = PM_ERR_GENERIC;
+	    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_RESULT, sts);
+	}
+	else if (sts >= 0) {
+	    pmcd_trace(TR_WRONG_PDU, ap->outFd, PDU_RESULT, sts);
+	    sts = PM_ERR_IPC;
+	}
+    }
+    if (pinpdu > 0)
+	__pmUnpinPDUBuf(pb);
+
+    if (sts < 0) {
+	*resp = MakeBadResult(dp->listSize, dp->list, sts);
+
+	if (sts == PM_ERR_PMDANOTREADY) {
+	    /* the agent is indicating it can't handle PDUs for now */
+	    extern int CheckError(AgentInfo *ap, int sts);
+
+	    for (k = 0; k < dp->listSize; k++)
+		(*resp)->vset[k]->numval = PM_ERR_AGAIN;
+	    sts = CheckError(ap, sts);
+	}
+
+	if (pmDebugOptions.appl0) {
+	    fprintf(stderr, "RESULT error from \"%s\" agent : %s\n",
+		    ap->pmDomainLabel, pmErrStr(sts));
+	}
+    }
+    return sts;
+}
+
+/*
+ * DSO fetch offload (-F).  DSO agents' fetch routines are otherwise
+ * called synchronously from DoFetch, so one expensive DSO delays both
+ * sending requests to and reading replies from the daemon agents.
+ * With offload enabled, DSO fetches are instead queued to a worker
+ * thread once the daemon agents have their requests, and run while
+ * pmcd waits for the daemon agents to respond.
+ *
+ * DSOs are still called one at a time (libpcp_pmda is not thread-safe)
+ * and only from within DoFetch, which waits for all of them before it
+ * returns - so outside DoFetch the main thread has exclusive use of the
+ * DSOs and agent table, as before.  Completed jobs are handed back over
+ * a pipe that DoFetch select()s on along with the daemon agent fds.
+ */
+int		pmcd_dso_offload;
+static int	dsopipe[2] = { -1, -1 };
+
+typedef struct DsoJob {
+    struct DsoJob	*next;
+    DomPmidList		*dpList;
+    AgentInfo		*aPtr;
+    ClientInfo		*cPtr;
+    int			ctxnum;
+    pmResult		*result;
+} DsoJob;
+
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	dsolock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	dsowake = PTHREAD_COND_INITIALIZER;
+static DsoJob		*dsohead;
+static DsoJob		*dsotail;
+
+static void *
+DsoFetchThread(void *arg)
+{
+    DsoJob		*job;
+
+    (void)arg;
+    for ( ; ; ) {
+	pthread_mutex_lock(&dsolock);
+	while ((job = dsohead) == NULL)
+	    pthread_cond_wait(&dsowake, &dsolock);
+	if ((dsohead = job->next) == NULL)
+	    dsotail = NULL;
+	pthread_mutex_unlock(&dsolock);
+
+	pmtimevalNow(&job->aPtr->fetchStart);
+	job->result = SendFetch(job->dpList, job->aPtr, job->cPtr, job->ctxnum);
+	FetchDone(job->aPtr);
+
+	if (write(dsopipe[1], &job, sizeof(job)) != sizeof(job)) {
+	    pmNotifyErr(LOG_ERR, "DsoFetchThread: write: %s\n", osstrerror());
+	    exit(1);
+	}
+    }
+    return NULL;
+}
+
+int
+StartDsoFetchThread(void)
+{
+    pthread_t		tid;
+    sigset_t		mask, omask;
+    int			sts;
+
+    if (pipe(dsopipe) < 0) {
+	sts = -oserror();
+	fprintf(stderr, "StartDsoFetchThread: pipe: %s\n", pmErrStr(sts));
+	return sts;
+    }
+    pmcd_openfds_sethi(dsopipe[0] > dsopipe[1] ? dsopipe[0] : dsopipe[1]);
+
+    /*
+     * Signals must be taken on the main thread, where they interrupt
+     * select() in ClientLoop; faults are reported on the faulting thread.
+     */
+    sigfillset(&mask);
+    sigdelset(&mask, SIGSEGV);
+    sigdelset(&mask, SIGBUS);
+    pthread_sigmask(SIG_BLOCK, &mask, &omask);
+    sts = pthread_create(&tid, NULL, DsoFetchThread, NULL);
+    pthread_sigmask(SIG_SETMASK, &omask, NULL);
+    if (sts != 0) {
+	fprintf(stderr, "StartDsoFetchThread: pthread_create: %s\n",
+		pmErrStr(-sts));
+	close(dsopipe[0]);
+	close(dsopipe[1]);
+	dsopipe[0] = dsopipe[1] = -1;
+	return -sts;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+static void
+QueueDsoFetch(DsoJob *job)
+{
+    pthread_mutex_lock(&dsolock);
+    job->next = NULL;
+    if (dsotail != NULL)
+	dsotail->next = job;
+    else
+	dsohead = job;
+    dsotail = job;
+    pthread_cond_signal(&dsowake);
+    pthread_mutex_unlock(&dsolock);
+}
+#else
+int
+StartDsoFetchThread(void)
+{
+    fprintf(stderr, "StartDsoFetchThread: no thread support, DSO fetch offload disabled\n");
+    return PM_ERR_NYI;
+}
+
+static void
+QueueDsoFetch(DsoJob *job)
+{
+    (void)job;	/* not reached, -F is rejected without thread support */
+}
+#endif
+
+/*
+ * Collect completed DSO fetches from the worker, blocking until at
+ * least one is available.  Returns the number collected.
+ */
+static int
+ReapDsoFetches(int nDso, pmResult **results, unsigned int *changes)
+{
+    DsoJob		*done[16];
+    ssize_t		bytes;
+    int			i, n, want;
+
+    want = nDso < 16 ? nDso : 16;
+    while ((bytes = read(dsopipe[0], done, want * sizeof(done[0]))) < 0) {
+	if (oserror() == EINTR)
+	    continue;
+	pmNotifyErr(LOG_ERR, "ReapDsoFetches: read: %s\n", osstrerror());
+	Shutdown();
+	exit(1);
+    }
+    n = (int)(bytes / sizeof(done[0]));
+    for (i = 0; i < n; i++) {
+	results[done[i]->aPtr - agent] = done[i]->result;
+	*changes |= ExtractState(done[i]->result);
+    }
+    return n;
+}
+
+/*
+ * pmFreeResult() all the accumulated results of a fetch.
+ */
+static void
+FreeFetchResults(DomPmidList *dList, pmResult **results)
+{
+    int			i, j;
+
+    for (i = 0; dList[i].domain != -1; i++) {
+	j = mapdom[dList[i].domain];
+	if (results[j] == NULL)
+	    continue;
+	if (agent[j].ipcType == AGENT_DSO && agent[j].status.connected &&
+	    !agent[j].status.madeDsoResult)
+	    /* Living DSO's manage their own pmResult skeleton unless
+	     * MakeBadResult was called to create the result.  The value sets
+	     * within the skeleton need to be freed though!
+	     */
+	    __pmFreeResultValues(results[j]);
+	else
+	    /* For others it is dynamically allocated in __pmDecodeResult or
+	     * MakeBadResult
+	     */
+	    pmFreeResult(results[j]);
+    }
+    if (results[nAgents] != NULL)
+	pmFreeResult(results[nAgents]);
+}
+
+/*
+ * Assemble the per-agent results of a fetch into a single pmResult in
+ * the order of the client's pmIDs, send it to the client, and free the
+ * per-agent results.  Returns the status of sending to the client.
+ */
+static int
+FinishFetch(ClientInfo *cip, int nPmids, pmID *pmidList, DomPmidList *dList,
+	    pmResult **results, unsigned int changes)
+{
+    static pmResult	*endResult = NULL;
+    static int		maxnpmids = 0;	/* sizes endResult */
+    static int		*resIndex = NULL;
+    static int		nDoms = 0;
+    int			i, j;
+    int			sts;
+
+    if (nAgents > nDoms) {
+	if (resIndex != NULL)
+	    free(resIndex);
+	resIndex = (int *)malloc((nAgents + 1) * sizeof(int));
+	if (resIndex == NULL) {
+	    pmNoMem("FinishFetch.resIndex", (nAgents + 1) * sizeof(int), PM_FATAL_ERR);
+	}
+	nDoms = nAgents;
+    }
+    if (nPmids > maxnpmids) {
+	int		need;
+	if (endResult != NULL)
+	    free(endResult);
+	need = (int)sizeof(pmResult) + (nPmids - 1) * (int)sizeof(pmValueSet *);
+	if ((endResult = (pmResult *)malloc(need)) == NULL) {
+	    pmNoMem("FinishFetch.endResult", need, PM_FATAL_ERR);
+	}
+	maxnpmids = nPmids;
+    }
+
+    if (changes)
+	MarkStateChanges(changes);
+
+    endResult->numpmid = nPmids;
+    pmtimevalNow(&endResult->timestamp);
+    /* The order of the pmIDs in the per-domain results is the same as in the
+     * original request, but on a per-domain basis.  resIndex is an array of
+     * indices (one per agent) of the next metric to be retrieved from each
+     * per-domain result's vset.
+     */
+    memset(resIndex, 0, (nAgents + 1) * sizeof(resIndex[0]));
+
+    for (i = 0; i < nPmids; i++) {
+	j = mapdom[((__pmID_int *)&pmidList[i])->domain];
+	endResult->vset[i] = results[j]->vset[resIndex[j]++];
+    }
+    pmcd_trace(TR_XMIT_PDU, cip->fd, PDU_RESULT, endResult->numpmid);
+
+    sts = 0;
+    if (cip->status.changes) {
+	/* notify client of PMCD state change */
+	sts = __pmSendError(cip->fd, FROM_ANON, (int)cip->status.changes);
+	if (sts > 0)
+	    sts = 0;
+	cip->status.changes = 0;
+    }
+    if (sts == 0)
+	sts = __pmSendResult(cip->fd, FROM_ANON, endResult);
+
+    if (sts < 0)
+	pmcd_trace(TR_XMIT_ERR, cip->fd, PDU_RESULT, sts);
+
+    FreeFetchResults(dList, results);
+    return sts;
+}
+
+/*
+ * Pipelined fetches (-a).  Otherwise DoFetch waits for all the agents
+ * involved in a fetch before any other client is serviced, so one slow
+ * daemon PMDA holds up every client, even those fetching only from
+ * other PMDAs.  When pipelining, each fetch is still split by agent,
+ * but each daemon agent works through its own FIFO of requests from
+ * different clients, and ClientLoop select()s on the busy agents along
+ * with the clients.  A fetch completes, and the client is sent its
+ * result, once the last of its daemon agents has replied.
+ *
+ * An agent has at most one request outstanding and a client is not
+ * read from while its fetch is in progress, so the PDU exchanges with
+ * each agent and the order of replies to each client are unchanged.
+ * DSO agents are called last, just before the result is sent, because
+ * a DSO may reuse its pmResult for its next fetch.  Other requests to
+ * a daemon agent first wait for it to finish any fetch in progress
+ * (WaitForAgent), while stores and changes to the agent table wait for
+ * all fetches to complete (DrainFetches).
+ */
+int		pmcd_async_fetch;
+
+typedef struct FetchReq FetchReq;
+
+typedef struct FetchSlot {
+    struct FetchSlot	*next;		/* Next request waiting for agent */
+    FetchReq		*req;		/* Fetch this is a part of */
+    DomPmidList		*dp;		/* pmIDs for this agent */
+    int			agent;		/* Index into agent[] */
+} FetchSlot;
+
+struct FetchReq {
+    int			client;		/* Index into client[] */
+    unsigned int	seq;		/* client[].seq when fetch arrived */
+    int			ctxnum;
+    int			nPmids;
+    pmID		*pmidList;	/* In the (pinned) fetch PDU buffer */
+    DomPmidList		*dList;		/* Copy of SplitPmidList() result */
+    pmResult		**results;	/* Per-agent results, as in DoFetch */
+    FetchSlot		*slots;		/* One per dList entry */
+    int			pending;	/* Daemon agents yet to respond */
+    unsigned int	changes;	/* State changes from agents */
+};
+
+typedef struct {
+    FetchSlot		*active;	/* Request sent to agent */
+    FetchSlot		*head;		/* Requests waiting for agent */
+    FetchSlot		*tail;
+    struct timeval	deadline;	/* When active request times out */
+    int			hold;		/* Do not send more requests yet */
+} FetchQueue;
+
+static FetchQueue	*fetchq;	/* Indexed by agent */
+static int		nFetchq;
+static int		nInFlight;	/* Fetches in progress */
+static int		nHeld;		/* Agents held by WaitForAgent */
+
+/*
+ * The client slot may have been freed, and even reused by another
+ * client, since this fetch arrived.
+ */
+static int
+ClientWaiting(FetchReq *rp)
+{
+    ClientInfo		*cip = &client[rp->client];
+
+    return cip->status.connected && cip->seq == rp->seq;
+}
+
+static void
+CompleteFetch(FetchReq *rp)
+{
+    ClientInfo		*cip = &client[rp->client];
+    AgentInfo		*ap;
+    int			i, j;
+    int			sts = 0;
+
+    nInFlight--;
+    if (ClientWaiting(rp)) {
+	for (i = 0; rp->dList[i].domain != -1; i++) {
+	    j = rp->slots[i].agent;
+	    ap = &agent[j];
+	    if (ap->ipcType != AGENT_DSO)
+		continue;
+	    pmtimevalNow(&ap->fetchStart);
+	    rp->results[j] = SendFetch(&rp->dList[i], ap, cip, rp->ctxnum);
+	    FetchDone(ap);
+	    UpdateFetchStats(ap);
+	    rp->changes |= ExtractState(rp->results[j]);
+	}
+	cip->status.fetching = 0;
+	sts = FinishFetch(cip, rp->nPmids, rp->pmidList, rp->dList,
+			  rp->results, rp->changes);
+    }
+    else
+	FreeFetchResults(rp->dList, rp->results);
+
+    __pmUnpinPDUBuf(rp->pmidList);
+    free(rp);
+    if (sts < 0)
+	CleanupClient(cip, sts);
+}
+
+static void
+SlotDone(FetchSlot *sp, pmResult *result)
+{
+    FetchReq		*rp = sp->req;
+
+    rp->results[sp->agent] = result;
+    rp->changes |= ExtractState(result);
+    if (--rp->pending == 0)
+	CompleteFetch(rp);
+}
+
+/* Send a request to an idle agent, or complete it if that fails */
+static void
+DispatchFetch(FetchSlot *sp)
+{
+    FetchReq		*rp = sp->req;
+    AgentInfo		*ap = &agent[sp->agent];
+    FetchQueue		*fq = &fetchq[sp->agent];
+    pmResult		*result;
+
+    pmtimevalNow(&ap->fetchStart);
+    if (ap->status.connected)
+	result = SendFetch(sp->dp, ap, &client[rp->client], rp->ctxnum);
+    else
+	result = MakeBadResult(sp->dp->listSize, sp->dp->list, PM_ERR_NOAGENT);
+    if (result == NULL) {	/* wait for agent's response */
+	ap->status.busy = 1;
+	fq->active = sp;
+	fq->deadline = ap->fetchStart;
+	fq->deadline.tv_sec += pmcd_timeout;
+	return;
+    }
+    FetchDone(ap);
+    UpdateFetchStats(ap);
+    SlotDone(sp, result);
+}
+
+static void
+NextFetch(int j)
+{
+    FetchQueue		*fq = &fetchq[j];
+    FetchSlot		*sp;
+
+    while (fq->active == NULL && !fq->hold && (sp = fq->head) != NULL) {
+	if ((fq->head = sp->next) == NULL)
+	    fq->tail = NULL;
+	agent[j].fetchQueued--;
+	if (!ClientWaiting(sp->req)) {
+	    /* client went away while this was queued, spare the agent */
+	    SlotDone(sp, MakeBadResult(sp->dp->listSize, sp->dp->list,
+				       PM_ERR_NOTCONN));
+	    continue;
+	}
+	DispatchFetch(sp);
+    }
+}
+
+static void
+QueueFetch(ClientInfo *cip, int ctxnum, int nPmids, pmID *pmidList)
+{
+    DomPmidList		*dList;
+    FetchReq		*rp;
+    FetchSlot		*sp;
+    FetchQueue		*fq;
+    size_t		lsize, need;
+    int			i, j, nDoms;
+
+    if (nAgents > nFetchq) {
+	need = nAgents * sizeof(FetchQueue);
+	if ((fetchq = (FetchQueue *)realloc(fetchq, need)) == NULL) {
+	    pmNoMem("QueueFetch.fetchq", need, PM_FATAL_ERR);
+	}
+	memset(&fetchq[nFetchq], 0, (nAgents - nFetchq) * sizeof(FetchQueue));
+	nFetchq = nAgents;
+    }
+
+    /* One heap block for the request, its results, slots and pmID lists */
+    dList = SplitPmidList(nPmids, pmidList);
+    for (nDoms = 0; dList[nDoms].domain != -1; nDoms++)
+	;
+    lsize = (nDoms + 1) * sizeof(DomPmidList) + nPmids * sizeof(pmID);
+    need = sizeof(FetchReq) + (nAgents + 1) * sizeof(pmResult *) +
+	   nDoms * sizeof(FetchSlot) + lsize;
+    if ((rp = (FetchReq *)calloc(1, need)) == NULL) {
+	pmNoMem("QueueFetch.req", need, PM_FATAL_ERR);
+    }
+    rp->results = (pmResult **)&rp[1];
+    rp->slots = (FetchSlot *)&rp->results[nAgents + 1];
+    rp->dList = (DomPmidList *)&rp->slots[nDoms];
+    memcpy(rp->dList, dList, lsize);
+    for (i = 0; i <= nDoms; i++)
+	rp->dList[i].list = (pmID *)((char *)rp->dList +
+				((char *)dList[i].list - (char *)dList));
+    rp->client = cip - client;
+    rp->seq = cip->seq;
+    rp->ctxnum = ctxnum;
+    rp->nPmids = nPmids;
+    rp->pmidList = pmidList;
+    if (rp->dList[nDoms].listSize != 0)
+	rp->results[nAgents] = MakeBadResult(rp->dList[nDoms].listSize,
+				rp->dList[nDoms].list, PM_ERR_NOAGENT);
+
+    cip->status.fetching = 1;
+    nInFlight++;
+    rp->pending = 1;		/* hold completion until all are queued */
+    for (i = 0; i < nDoms; i++) {
+	sp = &rp->slots[i];
+	sp->req = rp;
+	sp->dp = &rp->dList[i];
+	sp->agent = j = mapdom[sp->dp->domain];
+	if (agent[j].ipcType == AGENT_DSO)
+	    continue;
+	rp->pending++;
+	fq = &fetchq[j];
+	if (fq->active == NULL)
+	    DispatchFetch(sp);
+	else {
+	    if (fq->tail != NULL)
+		fq->tail->next = sp;
+	    else
+		fq->head = sp;
+	    fq->tail = sp;
+	    agent[j].fetchQueued++;
+	}
+    }
+    if (--rp->pending == 0)
+	CompleteFetch(rp);
+}
+
+/*
+ * Collect responses from agents that have them ready, and time out
+ * those that have taken too long (readyFds is NULL after a select
+ * timeout).
+ */
+static void
+PollFetches(__pmFdSet *readyFds)
+{
+    struct timeval	now;
+    FetchSlot		*sp;
+    AgentInfo		*ap;
+    pmResult		*result;
+    int			i, sts;
+
+    pmtimevalNow(&now);
+    for (i = 0; i < nAgents; i++) {
+	if ((sp = fetchq[i].active) == NULL)
+	    continue;
+	ap = &agent[i];
+	if (!ap->status.connected) {
+	    /* agent exited and has been cleaned up already */
+	    FetchDone(ap);
+	    result = MakeBadResult(sp->dp->listSize, sp->dp->list,
+				   PM_ERR_NOAGENT);
+	}
+	else if (readyFds != NULL && __pmFD_ISSET(ap->outFd, readyFds)) {
+	    ap->status.busy = 0;
+	    sts = RecvFetch(ap, sp->dp, &result);
+	    if (sts == PM_ERR_IPC || sts == PM_ERR_TIMEOUT)
+		CleanupAgent(ap, AT_COMM, ap->outFd);
+	}
+	else if (pmtimevalSub(&fetchq[i].deadline, &now) <= 0) {
+	    pmNotifyErr(LOG_INFO, "PollFetches: \"%s\" agent timeout",
+			ap->pmDomainLabel);
+	    FetchDone(ap);
+	    result = MakeBadResult(sp->dp->listSize, sp->dp->list,
+				   PM_ERR_NOAGENT);
+	    pmcd_trace(TR_RECV_TIMEOUT, ap->outFd, PDU_RESULT, 0);
+	    CleanupAgent(ap, AT_COMM, ap->inFd);
+	}
+	else
+	    continue;
+
+	fetchq[i].active = NULL;
+	UpdateFetchStats(ap);
+	SlotDone(sp, result);
+	NextFetch(i);
+    }
+}
+
+/*
+ * Add the agents with fetches in progress to the set of descriptors
+ * ClientLoop waits on, and remove the clients waiting for them.  The
+ * select timeout is set for the earliest agent timeout.
+ */
+int
+AddFetchFds(__pmFdSet *fds, int maxFd, struct timeval **timeout)
+{
+    static struct timeval	wait;
+    struct timeval		now;
+    struct timeval		*first = NULL;
+    double			left;
+    int				i, fd;
+
+    if (nInFlight == 0)
+	return maxFd;
+
+    for (i = 0; i < nClients; i++) {
+	if (client[i].status.connected && client[i].status.fetching)
+	    __pmFD_CLR(client[i].fd, fds);
+    }
+    pmtimevalNow(&now);
+    for (i = 0; i < nAgents; i++) {
+	if (fetchq[i].active == NULL)
+	    continue;
+	if (!agent[i].status.connected)
+	    first = &now;
+	else {
+	    fd = agent[i].outFd;
+	    __pmFD_SET(fd, fds);
+	    if (fd >= maxFd)
+		maxFd = fd + 1;
+	}
+	if (first == NULL || pmtimevalSub(&fetchq[i].deadline, first) < 0)
+	    first = &fetchq[i].deadline;
+    }
+    left = first ? pmtimevalSub(first, &now) : 0;
+    pmtimevalFromReal(left > 0 ? left : 0, &wait);
+    *timeout = &wait;
+    return maxFd;
+}
+
+void
+HandleFetchReplies(__pmFdSet *readyFds, int nReady)
+{
+    if (nInFlight > 0)
+	PollFetches(nReady > 0 ? readyFds : NULL);
+}
+
+/*
+ * Process fetch responses until agent j (or, if j is -1, every agent)
+ * is no longer working on a fetch.
+ */
+static void
+WaitFetches(int j)
+{
+    __pmFdSet		readyFds;
+    struct timeval	*timeout;
+    int			maxFd;
+    int			sts;
+
+    while (j < 0 ? nInFlight > 0 : fetchq[j].active != NULL) {
+	__pmFD_ZERO(&readyFds);
+	timeout = NULL;
+	maxFd = AddFetchFds(&readyFds, 0, &timeout);
+	sts = __pmSelectRead(maxFd, &readyFds, timeout);
+	if (sts < 0) {
+	    if (neterror() == EINTR)
+		continue;
+	    /* this is not expected to happen! */
+	    pmNotifyErr(LOG_ERR, "WaitFetches: fatal select failure: %s\n",
+			netstrerror());
+	    Shutdown();
+	    exit(1);
+	}
+	PollFetches(sts > 0 ? &readyFds : NULL);
+    }
+}
+
+/*
+ * Wait for all fetches in progress to complete, leaving the agents
+ * idle (as they would be without pipelining) for other requests.
+ */
+void
+DrainFetches(void)
+{
+    if (nInFlight > 0)
+	WaitFetches(-1);
+}
+
+/*
+ * Before exchanging PDUs with a daemon agent outside of a fetch, wait
+ * for it to complete any fetch it is working on, and hold back any
+ * others queued for it until ResumeFetches is called at the end of
+ * the client request.  Returns PM_ERR_AGAIN if the agent is not able
+ * to handle a request, else 0.
+ */
+int
+WaitForAgent(AgentInfo *ap)
+{
+    int			j = ap - agent;
+
+    if (nInFlight > 0 && j < nFetchq) {
+	if (!fetchq[j].hold) {
+	    fetchq[j].hold = 1;
+	    nHeld++;
+	}
+	WaitFetches(j);
+	if (!ap->status.connected)
+	    return PM_ERR_AGAIN;
+    }
+    return ap->status.notReady ? PM_ERR_AGAIN : 0;
+}
+
+void
+ResumeFetches(void)
+{
+    int			j;
+
+    if (nHeld == 0)
+	return;
+    nHeld = 0;
+    for (j = 0; j < nFetchq; j++) {
+	if (fetchq[j].hold) {
+	    fetchq[j].hold = 0;
+	    NextFetch(j);
+	}
+    }
+}
+
 int
 DoFetch(ClientInfo *cip, __pmPDU* pb)
 {
@@ -364,15 +1119,14 @@ DoFetch(ClientInfo *cip, __pmPDU* pb)
     pmTimeval		when;
     int			nPmids;
     pmID		*pmidList;
-    static pmResult	*endResult = NULL;
-    static int		maxnpmids = 0;	/* sizes endResult */
     DomPmidList		*dList;		/* NOTE: NOT indexed by agent index */
     static int		nDoms = 0;
     static pmResult	**results = NULL;
-    static int		*resIndex = NULL;
+    static DsoJob	*jobs = NULL;
     __pmFdSet		waitFds;
     __pmFdSet		readyFds;
     int			nWait;
+    int			nDso;
     int			maxFd;
     struct timeval	timeout;
     __pmHashCtl		*hcp;
@@ -382,12 +1136,12 @@ DoFetch(ClientInfo *cip, __pmPDU* pb)
     if (nAgents > nDoms) {
 	if (results != NULL)
 	    free(results);
-	if (resIndex != NULL)
-	    free(resIndex);
+	if (jobs != NULL)
+	    free(jobs);
 	results = (pmResult **)malloc((nAgents + 1) * sizeof (pmResult *));
-	resIndex = (int *)malloc((nAgents + 1) * sizeof(int));
-	if (results == NULL || resIndex == NULL) {
-	    pmNoMem("DoFetch.results", (nAgents + 1) * sizeof (pmResult *) + (nAgents + 1) * sizeof(int), PM_FATAL_ERR);
+	jobs = (DsoJob *)malloc(nAgents * sizeof(DsoJob));
+	if (results == NULL || jobs == NULL) {
+	    pmNoMem("DoFetch.results", (nAgents + 1) * sizeof (pmResult *) + nAgents * sizeof(DsoJob), PM_FATAL_ERR);
 	}
 	nDoms = nAgents;
     }
@@ -414,30 +1168,35 @@ DoFetch(ClientInfo *cip, __pmPDU* pb)
 	return PM_ERR_NOPROFILE;
     }
 
-    if (nPmids > maxnpmids) {
-	int		need;
-	if (endResult != NULL)
-	    free(endResult);
-	need = (int)sizeof(pmResult) + (nPmids - 1) * (int)sizeof(pmValueSet *);
-	if ((endResult = (pmResult *)malloc(need)) == NULL) {
-	    pmNoMem("DoFetch.endResult", need, PM_FATAL_ERR);
-	}
-	maxnpmids = nPmids;
+    if (pmcd_async_fetch) {
+	QueueFetch(cip, ctxnum, nPmids, pmidList);
+	return 0;
     }
 
     dList = SplitPmidList(nPmids, pmidList);
 
     /* For each domain in the split pmidList, dispatch the per-domain subset
      * of pmIDs to the appropriate agent.  For DSO agents, the pmResult will
-     * come back immediately.  If a request cannot be sent to an agent, a
-     * suitable pmResult (containing metric not available values) will be
-     * returned.
+     * come back immediately (unless offloaded, in which case the DSOs are
+     * queued once all daemon agents have their requests).  If a request
+     * cannot be sent to an agent, a suitable pmResult (containing metric
+     * not available values) will be returned.
      */
     __pmFD_ZERO(&waitFds);
     nWait = 0;
+    nDso = 0;
     maxFd = -1;
     for (i = 0; dList[i].domain != -1; i++) {
 	j = mapdom[dList[i].domain];
+	if (pmcd_dso_offload && agent[j].ipcType == AGENT_DSO) {
+	    jobs[nDso].dpList = &dList[i];
+	    jobs[nDso].aPtr = &agent[j];
+	    jobs[nDso].cPtr = cip;
+	    jobs[nDso].ctxnum = ctxnum;
+	    nDso++;
+	    continue;
+	}
+	pmtimevalNow(&agent[j].fetchStart);
 	results[j] = SendFetch(&dList[i], &agent[j], cip, ctxnum);
 	if (results[j] == NULL) { /* Wait for agent's response */
 	    int fd = agent[j].outFd;
@@ -447,17 +1206,33 @@ DoFetch(ClientInfo *cip, __pmPDU* pb)
 		maxFd = fd;
 	    nWait++;
 	} else {
+	    FetchDone(&agent[j]);
 	    changes |= ExtractState(results[j]);
 	}
     }
+    if (nDso > 0) {
+	for (i = 0; i < nDso; i++)
+	    QueueDsoFetch(&jobs[i]);
+	__pmFD_SET(dsopipe[0], &waitFds);
+	if (dsopipe[0] > maxFd)
+	    maxFd = dsopipe[0];
+    }
     /* Construct pmResult for bad-pmID list */
     if (dList[i].listSize != 0)
 	results[nAgents] = MakeBadResult(dList[i].listSize, dList[i].list, PM_ERR_NOAGENT);
 
-    /* Wait for results to roll in from agents */
-    while (nWait > 0) {
+    /* Wait for results to roll in from agents (and the DSO worker).
+     * Any outstanding DSO fetches are always collected before agents
+     * are cleaned up, so that never happens while DSO code is running.
+     */
+    while (nWait > 0 || nDso > 0) {
+	if (nWait == 0) {
+	    /* only DSO fetches remain, and these are never timed out */
+	    nDso -= ReapDsoFetches(nDso, results, &changes);
+	    continue;
+	}
         __pmFD_COPY(&readyFds, &waitFds);
-	if (nWait > 1) {
+	if (nWait > 1 || nDso > 0) {
 	    timeout.tv_sec = pmcd_timeout;
 	    timeout.tv_usec = 0;
 
@@ -468,9 +1243,13 @@ DoFetch(ClientInfo *cip, __pmPDU* pb)
 	    if (sts == 0) {
 		pmNotifyErr(LOG_INFO, "DoFetch: select timeout");
 
+		while (nDso > 0)
+		    nDso -= ReapDsoFetches(nDso, results, &changes);
+
 		/* Timeout, terminate agents with undelivered results */
 		for (i = 0; i < nAgents; i++) {
 		    if (agent[i].status.busy) {
+			FetchDone(&agent[i]);
 			/* Find entry in dList for this agent */
 			for (j = 0; dList[j].domain != -1; j++)
 			    if (dList[j].domain == agent[i].pmDomainId)
@@ -495,130 +1274,42 @@ DoFetch(ClientInfo *cip, __pmPDU* pb)
 	    }
 	}
 
+	/* Collect any DSO fetches completed by the worker */
+	if (nDso > 0 && __pmFD_ISSET(dsopipe[0], &readyFds)) {
+	    nDso -= ReapDsoFetches(nDso, results, &changes);
+	    if (nDso == 0)
+		__pmFD_CLR(dsopipe[0], &waitFds);
+	}
+
 	/* Read results from agents that have them ready */
 	for (i = 0; i < nAgents; i++) {
 	    AgentInfo	*ap = &agent[i];
-	    int		pinpdu;
-	    if (!ap->status.busy || !__pmFD_ISSET(ap->outFd, &readyFds))
+	    /* NB: DSO agents are never busy, and may be in use by the worker */
+	    if (ap->ipcType == AGENT_DSO ||
+		!ap->status.busy || !__pmFD_ISSET(ap->outFd, &readyFds))
 		continue;
 	    ap->status.busy = 0;
 	    __pmFD_CLR(ap->outFd, &waitFds);
 	    nWait--;
-	    pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
-	    if (sts > 0)
-		pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
-	    if (sts == PDU_RESULT) {
-		if ((sts = __pmDecodeResult(pb, &results[i])) >= 0) {
-		    if (results[i]->numpmid == aFreq[i]) {
-			changes |= ExtractState(results[i]);
-		    } else {
-			if (pmDebugOptions.appl0)
-			    pmNotifyErr(LOG_ERR, "DoFetch: \"%s\" agent given %d pmIDs, returned %d\n",
-					 ap->pmDomainLabel, aFreq[i], results[i]->numpmid);
-			pmFreeResult(results[i]);
-			sts = PM_ERR_IPC;
-		    }
-		}
-	    }
-	    else {
-		if (sts == PDU_ERROR) {
-		    int s;
-		    if ((s = __pmDecodeError(pb, &sts)) < 0)
-			sts = s;
-		    else if (sts >= 0)
-			sts = PM_ERR_GENERIC;
-		    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_RESULT, sts);
-		}
-		else if (sts >= 0) {
-		    pmcd_trace(TR_WRONG_PDU, ap->outFd, PDU_RESULT, sts);
-		    sts = PM_ERR_IPC;
-		}
-	    }
-	    if (pinpdu > 0)
-		__pmUnpinPDUBuf(pb);
-
-	    if (sts < 0) {
-		/* Find entry in dList for this agent */
-		for (j = 0; dList[j].domain != -1; j++)
-		    if (dList[j].domain == agent[i].pmDomainId)
-			break;
-		results[i] = MakeBadResult(dList[j].listSize,
-					   dList[j].list, sts);
-
-		if (sts == PM_ERR_PMDANOTREADY) {
-		    /* the agent is indicating it can't handle PDUs for now */
-		    int k;
-		    extern int CheckError(AgentInfo *ap, int sts);
-
-		    for (k = 0; k < dList[j].listSize; k++)
-			results[i]->vset[k]->numval = PM_ERR_AGAIN;
-		    sts = CheckError(&agent[i], sts);
-		}
-
-		if (pmDebugOptions.appl0) {
-		    fprintf(stderr, "RESULT error from \"%s\" agent : %s\n",
-			    ap->pmDomainLabel, pmErrStr(sts));
-		}
-		if (sts == PM_ERR_IPC || sts == PM_ERR_TIMEOUT)
-		    CleanupAgent(ap, AT_COMM, ap->outFd);
+	    /* Find entry in dList for this agent */
+	    for (j = 0; dList[j].domain != -1; j++)
+		if (dList[j].domain == ap->pmDomainId)
+		    break;
+	    if ((sts = RecvFetch(ap, &dList[j], &results[i])) >= 0)
+		changes |= ExtractState(results[i]);
+	    else if (sts == PM_ERR_IPC || sts == PM_ERR_TIMEOUT) {
+		while (nDso > 0)
+		    nDso -= ReapDsoFetches(nDso, results, &changes);
+		CleanupAgent(ap, AT_COMM, ap->outFd);
 	    }
 	}
     }
 
-    if (changes)
-	MarkStateChanges(changes);
+    for (i = 0; dList[i].domain != -1; i++)
+	UpdateFetchStats(&agent[mapdom[dList[i].domain]]);
 
-    endResult->numpmid = nPmids;
-    pmtimevalNow(&endResult->timestamp);
-    /* The order of the pmIDs in the per-domain results is the same as in the
-     * original request, but on a per-domain basis.  resIndex is an array of
-     * indices (one per agent) of the next metric to be retrieved from each
-     * per-domain result's vset.
-     */
-    memset(resIndex, 0, (nAgents + 1) * sizeof(resIndex[0]));
-
-    for (i = 0; i < nPmids; i++) {
-	j = mapdom[((__pmID_int *)&pmidList[i])->domain];
-	endResult->vset[i] = results[j]->vset[resIndex[j]++];
-    }
-    pmcd_trace(TR_XMIT_PDU, cip->fd, PDU_RESULT, endResult->numpmid);
-
-    sts = 0;
-    if (cip->status.changes) {
-	/* notify client of PMCD state change */
-	sts = __pmSendError(cip->fd, FROM_ANON, (int)cip->status.changes);
-	if (sts > 0)
-	    sts = 0;
-	cip->status.changes = 0;
-    }
-    if (sts == 0)
-	sts = __pmSendResult(cip->fd, FROM_ANON, endResult);
-
-    if (sts < 0) {
-	pmcd_trace(TR_XMIT_ERR, cip->fd, PDU_RESULT, sts);
+    if ((sts = FinishFetch(cip, nPmids, pmidList, dList, results, changes)) < 0)
 	CleanupClient(cip, sts);
-    }
-
-    /*
-     * pmFreeResult() all the accumulated results.
-     */
-    for (i = 0; dList[i].domain != -1; i++) {
-	j = mapdom[dList[i].domain];
-	if (agent[j].ipcType == AGENT_DSO && agent[j].status.connected &&
-	    !agent[j].status.madeDsoResult)
-	    /* Living DSO's manage their own pmResult skeleton unless
-	     * MakeBadResult was called to create the result.  The value sets
-	     * within the skeleton need to be freed though!
-	     */
-	    __pmFreeResultValues(results[j]);
-	else
-	    /* For others it is dynamically allocated in __pmDecodeResult or
-	     * MakeBadResult
-	     */
-	    pmFreeResult(results[j]);
-    }
-    if (results[nAgents] != NULL)
-	pmFreeResult(results[nAgents]);
     __pmUnpinPDUBuf(pmidList);
     return 0;
 }
@@ -79,7 +79,7 @@ DoText(ClientInfo *cp, __pmPDU* pb)
 					  ap->ipc.dso.dispatch.version.any.ext);
     }
     else {
-	if (ap->status.notReady)
+	if (WaitForAgent(ap) < 0)
 	    return PM_ERR_AGAIN;
 	pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_TEXT_REQ, ident);
 	sts = __pmSendTextReq(ap->inFd, cp - client, ident, type);
@@ -193,7 +193,7 @@ DoDesc(ClientInfo *cp, __pmPDU *pb)
 					ap->ipc.dso.dispatch.version.any.ext);
     }
     else {
-	if (ap->status.notReady)
+	if (WaitForAgent(ap) < 0)
 	    return PM_ERR_AGAIN;
 	pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_DESC_REQ, (int)pmid);
 	sts = __pmSendDescReq(ap->inFd, cp - client, pmid);
@@ -283,7 +283,7 @@ DoInstance(ClientInfo *cp, __pmPDU *pb)
 					ap->ipc.dso.dispatch.version.any.ext);
     }
     else {
-	if (ap->status.notReady) {
+	if (WaitForAgent(ap) < 0) {
 	    if (name != NULL) free(name);
 	    return PM_ERR_AGAIN;
 	}
@@ -506,7 +506,7 @@ DoLabel(ClientInfo *cp, __pmPDU *pb)
 	    nsets = sts;
     }
     else {
-	if (ap->status.notReady)
+	if (WaitForAgent(ap) < 0)
 	    return PM_ERR_AGAIN;
 
 	pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_LABEL_REQ, ident);
@@ -613,7 +613,7 @@ DoPMNSIDs(ClientInfo *cp, __pmPDU *pb)
 	}
 	else {
 	    /* daemon PMDA ... ship request on */
-	    if (ap->status.notReady)
+	    if (WaitForAgent(ap) < 0)
 		return PM_ERR_AGAIN;
 	    pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_PMNS_IDS, 1);
 	    sts = __pmSendIDList(ap->inFd, cp - client, 1, &idlist[0], 0);
@@ -731,7 +731,7 @@ DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
 	    else {
 		/* daemon PMDA ... ship request on */
 		int		fdfail = -1;
-		if (ap->status.notReady)
+		if (WaitForAgent(ap) < 0)
 		    lsts = PM_ERR_AGAIN;
 		else {
 		    pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_PMNS_NAMES, 1);
@@ -864,7 +864,7 @@ DoPMNSChild(ClientInfo *cp, __pmPDU *pb)
 	else {
 	    /* daemon PMDA ... ship request on */
 	    int		fdfail = -1;
-	    if (ap->status.notReady)
+	    if (WaitForAgent(ap) < 0)
 		sts = PM_ERR_AGAIN;
 	    else {
 		pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_PMNS_CHILD, 1);
@@ -1047,7 +1047,7 @@ traverse_dynamic(ClientInfo *cp, char *start, int *num_names, char ***names)
 	    else {
 		/* daemon PMDA ... ship request on */
 		int		fdfail = -1;
-		if (ap->status.notReady)
+		if (WaitForAgent(ap) < 0)
 		    continue;
 		pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_PMNS_TRAVERSE, 1);
 		sts = __pmSendTraversePMNSReq(ap->inFd, cp - client, namelist[0]);
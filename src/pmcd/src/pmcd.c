@@ -102,6 +102,8 @@ static pmLongOptions longopts[] = {
     { "certdb", 1, 'C', "PATH", "path to NSS certificate database" },
     { "passfile", 1, 'P', "PATH", "password file for certificate database access" },
     { "certname", 1, 'M', "NAME", "certificate name to use" },
+    { "dsothread", 0, 'F', 0, "call DSO PMDA fetch routines from a separate thread" },
+    { "pipeline", 0, 'a', 0, "service other clients while fetches are in progress" },
     { "", 1, 'L', "BYTES", "maximum size for PDUs from clients [default 65536]" },
     { "", 1, 'q', "TIME", "PMDA initial negotiation timeout (seconds) [default 3]" },
     { "", 1, 't', "TIME", "PMDA response timeout (seconds) [default 5]" },
@@ -121,7 +123,7 @@ static pmLongOptions longopts[] = {
 
 static pmOptions opts = {
     .flags = PM_OPTFLAG_POSIX,
-    .short_options = "Ac:C:D:fH:i:l:L:M:N:n:p:P:q:Qs:St:T:U:vx:?",
+    .short_options = "aAc:C:D:fFH:i:l:L:M:N:n:p:P:q:Qs:St:T:U:vx:?",
     .long_options = longopts,
 };
 
@@ -141,6 +143,10 @@ ParseOptions(int argc, char *argv[], int *nports)
     while ((c = pmgetopt_r(argc, argv, &opts)) != EOF) {
 	switch (c) {
 
+	    case 'a':	/* pipelined fetches from several clients at once */
+		pmcd_async_fetch = 1;
+		break;
+
 	    case 'A':	/* disable pmcd service advertising */
 		__pmServerClearFeature(PM_SERVER_FEATURE_DISCOVERY);
 		break;
@@ -167,6 +173,11 @@ ParseOptions(int argc, char *argv[], int *nports)
 		run_daemon = 0;
 		break;
 
+	    case 'F':
+		/* offload DSO fetches to a worker thread */
+		pmcd_dso_offload = 1;
+		break;
+
 	    case 'i':
 		/* one (of possibly several) interfaces for client requests */
 		__pmServerAddInterface(opts.optarg);
@@ -285,6 +296,11 @@ ParseOptions(int argc, char *argv[], int *nports)
 	}
     }
 
+    if (pmcd_async_fetch && pmcd_dso_offload) {
+	pmprintf("%s: -a and -F are mutually exclusive\n", pmGetProgname());
+	opts.errors++;
+    }
+
     if (usage || opts.errors || opts.optind < argc) {
 	pmUsageMessage(&opts);
 	if (usage)
@@ -340,6 +356,10 @@ HandleClientInput(__pmFdSet *fdsPtr)
 	if (pmDebugOptions.appl0)
 	    ShowClients(stderr);
 
+	/* stores need all agents idle, see DrainFetches */
+	if (php->type == PDU_RESULT)
+	    DrainFetches();
+
 	switch (php->type) {
 	    case PDU_PROFILE:
 		sts = (cp->denyOps & PMCD_OP_FETCH) ?
@@ -419,6 +439,9 @@ HandleClientInput(__pmFdSet *fdsPtr)
 	if (pinpdu > 0)
 	    __pmUnpinPDUBuf(pb);
 
+	/* Release agents held back from pipelined fetches */
+	ResumeFetches();
+
 	/*
 	 * May need to send connection attributes to interested PMDAs, if
 	 * something changed for this client during this PDU exchange.
@@ -553,6 +576,7 @@ SignalRestart(void)
     time_t	now;
 
     time(&now);
+    DrainFetches();
     pmNotifyErr(LOG_INFO, "\n\npmcd RESTARTED at %s", ctime(&now));
     fprintf(stderr, "\nCurrent PMCD clients ...\n");
     ShowClients(stderr);
@@ -752,6 +776,7 @@ ClientLoop(void)
     int		reload_namespace = 0;
     int		restartAgents = -1;	/* initial state unknown */
     __pmFdSet	readableFds;
+    struct timeval	*timeout;
 
     for (;;) {
 
@@ -781,7 +806,13 @@ ClientLoop(void)
 	    }
 	}
 
-	sts = __pmSelectRead(maxFd, &readableFds, NULL);
+	/* With pipelining, agents may be working on fetches */
+	timeout = NULL;
+	maxFd = AddFetchFds(&readableFds, maxFd, &timeout);
+
+	sts = __pmSelectRead(maxFd, &readableFds, timeout);
+	if (sts >= 0)
+	    HandleFetchReplies(&readableFds, sts);
 	if (sts > 0) {
 	    if (pmDebugOptions.appl0)
 		for (i = 0; i <= maxClientFd; i++)
@@ -839,6 +870,7 @@ ClientLoop(void)
 	    break;
 	}
 	if (AgentDied) {
+	    DrainFetches();
 	    AgentDied = 0;
 	    for (i = 0; i < nAgents; i++) {
 		if (!agent[i].status.connected)
@@ -1041,6 +1073,9 @@ main(int argc, char *argv[])
     if (__pmSecureServerCertificateSetup(certdb, dbpassfile, cert_nickname) < 0)
 	DontStart();
 
+    if (pmcd_dso_offload && StartDsoFetchThread() < 0)
+	DontStart();
+
     PrintAgentInfo(stderr);
     __pmAccDumpLists(stderr);
     fprintf(stderr, "\npmcd: PID = %" FMT_PID, pmcd_pid);
@@ -71,6 +71,19 @@ typedef struct {
     pid_t agentPid;			/* Process ID of the agent */
 } PipeInfo;
 
+/*
+ * Per-agent fetch latency, exported as the pmcd.agent.fetch.* metrics.
+ * Histogram bucket i counts fetches that took at most 100*10^i usec,
+ * except for the last bucket which counts all those taking longer.
+ */
+#define FETCH_NBUCKETS	6
+
+typedef struct {
+    __uint64_t	count;			/* Fetches completed */
+    __uint64_t	usec;			/* Sum of fetch latencies */
+    __uint64_t	hist[FETCH_NBUCKETS];	/* Fetch latency histogram */
+} FetchStats;
+
 /* The agent table and its size. */
 
 typedef struct {
@@ -97,6 +110,10 @@ typedef struct {
 	    flags : 16;			/* Agent-supplied connection flags */
     } status;
     int		reason;			/* if ! connected */
+    struct timeval fetchStart;		/* When current fetch was sent */
+    __uint64_t	fetchUsec;		/* Latency of current fetch */
+    FetchStats	fetchStats;		/* Fetch latency statistics */
+    int		fetchQueued;		/* Pipelined fetches waiting (-a) */
     union {				/* per-ipcType info */
 	DsoInfo    dso;
 	SocketInfo socket;
@@ -155,6 +172,18 @@ extern int	pmdarootfd;
 /* timeout to PMDAs (secs) */
 PMCD_DATA extern int	pmcd_timeout;
 
+/* call DSO agents' fetch routines from a separate thread */
+extern int	pmcd_dso_offload;
+extern int	StartDsoFetchThread(void);
+
+/* Pipelined fetches (-a), see dofetch.c */
+extern int	pmcd_async_fetch;
+extern int	AddFetchFds(__pmFdSet *, int, struct timeval **);
+extern void	HandleFetchReplies(__pmFdSet *, int);
+extern void	DrainFetches(void);
+extern int	WaitForAgent(AgentInfo *);
+extern void	ResumeFetches(void);
+
 /* timeout for credentials */
 extern int	_creds_timeout;
 
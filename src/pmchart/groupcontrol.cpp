@@ -51,6 +51,9 @@ GroupControl::init(int samples, int visible,
     my.position = *position;
     my.realDelta = pmtimevalToReal(interval);
     my.realPosition = pmtimevalToReal(position);
+    // the concurrent fetch deadline tracks the sample interval
+    if (concurrentFetch())
+	setConcurrentFetch(true, (int)(my.realDelta * 1000.0));
 
     my.timeData.clear();
     for (int i = 0; i < samples; i++)
@@ -268,6 +271,9 @@ GroupControl::adjustWorldView(QmcTime::Packet *packet, bool vcrMode)
     my.position = packet->position;
     my.realDelta = pmtimevalToReal(&packet->delta);
     my.realPosition = pmtimevalToReal(&packet->position);
+    // the concurrent fetch deadline tracks the sample interval
+    if (concurrentFetch())
+	setConcurrentFetch(true, (int)(my.realDelta * 1000.0));
 
     console->post("GroupControl::adjustWorldView: "
 		  "sh=%d vh=%d delta=%.2f position=%.2f (%s) state=%s",
@@ -592,6 +592,9 @@ main(int argc, char ** argv)
     // Create all of the sources
     liveGroup = new GroupControl();
     archiveGroup = new GroupControl(true); // restrictArchives
+    // Fetch from all live hosts in parallel, a laggard misses its sample
+    liveGroup->setConcurrentFetch(true,
+			(int)(pmtimevalToReal(&opts.interval) * 1000.0));
     if (Lflag)
 	liveGroup->use(PM_CONTEXT_LOCAL, QmcSource::localHost);
     sts = opts.nhosts + opts.narchives;
@@ -30,7 +30,6 @@ SamplingItem::SamplingItem(Chart *parent,
     my.info = QString::null;
 
     // initialize the pcp data and item data arrays
-    my.dataCount = 0;
     resetValues(samples, 0.0, 0.0);
 
     // set base scale, then tweak if value to plot is time / time
@@ -45,6 +44,8 @@ SamplingItem::SamplingItem(Chart *parent,
 
     // create and attach the plot right here
     my.curve = new SamplingCurve(label());
+    my.series = new SamplingSeries(&my.itemData);
+    my.curve->setSamples(my.series);	// curve takes ownership
     my.curve->attach(parent);
 
     // the 1000 is arbitrary ... just want numbers to be monotonic
@@ -72,16 +73,14 @@ void
 SamplingItem::resetValues(int values, double, double)
 {
     // Reset sizes of pcp data array and the plot data array
-    my.data.resize(values);
-    my.itemData.resize(values);
-    if (my.dataCount > values)
-	my.dataCount = values;
+    my.data.setCapacity(values);
+    my.itemData.setCapacity(values);
 }
 
 void
 SamplingItem::preserveSample(int index, int oldindex)
 {
-    if (my.dataCount > oldindex)
+    if (my.data.size() > oldindex)
 	my.itemData[index] = my.data[index] = my.data[oldindex];
     else
 	my.itemData[index] = my.data[index] = qQNaN();
@@ -101,7 +100,6 @@ SamplingItem::updateValues(bool forward,
     pmAtomValue	scaled, raw;
     QmcMetric	*metric = ChartItem::my.metric;
     double	value;
-    int		sz;
 
     if (metric->numValues() < 1 || metric->error(0)) {
 	value = qQNaN();
@@ -123,32 +121,27 @@ SamplingItem::updateValues(bool forward,
 	    value = scaled.d * my.scale;
     }
 
-    // sz will be the number of previous samples we want to keep.
-    if (my.dataCount < sampleHistory)
-	sz = qMax(0, (int)(my.dataCount));
-    else
-	sz = qMax(0, (int)((my.dataCount - 1)));
+    if (my.data.capacity() != sampleHistory)
+	resetValues(sampleHistory, 0.0, 0.0);
 
     if (forward) {
-	// Keep sz samples and add the new sample to the beginning.
-	my.data.resize(sz);
-	my.itemData.resize(sz);
-	my.data.push_front(value);
-	my.itemData.push_front(value);
+	// Add the new sample to the beginning, oldest falls off the end.
+	my.data.pushFront(value);
+	my.itemData.pushFront(value);
     } else {
-	// Keep sz samples and add the new sample to the end.
-	if (my.dataCount) {
-	    my.data.pop_front();
-	    my.itemData.pop_front();
-	}
-	my.data.resize(sz);
-	my.itemData.resize(sz);
-	my.data.push_back(value);
-	my.itemData.push_back(value);
+	// Add the new sample to the end, newest falls off the beginning.
+	my.data.pushBack(value);
+	my.itemData.pushBack(value);
     }
 
-    if (my.dataCount < sampleHistory)
-	my.dataCount++;
+    if (console->logLevel(PmChart::DebugApp)) {
+	QString	history;
+	for (int i = 0; i < my.data.size(); i++)
+	    history.append(QString(" %1").arg(my.data[i]));
+	console->post("SamplingItem::updateValues %s history%s",
+		metric->name().toStdString().c_str(),
+		history.toStdString().c_str());
+    }
 }
 
 void
@@ -159,7 +152,7 @@ SamplingItem::rescaleValues(const pmUnits *old_units, const pmUnits *new_units)
     console->post("Chart::rescaleValues change units from %s to %s",
 			pmUnitsStr(old_units), pmUnitsStr(new_units));
 
-    for (int i = my.dataCount - 1; i >= 0; i--) {
+    for (int i = my.data.size() - 1; i >= 0; i--) {
 	int	sts = 0;
 	new_av.d = 0;
 	if (my.data[i] != qQNaN()) {
@@ -186,17 +179,12 @@ SamplingItem::rescaleValues(const pmUnits *old_units, const pmUnits *new_units)
 void
 SamplingItem::replot(int history, const QVector<double> &timeData)
 {
-    // Restrict the number of samples to the minimum of history and my.dataCount
-    int count = qMin(history, my.dataCount);
+    // Restrict the number of samples to the minimum of history and data
+    int count = qMin(history, my.itemData.size());
 
-    // Use QwtPlotCurve::setSamples( const QVector<QPointF> & ) which is a
-    // non-deprecated instance of setSamples.
-    my.samples.clear();
-    for (int i = 0; i < count; ++i) {
-	QPointF sample(timeData[i], my.itemData[i]);
-	my.samples.push_back(sample);
-    }
-    my.curve->setSamples(my.samples);
+    // The curve reads straight from the sample history via my.series
+    my.series->setView(&timeData, qMin(count, timeData.size()));
+    my.curve->itemChanged();
     console->post("SamplingItem::replot");
 }
 
@@ -290,7 +278,7 @@ SamplingItem::updateCursor(const QPointF &, int index)
     // Use the point on our curve represented by the given data index.
     GroupControl		*group = my.chart->tab()->group();
     const QVector<double>	&timeData = group->timeAxisData();
-    Q_ASSERT(index < my.dataCount);
+    Q_ASSERT(index < my.itemData.size());
     QPointF curvePoint( timeData[index], my.itemData[index]);
 
     // Now get the point info.
@@ -307,20 +295,22 @@ void
 SamplingItem::copyRawDataPoint(int index)
 {
     if (index < 0)
-	index = my.dataCount - 1;
+	index = my.data.size() - 1;
     my.itemData[index] = my.data[index];
 }
 
 int
 SamplingItem::maximumDataCount(int maximum)
 {
-    return qMax(maximum, my.dataCount);
+    return qMax(maximum, my.data.size());
 }
 
 void
 SamplingItem::truncateData(int offset)
 {
-    for (int index = my.dataCount + 1; index < offset; index++) {
+    int limit = qMin(offset, my.data.capacity());
+
+    for (int index = my.data.size() + 1; index < limit; index++) {
 	my.data[index] = 0;
 	// don't re-set dataCount ... so we don't plot these values,
 	// we just want them to count 0 towards any Stack aggregation
@@ -331,8 +321,8 @@ double
 SamplingItem::sumData(int index, double sum)
 {
     if (index < 0)
-	index = my.dataCount - 1;
-    if (index < my.dataCount && !qIsNaN(my.data[index]))
+	index = my.data.size() - 1;
+    if (index < my.data.size() && !qIsNaN(my.data[index]))
 	sum += my.data[index];
     return sum;
 }
@@ -340,14 +330,14 @@ SamplingItem::sumData(int index, double sum)
 void
 SamplingItem::copyRawDataArray(void)
 {
-    for (int index = 0; index < my.dataCount; index++)
+    for (int index = 0; index < my.data.size(); index++)
 	my.itemData[index] = my.data[index];
 }
 
 void
 SamplingItem::copyDataPoint(int index)
 {
-    if (hidden() || index >= my.dataCount)
+    if (hidden() || index >= my.data.size())
 	my.itemData[index] = qQNaN();
     else
 	my.itemData[index] = my.data[index];
@@ -357,9 +347,9 @@ void
 SamplingItem::setPlotUtil(int index, double sum)
 {
     if (index < 0)
-	index = my.dataCount - 1;
+	index = my.data.size() - 1;
     if (hidden() || sum == 0.0 ||
-	index >= my.dataCount || qIsNaN(my.data[index]))
+	index >= my.data.size() || qIsNaN(my.data[index]))
 	my.itemData[index] = 0.0;
     else
 	my.itemData[index] = 100.0 * my.data[index] / sum;
@@ -369,7 +359,7 @@ double
 SamplingItem::setPlotStack(int index, double sum)
 {
     if (index < 0)
-	index = my.dataCount - 1;
+	index = my.data.size() - 1;
     if (!hidden() && !qIsNaN(my.itemData[index])) {
 	sum += my.itemData[index];
 	my.itemData[index] = sum;
@@ -382,7 +372,7 @@ double
 SamplingItem::setDataStack(int index, double sum)
 {
     if (index < 0)
-	index = my.dataCount - 1;
+	index = my.data.size() - 1;
     if (hidden() || qIsNaN(my.data[index])) {
 	my.itemData[index] = qQNaN();
     } else {
@@ -393,6 +383,66 @@ SamplingItem::setDataStack(int index, double sum)
 }
 
 
+void
+SamplingHistory::setCapacity(int capacity)
+{
+    if (capacity == this->capacity())
+	return;
+
+    // Keep the most recent samples, unwound to start at index zero
+    QVector<double> buffer(qMax(0, capacity), 0.0);
+    int count = qMin(my.count, buffer.size());
+    for (int i = 0; i < count; i++)
+	buffer[i] = (*this)[i];
+    my.buffer = buffer;
+    my.head = 0;
+    my.count = count;
+}
+
+void
+SamplingHistory::pushFront(double value)
+{
+    if (capacity() == 0)
+	return;
+    my.head = my.head ? my.head - 1 : capacity() - 1;
+    my.buffer[my.head] = value;
+    if (my.count < capacity())
+	my.count++;
+}
+
+void
+SamplingHistory::pushBack(double value)
+{
+    bool full = (my.count == capacity());
+
+    if (capacity() == 0)
+	return;
+    if (my.count) {
+	my.head = slot(1);
+	my.count--;
+	// a partial history keeps its length, padding with zero
+	if (!full)
+	    my.buffer[slot(my.count++)] = 0;
+    }
+    my.buffer[slot(my.count++)] = value;
+}
+
+void
+SamplingSeries::setView(const QVector<double> *timeData, int count)
+{
+    my.timeData = timeData;
+    my.count = count;
+    d_boundingRect = QRectF(0.0, 0.0, -1.0, -1.0);
+}
+
+QRectF
+SamplingSeries::boundingRect() const
+{
+    if (d_boundingRect.width() < 0.0)
+	d_boundingRect = qwtBoundingRect(*this);
+    return d_boundingRect;
+}
+
 //
 // SamplingCurve deals with overriding some QwtPlotCurve defaults;
 // particularly around dealing with empty sections of chart (NaN),
@@ -20,8 +20,67 @@
 #include <qwt_plot.h>
 #include <qwt_plot_curve.h>
 #include <qwt_scale_engine.h>
+#include <qwt_series_data.h>
 #include "chart.h"
 
+//
+// Fixed-capacity circular buffer of sample history, with the most
+// recent sample at index zero.  Adding a sample at either end is an
+// O(1) operation, rather than moving the entire history each time.
+//
+class SamplingHistory
+{
+public:
+    SamplingHistory() { my.head = my.count = 0; }
+
+    int capacity() const { return my.buffer.size(); }
+    int size() const { return my.count; }
+    void setCapacity(int capacity);
+
+    double &operator[](int index) { return my.buffer[slot(index)]; }
+    double operator[](int index) const { return my.buffer[slot(index)]; }
+
+    void pushFront(double value);	// add newest, drop oldest if full
+    void pushBack(double value);	// drop newest, add oldest
+
+private:
+    int slot(int index) const
+    {
+	return (my.head + index) % my.buffer.size();
+    }
+
+    struct {
+	QVector<double> buffer;
+	int head;
+	int count;
+    } my;
+};
+
+//
+// Presents the plot values of a SamplingItem to Qwt in place, pairing
+// them with the group time axis, so replot does not copy the history.
+//
+class SamplingSeries : public QwtSeriesData<QPointF>
+{
+public:
+    SamplingSeries(const SamplingHistory *data)
+	{ my.data = data; my.timeData = NULL; my.count = 0; }
+
+    void setView(const QVector<double> *timeData, int count);
+
+    virtual size_t size() const { return my.count; }
+    virtual QPointF sample(size_t i) const
+	{ return QPointF((*my.timeData)[i], (*my.data)[i]); }
+    virtual QRectF boundingRect() const;
+
+private:
+    struct {
+	const SamplingHistory *data;
+	const QVector<double> *timeData;
+	int count;
+    } my;
+};
+
 class SamplingCurve : public ChartCurve
 {
 public:
@@ -74,10 +133,9 @@ private:
 	SamplingCurve *curve;
 	QString info;
 	double scale;
-	QVector<double> data;
-	QVector<double> itemData;
-	QVector<QPointF> samples;
-	int dataCount;
+	SamplingHistory data;		// raw sample values
+	SamplingHistory itemData;	// values to plot (stacked, etc)
+	SamplingSeries *series;		// plot view onto itemData
     } my;
 };
 
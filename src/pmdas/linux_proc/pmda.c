@@ -41,6 +41,7 @@
 #include "getinfo.h"
 #include "proc_pid.h"
 #include "proc_runq.h"
+#include "proc_events.h"
 #include "proc_dynamic.h"
 #include "cgroups.h"
 
@@ -54,6 +55,8 @@ static int			all_access;	/* =1 no access checks */
 static int			have_access;	/* =1 recvd uid/gid */
 static size_t			_pm_system_pagesize;
 static unsigned int		threads;	/* control.all.threads */
+static unsigned int		workers;	/* control.all.workers */
+static int			events;		/* use proc connector backend */
 static char *			cgroups;	/* control.all.cgroups */
 unsigned int			conf_gen;	/* hotproc config version, if zero hotproc not configured yet */
 long				hz;
@@ -1806,6 +1809,80 @@ static pmdaMetric metrictab[] = {
     { PMDA_PMID(CLUSTER_CONTROL, 3), PM_TYPE_STRING,
     PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) } },
 
+/* proc.control.all.workers */
+  { &workers,
+    { PMDA_PMID(CLUSTER_CONTROL, 4), PM_TYPE_U32,
+    PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) } },
+
+/* proc.control.refresh.count */
+  { &proc_refresh_stats.count,
+    { PMDA_PMID(CLUSTER_CONTROL, 5), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+
+/* proc.control.refresh.pidlist */
+  { &proc_refresh_stats.pidlist,
+    { PMDA_PMID(CLUSTER_CONTROL, 6), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+
+/* proc.control.refresh.indom */
+  { &proc_refresh_stats.indom,
+    { PMDA_PMID(CLUSTER_CONTROL, 7), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+
+/* proc.control.refresh.prefetch */
+  { &proc_refresh_stats.prefetch,
+    { PMDA_PMID(CLUSTER_CONTROL, 8), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+
+/* proc.control.events.active */
+  { &proc_events.active,
+    { PMDA_PMID(CLUSTER_CONTROL, 9), PM_TYPE_U32,
+    PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) } },
+
+/* proc.control.events.count */
+  { &proc_events.events,
+    { PMDA_PMID(CLUSTER_CONTROL, 10), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+
+/* proc.control.events.resyncs */
+  { &proc_events.resyncs,
+    { PMDA_PMID(CLUSTER_CONTROL, 11), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+
+/*
+ * Exited process accounting cluster
+ */
+
+/* proc.exited.count */
+  { &proc_exited.count,
+    { PMDA_PMID(CLUSTER_PROC_EXITED, 0), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+
+/* proc.exited.tasks */
+  { &proc_exited.tasks,
+    { PMDA_PMID(CLUSTER_PROC_EXITED, 1), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+
+/* proc.exited.utime */
+  { &proc_exited.utime,
+    { PMDA_PMID(CLUSTER_PROC_EXITED, 2), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+
+/* proc.exited.stime */
+  { &proc_exited.stime,
+    { PMDA_PMID(CLUSTER_PROC_EXITED, 3), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+
+/* proc.exited.read_bytes */
+  { &proc_exited.read_bytes,
+    { PMDA_PMID(CLUSTER_PROC_EXITED, 4), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) } },
+
+/* proc.exited.write_bytes */
+  { &proc_exited.write_bytes,
+    { PMDA_PMID(CLUSTER_PROC_EXITED, 5), PM_TYPE_U64,
+    PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) } },
+
 /*
  * hotproc specific clusters
  */
@@ -1967,9 +2044,60 @@ proc_refresh(pmdaExt *pmda, int *need_refresh)
                         proc_ctx_threads(pmda->e_context, threads),
                         proc_ctx_cgroups(pmda->e_context, cgroups));
     }
+    if (need_refresh[CLUSTER_PROC_EXITED] || need_refresh[CLUSTER_CONTROL])
+	proc_events_refresh();
     return 0;
 }
 
+/*
+ * With more than one worker configured, read the per-pid files needed
+ * by this fetch for all requested pids in parallel before the callbacks
+ * extract values from them.
+ */
+static void
+proc_prefetch(pmdaExt *pmda, int *need_refresh)
+{
+    int		flags = 0, hotflags = 0;
+
+    if (workers < 2 || !have_access)
+	return;
+
+    if (need_refresh[CLUSTER_PID_STAT])
+	flags |= PROC_PID_FLAG_STAT_FETCHED;
+    if (need_refresh[CLUSTER_PID_STATM])
+	flags |= PROC_PID_FLAG_STATM_FETCHED;
+    if (need_refresh[CLUSTER_PID_STATUS])
+	flags |= PROC_PID_FLAG_STATUS_FETCHED;
+    if (need_refresh[CLUSTER_PID_SCHEDSTAT])
+	flags |= PROC_PID_FLAG_SCHEDSTAT_FETCHED;
+    if (need_refresh[CLUSTER_PID_IO])
+	flags |= PROC_PID_FLAG_IO_FETCHED;
+    if (need_refresh[CLUSTER_PID_FD])
+	flags |= PROC_PID_FLAG_FD_FETCHED;
+    if (need_refresh[CLUSTER_PID_OOM_SCORE])
+	flags |= PROC_PID_FLAG_OOM_SCORE_FETCHED;
+    if (flags)
+	prefetch_proc_pid(&proc_pid, INDOM(PROC_INDOM), pmda->e_prof, flags);
+
+    if (need_refresh[CLUSTER_HOTPROC_PID_STAT])
+	hotflags |= PROC_PID_FLAG_STAT_FETCHED;
+    if (need_refresh[CLUSTER_HOTPROC_PID_STATM])
+	hotflags |= PROC_PID_FLAG_STATM_FETCHED;
+    if (need_refresh[CLUSTER_HOTPROC_PID_STATUS])
+	hotflags |= PROC_PID_FLAG_STATUS_FETCHED;
+    if (need_refresh[CLUSTER_HOTPROC_PID_SCHEDSTAT])
+	hotflags |= PROC_PID_FLAG_SCHEDSTAT_FETCHED;
+    if (need_refresh[CLUSTER_HOTPROC_PID_IO])
+	hotflags |= PROC_PID_FLAG_IO_FETCHED;
+    if (need_refresh[CLUSTER_HOTPROC_PID_FD])
+	hotflags |= PROC_PID_FLAG_FD_FETCHED;
+    if (need_refresh[CLUSTER_HOTPROC_PID_OOM_SCORE])
+	hotflags |= PROC_PID_FLAG_OOM_SCORE_FETCHED;
+    if (hotflags)
+	prefetch_proc_pid(&hotproc_pid, INDOM(HOTPROC_INDOM), pmda->e_prof,
+			hotflags);
+}
+
 static int
 proc_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt *pmda)
 {
@@ -3746,8 +3874,10 @@ proc_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 		"proc_fetch", have_access, all_access,
 		proc_ctx_access(pmda->e_context));
 
-    if ((sts = proc_refresh(pmda, need_refresh)) == 0)
+    if ((sts = proc_refresh(pmda, need_refresh)) == 0) {
+	proc_prefetch(pmda, need_refresh);
 	sts = pmdaFetch(numpmid, pmidlist, resp, pmda);
+    }
 
     have_access = all_access || proc_ctx_revert(pmda->e_context);
     if (pmDebugOptions.auth)
@@ -3799,6 +3929,19 @@ proc_store(pmResult *result, pmdaExt *pmda)
 			free(av.cp);
 		}
 		break;
+	    case 4: /* proc.control.all.workers */
+		if (!have_access)
+		    sts = PM_ERR_PERMISSION;
+		else if ((sts = pmExtractValue(vsp->valfmt, &vsp->vlist[0],
+				PM_TYPE_U32, &av, PM_TYPE_U32)) >= 0) {
+		    if (av.ul > MAX_WORKERS)
+			sts = PM_ERR_BADSTORE;
+		    else {
+			workers = av.ul;
+			proc_pid_workers(workers);
+		    }
+		}
+		break;
 	    default:
 		sts = PM_ERR_PERMISSION;
 		break;
@@ -4058,6 +4201,8 @@ proc_init(pmdaInterface *dp)
 	threads = atoi(envpath);
     if ((envpath = getenv("PROC_ACCESS")) != NULL)
 	all_access = atoi(envpath);
+    if ((envpath = getenv("PROC_EVENTS")) != NULL)
+	events = atoi(envpath);
 
     if (_isDSO) {
 	char helppath[MAXPATHLEN];
@@ -4071,6 +4216,13 @@ proc_init(pmdaInterface *dp)
 	return;
     pmdaSetCommFlags(dp, PMDA_FLAG_AUTHORIZE | PMDA_FLAG_CONTAINER);
 
+    /* event-driven process tracking only makes sense for the live host */
+    if (events && proc_statspath[0] == '\0')
+	proc_events_init();
+
+    /* threads for parallel per-process file reads (-W), if any */
+    proc_pid_workers(workers);
+
     dp->version.seven.instance = proc_instance;
     dp->version.seven.store = proc_store;
     dp->version.seven.fetch = proc_fetch;
@@ -4142,16 +4294,18 @@ pmLongOptions	longopts[] = {
     PMOPT_DEBUG,
     { "no-access-checks", 0, 'A', 0, "no access checks will be performed (insecure, beware!)" },
     PMDAOPT_DOMAIN,
+    { "events", 0, 'E', 0, "track processes using kernel proc connector events" },
     PMDAOPT_LOGFILE,
     { "with-threads", 0, 'L', 0, "include threads in the all-processes instance domain" },
     { "from-cgroup", 1, 'r', "NAME", "restrict monitoring to processes in the named cgroup" },
     PMDAOPT_USERNAME,
+    { "workers", 1, 'W', "N", "read per-process files using N threads" },
     PMOPT_HELP,
     PMDA_OPTIONS_END
 };
 
 pmdaOptions	opts = {
-    .short_options = "AD:d:l:Lr:U:?",
+    .short_options = "AD:d:El:Lr:U:W:?",
     .long_options = longopts,
 };
 
@@ -4162,6 +4316,7 @@ main(int argc, char **argv)
     pmdaInterface	dispatch;
     char		helppath[MAXPATHLEN];
     char		*username = "root";
+    char		*endnum;
 
     _isDSO = 0;
     pmSetProgname(argv[0]);
@@ -4174,12 +4329,20 @@ main(int argc, char **argv)
 	case 'A':
 	    all_access = 1;
 	    break;
+	case 'E':
+	    events = 1;
+	    break;
 	case 'L':
 	    threads = 1;
 	    break;
 	case 'r':
 	    cgroups = opts.optarg;
 	    break;
+	case 'W':
+	    workers = (unsigned int)strtoul(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || workers > MAX_WORKERS)
+		opts.errors++;
+	    break;
 	}
     }
 
@@ -0,0 +1,598 @@
+/*
+ * Linux proc connector and taskstats process event tracking
+ *
+ * Rather than rescanning /proc on every refresh, subscribe to the kernel
+ * proc connector for fork and exit notifications and maintain the set of
+ * live tasks incrementally.  Exit accounting (CPU time, I/O) for tasks
+ * that have gone away is collected via the taskstats generic netlink
+ * family, so short-lived processes are accounted for rather than missed.
+ *
+ * Events are received on a dedicated thread, which only updates the
+ * task table and accounting totals under a mutex.  Should the kernel
+ * drop events (socket receive buffer overrun) the task table is rebuilt
+ * from a full /proc scan at the next refresh.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "pmda.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+#include "proc_pid.h"
+#include "proc_events.h"
+
+extern char *proc_statspath;
+
+#define EVENTS_RCVBUF	(8 * 1024 * 1024)
+#define EVENTS_MSGBUF	16384
+
+proc_exited_t		proc_exited;	/* snapshot for proc.exited metrics */
+proc_events_t		proc_events;	/* snapshot for proc.control.events */
+
+static pthread_mutex_t	events_lock = PTHREAD_MUTEX_INITIALIZER;
+static proc_exited_t	exited;		/* totals, updated by event thread */
+static __uint64_t	nevents;	/* events applied to the task table */
+static int		resync = 1;	/* task table needs a full rescan */
+static __pmHashPoolCtl	tasks;		/* tid -> tgid, for all live tasks */
+static int		cn_fd = -1;	/* proc connector netlink socket */
+static int		ts_fd = -1;	/* taskstats generic netlink socket */
+static int		ts_family;	/* taskstats generic netlink family */
+
+/*
+ * While the task table is rebuilt from /proc, without events_lock so
+ * the event thread is not held up behind the directory reads, fork and
+ * exit events are logged here and replayed onto the new table.
+ */
+typedef struct {
+    int			tid;
+    int			tgid;		/* -1 for an exit */
+} task_event_t;
+
+static int		rescanning;	/* task table rebuild in progress */
+static task_event_t	*pending;	/* events logged during the rebuild */
+static int		npending;
+static int		maxpending;
+
+static int		*runq_pids;	/* processes for runqueue accounting */
+static int		runq_size;
+
+static void
+task_add(__pmHashPoolCtl *hpp, int tid, int tgid)
+{
+    if (__pmHashSearch(tid, &hpp->hc) == NULL)
+	__pmHashPoolAdd(tid, (void *)(__psint_t)tgid, hpp);
+}
+
+static void
+task_del(__pmHashPoolCtl *hpp, int tid)
+{
+    __pmHashNode	*node;
+
+    if ((node = __pmHashSearch(tid, &hpp->hc)) != NULL)
+	__pmHashPoolDel(tid, node->data, hpp);
+}
+
+/* apply a fork (tgid >= 0) or exit event, called with events_lock held */
+static void
+task_event(int tid, int tgid)
+{
+    task_event_t	*ep;
+    int			size;
+
+    if (!rescanning) {
+	if (tgid < 0)
+	    task_del(&tasks, tid);
+	else
+	    task_add(&tasks, tid, tgid);
+	return;
+    }
+    if (npending == maxpending) {
+	size = maxpending ? maxpending * 2 : 1024;
+	if ((ep = (task_event_t *)realloc(pending, size * sizeof(*ep))) == NULL) {
+	    resync = 1;		/* rebuild again at the next refresh */
+	    return;
+	}
+	pending = ep;
+	maxpending = size;
+    }
+    pending[npending].tid = tid;
+    pending[npending].tgid = tgid;
+    npending++;
+}
+
+/*
+ * Rebuild the task table from /proc, called without events_lock and
+ * with rescanning set.  Events logged while scanning are applied to
+ * the new table afterwards - adds are idempotent and deletes of
+ * unknown tasks are ignored.
+ */
+static void
+task_rescan(void)
+{
+    DIR			*dirp, *taskdirp;
+    struct dirent	*dp, *tdp;
+    char		path[MAXPATHLEN];
+    __pmHashPoolCtl	scan;
+    int			i, pid;
+
+    __pmHashPoolInit(&scan);
+    pmsprintf(path, sizeof(path), "%s/proc", proc_statspath);
+    if ((dirp = opendir(path)) != NULL) {
+	while ((dp = readdir(dirp)) != NULL) {
+	    if (!isdigit((int)dp->d_name[0]))
+		continue;
+	    pid = atoi(dp->d_name);
+	    task_add(&scan, pid, pid);
+	    pmsprintf(path, sizeof(path), "%s/proc/%d/task", proc_statspath, pid);
+	    if ((taskdirp = opendir(path)) == NULL)
+		continue;
+	    while ((tdp = readdir(taskdirp)) != NULL) {
+		if (isdigit((int)tdp->d_name[0]))
+		    task_add(&scan, atoi(tdp->d_name), pid);
+	    }
+	    closedir(taskdirp);
+	}
+	closedir(dirp);
+    }
+
+    pthread_mutex_lock(&events_lock);
+    __pmHashPoolClear(&tasks);
+    tasks = scan;
+    for (i = 0; i < npending; i++) {
+	if (pending[i].tgid < 0)
+	    task_del(&tasks, pending[i].tid);
+	else
+	    task_add(&tasks, pending[i].tid, pending[i].tgid);
+    }
+    npending = 0;
+    rescanning = 0;
+    pthread_mutex_unlock(&events_lock);
+}
+
+static int
+cn_listen(int fd, enum proc_cn_mcast_op op)
+{
+    char		buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))];
+    struct nlmsghdr	*nlh = (struct nlmsghdr *)buf;
+    struct cn_msg	*cn;
+
+    memset(buf, 0, sizeof(buf));
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    nlh->nlmsg_type = NLMSG_DONE;
+    nlh->nlmsg_pid = getpid();
+    cn = (struct cn_msg *)NLMSG_DATA(nlh);
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(op);
+    memcpy(cn->data, &op, sizeof(op));
+
+    if (send(fd, buf, nlh->nlmsg_len, 0) < 0)
+	return -oserror();
+    return 0;
+}
+
+static int
+cn_open(void)
+{
+    struct sockaddr_nl	addr;
+    int			fd, size = EVENTS_RCVBUF;
+
+    if ((fd = socket(PF_NETLINK, SOCK_DGRAM|SOCK_CLOEXEC, NETLINK_CONNECTOR)) < 0)
+	return -oserror();
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0)
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	cn_listen(fd, PROC_CN_MCAST_LISTEN) < 0) {
+	size = -oserror();
+	close(fd);
+	return size;
+    }
+    return fd;
+}
+
+/* drain the proc connector socket, applying fork and exit events */
+static void
+cn_drain(void)
+{
+    char		buf[EVENTS_MSGBUF] __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct sockaddr_nl	from;
+    socklen_t		fromlen;
+    struct nlmsghdr	*nlh;
+    struct cn_msg	*cn;
+    struct proc_event	*ev;
+    int			len;
+
+    for (;;) {
+	fromlen = sizeof(from);
+	len = recvfrom(cn_fd, buf, sizeof(buf), MSG_DONTWAIT,
+			(struct sockaddr *)&from, &fromlen);
+	if (len < 0) {
+	    if (oserror() == ENOBUFS) {
+		/* events were dropped, task table is now unreliable */
+		pthread_mutex_lock(&events_lock);
+		resync = 1;
+		pthread_mutex_unlock(&events_lock);
+		continue;
+	    }
+	    break;	/* EAGAIN - drained */
+	}
+	if (len == 0 || from.nl_pid != 0)	/* only trust the kernel */
+	    continue;
+
+	pthread_mutex_lock(&events_lock);
+	for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+	     nlh = NLMSG_NEXT(nlh, len)) {
+	    if (nlh->nlmsg_type == NLMSG_NOOP)
+		continue;
+	    if (nlh->nlmsg_type == NLMSG_ERROR ||
+		nlh->nlmsg_type == NLMSG_OVERRUN) {
+		resync = 1;
+		break;
+	    }
+	    cn = (struct cn_msg *)NLMSG_DATA(nlh);
+	    if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+		continue;
+	    ev = (struct proc_event *)cn->data;
+	    switch (ev->what) {
+	    case PROC_EVENT_FORK:
+		task_event(ev->event_data.fork.child_pid,
+			   ev->event_data.fork.child_tgid);
+		nevents++;
+		break;
+	    case PROC_EVENT_EXIT:
+		task_event(ev->event_data.exit.process_pid, -1);
+		if (ev->event_data.exit.process_pid ==
+		    ev->event_data.exit.process_tgid)
+		    exited.count++;
+		nevents++;
+		break;
+	    default:
+		break;
+	    }
+	}
+	pthread_mutex_unlock(&events_lock);
+    }
+}
+
+static int
+genl_send(int fd, int type, int cmd, int attr, const void *data, int length)
+{
+    struct {
+	struct nlmsghdr		n;
+	struct genlmsghdr	g;
+	char			buf[256];
+    } msg;
+    struct nlattr		*na;
+
+    if (length > sizeof(msg.buf) - NLA_HDRLEN)
+	return -E2BIG;
+    memset(&msg, 0, sizeof(msg));
+    msg.n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    msg.n.nlmsg_type = type;
+    msg.n.nlmsg_flags = NLM_F_REQUEST;
+    msg.n.nlmsg_pid = getpid();
+    msg.g.cmd = cmd;
+    msg.g.version = 1;
+    na = (struct nlattr *)((char *)&msg + NLMSG_ALIGN(msg.n.nlmsg_len));
+    na->nla_type = attr;
+    na->nla_len = NLA_HDRLEN + length;
+    memcpy((char *)na + NLA_HDRLEN, data, length);
+    msg.n.nlmsg_len += NLA_ALIGN(na->nla_len);
+
+    if (send(fd, &msg, msg.n.nlmsg_len, 0) < 0)
+	return -oserror();
+    return 0;
+}
+
+/* resolve the generic netlink family identifier for taskstats */
+static int
+ts_resolve(int fd)
+{
+    char		buf[EVENTS_MSGBUF] __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct nlmsghdr	*nlh = (struct nlmsghdr *)buf;
+    struct nlattr	*na;
+    int			sts, len;
+
+    if ((sts = genl_send(fd, GENL_ID_CTRL, CTRL_CMD_GETFAMILY,
+			CTRL_ATTR_FAMILY_NAME, TASKSTATS_GENL_NAME,
+			sizeof(TASKSTATS_GENL_NAME))) < 0)
+	return sts;
+    if ((len = recv(fd, buf, sizeof(buf), 0)) < 0)
+	return -oserror();
+    if (!NLMSG_OK(nlh, len) || nlh->nlmsg_type == NLMSG_ERROR)
+	return -ENOENT;
+
+    len = nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+    na = (struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN);
+    while (len >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN) {
+	if (na->nla_type == CTRL_ATTR_FAMILY_ID)
+	    return *(__u16 *)((char *)na + NLA_HDRLEN);
+	len -= NLA_ALIGN(na->nla_len);
+	na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+    }
+    return -ENOENT;
+}
+
+static int
+ts_open(void)
+{
+    struct sockaddr_nl	addr;
+    char		cpumask[32];
+    int			fd, sts, size = EVENTS_RCVBUF;
+    long		ncpus = sysconf(_SC_NPROCESSORS_CONF);
+
+    if ((fd = socket(PF_NETLINK, SOCK_RAW|SOCK_CLOEXEC, NETLINK_GENERIC)) < 0)
+	return -oserror();
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0)
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+	sts = -oserror();
+	goto fail;
+    }
+    if ((sts = ts_resolve(fd)) < 0)
+	goto fail;
+    ts_family = sts;
+
+    /* ask for exit accounting of tasks on all CPUs */
+    pmsprintf(cpumask, sizeof(cpumask), "0-%ld", ncpus > 0 ? ncpus - 1 : 0);
+    if ((sts = genl_send(fd, ts_family, TASKSTATS_CMD_GET,
+			TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
+			cpumask, strlen(cpumask) + 1)) < 0)
+	goto fail;
+    return fd;
+
+fail:
+    close(fd);
+    return sts;
+}
+
+/* accumulate exit statistics from a TASKSTATS_TYPE_AGGR_PID attribute */
+static void
+ts_aggregate(struct nlattr *na)
+{
+    struct taskstats	*ts;
+    int			len = na->nla_len - NLA_HDRLEN;
+
+    na = (struct nlattr *)((char *)na + NLA_HDRLEN);
+    while (len >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN) {
+	if (na->nla_type == TASKSTATS_TYPE_STATS &&
+	    na->nla_len - NLA_HDRLEN >= offsetof(struct taskstats, write_bytes) +
+					sizeof(ts->write_bytes)) {
+	    ts = (struct taskstats *)((char *)na + NLA_HDRLEN);
+	    exited.tasks++;
+	    exited.utime += ts->ac_utime;
+	    exited.stime += ts->ac_stime;
+	    exited.read_bytes += ts->read_bytes;
+	    exited.write_bytes += ts->write_bytes;
+	}
+	len -= NLA_ALIGN(na->nla_len);
+	na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+    }
+}
+
+/* drain the taskstats socket, accumulating exit accounting */
+static void
+ts_drain(void)
+{
+    char		buf[EVENTS_MSGBUF] __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct nlmsghdr	*nlh;
+    struct nlattr	*na;
+    int			len, alen;
+
+    for (;;) {
+	if ((len = recv(ts_fd, buf, sizeof(buf), MSG_DONTWAIT)) <= 0) {
+	    if (len < 0 && oserror() == ENOBUFS)
+		continue;	/* some exit accounting was lost */
+	    break;
+	}
+	pthread_mutex_lock(&events_lock);
+	for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+	     nlh = NLMSG_NEXT(nlh, len)) {
+	    if (nlh->nlmsg_type == NLMSG_ERROR) {
+		struct nlmsgerr *err = (struct nlmsgerr *)NLMSG_DATA(nlh);
+		if (err->error != 0)
+		    pmNotifyErr(LOG_WARNING, "taskstats: %s",
+				pmErrStr(err->error));
+		continue;
+	    }
+	    if (nlh->nlmsg_type != ts_family)
+		continue;
+	    alen = nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+	    na = (struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN);
+	    while (alen >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN) {
+		/* per-thread stats only - per-tgid stats would double count */
+		if (na->nla_type == TASKSTATS_TYPE_AGGR_PID)
+		    ts_aggregate(na);
+		alen -= NLA_ALIGN(na->nla_len);
+		na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+	    }
+	}
+	pthread_mutex_unlock(&events_lock);
+    }
+}
+
+static void *
+proc_events_loop(void *arg)
+{
+    struct pollfd	pfd[2];
+    sigset_t		sigs;
+    int			nfds = 0;
+
+    /* leave signal delivery to the main PMDA thread */
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    pfd[nfds].fd = cn_fd;
+    pfd[nfds++].events = POLLIN;
+    if (ts_fd >= 0) {
+	pfd[nfds].fd = ts_fd;
+	pfd[nfds++].events = POLLIN;
+    }
+
+    for (;;) {
+	if (poll(pfd, nfds, -1) < 0) {
+	    if (oserror() == EINTR)
+		continue;
+	    pmNotifyErr(LOG_ERR, "proc events poll: %s", osstrerror());
+	    break;
+	}
+	if (pfd[0].revents)
+	    cn_drain();
+	if (nfds > 1 && pfd[1].revents)
+	    ts_drain();
+    }
+
+    pthread_mutex_lock(&events_lock);
+    proc_events.active = 0;
+    pthread_mutex_unlock(&events_lock);
+    return NULL;
+}
+
+int
+proc_events_init(void)
+{
+    pthread_t	tid;
+    int		sts;
+
+    if (cn_fd >= 0)
+	return 0;
+
+    __pmHashPoolInit(&tasks);
+    if ((cn_fd = cn_open()) < 0) {
+	sts = cn_fd;
+	pmNotifyErr(LOG_WARNING, "proc connector unavailable: %s",
+			pmErrStr(sts));
+	return sts;
+    }
+    if ((ts_fd = ts_open()) < 0)
+	pmNotifyErr(LOG_WARNING, "taskstats exit accounting unavailable: %s",
+			pmErrStr(ts_fd));
+
+    /* set before the thread starts, which clears it if it fails */
+    pthread_mutex_lock(&events_lock);
+    proc_events.active = 1;
+    proc_events.taskstats = (ts_fd >= 0);
+    pthread_mutex_unlock(&events_lock);
+
+    if ((sts = pthread_create(&tid, NULL, proc_events_loop, NULL)) != 0) {
+	pmNotifyErr(LOG_WARNING, "proc events thread: %s", strerror(sts));
+	pthread_mutex_lock(&events_lock);
+	proc_events.active = 0;
+	proc_events.taskstats = 0;
+	pthread_mutex_unlock(&events_lock);
+	cn_listen(cn_fd, PROC_CN_MCAST_IGNORE);
+	close(cn_fd);
+	cn_fd = -1;
+	if (ts_fd >= 0)
+	    close(ts_fd);
+	ts_fd = -1;
+	return -sts;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+static int
+compare_task(const void *pa, const void *pb)
+{
+    int a = *(int *)pa;
+    int b = *(int *)pb;
+    return a - b;
+}
+
+int
+proc_events_pidlist(int want_threads, proc_runq_t *runq_stats,
+		proc_pid_list_t *pids)
+{
+    __pmHashNode	*node;
+    int			*list;
+    int			i, tgid, size, nprocs = 0;
+
+    pthread_mutex_lock(&events_lock);
+    if (!proc_events.active) {
+	pthread_mutex_unlock(&events_lock);
+	return -ENOTCONN;
+    }
+    if (resync) {
+	resync = 0;
+	rescanning = 1;
+	proc_events.resyncs++;
+	pthread_mutex_unlock(&events_lock);
+	task_rescan();
+	pthread_mutex_lock(&events_lock);
+    }
+
+    /* copy out the task list, reading /proc only after unlocking */
+    pids->count = 0;
+    pids->threads = want_threads;
+    if (pids->size < tasks.hc.nodes) {
+	size = tasks.hc.nodes + 64;
+	if ((list = (int *)realloc(pids->pids, size * sizeof(int))) == NULL) {
+	    pthread_mutex_unlock(&events_lock);
+	    return -ENOMEM;
+	}
+	pids->pids = list;
+	pids->size = size;
+    }
+    if (runq_stats && runq_size < tasks.hc.nodes) {
+	size = tasks.hc.nodes + 64;
+	if ((list = (int *)realloc(runq_pids, size * sizeof(int))) == NULL) {
+	    pthread_mutex_unlock(&events_lock);
+	    return -ENOMEM;
+	}
+	runq_pids = list;
+	runq_size = size;
+    }
+    for (i = 0; i < tasks.hc.hsize; i++) {
+	for (node = tasks.hc.hash[i]; node != NULL; node = node->next) {
+	    tgid = (int)(__psint_t)node->data;
+	    if (!want_threads && node->key != tgid)
+		continue;
+	    pids->pids[pids->count++] = node->key;
+	    /* runqueue accounting is per-process, as for the /proc scan */
+	    if (runq_stats && node->key == tgid)
+		runq_pids[nprocs++] = tgid;
+	}
+    }
+    proc_events.events = nevents;
+    proc_exited = exited;
+    pthread_mutex_unlock(&events_lock);
+
+    for (i = 0; i < nprocs; i++)
+	proc_runq_append_pid(runq_pids[i], runq_stats);
+    qsort(pids->pids, pids->count, sizeof(int), compare_task);
+    return 0;
+}
+
+void
+proc_events_refresh(void)
+{
+    pthread_mutex_lock(&events_lock);
+    proc_events.events = nevents;
+    proc_exited = exited;
+    pthread_mutex_unlock(&events_lock);
+}
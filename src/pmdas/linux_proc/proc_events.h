@@ -0,0 +1,47 @@
+/*
+ * Linux proc connector and taskstats process event tracking
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef _PROC_EVENTS_H
+#define _PROC_EVENTS_H
+
+/* cumulative accounting for tasks that have exited, from taskstats */
+typedef struct {
+    __uint64_t		count;		/* processes exited (proc connector) */
+    __uint64_t		tasks;		/* tasks (threads) exited (taskstats) */
+    __uint64_t		utime;		/* usec user CPU time of exited tasks */
+    __uint64_t		stime;		/* usec system CPU time of exited tasks */
+    __uint64_t		read_bytes;	/* storage bytes read by exited tasks */
+    __uint64_t		write_bytes;	/* storage bytes written by exited tasks */
+} proc_exited_t;
+
+/* state of the event-driven process tracking backend */
+typedef struct {
+    unsigned int	active;		/* proc connector subscribed */
+    unsigned int	taskstats;	/* taskstats exit accounting registered */
+    __uint64_t		events;		/* fork/exit events processed */
+    __uint64_t		resyncs;	/* full /proc rescans after overflow */
+} proc_events_t;
+
+extern proc_exited_t proc_exited;
+extern proc_events_t proc_events;
+
+/* subscribe to process events, returns negative errno on failure */
+extern int proc_events_init(void);
+
+/* fill the pid list from the task table, returns 0 on success */
+extern int proc_events_pidlist(int, proc_runq_t *, proc_pid_list_t *);
+
+/* update the proc_exited and proc_events snapshots */
+extern void proc_events_refresh(void);
+
+#endif /* _PROC_EVENTS_H */
@@ -25,13 +25,17 @@
 #include <sys/types.h>
 #include <pwd.h>
 #include <grp.h>
+#include <signal.h>
+#include <pthread.h>
 #include "proc_pid.h"
 #include "proc_runq.h"
+#include "proc_events.h"
 #include "indom.h"
 #include "cgroups.h"
 #include "hotproc.h"
 
 static proc_pid_list_t procpids; /* previous pids list that the proc pmda uses */
+proc_refresh_t proc_refresh_stats; /* proc.control.refresh metrics */
 static void refresh_proc_pidlist(proc_pid_t *, proc_pid_list_t *);
 
 
@@ -87,6 +91,15 @@ static int previous = 1;
 struct timeval   hotproc_update_interval;
 int     hotproc_timer_id = -1;
 
+/* microseconds from start to end, for proc.control.refresh metrics */
+static __uint64_t
+usecsince(struct timeval *end, struct timeval *start)
+{
+    double	d = pmtimevalSub(end, start);
+
+    return d > 0 ? (__uint64_t)(d * 1000000) : 0;
+}
+
 int 
 get_hot_totals(double * ta, double * ti, double * tt, double * tci )
 {
@@ -204,6 +217,11 @@ refresh_global_pidlist(int want_threads, proc_runq_t *runq_stats, proc_pid_list_
     struct dirent *dp;
     char path[MAXPATHLEN];
 
+    /* incrementally maintained from proc connector events, if enabled */
+    if (proc_events.active &&
+	proc_events_pidlist(want_threads, runq_stats, pids) == 0)
+	return 0;
+
     pids->count = 0;
     pids->threads = want_threads;
 
@@ -1040,6 +1058,7 @@ refresh_proc_pid(proc_pid_t *proc_pid, proc_runq_t *proc_runq,
     char path[MAXPATHLEN];
     int sts, want_cgroups;
     const char *filter = cgroups;
+    struct timeval start, middle;
 
     want_cgroups = container || (cgroups && cgroups[0] != '\0');
 
@@ -1054,9 +1073,12 @@ refresh_proc_pid(proc_pid_t *proc_pid, proc_runq_t *proc_runq,
     if (proc_runq)
 	memset(proc_runq, 0, sizeof(proc_runq_t));
 
+    pmtimevalNow(&start);
     sts = !want_cgroups ?
 	refresh_global_pidlist(want_threads, proc_runq, &procpids) :
 	refresh_cgroup_pidlist(want_threads, proc_runq, &procpids, filter);
+    pmtimevalNow(&middle);
+    proc_refresh_stats.pidlist += usecsince(&middle, &start);
     if (sts < 0)
 	return sts;
 
@@ -1067,6 +1089,9 @@ refresh_proc_pid(proc_pid_t *proc_pid, proc_runq_t *proc_runq,
 		container ? "container" : "cgroups", filter ? filter : "");
 
     refresh_proc_pidlist(proc_pid, &procpids);
+    pmtimevalNow(&start);
+    proc_refresh_stats.indom += usecsince(&start, &middle);
+    proc_refresh_stats.count++;
     return 0;
 }
 
@@ -1075,19 +1100,225 @@ refresh_hotproc_pid(proc_pid_t *proc_pid, int threads, const char *cgroups)
 {
 
     int sts;
+    struct timeval start, middle;
 
     hotpids.count = 0;
     hotpids.threads = threads;
 
+    pmtimevalNow(&start);
     sts = refresh_hotproc_pidlist(&hotpids);
+    pmtimevalNow(&middle);
+    proc_refresh_stats.pidlist += usecsince(&middle, &start);
 
     if (sts < 0)
         return sts;
 
     refresh_proc_pidlist(proc_pid, &hotpids);
+    pmtimevalNow(&start);
+    proc_refresh_stats.indom += usecsince(&start, &middle);
+    proc_refresh_stats.count++;
     return 0;
 }
 
+/*
+ * Parallel refresh - read the per-pid files needed for a fetch up front,
+ * with the pids spread over a bounded set of worker threads, rather than
+ * one at a time from the fetch callback.  Each entry is only ever visited
+ * by one worker and the pidhash is not modified, so no locking is needed.
+ * Entries end up with the usual "fetched" flags and buffers, so the fetch
+ * callbacks find the work already done.
+ */
+static const struct {
+    int			flag;
+    proc_pid_entry_t	*(*fetch)(int, proc_pid_t *, int *);
+} prefetchers[] = {
+    { PROC_PID_FLAG_STAT_FETCHED,	fetch_proc_pid_stat },
+    { PROC_PID_FLAG_STATM_FETCHED,	fetch_proc_pid_statm },
+    { PROC_PID_FLAG_STATUS_FETCHED,	fetch_proc_pid_status },
+    { PROC_PID_FLAG_SCHEDSTAT_FETCHED,	fetch_proc_pid_schedstat },
+    { PROC_PID_FLAG_IO_FETCHED,		fetch_proc_pid_io },
+    { PROC_PID_FLAG_FD_FETCHED,		fetch_proc_pid_fd },
+    { PROC_PID_FLAG_OOM_SCORE_FETCHED,	fetch_proc_pid_oom_score },
+};
+
+/*
+ * The worker threads are started once, by proc_pid_workers(), and then
+ * wait for work.  Each prefetch hands out the entries in small batches
+ * from a shared cursor, and the fetching thread takes batches too.
+ */
+#define PREFETCH_BATCH	16
+
+static struct {
+    pthread_mutex_t	lock;
+    pthread_cond_t	work;		/* workers: new entries, or quit */
+    pthread_cond_t	done;		/* fetch: all batches completed */
+    pthread_t		*tids;
+    unsigned int	nthreads;
+    int			quit;
+    proc_pid_t		*proc_pid;
+    proc_pid_entry_t	**entries;
+    int			count;
+    int			next;		/* first entry not yet handed out */
+    int			busy;		/* batches handed out, not done */
+    int			flags;
+} prefetch = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+prefetch_entries(proc_pid_t *proc_pid, proc_pid_entry_t **entries, int count,
+		int want)
+{
+    proc_pid_entry_t	*ep;
+    int			i, j, sts, flags;
+
+    for (i = 0; i < count; i++) {
+	ep = entries[i];
+	for (j = 0; j < sizeof(prefetchers)/sizeof(prefetchers[0]); j++) {
+	    if (!(want & prefetchers[j].flag) ||
+		(ep->flags & prefetchers[j].flag))
+		continue;
+	    flags = ep->flags;
+	    prefetchers[j].fetch(ep->id, proc_pid, &sts);
+	    /* leave failures for the fetch callback to retry and report */
+	    if (sts < 0)
+		ep->flags = flags;
+	}
+    }
+}
+
+/* take batches until there are none left, called holding prefetch.lock */
+static void
+prefetch_batches(void)
+{
+    proc_pid_entry_t	**entries;
+    int			count;
+
+    while (prefetch.next < prefetch.count) {
+	entries = prefetch.entries + prefetch.next;
+	count = prefetch.count - prefetch.next;
+	if (count > PREFETCH_BATCH)
+	    count = PREFETCH_BATCH;
+	prefetch.next += count;
+	prefetch.busy++;
+	pthread_mutex_unlock(&prefetch.lock);
+	prefetch_entries(prefetch.proc_pid, entries, count, prefetch.flags);
+	pthread_mutex_lock(&prefetch.lock);
+	if (--prefetch.busy == 0 && prefetch.next >= prefetch.count)
+	    pthread_cond_signal(&prefetch.done);
+    }
+}
+
+static void *
+prefetch_worker(void *arg)
+{
+    sigset_t		sigs;
+
+    /* leave signal delivery to the main thread */
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    pthread_mutex_lock(&prefetch.lock);
+    while (!prefetch.quit) {
+	prefetch_batches();
+	pthread_cond_wait(&prefetch.work, &prefetch.lock);
+    }
+    pthread_mutex_unlock(&prefetch.lock);
+    return NULL;
+}
+
+/*
+ * Start (or stop) worker threads, so that with the fetching thread there
+ * are the given number of workers - at startup, and whenever the value
+ * of proc.control.all.workers changes, never from within a prefetch.
+ */
+void
+proc_pid_workers(unsigned int workers)
+{
+    unsigned int	i, nthreads = workers > 1 ? workers - 1 : 0;
+    int			sts;
+
+    if (nthreads == prefetch.nthreads)
+	return;
+
+    if (prefetch.nthreads > 0) {
+	pthread_mutex_lock(&prefetch.lock);
+	prefetch.quit = 1;
+	pthread_cond_broadcast(&prefetch.work);
+	pthread_mutex_unlock(&prefetch.lock);
+	for (i = 0; i < prefetch.nthreads; i++)
+	    pthread_join(prefetch.tids[i], NULL);
+	free(prefetch.tids);
+	prefetch.tids = NULL;
+	prefetch.nthreads = 0;
+	prefetch.quit = 0;
+    }
+    if (nthreads == 0)
+	return;
+
+    if ((prefetch.tids = calloc(nthreads, sizeof(pthread_t))) == NULL) {
+	pmNotifyErr(LOG_ERR, "cannot allocate %u prefetch workers\n", nthreads);
+	return;
+    }
+    for (i = 0; i < nthreads; i++) {
+	if ((sts = pthread_create(&prefetch.tids[i], NULL,
+				prefetch_worker, NULL)) != 0) {
+	    pmNotifyErr(LOG_ERR, "cannot start prefetch worker: %s\n",
+				strerror(sts));
+	    break;	/* the fetching thread covers for the rest */
+	}
+    }
+    prefetch.nthreads = i;
+}
+
+void
+prefetch_proc_pid(proc_pid_t *proc_pid, pmInDom indom, pmProfile *prof,
+		int flags)
+{
+    __pmHashNode	*node;
+    proc_pid_entry_t	**entries;
+    struct timeval	start, end;
+    int			i, count = 0;
+
+    if (prefetch.nthreads == 0 || proc_pid->indom->it_numinst < 2)
+	return;
+
+    pmtimevalNow(&start);
+    if ((entries = malloc(proc_pid->indom->it_numinst * sizeof(*entries))) == NULL)
+	return;
+    for (i = 0; i < proc_pid->pidhash.hsize; i++) {
+	for (node = proc_pid->pidhash.hash[i]; node != NULL; node = node->next) {
+	    if (count == proc_pid->indom->it_numinst)
+		break;
+	    if (__pmInProfile(indom, prof, node->key))
+		entries[count++] = (proc_pid_entry_t *)node->data;
+	}
+    }
+
+    pthread_mutex_lock(&prefetch.lock);
+    prefetch.proc_pid = proc_pid;
+    prefetch.entries = entries;
+    prefetch.count = count;
+    prefetch.next = 0;
+    prefetch.flags = flags;
+    pthread_cond_broadcast(&prefetch.work);
+    prefetch_batches();
+    while (prefetch.busy > 0)
+	pthread_cond_wait(&prefetch.done, &prefetch.lock);
+    prefetch.entries = NULL;
+    prefetch.count = prefetch.next = 0;
+    pthread_mutex_unlock(&prefetch.lock);
+    free(entries);
+
+    pmtimevalNow(&end);
+    proc_refresh_stats.prefetch += usecsince(&end, &start);
+    if (pmDebugOptions.libpmda)
+	fprintf(stderr, "prefetch_proc_pid: %d pids, flags=0x%x, %u workers\n",
+		count, flags, prefetch.nthreads + 1);
+}
+
 
 
 /*
@@ -319,9 +319,28 @@ typedef struct {
     int			threads;	/* /proc/PID/{xxx,task/PID/xxx} flag */
 } proc_pid_list_t;
 
+/* cumulative time spent in each phase of refreshing the proc indoms */
+typedef struct {
+    __uint64_t		count;		/* number of indom refreshes */
+    __uint64_t		pidlist;	/* usec spent scanning for pids */
+    __uint64_t		indom;		/* usec spent updating pidhash + indom */
+    __uint64_t		prefetch;	/* usec spent reading per-pid files */
+} proc_refresh_t;
+
+extern proc_refresh_t proc_refresh_stats;
+
 /* refresh the proc indom, reset all "fetched" flags */
 extern int refresh_proc_pid(proc_pid_t *, proc_runq_t *, int, const char *, const char *, int);
 
+/* upper bound on the number of prefetch worker threads */
+#define MAX_WORKERS	64
+
+/* start or stop threads to give this many prefetch workers in total */
+extern void proc_pid_workers(unsigned int);
+
+/* read the per-pid files for "fetched" flags, spread over worker threads */
+extern void prefetch_proc_pid(proc_pid_t *, pmInDom, pmProfile *, int);
+
 /* refresh the hotproc indom, checking against the current configuration */
 extern int refresh_hotproc_pid(proc_pid_t *, int, const char *);
 
@@ -60,6 +60,16 @@ static pmdaOptions opts = {
     .long_options = longopts,
 };
 
+/*
+ * Fetch-time lookup index, built once per mapping.  For each item, the
+ * metric descriptor and its first value (used for singular metrics and
+ * PM_IN_NULL lookups); instance values are found via the vindex hash.
+ */
+typedef struct {
+    int			metric;		/* index into metrics1/metrics2, or -1 */
+    int			value;		/* index into values, or -1 */
+} item_index_t;
+
 typedef struct {
     char		*name;		/* strdup client name */
     void		*addr;		/* mmap */
@@ -76,6 +86,8 @@ typedef struct {
     pid_t		pid;		/* process identifier */
     __int64_t		len;		/* mmap region len */
     __uint64_t		gen;		/* generation number on open */
+    item_index_t	*items;		/* item -> metric and first value */
+    __pmHashPoolCtl	vindex;		/* (item,instance) -> value */
 } stats_t;
 
 typedef struct {
@@ -84,6 +96,7 @@ typedef struct {
     pmdaNameSpace	*pmns;
     stats_t		*slist;
     int			scnt;
+    __pmHashPoolCtl	clusters;	/* cluster -> slist index */
     int			mtot;
     int			intot;
     int			reload;		/* require reload of maps */
@@ -238,6 +251,7 @@ create_client_stat(agent_t *ap, const char *client, const char *path, size_t siz
 		sp[in].cluster = cluster;
 		sp[in].gen = header.g1;
 		sp[in].len = size;
+		__pmHashPoolInit(&sp[in].vindex);
 		ap->slist = sp;
 		ap->scnt++;
 	    } else {
@@ -510,6 +524,139 @@ create_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
     return 0;
 }
 
+/*
+ * Key for the per-mapping values hash; only unique per item within a
+ * cluster and only for instances below 2^22, so lookups must check the
+ * item and instance of each candidate.
+ */
+static unsigned int
+value_key(int item, unsigned int inst)
+{
+    return (inst << 10) | (unsigned int)item;
+}
+
+static int
+value_matches(stats_t *s, mmv_disk_value_t *v, __uint64_t moffset,
+		unsigned int inst)
+{
+    __uint64_t		ioffset = v->instance;
+
+    if (v->metric != moffset)
+	return 0;
+    if (s->version == MMV_VERSION1) {
+	if (s->len < ioffset + sizeof(mmv_disk_instance_t))
+	    return 0;
+	return ((mmv_disk_instance_t *)((char *)s->addr + ioffset))->internal == inst;
+    }
+    if (s->len < ioffset + sizeof(mmv_disk_instance2_t))
+	return 0;
+    return ((mmv_disk_instance2_t *)((char *)s->addr + ioffset))->internal == inst;
+}
+
+static mmv_disk_value_t *
+mmv_lookup_value(stats_t *s, int item, __uint64_t moffset,
+		unsigned int inst)
+{
+    __pmHashNode	*hp;
+    unsigned int	key = value_key(item, inst);
+
+    for (hp = __pmHashSearch(key, &s->vindex.hc); hp != NULL; hp = hp->next) {
+	if (hp->key != key)
+	    continue;
+	if (value_matches(s, (mmv_disk_value_t *)hp->data, moffset, inst))
+	    return (mmv_disk_value_t *)hp->data;
+    }
+    return NULL;
+}
+
+/*
+ * Build the fetch lookup index for one mapping, so that each requested
+ * (item, instance) pair is resolved without scanning every metric and
+ * value in the file.  Where a client has exported duplicates the first
+ * one wins, as it always has for the linear search.
+ */
+static void
+index_stats(stats_t *s)
+{
+    item_index_t	*items;
+    mmv_disk_value_t	*v = s->values;
+    __uint64_t		moffset, msize, offset;
+    __uint32_t		indom;
+    unsigned int	inst;
+    int			i, mi, mcnt, item;
+
+    if ((items = malloc((MAX_MMV_ITEMS + 1) * sizeof(item_index_t))) == NULL) {
+	pmNotifyErr(LOG_ERR, "%s: client \"%s\" index out of memory - %s",
+			pmGetProgname(), s->name, osstrerror());
+	return;
+    }
+    for (i = 0; i <= MAX_MMV_ITEMS; i++)
+	items[i].metric = items[i].value = -1;
+    s->items = items;
+
+    if (s->version == MMV_VERSION1) {
+	if (s->metrics1 == NULL)
+	    return;
+	mcnt = s->mcnt1;
+	msize = sizeof(mmv_disk_metric_t);
+	moffset = (char *)s->metrics1 - (char *)s->addr;
+	for (mi = 0; mi < mcnt; mi++) {
+	    item = s->metrics1[mi].item;
+	    if (item >= 0 && item <= MAX_MMV_ITEMS && items[item].metric < 0)
+		items[item].metric = mi;
+	}
+    } else {
+	if (s->metrics2 == NULL)
+	    return;
+	mcnt = s->mcnt2;
+	msize = sizeof(mmv_disk_metric2_t);
+	moffset = (char *)s->metrics2 - (char *)s->addr;
+	for (mi = 0; mi < mcnt; mi++) {
+	    item = s->metrics2[mi].item;
+	    if (item >= 0 && item <= MAX_MMV_ITEMS && items[item].metric < 0)
+		items[item].metric = mi;
+	}
+    }
+
+    for (i = 0; i < s->vcnt; i++) {
+	offset = v[i].metric;
+	if (offset < moffset || (offset - moffset) % msize != 0)
+	    continue;
+	if ((mi = (offset - moffset) / msize) >= mcnt)
+	    continue;
+	if (s->version == MMV_VERSION1) {
+	    item = s->metrics1[mi].item;
+	    indom = s->metrics1[mi].indom;
+	} else {
+	    item = s->metrics2[mi].item;
+	    indom = s->metrics2[mi].indom;
+	}
+	if (item < 0 || item > MAX_MMV_ITEMS || items[item].metric != mi)
+	    continue;
+	if (items[item].value < 0)
+	    items[item].value = i;
+	if (indom == PM_INDOM_NULL || indom == 0)
+	    continue;
+
+	offset = v[i].instance;
+	if (s->version == MMV_VERSION1) {
+	    if (s->len < offset + sizeof(mmv_disk_instance_t))
+		continue;
+	    inst = ((mmv_disk_instance_t *)((char *)s->addr + offset))->internal;
+	} else {
+	    if (s->len < offset + sizeof(mmv_disk_instance2_t))
+		continue;
+	    inst = ((mmv_disk_instance2_t *)((char *)s->addr + offset))->internal;
+	}
+	if (mmv_lookup_value(s, item, moffset + mi * msize, inst) == NULL)
+	    __pmHashPoolAdd(value_key(item, inst), (void *)&v[i], &s->vindex);
+    }
+
+    if (pmDebugOptions.appl0)
+	pmNotifyErr(LOG_DEBUG, "MMV: %s - indexed %d metrics, %d values",
+			s->name, mcnt, s->vindex.hc.nodes);
+}
+
 static void
 map_stats(pmdaExt *pmda)
 {
@@ -552,12 +699,15 @@ map_stats(pmdaExt *pmda)
     if (ap->slist != NULL) {
 	for (i = 0; i < ap->scnt; i++) {
 	    free(ap->slist[i].name);
+	    free(ap->slist[i].items);
+	    __pmHashPoolClear(&ap->slist[i].vindex);
 	    __pmMemoryUnmap(ap->slist[i].addr, ap->slist[i].len);
 	}
 	free(ap->slist);
 	ap->slist = NULL;
 	ap->scnt = 0;
     }
+    __pmHashPoolClear(&ap->clusters);
 
     num = scandir(ap->statsdir, &files, NULL, alphasort);
     for (i = 0; i < num; i++) {
@@ -810,6 +960,9 @@ map_stats(pmdaExt *pmda)
 		break;
 	    }
 	}
+
+	index_stats(s);
+	__pmHashPoolAdd(s->cluster, (void *)(__psint_t)i, &ap->clusters);
     }
 
     pmdaTreeRebuildHash(ap->pmns, ap->mtot); /* for reverse (pmid->name) lookups */
@@ -817,73 +970,54 @@ map_stats(pmdaExt *pmda)
 }
 
 static int
-mmv_lookup_item1(int item, unsigned int inst,
+mmv_lookup_item(int item, unsigned int inst,
 	stats_t *s, mmv_disk_value_t **value,
 	__uint64_t *shorttext, __uint64_t *helptext)
 {
-    mmv_disk_metric_t	*m1 = s->metrics1;
-    mmv_disk_value_t	*v = s->values;
-    int			mi, vi, sts = PM_ERR_PMID;
+    item_index_t	*ip;
+    mmv_disk_value_t	*v;
+    __uint64_t		moffset;
+    __uint32_t		indom;
+    int			type;
 
-    for (mi = 0; mi < s->mcnt1; mi++) {
-	if (m1[mi].item != item)
-	    continue;
+    if (s->items == NULL || item < 0 || item > MAX_MMV_ITEMS)
+	return PM_ERR_PMID;
+    ip = &s->items[item];
+    if (ip->metric < 0)
+	return PM_ERR_PMID;
 
-	sts = PM_ERR_INST;
-	for (vi = 0; vi < s->vcnt; vi++) {
-	    mmv_disk_metric_t *mt = (mmv_disk_metric_t *)
-			((char *)s->addr + v[vi].metric);
-	    mmv_disk_instance_t *is = (mmv_disk_instance_t *)
-			((char *)s->addr + v[vi].instance);
-
-	    if ((mt == &m1[mi]) &&
-		(mt->indom == PM_INDOM_NULL || mt->indom == 0 ||
-		inst == PM_IN_NULL || is->internal == inst)) {
-		if (shorttext)
-		    *shorttext = m1[mi].shorttext;
-		if (helptext)
-		    *helptext = m1[mi].helptext;
-		*value = &v[vi];
-		return m1[mi].type;
-	    }
-	}
+    if (s->version == MMV_VERSION1) {
+	mmv_disk_metric_t *m1 = &s->metrics1[ip->metric];
+
+	moffset = (char *)m1 - (char *)s->addr;
+	indom = m1->indom;
+	type = m1->type;
+	if (shorttext)
+	    *shorttext = m1->shorttext;
+	if (helptext)
+	    *helptext = m1->helptext;
+    } else {
+	mmv_disk_metric2_t *m2 = &s->metrics2[ip->metric];
+
+	moffset = (char *)m2 - (char *)s->addr;
+	indom = m2->indom;
+	type = m2->type;
+	if (shorttext)
+	    *shorttext = m2->shorttext;
+	if (helptext)
+	    *helptext = m2->helptext;
     }
-    return sts;
-}
 
-static int
-mmv_lookup_item2(int item, unsigned int inst,
-	stats_t *s, mmv_disk_value_t **value,
-	__uint64_t *shorttext, __uint64_t *helptext)
-{
-    mmv_disk_metric2_t	*m2 = s->metrics2;
-    mmv_disk_value_t	*v = s->values;
-    int			mi, vi, sts = PM_ERR_PMID;
-
-    for (mi = 0; mi < s->mcnt2; mi++) {
-	if (m2[mi].item != item)
-	    continue;
-
-	sts = PM_ERR_INST;
-	for (vi = 0; vi < s->vcnt; vi++) {
-	    mmv_disk_metric2_t *mt = (mmv_disk_metric2_t *)
-			((char *)s->addr + v[vi].metric);
-	    mmv_disk_instance2_t *is = (mmv_disk_instance2_t *)
-			((char *)s->addr + v[vi].instance);
-
-	    if ((mt == &m2[mi]) &&
-		(mt->indom == PM_INDOM_NULL || mt->indom == 0 ||
-		inst == PM_IN_NULL || is->internal == inst)) {
-		if (shorttext)
-		    *shorttext = m2[mi].shorttext;
-		if (helptext)
-		    *helptext = m2[mi].helptext;
-		*value = &v[vi];
-		return m2[mi].type;
-	    }
-	}
+    if (indom == PM_INDOM_NULL || indom == 0 || inst == PM_IN_NULL) {
+	if (ip->value < 0)
+	    return PM_ERR_INST;
+	*value = &s->values[ip->value];
+	return type;
     }
-    return sts;
+    if ((v = mmv_lookup_value(s, item, moffset, inst)) == NULL)
+	return PM_ERR_INST;
+    *value = v;
+    return type;
 }
 
 static int
@@ -891,25 +1025,43 @@ mmv_lookup_stat_metric(agent_t *agent, pmID pmid, unsigned int inst,
 	stats_t **stats, mmv_disk_value_t **value,
 	__uint64_t *shorttext, __uint64_t *helptext)
 {
-    int			si, sts = PM_ERR_PMID;
-
-    for (si = 0; si < agent->scnt; si++) {
-	stats_t *s = &agent->slist[si];
+    __pmHashNode	*hp;
+    mmv_disk_value_t	*v;
+    __uint64_t		st, ht;
+    unsigned int	cluster = pmID_cluster(pmid);
+    int			si, last = -1, found = agent->scnt;
+    int			sts, type = PM_ERR_PMID;
 
-	if (s->cluster != pmID_cluster(pmid))
+    /*
+     * Clients may share a cluster, in which case the first mapping (in
+     * slist order) holding the requested value wins, else the error
+     * from the last mapping searched is returned.
+     */
+    for (hp = __pmHashSearch(cluster, &agent->clusters.hc); hp != NULL; hp = hp->next) {
+	if (hp->key != cluster)
 	    continue;
-
-	sts = (s->version == MMV_VERSION1) ?
-	    mmv_lookup_item1(pmID_item(pmid), inst, s, value, shorttext, helptext):
-	    mmv_lookup_item2(pmID_item(pmid), inst, s, value, shorttext, helptext);
+	if ((si = (int)(__psint_t)hp->data) > found)
+	    continue;
+	sts = mmv_lookup_item(pmID_item(pmid), inst, &agent->slist[si],
+				&v, &st, &ht);
 	if (sts == MMV_TYPE_NOSUPPORT)
 	    sts = PM_ERR_APPVERSION;
 	if (sts >= 0) {
-	    *stats = s;
-	    break;
+	    found = si;
+	    type = sts;
+	    *value = v;
+	    if (shorttext)
+		*shorttext = st;
+	    if (helptext)
+		*helptext = ht;
+	} else if (found == agent->scnt && si > last) {
+	    last = si;
+	    type = sts;
 	}
     }
-    return sts;
+    if (found < agent->scnt)
+	*stats = &agent->slist[found];
+    return type;
 }
 
 static int
@@ -1363,6 +1515,7 @@ init_pmda(pmdaInterface *dp, agent_t *ap)
 
     pmsprintf(ap->statsdir, MAXPATHLEN, "%s%c%s", ap->pcptmpdir, sep, ap->prefix);
     pmsprintf(ap->pmnsdir, MAXPATHLEN, "%s%c" "pmns", ap->pcpvardir, sep);
+    __pmHashPoolInit(&ap->clusters);
 
     /* Initialize internal dispatch table */
     if (dp->status == 0) {
@@ -87,6 +87,10 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(0,24), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* labels */
     { PMDA_PMID(0,25), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* fetch.inflight */
+    { PMDA_PMID(0,26), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* fetch.queued */
+    { PMDA_PMID(0,27), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
 
 /* pdu_in.error */
     { PMDA_PMID(1,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
@@ -185,6 +189,24 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(4,1), PM_TYPE_32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* agent.fenced */
     { PMDA_PMID(4,2), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* agent.fetch.count */
+    { PMDA_PMID(4,3), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.time */
+    { PMDA_PMID(4,4), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* agent.fetch.latency.le_100us */
+    { PMDA_PMID(4,5), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.latency.le_1ms */
+    { PMDA_PMID(4,6), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.latency.le_10ms */
+    { PMDA_PMID(4,7), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.latency.le_100ms */
+    { PMDA_PMID(4,8), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.latency.le_1s */
+    { PMDA_PMID(4,9), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.latency.gt_1s */
+    { PMDA_PMID(4,10), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* agent.fetch.queued */
+    { PMDA_PMID(4,11), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) },
 
 /* pmie.configfile */
     { PMDA_PMID(5,0), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -206,6 +228,8 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(5,8), PM_TYPE_FLOAT, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,-1,1,0,PM_TIME_SEC,PM_COUNT_ONE) },
 /* pmie.eval.actual */
     { PMDA_PMID(5,9), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmie.eval.time */
+    { PMDA_PMID(5,10), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
 
 /* client.whoami */
     { PMDA_PMID(6,0), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -525,7 +549,8 @@ refresh_pmie_indom(void)
 				fullpath, osstrerror());
 		    continue;
 		}
-		if (statbuf.st_size != sizeof(pmiestats_t))
+		if (statbuf.st_size != sizeof(pmiestats_t) &&
+		    statbuf.st_size != PMIESTATS_V1_SIZE)
 		    continue;
 		if  ((endp = strdup(dp->d_name)) == NULL) {
 		    pmNoMem("pmie iname", strlen(dp->d_name), PM_RECOV_ERR);
@@ -1531,6 +1556,21 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 				fetch_labels(pmda->e_context, &atom, &host);
 				break;
 
+			case 26:	/* clients with fetches in progress */
+				atom.ul = 0;
+				for (j = 0; j < nClients; j++) {
+				    if (client[j].status.connected &&
+					client[j].status.fetching)
+					atom.ul++;
+				}
+				break;
+
+			case 27:	/* fetches waiting for agents */
+				atom.ul = 0;
+				for (j = 0; j < nAgents; j++)
+				    atom.ul += agent[j].fetchQueued;
+				break;
+
 			default:
 				sts = atom.l = PM_ERR_PMID;
 				break;
@@ -1649,6 +1689,23 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			case 2:		/* agent.fenced */
 			    atom.ul = agent[j].status.fenced;
 			    break;
+			case 3:		/* agent.fetch.count */
+			    atom.ull = agent[j].fetchStats.count;
+			    break;
+			case 4:		/* agent.fetch.time */
+			    atom.ull = agent[j].fetchStats.usec;
+			    break;
+			case 5:		/* agent.fetch.latency.le_100us */
+			case 6:		/* agent.fetch.latency.le_1ms */
+			case 7:		/* agent.fetch.latency.le_10ms */
+			case 8:		/* agent.fetch.latency.le_100ms */
+			case 9:		/* agent.fetch.latency.le_1s */
+			case 10:	/* agent.fetch.latency.gt_1s */
+			    atom.ull = agent[j].fetchStats.hist[item - 5];
+			    break;
+			case 11:	/* agent.fetch.queued */
+			    atom.ul = agent[j].fetchQueued;
+			    break;
 			default:
 			    sts = atom.l = PM_ERR_PMID;
 			    break;
@@ -1718,6 +1775,11 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			case 9:		/* pmie.eval.actual */
 			    atom.ul = pmie->eval_actual;
 			    break;
+			case 10:	/* pmie.eval.time */
+			    if (pmies[j].size < sizeof(pmiestats_t))
+				continue;	/* older pmie */
+			    atom.ull = pmie->eval_time;
+			    break;
 			default:
 			    sts = atom.l = PM_ERR_PMID;
 			    break;
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#include <math.h>
+#include <string.h>
+
+#include "utils.h"
+#include "aggregators.h"
+#include "aggregator-metrics.h"
+#include "aggregator-metric-duration.h"
+#include "aggregator-metric-duration-ddsketch.h"
+#include "config-reader.h"
+
+#define DDSKETCH_GAMMA ((1.0 + DDSKETCH_RELATIVE_ACCURACY) / (1.0 - DDSKETCH_RELATIVE_ACCURACY))
+
+/**
+ * Makes sure bucket with given index is stored, growing bucket array if needed
+ * - if that would span more than DDSKETCH_MAX_BUCKETS, lowest buckets are merged together and index may be raised
+ * @arg sketch - Target sketch
+ * @arg index - Bucket index, updated when bucket it falls into was collapsed
+ */
+static void
+ddsketch_cover_index(struct ddsketch_duration_value* sketch, int* index) {
+    int low = sketch->offset;
+    int high = sketch->offset + (int)sketch->length - 1;
+    if (sketch->length == 0) {
+        low = high = *index;
+    } else if (*index < low) {
+        low = *index;
+    } else if (*index > high) {
+        high = *index;
+    } else {
+        return;
+    }
+    if (high - low + 1 > DDSKETCH_MAX_BUCKETS) {
+        low = high - DDSKETCH_MAX_BUCKETS + 1;
+        if (*index < low) {
+            *index = low;
+        }
+    }
+    size_t length = high - low + 1;
+    if (length > sketch->capacity) {
+        size_t capacity = sketch->capacity * 2;
+        if (capacity < length) {
+            capacity = length;
+        }
+        if (capacity > DDSKETCH_MAX_BUCKETS) {
+            capacity = DDSKETCH_MAX_BUCKETS;
+        }
+        unsigned long long* counts = realloc(sketch->counts, sizeof(unsigned long long) * capacity);
+        ALLOC_CHECK("Unable to allocate memory for duration sketch buckets.");
+        sketch->counts = counts;
+        sketch->capacity = capacity;
+    }
+    if (sketch->length == 0) {
+        memset(sketch->counts, 0, sizeof(unsigned long long) * length);
+    } else if (sketch->offset >= low) {
+        // grown downwards (or not at all), shift existing buckets up
+        size_t shift = sketch->offset - low;
+        memmove(&sketch->counts[shift], sketch->counts, sizeof(unsigned long long) * sketch->length);
+        memset(sketch->counts, 0, sizeof(unsigned long long) * shift);
+        memset(&sketch->counts[shift + sketch->length], 0, sizeof(unsigned long long) * (length - shift - sketch->length));
+    } else {
+        // grown upwards past the limit, fold lowest buckets into new lowest one
+        size_t collapsed = low - sketch->offset;
+        size_t i;
+        unsigned long long folded = 0;
+        if (collapsed > sketch->length) {
+            collapsed = sketch->length;
+        }
+        for (i = 0; i < collapsed; i++) {
+            folded += sketch->counts[i];
+        }
+        size_t kept = sketch->length - collapsed;
+        memmove(sketch->counts, &sketch->counts[collapsed], sizeof(unsigned long long) * kept);
+        memset(&sketch->counts[kept], 0, sizeof(unsigned long long) * (length - kept));
+        sketch->counts[0] += folded;
+    }
+    sketch->offset = low;
+    sketch->length = length;
+}
+
+/**
+ * Creates DDSketch duration value
+ * @arg value - Initial value
+ * @arg out - Placeholder sketch
+ */
+void
+create_ddsketch_duration_value(double value, void** out) {
+    struct ddsketch_duration_value* sketch =
+        (struct ddsketch_duration_value*) malloc(sizeof(struct ddsketch_duration_value));
+    ALLOC_CHECK("Unable to allocate memory for duration sketch.");
+    *sketch = (struct ddsketch_duration_value) { 0 };
+    sketch->counts = (unsigned long long*) malloc(sizeof(unsigned long long) * DDSKETCH_INITIAL_BUCKETS);
+    ALLOC_CHECK("Unable to allocate memory for duration sketch buckets.");
+    sketch->capacity = DDSKETCH_INITIAL_BUCKETS;
+    update_ddsketch_duration_value(value, sketch);
+    *out = sketch;
+}
+
+/**
+ * Records value in sketch, in constant time
+ * @arg value - Value to record
+ * @arg sketch - Sketch to update
+ */
+void
+update_ddsketch_duration_value(double value, struct ddsketch_duration_value* sketch) {
+    sketch->count += 1;
+    if (sketch->count == 1 || value < sketch->min) {
+        sketch->min = value;
+    }
+    if (sketch->count == 1 || value > sketch->max) {
+        sketch->max = value;
+    }
+    // Welford's online algorithm, so that standard deviation needs no stored values
+    double delta = value - sketch->mean;
+    sketch->mean += delta / sketch->count;
+    sketch->m2 += delta * (value - sketch->mean);
+    if (value <= DDSKETCH_MIN_INDEXABLE_VALUE) {
+        sketch->zero_count += 1;
+        return;
+    }
+    int index = (int)ceil(log(value) / log(DDSKETCH_GAMMA));
+    ddsketch_cover_index(sketch, &index);
+    sketch->counts[index - sketch->offset] += 1;
+}
+
+/**
+ * Estimates value at given quantile, within DDSKETCH_RELATIVE_ACCURACY of actual value
+ * @arg sketch - Target sketch
+ * @arg quantile - Quantile in range 0-1
+ * @return quantile value
+ */
+static double
+ddsketch_quantile(struct ddsketch_duration_value* sketch, double quantile) {
+    double rank = quantile * (sketch->count - 1);
+    unsigned long long cumulative = sketch->zero_count;
+    if (cumulative > rank) {
+        return 0;
+    }
+    size_t i;
+    for (i = 0; i < sketch->length; i++) {
+        cumulative += sketch->counts[i];
+        if (cumulative > rank) {
+            double value = 2.0 * pow(DDSKETCH_GAMMA, sketch->offset + (int)i) / (DDSKETCH_GAMMA + 1.0);
+            if (value < sketch->min) {
+                return sketch->min;
+            }
+            if (value > sketch->max) {
+                return sketch->max;
+            }
+            return value;
+        }
+    }
+    return sketch->max;
+}
+
+/**
+ * Gets duration values meta data from sketch
+ * @arg sketch - Target sketch
+ * @arg instance - What information to extract
+ * @return duration instance value
+ */
+double
+get_ddsketch_duration_instance(struct ddsketch_duration_value* sketch, enum DURATION_INSTANCE instance) {
+    if (sketch == NULL || sketch->count == 0) {
+        return 0;
+    }
+    switch (instance) {
+        case DURATION_MIN:
+            return sketch->min;
+        case DURATION_MAX:
+            return sketch->max;
+        case DURATION_AVERAGE:
+            return sketch->mean;
+        case DURATION_COUNT:
+            return (double)sketch->count;
+        case DURATION_STANDARD_DEVIATION:
+            return sqrt(sketch->m2 / (double)sketch->count);
+        case DURATION_MEDIAN:
+            return ddsketch_quantile(sketch, 0.5);
+        case DURATION_PERCENTILE90:
+            return ddsketch_quantile(sketch, 0.9);
+        case DURATION_PERCENTILE95:
+            return ddsketch_quantile(sketch, 0.95);
+        case DURATION_PERCENTILE99:
+            return ddsketch_quantile(sketch, 0.99);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Prints duration sketch metadata in human readable way
+ * @arg f - Opened file handle, doesn't close it when finished
+ * @arg sketch - Target sketch
+ */
+void
+print_ddsketch_duration_value(FILE* f, struct ddsketch_duration_value* sketch) {
+    fprintf(f, "min             = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_MIN));
+    fprintf(f, "max             = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_MAX));
+    fprintf(f, "median          = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_MEDIAN));
+    fprintf(f, "average         = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_AVERAGE));
+    fprintf(f, "percentile90    = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_PERCENTILE90));
+    fprintf(f, "percentile95    = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_PERCENTILE95));
+    fprintf(f, "percentile99    = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_PERCENTILE99));
+    fprintf(f, "count           = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_COUNT));
+    fprintf(f, "std deviation   = %lf\n", get_ddsketch_duration_instance(sketch, DURATION_STANDARD_DEVIATION));
+    fprintf(f, "buckets         = %lu\n", sketch->length);
+}
+
+/**
+ * Frees DDSketch duration metric value
+ * @arg config
+ * @arg value - value to be freed
+ */
+void
+free_ddsketch_duration_value(struct agent_config* config, void* value) {
+    (void)config;
+    struct ddsketch_duration_value* sketch = (struct ddsketch_duration_value*)value;
+    if (sketch != NULL) {
+        if (sketch->counts != NULL) {
+            free(sketch->counts);
+        }
+        free(sketch);
+    }
+}
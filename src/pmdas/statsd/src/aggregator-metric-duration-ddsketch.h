@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef AGGREGATOR_DURATION_DDSKETCH_
+#define AGGREGATOR_DURATION_DDSKETCH_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "aggregator-metric-duration.h"
+#include "config-reader.h"
+
+/**
+ * Relative error guaranteed for reported quantiles
+ */
+#define DDSKETCH_RELATIVE_ACCURACY 0.01
+
+/**
+ * Upper bound of buckets per sketch, once reached lowest buckets are collapsed together
+ * - with 1% accuracy 2048 buckets cover values spanning 18 orders of magnitude
+ * - quantiles falling into collapsed buckets are overestimated
+ */
+#define DDSKETCH_MAX_BUCKETS 2048
+
+/**
+ * Bucket count sketch starts with, doubled as needed up to DDSKETCH_MAX_BUCKETS
+ */
+#define DDSKETCH_INITIAL_BUCKETS 64
+
+/**
+ * Values up to this are recorded in zero bucket
+ */
+#define DDSKETCH_MIN_INDEXABLE_VALUE 1e-9
+
+/**
+ * Represents DDSketch duration aggregation unit - logarithmically sized buckets stored densely,
+ * bucket i counts values in (gamma^(i-1), gamma^i] where gamma = (1 + accuracy) / (1 - accuracy)
+ */
+typedef struct ddsketch_duration_value {
+    unsigned long long* counts;
+    size_t capacity;
+    size_t length;
+    int offset; // bucket index of counts[0]
+    unsigned long long zero_count;
+    unsigned long long count;
+    double min;
+    double max;
+    double mean;
+    double m2; // sum of squared differences from mean
+} ddsketch_duration_value;
+
+/**
+ * Creates DDSketch duration value
+ * @arg value - Initial value
+ * @arg out - Placeholder sketch
+ */
+extern void
+create_ddsketch_duration_value(double value, void** out);
+
+/**
+ * Records value in sketch, in constant time
+ * @arg value - Value to record
+ * @arg sketch - Sketch to update
+ */
+extern void
+update_ddsketch_duration_value(double value, struct ddsketch_duration_value* sketch);
+
+/**
+ * Gets duration values meta data from sketch
+ * @arg sketch - Target sketch
+ * @arg instance - What information to extract
+ * @return duration instance value
+ */
+extern double
+get_ddsketch_duration_instance(struct ddsketch_duration_value* sketch, enum DURATION_INSTANCE instance);
+
+/**
+ * Prints duration sketch metadata in human readable way
+ * @arg f - Opened file handle, doesn't close it when finished
+ * @arg sketch - Target sketch
+ */
+extern void
+print_ddsketch_duration_value(FILE* f, struct ddsketch_duration_value* sketch);
+
+/**
+ * Frees DDSketch duration metric value
+ * @arg config
+ * @arg value - value to be freed
+ */
+extern void
+free_ddsketch_duration_value(struct agent_config* config, void* value);
+
+#endif
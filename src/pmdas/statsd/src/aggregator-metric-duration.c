@@ -22,6 +22,7 @@
 #include "aggregator-metric-duration.h"
 #include "aggregator-metric-duration-exact.h"
 #include "aggregator-metric-duration-hdr.h"
+#include "aggregator-metric-duration-ddsketch.h"
 #include "errno.h"
 #include "utils.h"
 
@@ -46,6 +47,8 @@ create_duration_value(struct agent_config* config, struct statsd_datagram* datag
             (unsigned long long) new_value, 
             out
         );
+    } else if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_DDSKETCH) {
+        create_ddsketch_duration_value(new_value, out);
     } else {
         create_exact_duration_value(
             (unsigned long long) new_value,
@@ -57,7 +60,7 @@ create_duration_value(struct agent_config* config, struct statsd_datagram* datag
 
 /**
  * Updates duration metric record of value subtype
- * @arg config - Config from which we know what duration type is, either HDR or exact
+ * @arg config - Config from which we know what duration type is, either HDR, DDSketch or exact
  * @arg item - Item to be updated
  * @arg datagram - Data to update the item with
  * @return 1 on success, 0 on fail
@@ -80,6 +83,11 @@ update_duration_value(struct agent_config* config, struct statsd_datagram* datag
             (unsigned long long) new_value,
             (struct hdr_histogram*) value
         );
+    } else if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_DDSKETCH) {
+        update_ddsketch_duration_value(
+            new_value,
+            (struct ddsketch_duration_value*) value
+        );
     } else {
         update_exact_duration_value(
             (unsigned long long) new_value,
@@ -92,7 +100,8 @@ update_duration_value(struct agent_config* config, struct statsd_datagram* datag
 /**
  * Extracts duration metric meta values from duration metric record
  * @arg config - Config which contains info on which duration aggregating type we are using
- * @arg value - Either "struct exact_duration_collection*" or "struct hdr_histogram*", basically value from metric that has type of "duration"
+ * @arg value - One of "struct exact_duration_collection*", "struct hdr_histogram*" or "struct ddsketch_duration_value*",
+ * basically value from metric that has type of "duration"
  * @arg instance - What information to extract
  * @return duration instance value
  */
@@ -101,6 +110,8 @@ get_duration_instance(struct agent_config* config, void* value, enum DURATION_IN
     double result = 0;
     if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_BASIC) {
         result = get_exact_duration_instance((struct exact_duration_collection*)value, instance);
+    } else if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_DDSKETCH) {
+        result = get_ddsketch_duration_instance((struct ddsketch_duration_value*)value, instance);
     } else {
         result = get_hdr_histogram_duration_instance((struct hdr_histogram*)value, instance);
     }
@@ -123,6 +134,9 @@ print_duration_metric_value(struct agent_config* config, FILE* f, void* value) {
             case DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM:
                 print_hdr_duration_value(f, (struct hdr_histogram*)value);
                 break;
+            case DURATION_AGGREGATION_TYPE_DDSKETCH:
+                print_ddsketch_duration_value(f, (struct ddsketch_duration_value*)value);
+                break;
         }
     }
 }
@@ -158,5 +172,8 @@ free_duration_value(struct agent_config* config, void* value) {
         case DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM:
             free_hdr_duration_value(config, value);
             break;
+        case DURATION_AGGREGATION_TYPE_DDSKETCH:
+            free_ddsketch_duration_value(config, value);
+            break;
     }
 }
@@ -27,7 +27,7 @@
  * @arg container - Metrics struct acting as metrics wrapper
  * @arg item - Parent item
  * 
- * Synchronized by 
+ * Synchronized by mutex on pmda_metrics_shard
  */
 static void
 create_labels_dict(
@@ -35,7 +35,8 @@ create_labels_dict(
     struct pmda_metrics_container* container,
     struct metric* item
 ) {
-    pthread_mutex_lock(&container->mutex);
+    struct pmda_metrics_shard* shard = get_metric_shard(container, item);
+    pthread_mutex_lock(&shard->mutex);
     /**
      * Callbacks for metrics hashtable
      */
@@ -48,7 +49,7 @@ create_labels_dict(
     };
     labels* children = dictCreate(&metric_label_dict_callbacks, container->metrics_privdata);
     item->children = children;
-    pthread_mutex_unlock(&container->mutex);
+    pthread_mutex_unlock(&shard->mutex);
 }
 
 
@@ -59,7 +60,7 @@ create_labels_dict(
  * @arg item - Metric serving as root
  * @arg datagram - Datagram to be processed
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 int
 process_labeled_datagram(
@@ -86,7 +87,7 @@ process_labeled_datagram(
     int label_exists = find_label_by_name(container, item, label_key, &label);
     int status = 0;
     if (label_exists) {
-        int update_success = update_metric_value(config, container, label->type, datagram, &label->value);
+        int update_success = update_metric_value(config, container, item, label->type, datagram, &label->value);
         if (update_success != 1) {
             METRIC_PROCESSING_ERR_LOG("%s REASON: sematically incorrect values.", throwing_away_msg);
             status = 0;
@@ -115,7 +116,7 @@ process_labeled_datagram(
  * @arg out - Placeholder label
  * @return 1 when any found, 0 when not
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 int
 find_label_by_name(
@@ -124,17 +125,18 @@ find_label_by_name(
     char* key,
     struct metric_label** out
 ) {
-    pthread_mutex_lock(&container->mutex);
+    struct pmda_metrics_shard* shard = get_metric_shard(container, item);
+    pthread_mutex_lock(&shard->mutex);
     dictEntry* result = dictFind(item->children, key);
     if (result == NULL) {
-        pthread_mutex_unlock(&container->mutex);
+        pthread_mutex_unlock(&shard->mutex);
         return 0;
     }
     if (out != NULL) {
         struct metric_label* label = (struct metric_label*)result->v.val;
         *out = label;
     }
-    pthread_mutex_unlock(&container->mutex);
+    pthread_mutex_unlock(&shard->mutex);
     return 1;
 }
 
@@ -237,15 +239,16 @@ create_label(
  * @arg key - Label key
  * @arg label - Label to be saved
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 void
 add_label(struct pmda_metrics_container* container, struct metric* item, char* key, struct metric_label* label) {
-    pthread_mutex_lock(&container->mutex);
+    struct pmda_metrics_shard* shard = get_metric_shard(container, item);
+    pthread_mutex_lock(&shard->mutex);
     dictAdd(item->children, key, label);
-    container->generation += 1;
     item->meta->pcp_instance_change_requested = 1;
-    pthread_mutex_unlock(&container->mutex);
+    pthread_mutex_unlock(&shard->mutex);
+    increment_metrics_generation(container);
 }
 
 /**
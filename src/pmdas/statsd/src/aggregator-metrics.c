@@ -55,8 +55,11 @@ init_pmda_metrics(struct agent_config* config) {
     ALLOC_CHECK("Unable to create priv PMDA metrics container data.");
     dict_data->config = config;
     dict_data->container = container;
-    metrics* m = dictCreate(&metric_dict_callbacks, dict_data);
-    container->metrics = m;
+    size_t i;
+    for (i = 0; i < METRICS_SHARD_COUNT; i++) {
+        pthread_mutex_init(&container->shards[i].mutex, NULL);
+        container->shards[i].metrics = dictCreate(&metric_dict_callbacks, dict_data);
+    }
     container->generation = 0;
     container->metrics_privdata = dict_data;
     return container;
@@ -82,6 +85,56 @@ create_metric_dict_key(char* key) {
     return result;
 }
 
+/**
+ * Gets index of shard metric with given hashtable key belongs to
+ * @arg key - Metric key
+ * @return shard index
+ */
+size_t
+get_metric_shard_index(char* key) {
+    // dict picks buckets using low bits of the same hash, so use high ones here
+    return (str_hash_callback(key) >> 32) % METRICS_SHARD_COUNT;
+}
+
+/**
+ * Gets shard that holds given metric, its mutex guards metric value and labels
+ * @arg container - Metrics container
+ * @arg item - Metric that is already stored in container
+ * @return shard
+ */
+struct pmda_metrics_shard*
+get_metric_shard(struct pmda_metrics_container* container, struct metric* item) {
+    return &container->shards[item->shard];
+}
+
+/**
+ * Returns current generation of metrics, incremented whenever metric or label is added or removed
+ * @arg container - Metrics container
+ * @return generation
+ *
+ * Synchronized by mutex on pmda_metrics_container
+ */
+size_t
+get_metrics_generation(struct pmda_metrics_container* container) {
+    pthread_mutex_lock(&container->mutex);
+    size_t generation = container->generation;
+    pthread_mutex_unlock(&container->mutex);
+    return generation;
+}
+
+/**
+ * Increments generation of metrics, so that PMNS is remapped on next PCP request
+ * @arg container - Metrics container
+ *
+ * Synchronized by mutex on pmda_metrics_container
+ */
+void
+increment_metrics_generation(struct pmda_metrics_container* container) {
+    pthread_mutex_lock(&container->mutex);
+    container->generation += 1;
+    pthread_mutex_unlock(&container->mutex);
+}
+
 /**
  * Processes datagram struct into metric 
  * @arg config - Agent config
@@ -103,7 +156,7 @@ process_metric(struct agent_config* config, struct pmda_metrics_container* conta
     if (metric_exists) {
         int datagram_contains_tags = datagram->tags != NULL;
         if (!datagram_contains_tags) {
-            int res = update_metric_value(config, container, item->type, datagram, &item->value);
+            int res = update_metric_value(config, container, item, item->type, datagram, &item->value);
             if (res == 0) {
                 METRIC_PROCESSING_ERR_LOG("%s REASON: semantically incorrect values.", throwing_away_msg);
                 status = 0;
@@ -205,13 +258,11 @@ print_metric_meta(FILE* f, struct metric_metadata* meta) {
  * @arg config - Config containing information about where to output
  * @arg container - Metrics struct acting as metrics wrapper
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on each pmda_metrics_shard in turn
  */
 void
 write_metrics_to_file(struct agent_config* config, struct pmda_metrics_container* container) {
     VERBOSE_LOG(0, "Writing metrics to file...");
-    pthread_mutex_lock(&container->mutex);
-    metrics* m = container->metrics;
     if (strlen(config->debug_output_filename) == 0) return; 
     int sep = pmPathSeparator();
     char debug_output[MAXPATHLEN];
@@ -224,36 +275,40 @@ write_metrics_to_file(struct agent_config* config, struct pmda_metrics_container
     FILE* f;
     f = fopen(debug_output, "a+");
     if (f == NULL) {
-        pthread_mutex_unlock(&container->mutex);
         VERBOSE_LOG(0, "Unable to open file for output.");
         return;
     }
-    dictIterator* iterator = dictGetSafeIterator(m);
-    dictEntry* current;
     long int count = 0;
-    while ((current = dictNext(iterator)) != NULL) {
-        struct metric* item = (struct metric*)current->v.val;
-        switch (item->type) {
-            case METRIC_TYPE_COUNTER:
-                print_counter_metric(config, f, item);
-                break;
-            case METRIC_TYPE_GAUGE:
-                print_gauge_metric(config, f, item);
-                break;
-            case METRIC_TYPE_DURATION:
-                print_duration_metric(config, f, item);
-                break;
-            case METRIC_TYPE_NONE:
-                // not an actualy metric error case
-                break;
+    size_t i;
+    for (i = 0; i < METRICS_SHARD_COUNT; i++) {
+        struct pmda_metrics_shard* shard = &container->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        dictIterator* iterator = dictGetSafeIterator(shard->metrics);
+        dictEntry* current;
+        while ((current = dictNext(iterator)) != NULL) {
+            struct metric* item = (struct metric*)current->v.val;
+            switch (item->type) {
+                case METRIC_TYPE_COUNTER:
+                    print_counter_metric(config, f, item);
+                    break;
+                case METRIC_TYPE_GAUGE:
+                    print_gauge_metric(config, f, item);
+                    break;
+                case METRIC_TYPE_DURATION:
+                    print_duration_metric(config, f, item);
+                    break;
+                case METRIC_TYPE_NONE:
+                    // not an actualy metric error case
+                    break;
+            }
+            count++;
         }
-        count++;
+        dictReleaseIterator(iterator);
+        pthread_mutex_unlock(&shard->mutex);
     }
-    dictReleaseIterator(iterator);
     fprintf(f, "----------------\n");
     fprintf(f, "Total number of records: %lu \n", count);
     fclose(f);    
-    pthread_mutex_unlock(&container->mutex);
     VERBOSE_LOG(0, "Wrote metrics to debug file.");
 }
 
@@ -264,22 +319,22 @@ write_metrics_to_file(struct agent_config* config, struct pmda_metrics_container
  * @arg out - Placeholder metric
  * @return 1 when any found, 0 when not
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 int
 find_metric_by_name(struct pmda_metrics_container* container, char* key, struct metric** out) {
-    pthread_mutex_lock(&container->mutex);
-    metrics* m = container->metrics;
-    dictEntry* result = dictFind(m, key);
+    struct pmda_metrics_shard* shard = &container->shards[get_metric_shard_index(key)];
+    pthread_mutex_lock(&shard->mutex);
+    dictEntry* result = dictFind(shard->metrics, key);
     if (result == NULL) {
-        pthread_mutex_unlock(&container->mutex);
+        pthread_mutex_unlock(&shard->mutex);
         return 0;
     }
     if (out != NULL) {
         struct metric* item = (struct metric*)result->v.val;
         *out = item;
     }
-    pthread_mutex_unlock(&container->mutex);
+    pthread_mutex_unlock(&shard->mutex);
     return 1;
 }
 
@@ -301,6 +356,7 @@ create_metric(struct agent_config* config, struct statsd_datagram* datagram, str
     strncpy((*out)->name, datagram->name, len);
     (*out)->meta = create_metric_meta(datagram);
     (*out)->children = NULL;
+    (*out)->shard = get_metric_shard_index(datagram->name);
     int status = 0; 
     (*out)->type = datagram->type;
     (*out)->value = NULL;
@@ -334,14 +390,16 @@ create_metric(struct agent_config* config, struct statsd_datagram* datagram, str
  * @arg container - Metrics container 
  * @arg item - Metric to be saved
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 void
 add_metric(struct pmda_metrics_container* container, char* key, struct metric* item) {
-    pthread_mutex_lock(&container->mutex);
-    dictAdd(container->metrics, key, item);
-    container->generation += 1;
-    pthread_mutex_unlock(&container->mutex);
+    item->shard = get_metric_shard_index(key);
+    struct pmda_metrics_shard* shard = &container->shards[item->shard];
+    pthread_mutex_lock(&shard->mutex);
+    dictAdd(shard->metrics, key, item);
+    pthread_mutex_unlock(&shard->mutex);
+    increment_metrics_generation(container);
 }
 
 /**
@@ -349,36 +407,40 @@ add_metric(struct pmda_metrics_container* container, char* key, struct metric* i
  * @arg container - Metrics container
  * @arg key - Metric's hashtable key
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 void
 remove_metric(struct pmda_metrics_container* container, char* key) {
-    pthread_mutex_lock(&container->mutex);
-    dictDelete(container->metrics, key);
-    container->generation += 1;
-    pthread_mutex_unlock(&container->mutex);
+    struct pmda_metrics_shard* shard = &container->shards[get_metric_shard_index(key)];
+    pthread_mutex_lock(&shard->mutex);
+    dictDelete(shard->metrics, key);
+    pthread_mutex_unlock(&shard->mutex);
+    increment_metrics_generation(container);
 }
 
 /**
  * Updates metric record
  * @arg config - Agent config
  * @arg container - Metrics container
+ * @arg item - Metric that owns the value
  * @arg type - What type the metric value is
  * @arg datagram - Data with which to update
  * @arg value - Dest value
  * @return 1 on success, 0 when update itself fails, -1 when metric with same name but different type is already recorded
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 int
 update_metric_value(
     struct agent_config* config,
     struct pmda_metrics_container* container,
+    struct metric* item,
     enum METRIC_TYPE type,
     struct statsd_datagram* datagram,
     void** value
 ) {
-    pthread_mutex_lock(&container->mutex);
+    struct pmda_metrics_shard* shard = get_metric_shard(container, item);
+    pthread_mutex_lock(&shard->mutex);
     int status = 0;
     if (datagram->type != type) {
         status = -1;
@@ -410,7 +472,7 @@ update_metric_value(
                 break;
         }
     }
-    pthread_mutex_unlock(&container->mutex);
+    pthread_mutex_unlock(&shard->mutex);
     return status;
 }
 
@@ -441,7 +503,11 @@ check_metric_name_available(struct pmda_metrics_container* container, char* key)
         "pmda.settings.debug_output_filename",
         "pmda.settings.port",
         "pmda.settings.parser_type",
-        "pmda.settings.duration_aggregation_type"
+        "pmda.settings.duration_aggregation_type",
+        "pmda.dropped_queue_full",
+        "pmda.dropped_kernel",
+        "pmda.queue_depth.unprocessed",
+        "pmda.queue_depth.parsed"
     };
     size_t i;
     for (i = 0; i < sizeof(g_blacklist) / sizeof(g_blacklist[0]); i++) {
@@ -510,11 +576,12 @@ free_metric_metadata(struct metric_metadata* meta) {
  * @arg container - Metrics container
  * @arg item - Metric to be updated
  * 
- * Synchronized by mutex on pmda_metrics_container struct
+ * Synchronized by mutex on pmda_metrics_shard struct
  */
 void
 mark_metric_as_pernament(struct pmda_metrics_container* container, struct metric* item) {
-    pthread_mutex_lock(&container->mutex);
+    struct pmda_metrics_shard* shard = get_metric_shard(container, item);
+    pthread_mutex_lock(&shard->mutex);
     item->pernament = 1;
-    pthread_mutex_unlock(&container->mutex);
+    pthread_mutex_unlock(&shard->mutex);
 }
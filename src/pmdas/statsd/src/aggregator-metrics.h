@@ -26,6 +26,11 @@
 typedef dict metrics;
 typedef dict labels;
 
+/**
+ * Number of independently locked partitions of the metrics hashtable
+ */
+#define METRICS_SHARD_COUNT MAX_AGGREGATOR_THREADS
+
 typedef enum DURATION_INSTANCE {
     DURATION_MIN,
     DURATION_MAX,
@@ -73,6 +78,7 @@ typedef struct metric {
     labels* children;
     enum METRIC_TYPE type;
     void* value;
+    size_t shard; // index of container shard this metric is stored in
 } metric;
 
 /**
@@ -90,8 +96,20 @@ typedef struct duration_values_meta {
     double std_deviation;
 } duration_values_meta;
 
-typedef struct pmda_metrics_container {
+/**
+ * Partition of metrics hashtable, only ever updated by single aggregator thread
+ */
+typedef struct pmda_metrics_shard {
     metrics* metrics;
+    pthread_mutex_t mutex;
+} pmda_metrics_shard;
+
+/**
+ * Metrics are partitioned into shards by key hash, shard mutex guards its metrics and their values and labels,
+ * container mutex guards generation only
+ */
+typedef struct pmda_metrics_container {
+    struct pmda_metrics_shard shards[METRICS_SHARD_COUNT];
     struct pmda_metrics_dict_privdata* metrics_privdata;
     size_t generation;
     pthread_mutex_t mutex;
@@ -115,6 +133,42 @@ init_pmda_metrics(struct agent_config* config);
 extern char*
 create_metric_dict_key(char* key);
 
+/**
+ * Gets index of shard metric with given hashtable key belongs to
+ * @arg key - Metric key
+ * @return shard index
+ */
+extern size_t
+get_metric_shard_index(char* key);
+
+/**
+ * Gets shard that holds given metric, its mutex guards metric value and labels
+ * @arg container - Metrics container
+ * @arg item - Metric that is already stored in container
+ * @return shard
+ */
+extern struct pmda_metrics_shard*
+get_metric_shard(struct pmda_metrics_container* container, struct metric* item);
+
+/**
+ * Returns current generation of metrics, incremented whenever metric or label is added or removed
+ * @arg container - Metrics container
+ * @return generation
+ *
+ * Synchronized by mutex on pmda_metrics_container
+ */
+extern size_t
+get_metrics_generation(struct pmda_metrics_container* container);
+
+/**
+ * Increments generation of metrics, so that PMNS is remapped on next PCP request
+ * @arg container - Metrics container
+ *
+ * Synchronized by mutex on pmda_metrics_container
+ */
+extern void
+increment_metrics_generation(struct pmda_metrics_container* container);
+
 /**
  * Processes datagram struct into metric 
  * @arg config - Agent config
@@ -138,7 +192,7 @@ free_metric(struct agent_config* config, struct metric* item);
  * @arg config - Config containing information about where to output
  * @arg container - Metrics struct acting as metrics wrapper
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on each pmda_metrics_shard in turn
  */
 extern void
 write_metrics_to_file(struct agent_config* config, struct pmda_metrics_container* container);
@@ -150,7 +204,7 @@ write_metrics_to_file(struct agent_config* config, struct pmda_metrics_container
  * @arg out - Placeholder metric
  * @return 1 when any found, 0 when not
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 extern int
 find_metric_by_name(struct pmda_metrics_container* container, char* key, struct metric** out);
@@ -170,7 +224,7 @@ create_metric(struct agent_config* config, struct statsd_datagram* datagram, str
  * @arg container - Metrics container 
  * @arg item - Metric to be saved
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 extern void
 add_metric(struct pmda_metrics_container* container, char* key, struct metric* item);
@@ -180,7 +234,7 @@ add_metric(struct pmda_metrics_container* container, char* key, struct metric* i
  * @arg container - Metrics container
  * @arg key - Metric's hashtable key
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 extern void
 remove_metric(struct pmda_metrics_container* container, char* key);
@@ -189,17 +243,19 @@ remove_metric(struct pmda_metrics_container* container, char* key);
  * Updates metric record
  * @arg config - Agent config
  * @arg container - Metrics container
+ * @arg item - Metric that owns the value
  * @arg type - What type the metric value is
  * @arg datagram - Data with which to update
  * @arg value - Dest value
  * @return 1 on success, 0 when update itself fails, -1 when metric with same name but different type is already recorded
  * 
- * Synchronized by mutex on pmda_metrics_container
+ * Synchronized by mutex on pmda_metrics_shard
  */
 extern int
 update_metric_value(
     struct agent_config* config,
     struct pmda_metrics_container* container,
+    struct metric* item,
     enum METRIC_TYPE type,
     struct statsd_datagram* datagram,
     void** value
@@ -244,7 +300,7 @@ print_metric_meta(FILE* f, struct metric_metadata* meta);
  * @arg container - Metrics container
  * @arg item - Metric to be updated
  * 
- * Synchronized by mutex on pmda_metrics_container struct
+ * Synchronized by mutex on pmda_metrics_shard struct
  */
 extern void
 mark_metric_as_pernament(struct pmda_metrics_container* container, struct metric* item);
@@ -35,6 +35,8 @@ init_pmda_stats(struct agent_config* config) {
     *stats = (struct pmda_stats) { 0 };
     stats->metrics_recorded = counters;
     container->stats = stats;
+    container->network_listener_to_parser = NULL;
+    container->parser_to_aggregator = NULL;
     return container;
 }
 
@@ -74,6 +76,15 @@ reset_stat(struct agent_config* config, struct pmda_stats_container* s, enum STA
             s->stats->metrics_recorded->gauge = 0;
             s->stats->metrics_recorded->duration = 0;
             break;
+        case STAT_QUEUE_DROPPED:
+            s->stats->queue_dropped = 0;
+            break;
+        case STAT_KERNEL_DROPPED:
+            s->stats->kernel_dropped = 0;
+            break;
+        case STAT_UNPROCESSED_QUEUE_DEPTH:
+        case STAT_PARSED_QUEUE_DEPTH:
+            break;
     }
     pthread_mutex_unlock(&s->mutex);
 }
@@ -126,6 +137,15 @@ process_stat(struct agent_config* config, struct pmda_stats_container* s, enum S
             }
             break;
         }
+        case STAT_QUEUE_DROPPED:
+            s->stats->queue_dropped += *((unsigned long*) data);
+            break;
+        case STAT_KERNEL_DROPPED:
+            s->stats->kernel_dropped += *((unsigned long*) data);
+            break;
+        case STAT_UNPROCESSED_QUEUE_DEPTH:
+        case STAT_PARSED_QUEUE_DEPTH:
+            break;
     }
     pthread_mutex_unlock(&s->mutex);
 }
@@ -163,6 +183,8 @@ write_stats_to_file(struct agent_config* config, struct pmda_stats_container* st
     fprintf(f, "parsed: %lu \n", stats->stats->parsed);
     fprintf(f, "thrown away: %lu \n", stats->stats->dropped);
     fprintf(f, "aggregated: %lu \n", stats->stats->aggregated);
+    fprintf(f, "dropped on full parser queue: %lu \n", stats->stats->queue_dropped);
+    fprintf(f, "dropped by kernel: %lu \n", stats->stats->kernel_dropped);
     fprintf(f, "time spent parsing: %lu ns \n", stats->stats->time_spent_parsing);
     fprintf(f, "time spent aggregating: %lu ns \n", stats->stats->time_spent_aggregating);
     fprintf(
@@ -189,7 +211,6 @@ write_stats_to_file(struct agent_config* config, struct pmda_stats_container* st
  */
 unsigned long int
 get_agent_stat(struct agent_config* config, struct pmda_stats_container* stats, enum STAT_TYPE type, void* data) {
-    (void)config;
     pthread_mutex_lock(&stats->mutex);
     long result;
     switch (type) {
@@ -235,6 +256,26 @@ get_agent_stat(struct agent_config* config, struct pmda_stats_container* stats,
             result = total;
             break;
         }
+        case STAT_QUEUE_DROPPED:
+            result = stats->stats->queue_dropped;
+            break;
+        case STAT_KERNEL_DROPPED:
+            result = stats->stats->kernel_dropped;
+            break;
+        case STAT_UNPROCESSED_QUEUE_DEPTH:
+            result = stats->network_listener_to_parser != NULL ? chan_size(stats->network_listener_to_parser) : 0;
+            break;
+        case STAT_PARSED_QUEUE_DEPTH:
+        {
+            result = 0;
+            if (stats->parser_to_aggregator != NULL) {
+                unsigned int i;
+                for (i = 0; i < config->aggregator_threads; i++) {
+                    result += chan_size(stats->parser_to_aggregator[i]);
+                }
+            }
+            break;
+        }
         default:
             result = 0;
             break;
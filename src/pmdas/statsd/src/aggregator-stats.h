@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <chan/chan.h>
 
 #include "config-reader.h"
 
@@ -27,7 +28,11 @@ typedef enum STAT_TYPE {
     STAT_AGGREGATED,
     STAT_TIME_SPENT_PARSING,
     STAT_TIME_SPENT_AGGREGATING,
-    STAT_TRACKED_METRIC
+    STAT_TRACKED_METRIC,
+    STAT_QUEUE_DROPPED,
+    STAT_KERNEL_DROPPED,
+    STAT_UNPROCESSED_QUEUE_DEPTH,
+    STAT_PARSED_QUEUE_DEPTH
 } STAT_TYPE;
 
 typedef struct metric_counters {
@@ -43,12 +48,16 @@ typedef struct pmda_stats {
     size_t aggregated;
     size_t time_spent_parsing;
     size_t time_spent_aggregating;
+    size_t queue_dropped;
+    size_t kernel_dropped;
     struct metric_counters* metrics_recorded;
 } pmda_stats;
 
 typedef struct pmda_stats_container {
     struct pmda_stats* stats;
     pthread_mutex_t mutex;
+    chan_t* network_listener_to_parser;
+    chan_t** parser_to_aggregator; // one channel per aggregator thread
 } pmda_stats_container;
 
 /**
@@ -30,23 +30,30 @@
 #include "aggregator-stats.h"
 
 /**
- * Mutex guarding aggregator proccesing, so there are no race condiditions if we request debug output.
+ * Lock guarding aggregator proccesing, so there are no race condiditions if we request debug output.
+ * Aggregator threads each work on their own metrics shards, so they only need to hold it for reading.
  */
-static pthread_mutex_t g_aggregator_processing_lock;
+static pthread_rwlock_t g_aggregator_processing_lock = PTHREAD_RWLOCK_INITIALIZER;
 
 /**
  * This is shared with a function thats called from signal handler, should debug data be requested
+ * - all aggregator threads share the same config and containers, so any of their args will do
  */
 static struct aggregator_args* g_aggregator_args = NULL;
 
 /**
- * Thread startpoint - passes down given datagram to aggregator to record value it contains (should be used for a single new thread)
+ * Thread startpoint - passes down given datagram to aggregator to record value it contains
+ * - there may be several aggregator threads, each receiving datagrams of metrics in shards it owns, see config aggregator_threads
  * @arg args - aggregator_args
  */
 void*
 aggregator_exec(void* args) {
     pthread_setname_np(pthread_self(), "Aggregator");
-    g_aggregator_args = (struct aggregator_args*)args;
+    pthread_rwlock_wrlock(&g_aggregator_processing_lock);
+    if (g_aggregator_args == NULL) {
+        g_aggregator_args = (struct aggregator_args*)args;
+    }
+    pthread_rwlock_unlock(&g_aggregator_processing_lock);
     struct agent_config* config = ((struct aggregator_args*)args)->config;
     struct pmda_metrics_container* metrics_container = ((struct aggregator_args*)args)->metrics_container;
     struct pmda_stats_container* stats_container = ((struct aggregator_args*)args)->stats_container;
@@ -72,13 +79,13 @@ aggregator_exec(void* args) {
             free_parser_to_aggregator_message(message);
             continue;
         }
-        pthread_mutex_lock(&g_aggregator_processing_lock);
+        pthread_rwlock_rdlock(&g_aggregator_processing_lock);
         process_stat(config, stats_container, STAT_RECEIVED, NULL);
         if (message->type == PARSER_RESULT_PARSED) {
             clock_gettime(CLOCK_MONOTONIC, &t0);
             int status = process_metric(config, metrics_container, (struct statsd_datagram*) message->data);
             clock_gettime(CLOCK_MONOTONIC, &t1);
-            time_spent_aggregating = t1.tv_nsec - t0.tv_nsec;
+            time_spent_aggregating = (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
             process_stat(config, stats_container, STAT_PARSED, NULL);
             process_stat(config, stats_container, STAT_TIME_SPENT_PARSING, &message->time);
             if (status) {
@@ -92,7 +99,7 @@ aggregator_exec(void* args) {
             process_stat(config, stats_container, STAT_TIME_SPENT_PARSING, &message->time);
         }
         free_parser_to_aggregator_message(message);
-        pthread_mutex_unlock(&g_aggregator_processing_lock);
+        pthread_rwlock_unlock(&g_aggregator_processing_lock);
     }
     VERBOSE_LOG(2, "Aggregator thread exiting.");
     pthread_exit(NULL);
@@ -104,10 +111,10 @@ aggregator_exec(void* args) {
 void
 aggregator_debug_output() {
     if (g_aggregator_args != NULL) {
-        pthread_mutex_lock(&g_aggregator_processing_lock);
+        pthread_rwlock_wrlock(&g_aggregator_processing_lock);
         write_metrics_to_file(g_aggregator_args->config, g_aggregator_args->metrics_container);
         write_stats_to_file(g_aggregator_args->config, g_aggregator_args->stats_container);
-        pthread_mutex_unlock(&g_aggregator_processing_lock);
+        pthread_rwlock_unlock(&g_aggregator_processing_lock);
     }
 }
 
@@ -32,7 +32,8 @@ typedef struct aggregator_args
 } aggregator_args;
 
 /**
- * Thread startpoint - passes down given datagram to aggregator to record value it contains (should be used for a single new thread)
+ * Thread startpoint - passes down given datagram to aggregator to record value it contains
+ * - there may be several aggregator threads, each receiving datagrams of metrics in shards it owns, see config aggregator_threads
  * @arg args - aggregator_args
  */
 extern void*
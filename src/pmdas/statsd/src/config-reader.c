@@ -33,6 +33,9 @@ set_default_config(struct agent_config* config) {
     memcpy(config->debug_output_filename, "debug", 6);
     config->show_version = 0;
     config->port = 8125;
+    config->listener_threads = 1;
+    config->parser_threads = 1;
+    config->aggregator_threads = 1;
     config->parser_type = PARSER_TYPE_BASIC;
     config->duration_aggregation_type = DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM;
     pmGetUsername(&(config->username));
@@ -71,6 +74,21 @@ ini_line_handler(void* user, const char* section, const char* name, const char*
         if (param < UINT32_MAX) {
             dest->port = (unsigned int) param;
         }
+    } else if (MATCH("listener_threads")) {
+        long unsigned int param = strtoul(value, NULL, 10);
+        if (param >= 1 && param <= MAX_WORKER_THREADS) {
+            dest->listener_threads = (unsigned int) param;
+        }
+    } else if (MATCH("parser_threads")) {
+        long unsigned int param = strtoul(value, NULL, 10);
+        if (param >= 1 && param <= MAX_WORKER_THREADS) {
+            dest->parser_threads = (unsigned int) param;
+        }
+    } else if (MATCH("aggregator_threads")) {
+        long unsigned int param = strtoul(value, NULL, 10);
+        if (param >= 1 && param <= MAX_AGGREGATOR_THREADS) {
+            dest->aggregator_threads = (unsigned int) param;
+        }
     } else if (MATCH("verbose")) {
         long unsigned int param = strtoul(value, NULL, 10);
         if (param < 3) {
@@ -93,7 +111,7 @@ ini_line_handler(void* user, const char* section, const char* name, const char*
         }
     } else if (MATCH("duration_aggregation_type")) {
         long unsigned int param = strtoul(value, NULL, 10);
-        if (param < UINT32_MAX) {
+        if (param <= DURATION_AGGREGATION_TYPE_DDSKETCH) {
             dest->duration_aggregation_type = (unsigned int) param;
         }
     } else {
@@ -137,13 +155,16 @@ read_agent_config_cmd(pmdaInterface* dispatch, struct agent_config* dest, int ar
         { "max-udp", 1, 'Z', "MAX-UDP", "Maximum size of UDP datagram" },
         { "port", 1, 'P', "PORT", "Port to listen to" },
         { "parser-type", 1, 'r', "PARSER-TYPE", "Parser type to use (ragel = 1, basic = 0)" },
-        { "duration-aggregation-type", 1, 'a', "DURATION-AGGREGATION-TYPE", "Aggregation type for duration metric to use (hdr_histogram = 1, basic histogram = 0)" },
+        { "duration-aggregation-type", 1, 'a', "DURATION-AGGREGATION-TYPE", "Aggregation type for duration metric to use (ddsketch = 2, hdr_histogram = 1, basic histogram = 0)" },
         { "max-unprocessed-packets-size:", 1, 'z', "MAX-UNPROCESSED-PACKETS-SIZE", "Maximum count of unprocessed packets." },
+        { "listener-threads", 1, 'L', "LISTENER-THREADS", "Number of threads receiving datagrams" },
+        { "parser-threads", 1, 'T', "PARSER-THREADS", "Number of threads parsing datagrams" },
+        { "aggregator-threads", 1, 'A', "AGGREGATOR-THREADS", "Number of threads aggregating parsed datagrams" },
         PMDA_OPTIONS_END
     };
 
     static pmdaOptions opts = {
-        .short_options = "D:d:l:U:v:so:Z:P:r:a:z:?",
+        .short_options = "D:d:l:U:v:so:Z:P:r:a:z:L:T:A:?",
         .long_options = longopts,
     };
     while(1) {
@@ -202,7 +223,7 @@ read_agent_config_cmd(pmdaInterface* dispatch, struct agent_config* dest, int ar
             case 'a':
             {
                 long unsigned int param = strtoul(opts.optarg, NULL, 10);		
-                if (param < UINT32_MAX) {		
+                if (param <= DURATION_AGGREGATION_TYPE_DDSKETCH) {		
                     dest->duration_aggregation_type = (unsigned int) param;		
                 } else {
                     pmNotifyErr(LOG_INFO, "duration_aggregation_type option value is out of bounds.");
@@ -219,6 +240,36 @@ read_agent_config_cmd(pmdaInterface* dispatch, struct agent_config* dest, int ar
                 }
                 break;
             }
+            case 'L':
+            {
+                long unsigned int param = strtoul(opts.optarg, NULL, 10);
+                if (param >= 1 && param <= MAX_WORKER_THREADS) {
+                    dest->listener_threads = (unsigned int) param;
+                } else {
+                    pmNotifyErr(LOG_INFO, "listener_threads option value is out of bounds.");
+                }
+                break;
+            }
+            case 'T':
+            {
+                long unsigned int param = strtoul(opts.optarg, NULL, 10);
+                if (param >= 1 && param <= MAX_WORKER_THREADS) {
+                    dest->parser_threads = (unsigned int) param;
+                } else {
+                    pmNotifyErr(LOG_INFO, "parser_threads option value is out of bounds.");
+                }
+                break;
+            }
+            case 'A':
+            {
+                long unsigned int param = strtoul(opts.optarg, NULL, 10);
+                if (param >= 1 && param <= MAX_AGGREGATOR_THREADS) {
+                    dest->aggregator_threads = (unsigned int) param;
+                } else {
+                    pmNotifyErr(LOG_INFO, "aggregator_threads option value is out of bounds.");
+                }
+                break;
+            }
         }
     }
     if (opts.errors) {
@@ -245,7 +296,11 @@ print_agent_config(struct agent_config* config) {
     pmNotifyErr(LOG_INFO, "parser_type: %s \n", config->parser_type == PARSER_TYPE_BASIC ? "BASIC" : "RAGEL");
     pmNotifyErr(LOG_INFO, "maximum of unprocessed packets: %d \n", config->max_unprocessed_packets);
     pmNotifyErr(LOG_INFO, "maximum udp packet size: %ld \n", config->max_udp_packet_size);
+    pmNotifyErr(LOG_INFO, "listener threads: %d \n", config->listener_threads);
+    pmNotifyErr(LOG_INFO, "parser threads: %d \n", config->parser_threads);
+    pmNotifyErr(LOG_INFO, "aggregator threads: %d \n", config->aggregator_threads);
     pmNotifyErr(LOG_INFO, "duration_aggregation_type: %s\n", 
-        config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM ? "HDR_HISTOGRAM" : "BASIC");
+        config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM ? "HDR_HISTOGRAM" :
+        config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_DDSKETCH ? "DDSKETCH" : "BASIC");
     pmNotifyErr(LOG_INFO, "</settings>\n");
 }
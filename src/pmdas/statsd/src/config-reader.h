@@ -21,6 +21,16 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+/**
+ * Upper bound for both listener_threads and parser_threads settings
+ */
+#define MAX_WORKER_THREADS 64
+
+/**
+ * Upper bound for aggregator_threads setting, each aggregator owns at least one metrics hashtable shard
+ */
+#define MAX_AGGREGATOR_THREADS 16
+
 typedef enum PARSER_TYPE {
     PARSER_TYPE_BASIC = 0,
     PARSER_TYPE_RAGEL = 1
@@ -28,7 +38,8 @@ typedef enum PARSER_TYPE {
 
 typedef enum DURATION_AGGREGATION_TYPE {
     DURATION_AGGREGATION_TYPE_BASIC = 0,
-    DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM = 1
+    DURATION_AGGREGATION_TYPE_HDR_HISTOGRAM = 1,
+    DURATION_AGGREGATION_TYPE_DDSKETCH = 2
 } DURATION_AGGREGATION_TYPE;
 
 typedef struct agent_config {
@@ -39,6 +50,9 @@ typedef struct agent_config {
     unsigned int show_version;
     unsigned int max_unprocessed_packets;
     unsigned int port;
+    unsigned int listener_threads;
+    unsigned int parser_threads;
+    unsigned int aggregator_threads;
     char* debug_output_filename;
     char* username;
 } agent_config;
@@ -21,6 +21,8 @@
 #include <chan/chan.h>
 #include <pthread.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
 #include <signal.h>
 
 #include "network-listener.h"
@@ -28,28 +30,27 @@
 #include "parser-ragel.h"
 #include "utils.h"
 #include "config-reader.h"
+#include "aggregator-stats.h"
 
 /**
- * Thread entrypoint - listens on address and port specified in config 
- * for UDP/TCP containing StatsD payload and then sends it over to parser thread for parsing
- * @arg args - network_listener_args
+ * Creates, configures and binds a listening UDP socket
+ * - with more than one listener thread, each thread binds its own socket to the same port
+ *   with SO_REUSEPORT and the kernel spreads incoming datagrams between them
+ * @arg config - Application config
+ * @return socket file descriptor
  */
-void*
-network_listener_exec(void* args) {
-    pthread_setname_np(pthread_self(), "Net. Listener");
-    static char* end_message = "PMDASTATSD_EXIT"; 
-    struct agent_config* config = ((struct network_listener_args*)args)->config;
-    chan_t* network_listener_to_parser = ((struct network_listener_args*)args)->network_listener_to_parser;
+static int
+create_listener_socket(struct agent_config* config) {
     const char* hostname = 0;
     struct addrinfo hints;
-    fd_set readfds;
+    struct addrinfo* res = 0;
+    char port_buffer[6];
+    int enable = 1;
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_DGRAM;
     hints.ai_protocol = 0;
     hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG;
-    struct addrinfo* res = 0;
-    char port_buffer[6];
     pmsprintf(port_buffer, 6, "%d", config->port);
     int err = getaddrinfo(hostname, port_buffer, &hints, &res);
     if (err != 0) {
@@ -59,65 +60,154 @@ network_listener_exec(void* args) {
     if (fd == -1) {
         DIE("failed creating socket (err=%s)", strerror(errno));
     }
+    if (config->listener_threads > 1 &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+        DIE("failed setting SO_REUSEPORT on socket (err=%s)", strerror(errno));
+    }
+#ifdef SO_RXQ_OVFL
+    // ask kernel to report count of datagrams dropped on full socket receive buffer
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+#endif
     if (bind(fd, res->ai_addr, res->ai_addrlen) == -1) {
         DIE("failed binding socket (err=%s)", strerror(errno));
     }
-    VERBOSE_LOG(0, "Socket enstablished.");
-    VERBOSE_LOG(0, "Waiting for datagrams.");
     fcntl(fd, F_SETFL, O_NONBLOCK);
-    struct timeval tv;
     freeaddrinfo(res);
+    return fd;
+}
+
+/**
+ * Extracts socket receive queue overflow count from ancillary data of received datagram
+ * @arg header - Received message header
+ * @arg dropped - Placeholder for the cumulative count of datagrams kernel dropped on this socket
+ */
+static void
+read_kernel_drops(struct msghdr* header, uint32_t* dropped) {
+#ifdef SO_RXQ_OVFL
+    struct cmsghdr* cmsg;
+    for (cmsg = CMSG_FIRSTHDR(header); cmsg != NULL; cmsg = CMSG_NXTHDR(header, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(dropped, CMSG_DATA(cmsg), sizeof(*dropped));
+        }
+    }
+#else
+    (void)header;
+    (void)dropped;
+#endif
+}
+
+/**
+ * Thread entrypoint - listens on address and port specified in config 
+ * for UDP/TCP containing StatsD payload and then sends it over to parser threads for parsing
+ * - receives datagrams in batches of up to LISTENER_BATCH_SIZE with single recvmmsg call
+ * - datagrams that don't fit into the parser queue are dropped and counted, rather than
+ *   blocking receiving and making kernel drop them silently
+ * @arg args - network_listener_args
+ */
+void*
+network_listener_exec(void* args) {
+    pthread_setname_np(pthread_self(), "Net. Listener");
+    static char* end_message = "PMDASTATSD_EXIT"; 
+    struct agent_config* config = ((struct network_listener_args*)args)->config;
+    chan_t* network_listener_to_parser = ((struct network_listener_args*)args)->network_listener_to_parser;
+    struct pmda_stats_container* stats = ((struct network_listener_args*)args)->stats_container;
+    int fd = create_listener_socket(config);
+    VERBOSE_LOG(0, "Socket enstablished.");
+    VERBOSE_LOG(0, "Waiting for datagrams.");
     int max_udp_packet_size = config->max_udp_packet_size;
-    char *buffer = (char *) malloc(max_udp_packet_size * sizeof(char*));
-    struct sockaddr_storage src_addr;
-    socklen_t src_addr_len = sizeof(src_addr);
-    int rv;
-    while(1) {
-        FD_ZERO(&readfds);
-        FD_SET(fd, &readfds);
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-        rv = select(fd + 1, &readfds, NULL, NULL, &tv);
-        if (rv == 1) {
-            ssize_t count = recvfrom(fd, buffer, max_udp_packet_size, 0, (struct sockaddr*)&src_addr, &src_addr_len);
-            if (count == -1) {
-                DIE("%s", strerror(errno));
-            } 
-            // since we checked for -1
-            else if ((signed int)count == max_udp_packet_size) { 
+    char *buffers = (char *) malloc(LISTENER_BATCH_SIZE * max_udp_packet_size * sizeof(char));
+    ALLOC_CHECK("Unable to assign memory for datagram buffers.");
+    struct mmsghdr messages[LISTENER_BATCH_SIZE];
+    struct iovec iovecs[LISTENER_BATCH_SIZE];
+    char control[LISTENER_BATCH_SIZE][CMSG_SPACE(sizeof(uint32_t))];
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    uint32_t kernel_dropped = 0, kernel_dropped_seen = 0;
+    unsigned long queue_dropped;
+    chan_t* send_chans[1] = { network_listener_to_parser };
+    void* send_msgs[1];
+    int i, count, rv;
+    int exiting = 0;
+    while(!exiting) {
+        rv = poll(&pfd, 1, 1000);
+        if (rv != 1) {
+            if (check_exit_flag()) {
+                break;
+            }
+            continue;
+        }
+        for (i = 0; i < LISTENER_BATCH_SIZE; i++) {
+            iovecs[i].iov_base = buffers + (i * max_udp_packet_size);
+            iovecs[i].iov_len = max_udp_packet_size;
+            memset(&messages[i], 0, sizeof(struct mmsghdr));
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_control = control[i];
+            messages[i].msg_hdr.msg_controllen = sizeof(control[i]);
+        }
+        count = recvmmsg(fd, messages, LISTENER_BATCH_SIZE, MSG_DONTWAIT, NULL);
+        if (count == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                continue;
+            }
+            DIE("%s", strerror(errno));
+        }
+        queue_dropped = 0;
+        for (i = 0; i < count; i++) {
+            char* buffer = (char*) iovecs[i].iov_base;
+            size_t length = messages[i].msg_len;
+            read_kernel_drops(&messages[i].msg_hdr, &kernel_dropped);
+            if (length == (size_t)max_udp_packet_size || (messages[i].msg_hdr.msg_flags & MSG_TRUNC)) { 
                 VERBOSE_LOG(2, "Datagram too large for buffer: truncated and skipped");
-            } else {
-                struct unprocessed_statsd_datagram* datagram = (struct unprocessed_statsd_datagram*) malloc(sizeof(struct unprocessed_statsd_datagram));
-                ALLOC_CHECK("Unable to assign memory for struct representing unprocessed datagrams.");
-                datagram->value = (char*) malloc(sizeof(char) * (count + 1));
-                ALLOC_CHECK("Unable to assign memory for datagram value.");
-                memcpy(datagram->value, buffer, count);
-                datagram->value[count] = '\0';
-                if (strcmp(end_message, datagram->value) == 0) {
-                    free_unprocessed_datagram(datagram);
-                    kill(getpid(), SIGINT);
-                    break;
-                }
-                chan_send(network_listener_to_parser, datagram);
+                continue;
             }
-            memset(buffer, 0, max_udp_packet_size);
-            rv = 0;
-        } else {
-            int exit_flag = check_exit_flag();
-            if (exit_flag) {        
+            struct unprocessed_statsd_datagram* datagram = (struct unprocessed_statsd_datagram*) malloc(sizeof(struct unprocessed_statsd_datagram));
+            ALLOC_CHECK("Unable to assign memory for struct representing unprocessed datagrams.");
+            datagram->value = (char*) malloc(sizeof(char) * (length + 1));
+            ALLOC_CHECK("Unable to assign memory for datagram value.");
+            memcpy(datagram->value, buffer, length);
+            datagram->value[length] = '\0';
+            if (strcmp(end_message, datagram->value) == 0) {
+                free_unprocessed_datagram(datagram);
+                kill(getpid(), SIGINT);
+                exiting = 1;
                 break;
             }
+            // non-blocking send, parser queue full means parsers can't keep up
+            send_msgs[0] = datagram;
+            if (chan_select(NULL, 0, NULL, send_chans, 1, send_msgs) == -1) {
+                free_unprocessed_datagram(datagram);
+                queue_dropped++;
+            }
+        }
+        if (queue_dropped) {
+            process_stat(config, stats, STAT_QUEUE_DROPPED, &queue_dropped);
+        }
+        if (kernel_dropped != kernel_dropped_seen) {
+            unsigned long delta = (uint32_t)(kernel_dropped - kernel_dropped_seen);
+            process_stat(config, stats, STAT_KERNEL_DROPPED, &delta);
+            kernel_dropped_seen = kernel_dropped;
         }
     }
     VERBOSE_LOG(2, "Network listener thread exiting.");
+    close(fd);
+    free(buffers);
+    pthread_exit(NULL);
+}
+
+/**
+ * Tells one parser thread to exit, sent by main thread once all listener threads are joined
+ * @arg network_listener_to_parser - Network listener -> Parser
+ */
+void
+send_listener_end_message(chan_t* network_listener_to_parser) {
+    static char* end_message = "PMDASTATSD_EXIT"; 
     struct unprocessed_statsd_datagram* datagram = (struct unprocessed_statsd_datagram*) malloc(sizeof(struct unprocessed_statsd_datagram));
     ALLOC_CHECK("Unable to assign memory for struct representing unprocessed datagrams.");
     size_t length = strlen(end_message) + 1;
     datagram->value = (char*) malloc(sizeof(char) * length);
+    ALLOC_CHECK("Unable to assign memory for datagram value.");
     memcpy(datagram->value, end_message, length);
     chan_send(network_listener_to_parser, datagram);
-    free(buffer);
-    pthread_exit(NULL);
 }
 
 /**
@@ -138,14 +228,15 @@ free_unprocessed_datagram(struct unprocessed_statsd_datagram* datagram) {
  * Creates arguments for network listener thread
  * @arg config - Application config
  * @arg unprocessed_channel - Network listener -> Parser
- * @arg stats_sink - Channel for sending stats about PMDA itself
+ * @arg stats - Container for stats about PMDA itself
  * @return network_listener_args
  */
 struct network_listener_args*
-create_listener_args(struct agent_config* config, chan_t* network_listener_to_parser) {
+create_listener_args(struct agent_config* config, chan_t* network_listener_to_parser, struct pmda_stats_container* stats) {
     struct network_listener_args* listener_args = (struct network_listener_args*) malloc(sizeof(struct network_listener_args));
     ALLOC_CHECK("Unable to assign memory for listener arguments.");
     listener_args->config = config;
     listener_args->network_listener_to_parser = network_listener_to_parser;
+    listener_args->stats_container = stats;
     return listener_args;
 }
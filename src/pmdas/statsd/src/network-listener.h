@@ -19,6 +19,12 @@
 #include <chan/chan.h>
 
 #include "config-reader.h"
+#include "aggregator-stats.h"
+
+/**
+ * Maximum number of datagrams received with single recvmmsg call
+ */
+#define LISTENER_BATCH_SIZE 64
 
 typedef struct unprocessed_statsd_datagram
 {
@@ -29,16 +35,24 @@ typedef struct network_listener_args
 {
     struct agent_config* config;
     chan_t* network_listener_to_parser;
+    struct pmda_stats_container* stats_container;
 } network_listener_args;
 
 /**
  * Thread entrypoint - listens on address and port specified in config 
- * for UDP/TCP containing StatsD payload and then sends it over to parser thread for parsing
+ * for UDP/TCP containing StatsD payload and then sends it over to parser threads for parsing
  * @arg args - network_listener_args
  */
 extern void*
 network_listener_exec(void* args);
 
+/**
+ * Tells one parser thread to exit, sent by main thread once all listener threads are joined
+ * @arg network_listener_to_parser - Network listener -> Parser
+ */
+extern void
+send_listener_end_message(chan_t* network_listener_to_parser);
+
 /**
  * Free unprocessed datagram
  * @arg datagram
@@ -50,9 +64,10 @@ free_unprocessed_datagram(struct unprocessed_statsd_datagram* datagram);
  * Creates arguments for network listener thread
  * @arg config - Application config
  * @arg network_listener_to_parser - Network listener -> Parser
+ * @arg stats - Container for stats about PMDA itself
  * @return network_listener_args
  */
 extern struct network_listener_args*
-create_listener_args(struct agent_config* config, chan_t* network_listener_to_parser);
+create_listener_args(struct agent_config* config, chan_t* network_listener_to_parser, struct pmda_stats_container* stats);
 
 #endif
@@ -22,6 +22,7 @@
 #include "network-listener.h"
 #include "parsers.h"
 #include "aggregators.h"
+#include "aggregator-metrics.h"
 #include "parser-basic.h"
 #include "parser-ragel.h"
 #include "utils.h"
@@ -29,6 +30,9 @@
 /**
  * Thread entrypoint - listens to incoming payload on a unprocessed channel
  * and sends over successfully parsed data over to Aggregator thread via processed channel
+ * - there may be several parser threads sharing both channels, see config parser_threads
+ * - parsed datagrams are routed by metric name to aggregator thread owning its metrics shard,
+ *   so that each shard is only ever updated by single aggregator
  * @arg args - parser_args
  */
 void*
@@ -37,7 +41,9 @@ parser_exec(void* args) {
     static char* network_end_message = "PMDASTATSD_EXIT";
     struct agent_config* config = ((struct parser_args*)args)->config;
     chan_t* network_listener_to_parser = ((struct parser_args*)args)->network_listener_to_parser;
-    chan_t* parser_to_aggregator = ((struct parser_args*)args)->parser_to_aggregator;
+    chan_t** parser_to_aggregator = ((struct parser_args*)args)->parser_to_aggregator;
+    unsigned int aggregator_count = config->aggregator_threads;
+    unsigned int dropped_index = 0;
     datagram_parse_callback parse_datagram;
     if ((int)config->parser_type == (int)PARSER_TYPE_BASIC) {
         parse_datagram = &basic_parser_parse;
@@ -47,6 +53,7 @@ parser_exec(void* args) {
     struct unprocessed_statsd_datagram* datagram;
     ALLOC_CHECK("Unable to allocate space for unprocessed statsd datagram.");
     char delim[] = "\n";
+    char* saveptr;
     struct timespec t0, t1;
     unsigned long time_spent_parsing;
     int should_exit;
@@ -68,7 +75,7 @@ parser_exec(void* args) {
             continue;
         }
         struct statsd_datagram* parsed;
-        char* tok = strtok(datagram->value, delim);
+        char* tok = strtok_r(datagram->value, delim, &saveptr);
         while (tok != NULL) {
             clock_gettime(CLOCK_MONOTONIC, &t0);
             int success = parse_datagram(tok, &parsed);
@@ -76,22 +83,34 @@ parser_exec(void* args) {
             struct parser_to_aggregator_message* message =
                 (struct parser_to_aggregator_message*) malloc(sizeof(struct parser_to_aggregator_message));
             ALLOC_CHECK("Unable to assign memory for parser to aggregator message.");
-            time_spent_parsing = (t1.tv_nsec) - (t0.tv_nsec);
+            time_spent_parsing = (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
             message->time = time_spent_parsing;
             if (success) {
                 message->data = parsed;
                 message->type = PARSER_RESULT_PARSED;
-                chan_send(parser_to_aggregator, message);
+                size_t shard = get_metric_shard_index(parsed->name);
+                chan_send(parser_to_aggregator[shard % aggregator_count], message);
             } else {
                 message->data = NULL;
                 message->type = PARSER_RESULT_DROPPED;
-                chan_send(parser_to_aggregator, message);
+                // only accounted for, spread them evenly
+                dropped_index = (dropped_index + 1) % aggregator_count;
+                chan_send(parser_to_aggregator[dropped_index], message);
             }
-            tok = strtok(NULL, delim);
+            tok = strtok_r(NULL, delim, &saveptr);
         }
         free_unprocessed_datagram(datagram);
     }
     VERBOSE_LOG(2, "Parser exiting.");
+    pthread_exit(NULL);
+}
+
+/**
+ * Tells aggregator thread to exit, sent by main thread once all parser threads are joined
+ * @arg parser_to_aggregator - Parser -> Aggregator channel of that thread
+ */
+void
+send_parser_end_message(chan_t* parser_to_aggregator) {
     struct parser_to_aggregator_message* message =
         (struct parser_to_aggregator_message*) malloc(sizeof(struct parser_to_aggregator_message));
     ALLOC_CHECK("Unable to assign memory for parser to aggregator message.");
@@ -99,18 +118,17 @@ parser_exec(void* args) {
     message->time = 0;
     message->data = NULL;
     chan_send(parser_to_aggregator, message);
-    pthread_exit(NULL);
 }
 
 /**
  * Creates arguments for parser thread
  * @arg config - Application config
  * @arg network_listener_to_parser - Network listener -> Parser
- * @arg parser_to_aggregator - Parser -> Aggregator
+ * @arg parser_to_aggregator - Parser -> Aggregator channels, indexed by aggregator thread
  * @return parser_args
  */
 struct parser_args*
-create_parser_args(struct agent_config* config, chan_t* network_listener_to_parser, chan_t* parser_to_aggregator) {
+create_parser_args(struct agent_config* config, chan_t* network_listener_to_parser, chan_t** parser_to_aggregator) {
     struct parser_args* parser_args = (struct parser_args*) malloc(sizeof(struct parser_args));
     ALLOC_CHECK("Unable to assign memory for parser arguments.");
     parser_args->config = config;
@@ -24,7 +24,7 @@ typedef struct parser_args
 {
     struct agent_config* config;
     chan_t* network_listener_to_parser;
-    chan_t* parser_to_aggregator;
+    chan_t** parser_to_aggregator; // one channel per aggregator thread, see config aggregator_threads
 } parser_args;
 
 typedef enum METRIC_TYPE { 
@@ -72,15 +72,22 @@ typedef int (*datagram_parse_callback)(char*, struct statsd_datagram**);
 extern void*
 parser_exec(void* args);
 
+/**
+ * Tells aggregator thread to exit, sent by main thread once all parser threads are joined
+ * @arg parser_to_aggregator - Parser -> Aggregator channel of that thread
+ */
+extern void
+send_parser_end_message(chan_t* parser_to_aggregator);
+
 /**
  * Creates arguments for parser thread
  * @arg config - Application config
  * @arg network_listener_to_parser - Network listener -> Parser
- * @arg parser_to_aggregator - Parser -> Aggregator
+ * @arg parser_to_aggregator - Parser -> Aggregator channels, indexed by aggregator thread
  * @return parser_args
  */
 extern struct parser_args*
-create_parser_args(struct agent_config* config, chan_t* network_listener_to_parser, chan_t* parser_to_aggregator);
+create_parser_args(struct agent_config* config, chan_t* network_listener_to_parser, chan_t** parser_to_aggregator);
 
 /**
  * 
@@ -403,6 +403,14 @@ insert_hardcoded_metrics(pmdaExt* pmda) {
     pmdaTreeInsert(data->pcp_pmns, pmID_build(pmda->e_domain, 0, 12), name);
     pmsprintf(name, 64, "statsd.pmda.settings.duration_aggregation_type");
     pmdaTreeInsert(data->pcp_pmns, pmID_build(pmda->e_domain, 0, 13), name);
+    pmsprintf(name, 64, "statsd.pmda.dropped_queue_full");
+    pmdaTreeInsert(data->pcp_pmns, pmID_build(pmda->e_domain, 0, 14), name);
+    pmsprintf(name, 64, "statsd.pmda.dropped_kernel");
+    pmdaTreeInsert(data->pcp_pmns, pmID_build(pmda->e_domain, 0, 15), name);
+    pmsprintf(name, 64, "statsd.pmda.queue_depth.unprocessed");
+    pmdaTreeInsert(data->pcp_pmns, pmID_build(pmda->e_domain, 0, 16), name);
+    pmsprintf(name, 64, "statsd.pmda.queue_depth.parsed");
+    pmdaTreeInsert(data->pcp_pmns, pmID_build(pmda->e_domain, 0, 17), name);
     VERBOSE_LOG(1, "Populated PMNS with hardcoded metrics.");
 }
 
@@ -427,18 +435,22 @@ statsd_map_stats(pmdaExt* pmda) {
     reset_stat(data->config, data->stats_storage, STAT_TRACKED_METRIC);
     insert_hardcoded_metrics(pmda);
     struct pmda_metrics_container* container = data->metrics_storage;
-    pthread_mutex_lock(&container->mutex);
-    metrics* m = container->metrics;
-    dictIterator* iterator = dictGetSafeIterator(m);
-    dictEntry* current;
-    while ((current = dictNext(iterator)) != NULL) {
-        struct metric* item = (struct metric*)current->v.val;
-        char* key = (char*)current->key;
-        map_metric(key, item, pmda);
+    // metrics added while shards are being walked bump generation again, so they get mapped on next request
+    data->generation = get_metrics_generation(container);
+    size_t i;
+    for (i = 0; i < METRICS_SHARD_COUNT; i++) {
+        struct pmda_metrics_shard* shard = &container->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        dictIterator* iterator = dictGetSafeIterator(shard->metrics);
+        dictEntry* current;
+        while ((current = dictNext(iterator)) != NULL) {
+            struct metric* item = (struct metric*)current->v.val;
+            char* key = (char*)current->key;
+            map_metric(key, item, pmda);
+        }
+        dictReleaseIterator(iterator);
+        pthread_mutex_unlock(&shard->mutex);
     }
-    dictReleaseIterator(iterator);
-    data->generation = data->metrics_storage->generation;
-    pthread_mutex_unlock(&container->mutex);
 
     pmdaTreeRebuildHash(data->pcp_pmns, data->pcp_metric_count);
 }
@@ -451,9 +463,7 @@ statsd_map_stats(pmdaExt* pmda) {
 static void
 statsd_possible_reload(pmdaExt* pmda) {    
     struct pmda_data_extension* data = (struct pmda_data_extension*) pmdaExtGetData(pmda);
-    pthread_mutex_lock(&data->metrics_storage->mutex);
-    int need_reload = data->metrics_storage->generation != data->generation ? 1 : 0;
-    pthread_mutex_unlock(&data->metrics_storage->mutex);
+    int need_reload = get_metrics_generation(data->metrics_storage) != data->generation ? 1 : 0;
     if (need_reload) {
         VERBOSE_LOG(1, "statsd: %s: reloading", pmGetProgname());
         statsd_map_stats(pmda);
@@ -612,14 +622,6 @@ statsd_text(int ident, int type, char** buffer, pmdaExt* pmda) {
                 return 0;
             }
             case 10:
-            {
-                static char oneliner[] = "Debug flag.";
-                static char full_description[] = 
-                    "Debug flag. This shows current setting.\n";
-                *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
-                return 0;
-            }
-            case 11:
             {
                 static char oneliner[] = "Debug output filename.";
                 static char full_description[] = 
@@ -627,7 +629,7 @@ statsd_text(int ident, int type, char** buffer, pmdaExt* pmda) {
                 *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
                 return 0;
             }
-            case 12:
+            case 11:
             {
                 static char oneliner[] = "Port that is listened to.";
                 static char full_description[] = 
@@ -635,16 +637,15 @@ statsd_text(int ident, int type, char** buffer, pmdaExt* pmda) {
                 *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
                 return 0;
             }
-            case 13:
+            case 12:
             {
                 static char oneliner[] = "Used parser type.";
                 static char full_description[] = 
                     "Used parser type. This shows current setting.\n";
                 *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
                 return 0;
-                return 0;
             }
-            case 14: 
+            case 13: 
             {
                 static char oneliner[] = "Used duration aggregation type.";
                 static char full_description[] = 
@@ -652,6 +653,42 @@ statsd_text(int ident, int type, char** buffer, pmdaExt* pmda) {
                 *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
                 return 0;
             }
+            case 14:
+            {
+                static char oneliner[] = "Datagrams dropped on full parser queue";
+                static char full_description[] = 
+                    "Number of datagrams that were received but dropped because the queue\n"
+                    "of unprocessed datagrams was full, i.e. parser threads were not able\n"
+                    "to keep up. Consider raising max_unprocessed_packets or parser_threads.\n";
+                *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
+                return 0;
+            }
+            case 15:
+            {
+                static char oneliner[] = "Datagrams dropped by kernel";
+                static char full_description[] = 
+                    "Number of datagrams the kernel dropped because a listening socket's\n"
+                    "receive buffer was full, i.e. listener threads were not able to keep up.\n"
+                    "Consider raising listener_threads.\n";
+                *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
+                return 0;
+            }
+            case 16:
+            {
+                static char oneliner[] = "Datagrams waiting to be parsed";
+                static char full_description[] = 
+                    "Current number of received datagrams queued for parser threads.\n";
+                *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
+                return 0;
+            }
+            case 17:
+            {
+                static char oneliner[] = "Parsed metrics waiting to be aggregated";
+                static char full_description[] = 
+                    "Current number of parsed metrics queued for the aggregator thread.\n";
+                *buffer = (type & PM_TEXT_ONELINE) ? oneliner : full_description;
+                return 0;
+            }
         }
         return PM_ERR_PMID;
     }
@@ -798,9 +835,10 @@ statsd_label_callback(pmInDom in_dom, unsigned int inst, pmLabelSet** lp) {
     if (!found) {
         return 0;
     }
-    pthread_mutex_lock(&data->metrics_storage->mutex);
+    struct pmda_metrics_shard* shard = get_metric_shard(data->metrics_storage, item);
+    pthread_mutex_lock(&shard->mutex);
     pmdaAddLabels(lp, "%s", label->labels);
-    pthread_mutex_unlock(&data->metrics_storage->mutex);
+    pthread_mutex_unlock(&shard->mutex);
     return label->pair_count;
 }
 
@@ -914,10 +952,15 @@ statsd_resolve_static_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pmA
             char* result;
             char* basic = "Basic";
             char* ragel = "HDR histogram";
+            char* ddsketch = "DDSketch";
             if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_BASIC) {
                 result = (char*) malloc(sizeof(char) * 6);
                 ALLOC_CHECK("Unable to allocate memory for duration aggregation type value.");
                 memcpy(result, basic, 6);
+            } else if (config->duration_aggregation_type == DURATION_AGGREGATION_TYPE_DDSKETCH) {
+                result = (char*) malloc(sizeof(char) * 9);
+                ALLOC_CHECK("Unable to allocate memory for duration aggregation type value.");
+                memcpy(result, ddsketch, 9);
             } else {
                 result = (char*) malloc(sizeof(char) * 14);
                 ALLOC_CHECK("Unable to allocate memory for duration aggregation type value.");
@@ -926,6 +969,22 @@ statsd_resolve_static_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pmA
             (*atom)->cp = result;
             break;
         }
+        /* dropped_queue_full */
+        case 14:
+            (*atom)->ull = get_agent_stat(config, stats, STAT_QUEUE_DROPPED, NULL);
+            break;
+        /* dropped_kernel */
+        case 15:
+            (*atom)->ull = get_agent_stat(config, stats, STAT_KERNEL_DROPPED, NULL);
+            break;
+        /* queue_depth.unprocessed */
+        case 16:
+            (*atom)->ull = get_agent_stat(config, stats, STAT_UNPROCESSED_QUEUE_DEPTH, NULL);
+            break;
+        /* queue_depth.parsed */
+        case 17:
+            (*atom)->ull = get_agent_stat(config, stats, STAT_PARSED_QUEUE_DEPTH, NULL);
+            break;
         default:
             status = PM_ERR_PMID;
     }
@@ -945,6 +1004,7 @@ statsd_resolve_dynamic_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pm
     struct pmda_data_extension* data = helper->data;
     struct agent_config* config = data->config;
     struct metric* result = helper->item;
+    struct pmda_metrics_shard* shard = get_metric_shard(data->metrics_storage, result);
     unsigned int serial = pmInDom_serial(mdesc->m_desc.indom);
     int is_default_domain = (serial == STATSD_METRIC_DEFAULT_INDOM) ||
                             (serial == STATSD_METRIC_DEFAULT_DURATION_INDOM);
@@ -952,7 +1012,7 @@ statsd_resolve_dynamic_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pm
     enum DURATION_INSTANCE duration_stat;
     // metrics without any labels
     if (is_default_domain) {
-        pthread_mutex_lock(&data->metrics_storage->mutex);
+        pthread_mutex_lock(&shard->mutex);
         if (result->type == METRIC_TYPE_DURATION) {
             duration_stat = map_to_duration_instance(instance);
             (*atom)->d = get_duration_instance(config, result->value, duration_stat);
@@ -960,7 +1020,7 @@ statsd_resolve_dynamic_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pm
             (*atom)->d = *(double*)result->value;
         }
         status = PMDA_FETCH_STATIC;
-        pthread_mutex_unlock(&data->metrics_storage->mutex);
+        pthread_mutex_unlock(&shard->mutex);
     } 
     // metrics with labels
     else {
@@ -969,7 +1029,7 @@ statsd_resolve_dynamic_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pm
                                     ((result->type == METRIC_TYPE_DURATION && instance < 9) || instance == 0);
         // check if request was for root value
         if (request_for_root_value) {
-            pthread_mutex_lock(&data->metrics_storage->mutex);
+            pthread_mutex_lock(&shard->mutex);
             if (result->type == METRIC_TYPE_DURATION) {
                 duration_stat = map_to_duration_instance(instance);
                 (*atom)->d = get_duration_instance(config, result->value, duration_stat);
@@ -977,7 +1037,7 @@ statsd_resolve_dynamic_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pm
                 (*atom)->d = *(double*)result->value;
             }
             status = PMDA_FETCH_STATIC;
-            pthread_mutex_unlock(&data->metrics_storage->mutex);
+            pthread_mutex_unlock(&shard->mutex);
         } else {
         // else return some labeled value
             int instance_label_offset;
@@ -996,7 +1056,7 @@ statsd_resolve_dynamic_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pm
                 &label
             );
             if (found) {
-                pthread_mutex_lock(&data->metrics_storage->mutex);
+                pthread_mutex_lock(&shard->mutex);
                 if (result->type == METRIC_TYPE_DURATION) {
                     duration_stat = map_to_duration_instance(instance);
                     (*atom)->d = get_duration_instance(config, label->value, duration_stat);
@@ -1004,7 +1064,7 @@ statsd_resolve_dynamic_metric_fetch(pmdaMetric* mdesc, unsigned int instance, pm
                     (*atom)->d = *(double*)label->value;
                 }
                 status = PMDA_FETCH_STATIC;
-                pthread_mutex_unlock(&data->metrics_storage->mutex);
+                pthread_mutex_unlock(&shard->mutex);
             }
         }
     }
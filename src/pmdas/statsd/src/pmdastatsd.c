@@ -21,6 +21,7 @@
 #include "pmdastatsd.h"
 #include "config-reader.h"
 #include "network-listener.h"
+#include "parsers.h"
 #include "aggregators.h"
 #include "aggregator-metrics.h"
 #include "aggregator-stats.h"
@@ -106,19 +107,24 @@ create_statsd_hardcoded_instances(struct pmda_data_extension* data) {
 static void
 create_statsd_hardcoded_metrics(struct pmda_data_extension* data) {
     size_t i;
-    size_t hardcoded_count = 14;
+    size_t hardcoded_count = 18;
     data->pcp_metrics = (pmdaMetric*) malloc(hardcoded_count * sizeof(pmdaMetric));
     ALLOC_CHECK("Unable to allocate space for static PMDA metrics.");
     // helper containing only reference to priv data same for all hardcoded metrics
     static struct pmda_metric_helper helper;
     size_t agent_stat_count = 7;
+    size_t settings_end = 14;
     helper.data = data;
     for (i = 0; i < hardcoded_count; i++) {
         data->pcp_metrics[i].m_user = &helper;
         data->pcp_metrics[i].m_desc.pmid = pmID_build(STATSD, 0, i);
         data->pcp_metrics[i].m_desc.sem = PM_SEM_INSTANT;
-        if (i < agent_stat_count) {
+        if (i < agent_stat_count || i >= settings_end) {
             data->pcp_metrics[i].m_desc.type = PM_TYPE_U64;
+            if (i == 14 || i == 15) {
+                // dropped_queue_full / dropped_kernel
+                data->pcp_metrics[i].m_desc.sem = PM_SEM_COUNTER;
+            }
             if (i == 4) {
                 data->pcp_metrics[i].m_desc.indom = STATS_METRIC_COUNTERS_INDOM;
             } else {
@@ -154,10 +160,14 @@ create_statsd_hardcoded_metrics(struct pmda_data_extension* data) {
 
 static void
 free_shared_data(struct agent_config* config, struct pmda_data_extension* data) {
+    size_t i;
     // frees config
     free(config->debug_output_filename);
-    // remove metrics dictionary and related
-    dictRelease(data->metrics_storage->metrics);
+    // remove metrics dictionaries and related
+    for (i = 0; i < METRICS_SHARD_COUNT; i++) {
+        dictRelease(data->metrics_storage->shards[i].metrics);
+        pthread_mutex_destroy(&data->metrics_storage->shards[i].mutex);
+    }
     // privdata will be left behind, need to remove manually
     free(data->metrics_storage->metrics_privdata);
     pthread_mutex_destroy(&data->metrics_storage->mutex);
@@ -170,7 +180,6 @@ free_shared_data(struct agent_config* config, struct pmda_data_extension* data)
     // free instance map
     dictRelease(data->instance_map);
     // clear PCP metric table
-    size_t i;
     for (i = 0; i < data->pcp_metric_count; i++) {
         size_t j = data->pcp_hardcoded_metric_count;
         if (!(i < j)) {
@@ -253,13 +262,13 @@ main_PDU_loop(pmdaInterface* dispatch) {
 }
 
 static int _isDSO = 1; /* for local contexts */
-static pthread_t network_listener;
-static pthread_t aggregator;
-static pthread_t parser;
+static pthread_t network_listeners[MAX_WORKER_THREADS];
+static pthread_t aggregators[MAX_AGGREGATOR_THREADS];
+static pthread_t parsers[MAX_WORKER_THREADS];
 static chan_t* network_listener_to_parser;
-static chan_t* parser_to_aggregator;
+static chan_t* parser_to_aggregator[MAX_AGGREGATOR_THREADS];
 static struct network_listener_args* listener_thread_args;
-static struct aggregator_args* aggregator_thread_args;
+static struct aggregator_args* aggregator_thread_args[MAX_AGGREGATOR_THREADS];
 static struct parser_args* parser_thread_args;
 static struct agent_config config;
 static struct pmda_data_extension data = { 0 };
@@ -273,6 +282,7 @@ statsd_init(pmdaInterface *dispatch)
     struct pmda_metrics_container* metrics;
     struct pmda_stats_container* stats;
     int pthread_errno, sep = pmPathSeparator();
+    unsigned int i;
 
     if (_isDSO) {
         pmsprintf(
@@ -297,22 +307,35 @@ statsd_init(pmdaInterface *dispatch)
     if (network_listener_to_parser == NULL) {
 	    DIE("Unable to create channel network listener -> parser.");
     }
-    parser_to_aggregator = chan_init(config.max_unprocessed_packets);
-    if (parser_to_aggregator == NULL) {
-	    DIE("Unable to create channel parser -> aggregator.");
+    for (i = 0; i < config.aggregator_threads; i++) {
+        parser_to_aggregator[i] = chan_init(config.max_unprocessed_packets);
+        if (parser_to_aggregator[i] == NULL) {
+            DIE("Unable to create channel parser -> aggregator.");
+        }
     }
 
-    listener_thread_args = create_listener_args(&config, network_listener_to_parser);
+    stats->network_listener_to_parser = network_listener_to_parser;
+    stats->parser_to_aggregator = parser_to_aggregator;
+
+    listener_thread_args = create_listener_args(&config, network_listener_to_parser, stats);
     parser_thread_args = create_parser_args(&config, network_listener_to_parser, parser_to_aggregator);
-    aggregator_thread_args = create_aggregator_args(&config, parser_to_aggregator, metrics, stats);
+    for (i = 0; i < config.aggregator_threads; i++) {
+        aggregator_thread_args[i] = create_aggregator_args(&config, parser_to_aggregator[i], metrics, stats);
+    }
 
     pthread_errno = 0; 
-    pthread_errno = pthread_create(&network_listener, NULL, network_listener_exec, listener_thread_args);
-    PTHREAD_CHECK(pthread_errno);
-    pthread_errno = pthread_create(&parser, NULL, parser_exec, parser_thread_args);
-    PTHREAD_CHECK(pthread_errno);
-    pthread_errno = pthread_create(&aggregator, NULL, aggregator_exec, aggregator_thread_args);
-    PTHREAD_CHECK(pthread_errno);
+    for (i = 0; i < config.listener_threads; i++) {
+        pthread_errno = pthread_create(&network_listeners[i], NULL, network_listener_exec, listener_thread_args);
+        PTHREAD_CHECK(pthread_errno);
+    }
+    for (i = 0; i < config.parser_threads; i++) {
+        pthread_errno = pthread_create(&parsers[i], NULL, parser_exec, parser_thread_args);
+        PTHREAD_CHECK(pthread_errno);
+    }
+    for (i = 0; i < config.aggregator_threads; i++) {
+        pthread_errno = pthread_create(&aggregators[i], NULL, aggregator_exec, aggregator_thread_args[i]);
+        PTHREAD_CHECK(pthread_errno);
+    }
 
     if (dispatch->status != 0) {
         pthread_exit(NULL);
@@ -342,31 +365,47 @@ statsd_init(pmdaInterface *dispatch)
 
 static void
 statsd_done(void) {    
-    if (pthread_join(network_listener, NULL) != 0) {
-        DIE("Error joining network network listener thread.");
-    } else {
-        VERBOSE_LOG(2, "Network listener thread joined.");
+    unsigned int i;
+    for (i = 0; i < config.listener_threads; i++) {
+        if (pthread_join(network_listeners[i], NULL) != 0) {
+            DIE("Error joining network network listener thread.");
+        } else {
+            VERBOSE_LOG(2, "Network listener thread joined.");
+        }
     }
-    if (pthread_join(parser, NULL) != 0) {
-        DIE("Error joining datagram parser thread.");
-    } else {
-        VERBOSE_LOG(2, "Parser thread joined.");
+    // each parser thread exits once it receives an end message
+    for (i = 0; i < config.parser_threads; i++) {
+        send_listener_end_message(network_listener_to_parser);
     }
-    if (pthread_join(aggregator, NULL) != 0) {    
-        DIE("Error joining datagram aggregator thread.");
-    } else {
-        VERBOSE_LOG(2, "Aggregator thread joined.");
+    for (i = 0; i < config.parser_threads; i++) {
+        if (pthread_join(parsers[i], NULL) != 0) {
+            DIE("Error joining datagram parser thread.");
+        } else {
+            VERBOSE_LOG(2, "Parser thread joined.");
+        }
+    }
+    for (i = 0; i < config.aggregator_threads; i++) {
+        send_parser_end_message(parser_to_aggregator[i]);
+        if (pthread_join(aggregators[i], NULL) != 0) {
+            DIE("Error joining datagram aggregator thread.");
+        } else {
+            VERBOSE_LOG(2, "Aggregator thread joined.");
+        }
     }
 
     free_shared_data(&config, &data);
     free(listener_thread_args);
     free(parser_thread_args);
-    free(aggregator_thread_args);
+    for (i = 0; i < config.aggregator_threads; i++) {
+        free(aggregator_thread_args[i]);
+    }
     
     chan_close(network_listener_to_parser);
-    chan_close(parser_to_aggregator);
     chan_dispose(network_listener_to_parser);
-    chan_dispose(parser_to_aggregator);
+    for (i = 0; i < config.aggregator_threads; i++) {
+        chan_close(parser_to_aggregator[i]);
+        chan_dispose(parser_to_aggregator[i]);
+    }
 }
 
 int
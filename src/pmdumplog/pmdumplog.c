@@ -1142,6 +1142,13 @@ main(int argc, char *argv[])
      */
     PM_UNLOCK(ctxp->c_lock);
 
+    /* metadata hash tables are traversed directly, so decode it all now */
+    if ((sts = __pmLogLoadLazyMeta(ctxp->c_archctl)) < 0) {
+	fprintf(stderr, "%s: Cannot load metadata for archive \"%s\": %s\n",
+		pmGetProgname(), opts.archives[0], pmErrStr(sts));
+	exit(1);
+    }
+
     if (mode == PM_MODE_FORW)
 	pmSetMode(mode, &opts.start, 0);
     else
@@ -602,6 +602,7 @@ freeFetch(Fetch *f)
 	pmDestroyContext(f->handle);
 	if (f->result) pmFreeResult(f->result);
 	if (f->pmids) free(f->pmids);
+	__pmHashClear(&f->pmidx);
 	free(f);
     }
 }
@@ -1327,6 +1328,7 @@ dumpTask(Task *t)
     fprintf(stderr, "  eval time: ");
     showFullTime(stderr, t->eval);
     fputc('\n', stderr);
+    fprintf(stderr, "  time spent: %.6f\n", t->spent);
     fprintf(stderr, "  retry delta: ");
     if (t->retry == 0)
 	fprintf(stderr, "N/A");
@@ -152,6 +152,7 @@ typedef struct metric {
     RealTime	    stomp;	/* previous time stamp for rate calculation */
     double	    *vals;	/* vector of values for rate computation */
     int		    offset;	/* offset within sample in expr ring buffer */
+    int		    fetchidx;	/* index of pmid in Fetch pmids[] */
 } Metric;
 
 /*
@@ -184,7 +185,9 @@ typedef struct fetch {
     int            handle;      /* PMCS context handle */
     int		   npmids;	/* number of metrics in fetch */
     pmID	   *pmids;	/* array of metric ids to fetch */
+    __pmHashCtl	   pmidx;	/* pmID -> index in pmids[] */
     pmResult       *result;     /* result of fetch */
+    int		   sts;		/* status of most recent pmFetch */
 } Fetch;
 
 /* set of bundled fetches for single host (may be archive or live):
@@ -216,6 +219,7 @@ typedef struct task {
     Symbol	  *rules;	/* array of rules to be evaluated */
     Host          *hosts;	/* fetches to be executed and waiting */
     pmResult	  *rslt;	/* for secret agent mode */
+    RealTime	  spent;	/* cumulative fetch and evaluation time */
 } Task;
 
 /* value semantics - as in pmDesc plus following */
@@ -203,12 +203,15 @@ eval(Task *task)
 {
     Symbol	*s;
     pmValueSet  *vset;
+    RealTime	begin;
+    RealTime	spent;
     int		i;
 
     if (pmDebugOptions.appl2) {
 	fprintf(stderr, "Evaluating task:\n");
 	dumpTask(task);
     }
+    begin = getReal();
 
     /* fetch metrics */
     taskFetch(task);
@@ -224,6 +227,12 @@ eval(Task *task)
 	s++;
     }
 
+    /* account for fetch and evaluation time */
+    if ((spent = getReal() - begin) > 0) {
+	task->spent += spent;
+	perf->eval_time += (__uint64_t)(spent * 1000000);
+    }
+
     if (verbose) {
 
 	/* send binary values */
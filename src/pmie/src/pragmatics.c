@@ -25,6 +25,8 @@
 
 #include <math.h>
 #include <ctype.h>
+#include <signal.h>
+#include <pthread.h>
 #include "pmapi.h"
 #include "libpcp.h"
 #include "dstruct.h"
@@ -298,6 +300,7 @@ findFetch(Host *h, Metric *m)
     int		    n;
     pmID	    pmid = m->desc.pmid;
     pmID	    *p;
+    __pmHashNode    *hp;
     struct timeval  tv;
 
     /* find existing Fetch bundle */
@@ -333,21 +336,24 @@ findFetch(Host *h, Metric *m)
     }
 
     /* look for existing pmid */
-    p = f->pmids;
-    n = f->npmids;
-    for (i = 0; i < n; i++) {
-	if (*p == pmid) break;
-	p++;
-    }
-
-    /* add new pmid */
-    if (i == n) {
+    if ((hp = __pmHashSearch(pmid, &f->pmidx)) != NULL)
+	i = (int)(__psint_t)hp->data;
+    else {
+	/* add new pmid */
+	n = f->npmids;
 	p = f->pmids;
 	p = ralloc(p, (n+1) * sizeof(pmID));
 	p[n] = pmid;
 	f->npmids = n + 1;
 	f->pmids = p;
+	if ((sts = __pmHashAdd(pmid, (void *)(__psint_t)n, &f->pmidx)) < 0) {
+	    fprintf(stderr, "%s: __pmHashAdd failed: %s\n", pmGetProgname(),
+		    pmErrStr(sts));
+	    exit(1);
+	}
+	i = n;
     }
+    m->fetchidx = i;
 
     return f;
 }
@@ -1012,6 +1018,148 @@ mark_all(Host *hdown)
     }
 }
 
+/*
+ * Live fetches for a Task are issued concurrently, one host per thread,
+ * so a round costs the latency of the slowest host rather than the sum
+ * over all of them.  The PMAPI current context is thread-private and
+ * each Fetch has its own context, so the threads only contend on the
+ * libpcp locks.  Worker threads are started on first use and kept for
+ * the life of pmie, growing to one less than the most live hosts of
+ * any Task (the calling thread fetches too), up to MAXFETCHERS.
+ */
+#define MAXFETCHERS	32
+
+static pthread_mutex_t	fetchlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	fetchwork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	fetchdone = PTHREAD_COND_INITIALIZER;
+static Host		**fetchhosts;	/* live hosts for this round */
+static int		fetchsize;	/* allocated size of fetchhosts */
+static int		fetchcount;	/* number of hosts this round */
+static int		fetchnext;	/* next host to be fetched from */
+static int		fetchbusy;	/* hosts not yet fetched from */
+static int		nfetchers;	/* worker threads started */
+
+/*
+ * fetch from one host, in Fetch order, and as before stop at the
+ * first failure - the host is about to be marked down, so there is
+ * no point waiting on its remaining fetches
+ */
+static void
+fetchHost(Host *h)
+{
+    Fetch	*f;
+
+    for (f = h->fetches; f; f = f->next) {
+	if ((f->sts = pmUseContext(f->handle)) >= 0)
+	    f->sts = pmFetch(f->npmids, f->pmids, &f->result);
+	if (f->sts < 0)
+	    break;
+    }
+}
+
+/* take hosts from this round until there are none left, holding fetchlock */
+static void
+fetchRound(void)
+{
+    Host	*h;
+
+    while (fetchnext < fetchcount) {
+	h = fetchhosts[fetchnext++];
+	pthread_mutex_unlock(&fetchlock);
+	fetchHost(h);
+	pthread_mutex_lock(&fetchlock);
+	if (--fetchbusy == 0)
+	    pthread_cond_signal(&fetchdone);
+    }
+}
+
+static void *
+fetchWorker(void *arg)
+{
+    sigset_t	sigs;
+
+    /* leave signal delivery to the main thread */
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    pthread_mutex_lock(&fetchlock);
+    for ( ; ; ) {
+	fetchRound();
+	pthread_cond_wait(&fetchwork, &fetchlock);
+    }
+    /* NOTREACHED */
+    return NULL;
+}
+
+/*
+ * issue the fetches for all live hosts of a Task concurrently, each
+ * fetch completes or fails within the libpcp request timeout, which
+ * bounds the wait here
+ */
+static void
+fetchLive(Task *t)
+{
+    Host	*h;
+    Host	**hosts;
+    pthread_t	tid;
+    int		n = 0;
+
+    for (h = t->hosts; h; h = h->next) {
+	if (!h->down)
+	    n++;
+    }
+    if (n > fetchsize) {
+	if ((hosts = (Host **)realloc(fetchhosts, n * sizeof(Host *))) == NULL)
+	    n = 0;	/* out of memory, fetch serially */
+	else {
+	    fetchhosts = hosts;
+	    fetchsize = n;
+	}
+    }
+    if (n <= 1) {
+	for (h = t->hosts; h; h = h->next) {
+	    if (!h->down)
+		fetchHost(h);
+	}
+	return;
+    }
+
+    while (nfetchers < n - 1 && nfetchers < MAXFETCHERS) {
+	if (pthread_create(&tid, NULL, fetchWorker, NULL) != 0)
+	    break;	/* any hosts left over are fetched from here */
+	pthread_detach(tid);
+	nfetchers++;
+    }
+
+    pthread_mutex_lock(&fetchlock);
+    fetchcount = 0;
+    for (h = t->hosts; h; h = h->next) {
+	if (!h->down)
+	    fetchhosts[fetchcount++] = h;
+    }
+    fetchnext = 0;
+    fetchbusy = fetchcount;
+    pthread_cond_broadcast(&fetchwork);
+    fetchRound();
+    while (fetchbusy > 0)
+	pthread_cond_wait(&fetchdone, &fetchlock);
+    fetchcount = fetchnext = 0;
+    pthread_mutex_unlock(&fetchlock);
+}
+
+/* are the instances in vset in ascending order? */
+static int
+sorted(pmValueSet *vset)
+{
+    int		i;
+
+    for (i = 1; i < vset->numval; i++) {
+	if (vset->vlist[i-1].inst > vset->vlist[i].inst)
+	    return 0;
+    }
+    return 1;
+}
+
 /* execute fetches for given Task */
 void
 taskFetch(Task *t)
@@ -1026,36 +1174,49 @@ taskFetch(Task *t)
     int		sts;
 
     /* do all fetches, quick as you can */
-    h = t->hosts;
-    while (h) {
-	f = h->fetches;
-	while (f) {
+    for (h = t->hosts; h; h = h->next) {
+	for (f = h->fetches; f; f = f->next) {
 	    if (f->result) pmFreeResult(f->result);
-	    if (! h->down) {
+	    f->result = NULL;
+	}
+    }
+    if (archives) {
+	/* archive contexts are read serially, in host order */
+	for (h = t->hosts; h; h = h->next) {
+	    if (h->down)
+		continue;
+	    for (f = h->fetches; f; f = f->next) {
 		pmUseContext(f->handle);
 		if ((sts = pmFetch(f->npmids, f->pmids, &f->result)) < 0) {
-		    if (archives) {
-			if (sts == PM_ERR_LOGREC) {
-			    fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
-				    pmErrStr(sts));
-			    exit(1);
-			}
-		    }
-		    else {
-			pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
-				symName(f->host->name), pmErrStr(sts));
-			host_state_changed(symName(f->host->conn), STATE_LOSTCONN);
-			h->down = 1;
-			mark_all(h);
+		    if (sts == PM_ERR_LOGREC) {
+			fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
+				pmErrStr(sts));
+			exit(1);
 		    }
 		    f->result = NULL;
 		}
 	    }
-	    else
+	}
+    }
+    else {
+	fetchLive(t);
+
+	/* report failures from this thread, in host order */
+	for (h = t->hosts; h; h = h->next) {
+	    if (h->down)
+		continue;
+	    for (f = h->fetches; f; f = f->next) {
+		if (f->sts >= 0)
+		    continue;
+		pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
+			symName(f->host->name), pmErrStr(f->sts));
 		f->result = NULL;
-	    f = f->next;
+		host_state_changed(symName(f->host->conn), STATE_LOSTCONN);
+		h->down = 1;
+		mark_all(h);
+		break;	/* no later fetches from this host were issued */
+	    }
 	}
-	h = h->next;
     }
 
     /* sort and distribute pmValueSets to requesting Metrics */
@@ -1064,30 +1225,40 @@ taskFetch(Task *t)
 	if (! h->down) {
 	    f = h->fetches;
 	    while (f && (r = f->result)) {
-		/* sort all vlists in result r */
+		/*
+		 * sort all vlists in result r - pmcd usually returns
+		 * instances in the same (often ascending) order every
+		 * time, so only pay for the qsort when out of order
+		 */
 		v = r->vset;
 		for (i = 0; i < r->numpmid; i++) {
-		    if ((*v)->numval > 0) {
+		    if ((*v)->numval > 1 && !sorted(*v)) {
 			qsort((*v)->vlist, (size_t)(*v)->numval,
 			      sizeof(pmValue), compair);
 		    }
 		    v++;
 		}
 
-		/* distribute pmValueSets to Metrics */
+		/*
+		 * distribute pmValueSets to Metrics - the result holds
+		 * one pmValueSet per requested pmid, in pmids[] order
+		 */
 		p = f->profiles;
 		while (p) {
 		    m = p->metrics;
 		    while (m) {
-			for (i = 0; i < r->numpmid; i++) {
-			    if (m->desc.pmid == r->vset[i]->pmid) {
-				if (r->vset[i]->numval > 0) {
-				    m->vset = r->vset[i];
-				    m->stamp = pmtimevalToReal(&r->timestamp);
-				}
-				break;
+			i = m->fetchidx;
+			if (i < 0 || i >= r->numpmid ||
+			    r->vset[i]->pmid != m->desc.pmid) {
+			    for (i = 0; i < r->numpmid; i++) {
+				if (m->desc.pmid == r->vset[i]->pmid)
+				    break;
 			    }
 			}
+			if (i < r->numpmid && r->vset[i]->numval > 0) {
+			    m->vset = r->vset[i];
+			    m->stamp = pmtimevalToReal(&r->timestamp);
+			}
 			m = m->next;
 		    }
 		    p = p->next;
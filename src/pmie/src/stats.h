@@ -16,6 +16,7 @@
 
 #include <sys/types.h>
 #include <sys/param.h>
+#include <stddef.h>
 
 /* subdir nested under PCP_TMP_DIR */
 #define PMIE_SUBDIR	"pmie"
@@ -33,6 +34,11 @@ typedef struct {
     unsigned int	eval_unknown;		/* pmcd.pmie.eval.unknown  */
     unsigned int	eval_actual;		/* pmcd.pmie.eval.actual   */
     unsigned int	version;
+    __uint64_t		eval_time;		/* pmcd.pmie.eval.time     */
 } pmiestats_t;
 
+/* size of the original version 1 layout, without eval_time */
+#define PMIESTATS_V1_SIZE \
+	(offsetof(pmiestats_t, version) + sizeof(unsigned int))
+
 #endif /* STATS_H */
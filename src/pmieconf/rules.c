@@ -2312,7 +2312,8 @@ lookup_processes(int *count, char ***processes)
 		 pmGetConfig("PCP_TMP_DIR"), sep, PMIE_SUBDIR, sep, dp->d_name);
 	if (stat(proc, &statbuf) < 0)
 	    continue;
-	if (statbuf.st_size != sizeof(pmiestats_t))
+	if (statbuf.st_size != sizeof(pmiestats_t) &&
+	    statbuf.st_size != PMIESTATS_V1_SIZE)
 	    continue;
 	if ((fd = open(proc, O_RDONLY)) < 0)
 	    continue;
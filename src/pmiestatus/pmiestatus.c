@@ -38,14 +38,14 @@ main(int argc, char **argv)
 	    goto closefile;
 	}
 
-	if (st.st_size != sizeof(ps)) {
+	if (st.st_size != sizeof(ps) && st.st_size != PMIESTATS_V1_SIZE) {
 	    fprintf(stderr, "%s: %s is not a valid pmie stats file\n",
 		    pmGetProgname(), argv[i]);
 	    goto closefile;
 	}
-	if (read(f, &ps, sizeof(ps)) != sizeof(ps)) {
+	if (read(f, &ps, st.st_size) != st.st_size) {
 	    fprintf(stderr, "%s: cannot read %ld bytes from %s\n",
-		    pmGetProgname(), (long)sizeof(ps), argv[i]);
+		    pmGetProgname(), (long)st.st_size, argv[i]);
 	    goto closefile;
 	}
 
@@ -125,6 +125,11 @@ extern void insertresult(rlist_t **, pmResult *);
 extern pmResult *searchmlist(pmResult *);
 extern void abandon_extract(void);
 
+/* input archive read-ahead */
+extern void startreadahead(int);
+extern void stopreadahead(void);
+extern int readlog(int, pmResult **);
+
 /* command line args needed across source files */
 extern int	xarg;
 
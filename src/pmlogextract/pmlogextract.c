@@ -35,6 +35,7 @@ static pmLongOptions longopts[] = {
     { "config", 1, 'c', "FILE", "file to load configuration from" },
     { "desperate", 0, 'd', 0, "desperate, save output after fatal error" },
     { "first", 0, 'f', 0, "use timezone from first archive [default is last]" },
+    { "threads", 1, 'j', "N", "decode input archives using N read-ahead threads" },
     { "mark", 0, 'm', 0, "ignore prologue/epilogue records and <mark> between archives" },
     PMOPT_START,
     { "samples", 1, 's', "NUM", "terminate after NUM log records have been written" },
@@ -48,7 +49,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "c:D:dfmS:s:T:v:wxZ:z?",
+    .short_options = "c:D:dfj:mS:s:T:v:wxZ:z?",
     .long_options = longopts,
     .short_usage = "[options] input-archive output-archive",
 };
@@ -227,6 +228,7 @@ printsem(FILE *f, int sem)
 #define META			1
 #define LOG_META		2
 #define NUM_SEC_PER_DAY		86400
+#define MAX_READAHEAD		8	/* default limit on -j threads */
 
 #define NOT_WRITTEN		0
 #define MARK_FOR_WRITE		1
@@ -297,6 +299,17 @@ int			inarchnum;	/* number of input archives */
 
 int			ilog;		/* index of earliest log */
 
+/*
+ * inputs with a log record (or mark) ready to go are kept in a binary
+ * min-heap ordered by timestamp and then by index into inarch[], so
+ * picking the earliest is O(log inarchnum) rather than a scan of all
+ * the inputs for every record written
+ */
+static int		*heap;		/* indices into inarch[] */
+static int		heapnum;	/* number of inputs in heap */
+static int		*pending;	/* inputs needing a nextlog() read */
+static int		npending;
+
 static __pmHashCtl	rdesc;		/* meta desc records to be written */
 static __pmHashCtl	rindom;		/* meta indom records to be written */
 static __pmHashCtl	rindomoneline;	/* indom oneline records to be written */
@@ -321,6 +334,7 @@ static pmTimeval	logend = {-1,0};	/* log end time */
 /* command line args */
 char	*configfile;			/* -c arg - name of config file */
 int	farg;				/* -f arg - use first timezone */
+int	jarg = -1;			/* -j arg - read-ahead threads */
 int	old_mark_logic;			/* -m arg - <mark> b/n archives */
 int	sarg = -1;			/* -s arg - finish after X samples */
 char	*Sarg;				/* -S arg - window start */
@@ -1520,18 +1534,79 @@ _createmark(void)
     return((__pmPDU *)markp);
 }
 
-void
-checklogtime(pmTimeval *this, int indx)
+/*
+ * timestamp of the log record (or mark) that input indx has ready
+ */
+static void
+logtime(int indx, pmTimeval *tp)
 {
-    if ((curlog.tv_sec == 0 && curlog.tv_usec == 0) ||
-	(curlog.tv_sec > this->tv_sec ||
-	(curlog.tv_sec == this->tv_sec && curlog.tv_usec > this->tv_usec))) {
-	    ilog = indx;
-	    curlog.tv_sec = this->tv_sec;
-	    curlog.tv_usec = this->tv_usec;
+    inarch_t	*iap = &inarch[indx];
+
+    if (iap->_Nresult != NULL) {
+	tp->tv_sec = iap->_Nresult->timestamp.tv_sec;
+	tp->tv_usec = iap->_Nresult->timestamp.tv_usec;
+    }
+    else {
+	tp->tv_sec = iap->pb[LOG][3];	/* no swab needed */
+	tp->tv_usec = iap->pb[LOG][4];	/* no swab needed */
     }
 }
 
+/*
+ * heap order - earliest timestamp first, and for equal timestamps the
+ * lowest inarch[] index (the archive order on the command line)
+ */
+static int
+heapcmp(int a, int b)
+{
+    pmTimeval	ta;
+    pmTimeval	tb;
+    int		sts;
+
+    logtime(a, &ta);
+    logtime(b, &tb);
+    if ((sts = tvcmp(&ta, &tb)) != 0)
+	return sts;
+    return a - b;
+}
+
+static void
+heappush(int indx)
+{
+    int		i = heapnum++;
+    int		parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (heapcmp(heap[parent], indx) <= 0)
+	    break;
+	heap[i] = heap[parent];
+	i = parent;
+    }
+    heap[i] = indx;
+}
+
+/*
+ * remove the earliest input, heap[0], from the heap
+ */
+static void
+heappop(void)
+{
+    int		last = heap[--heapnum];
+    int		i = 0;
+    int		child;
+
+    while ((child = 2 * i + 1) < heapnum) {
+	if (child + 1 < heapnum && heapcmp(heap[child+1], heap[child]) < 0)
+	    child++;
+	if (heapcmp(last, heap[child]) <= 0)
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = last;
+}
+
 
 /*
  * pick next meta record - if all meta is at EOF return -1
@@ -1835,54 +1910,42 @@ againmeta:
 
 
 /*
- * read in next log record for every archive
+ * read in next log record for every archive that needs one, i.e. those
+ * on the pending list, and add them to the heap
  */
 static int
 nextlog(void)
 {
     int		indx;
-    int		eoflog = 0;	/* number of log files at eof */
     int		sts;
     pmTimeval	curtime;
-    __pmArchCtl	*acp;
     __pmContext	*ctxp;
     inarch_t	*iap;
 
 
-    for (indx=0; indx<inarchnum; indx++) {
+    while (npending > 0) {
+	indx = pending[--npending];
 	iap = &inarch[indx];
 
 	/* if at the end of log file then skip this archive */
-	if (iap->eof[LOG]) {
-	    ++eoflog;
+	if (iap->eof[LOG])
 	    continue;
-	}
-
-	/* if we already have a log record then skip this archive */
-	if (iap->_Nresult != NULL) {
-	    continue;
-	}
 
 	/* if mark has been written out, then log is at EOF */
 	if (iap->mark) {
 	    iap->eof[LOG] = 1;
-	    ++eoflog;
 	    continue;
 	}
 
-	if ((ctxp = __pmHandleToPtr(iap->ctx)) == NULL) {
-	    fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), iap->ctx);
-	    abandon_extract();
-	}
-	/* Need to hold c_lock for __pmLogRead_ctx() */
-	acp = ctxp->c_archctl;
-
 againlog:
-	if ((sts=__pmLogRead_ctx(ctxp, PM_MODE_FORW, NULL, &iap->_result, PMLOGREAD_NEXT)) < 0) {
+	if ((sts = readlog(indx, &iap->_result)) < 0) {
 	    if (sts != PM_ERR_EOL) {
 		fprintf(stderr, "%s: Error: __pmLogRead[log %s]: %s\n",
 			pmGetProgname(), iap->name, pmErrStr(sts));
-		_report(acp->ac_mfp);
+		if ((ctxp = __pmHandleToPtr(iap->ctx)) != NULL) {
+		    _report(ctxp->c_archctl->ac_mfp);
+		    PM_UNLOCK(ctxp->c_lock);
+		}
 		if (sts != PM_ERR_LOGREC)
 		    abandon_extract();
 	    }
@@ -1894,13 +1957,12 @@ againlog:
 	    if (first_datarec) {
 		iap->mark = 1;
 		iap->eof[LOG] = 1;
-		++eoflog;
 	    }
 	    else {
 		iap->mark = 1;
 		iap->pb[LOG] = _createmark();
+		heappush(indx);
 	    }
-	    PM_UNLOCK(ctxp->c_lock);
 	    continue;
 	}
 	iap->recnum++;
@@ -1934,11 +1996,8 @@ againlog:
 			fprintf(stderr,
 			    "%s: Warning: failed to get pmcd.pid from %s at record %d: %s\n",
 				pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
-			if (pmDebugOptions.desperate) {
-			    PM_UNLOCK(ctxp->c_lock);
+			if (pmDebugOptions.desperate)
 			    __pmDumpResult(stderr, iap->_result);
-			    PM_LOCK(ctxp->c_lock);
-			}
 		    }
 		    else
 			iap->pmcd_pid = av.ll;
@@ -1949,11 +2008,8 @@ againlog:
 			fprintf(stderr,
 			    "%s: Warning: failed to get pmcd.seqnum from %s at record %d: %s\n",
 				pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
-			if (pmDebugOptions.desperate) {
-			    PM_UNLOCK(ctxp->c_lock);
+			if (pmDebugOptions.desperate)
 			    __pmDumpResult(stderr, iap->_result);
-			    PM_LOCK(ctxp->c_lock);
-			}
 		    }
 		    else
 			iap->pmcd_seqnum = av.l;
@@ -2005,17 +2061,17 @@ againlog:
                 goto againlog;
             }
 	}
-	PM_UNLOCK(ctxp->c_lock);
-
-    } /*for(indx)*/
+	heappush(indx);
+    }
 
     /*
      * if we are here, then each archive control struct should either
      * be at eof, or it should have a _result, or it should have a mark PDU
      * (if we have a _result, we may want all/some/none of the pmid's in it)
+     * and all but those at eof are in the heap
      */
 
-    if (eoflog == inarchnum) return(-1);
+    if (heapnum == 0) return(-1);
     return 0;
 }
 
@@ -2058,6 +2114,14 @@ parseargs(int argc, char *argv[])
 	    farg = 1;
 	    break;
 
+	case 'j':	/* number of read-ahead threads */
+	    jarg = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || jarg < 0) {
+		pmprintf("%s: -j requires numeric argument\n", pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'm':	/* always add <mark> between archives */
 	    old_mark_logic = 1;
 	    break;
@@ -2194,6 +2258,7 @@ checkwinend(pmTimeval now)
 	    return(-1);
 
     ilog = -1;
+    heapnum = 0;
     for (indx=0; indx<inarchnum; indx++) {
 	iap = &inarch[indx];
 	if (iap->_Nresult != NULL) {
@@ -2224,6 +2289,12 @@ checkwinend(pmTimeval now)
 		iap->pb[LOG] = NULL;
 	    }
 	}
+
+	/* rebuild the heap, and read again for those discarded */
+	if (iap->_Nresult != NULL || iap->pb[LOG] != NULL)
+	    heappush(indx);
+	else if (!iap->eof[LOG])
+	    pending[npending++] = indx;
     } /*for(indx)*/
 
     /* must create "mark" record and write it out */
@@ -2476,10 +2547,7 @@ main(int argc, char **argv)
     char	*msg;
 
     pmTimeval 	now = {0,0};		/* the current time */
-    pmTimeval 	mintime = {0,0};
-    pmTimeval 	tmptime = {0,0};
 
-    pmTimeval	tstamp;			/* temporary timestamp */
     inarch_t	*iap;			/* ptr to archive control */
     rlist_t	*rlready = NULL;	/* results ready for writing */
 
@@ -2520,15 +2588,17 @@ main(int argc, char **argv)
     /* input archive(s) */
     inarchnum = argc - 1 - opts.optind;
     inarch = (inarch_t *) malloc(inarchnum * sizeof(inarch_t));
-    if (inarch == NULL) {
+    heap = (int *) malloc(inarchnum * sizeof(int));
+    pending = (int *) malloc(inarchnum * sizeof(int));
+    if (inarch == NULL || heap == NULL || pending == NULL) {
 	fprintf(stderr, "%s: Error: mallco inarch: %s\n",
 		pmGetProgname(), osstrerror());
 	exit(1);
     }
     if (pmDebugOptions.appl1) {
-        totalmalloc += (inarchnum * sizeof(inarch_t));
+        totalmalloc += (inarchnum * (sizeof(inarch_t) + 2 * sizeof(int)));
         fprintf(stderr, "main        : allocated %d\n",
-			(int)(inarchnum * sizeof(inarch_t)));
+			(int)(inarchnum * (sizeof(inarch_t) + 2 * sizeof(int))));
     }
 
 
@@ -2711,6 +2781,23 @@ main(int argc, char **argv)
 	}
     }
 
+    /*
+     * every input needs its first log record, read in archive order;
+     * by default decode ahead using up to one thread per CPU, unless
+     * diagnostics have been asked for (they would be interleaved)
+     */
+    for (indx=0; indx<inarchnum; indx++)
+	pending[npending++] = inarchnum - 1 - indx;
+    if (jarg < 0) {
+	jarg = 0;
+	if (inarchnum > 1 && pmDebugOptions.log == 0 && pmDebugOptions.lock == 0) {
+	    long	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	    if (ncpu > 1)
+		jarg = ncpu < MAX_READAHEAD ? ncpu : MAX_READAHEAD;
+	}
+    }
+    startreadahead(jarg);
+
     /*
      * get log record - choose one with earliest timestamp
      * write out meta data (required by this log record)
@@ -2724,48 +2811,22 @@ main(int argc, char **argv)
 	old_meta_offset = __pmFtell(logctl.l_mdfp);
 	assert(old_meta_offset >= 0);
 
-	/* nextlog() resets ilog, and curlog (to the smallest timestamp) */
+	/* nextlog() refills the heap of inputs with a record or mark ready */
 	stslog = nextlog();
 
 	if (stslog < 0)
 	    break;
 
 	/*
-	 * find the _Nresult (or mark pdu) with the earliest timestamp;
-	 * set ilog
-	 * (this is a bit more complex when tflag is specified)
+	 * the _Nresult (or mark pdu) with the earliest timestamp is at
+	 * the top of the heap; set ilog and curlog
 	 */
-	mintime.tv_sec = mintime.tv_usec = 0;
-	for (indx=0; indx<inarchnum; indx++) {
-	    if (inarch[indx]._Nresult != NULL) {
-		tstamp.tv_sec = inarch[indx]._Nresult->timestamp.tv_sec;
-		tstamp.tv_usec = inarch[indx]._Nresult->timestamp.tv_usec;
-		checklogtime(&tstamp, indx);
-
-		if (ilog == indx) {
-		    tmptime = curlog;
-		    if (mintime.tv_sec <= 0 || tvcmp(&mintime, &tmptime) > 0)
-		        mintime = tmptime;
-		}
-	    }
-	    else if (inarch[indx].pb[LOG] != NULL) {
-		tstamp.tv_sec = inarch[indx].pb[LOG][3]; /* no swab needed */
-		tstamp.tv_usec = inarch[indx].pb[LOG][4]; /* no swab needed */
-		checklogtime(&tstamp, indx);
-
-		if (ilog == indx) {
-		    tmptime = curlog;
-		    if (mintime.tv_sec <= 0 || tvcmp(&mintime, &tmptime) > 0)
-		        mintime = tmptime;
-		}
-	    }
-	}
+	ilog = heap[0];
+	logtime(ilog, &curlog);
 
 	/*
 	 * now     == the earliest timestamp of the archive(s)
 	 *		and/or mark records
-	 * mintime == now or timestamp of the earliest mark
-	 *		(whichever is smaller)
 	 */
 	now = curlog;
 
@@ -2792,6 +2853,10 @@ main(int argc, char **argv)
 	}
 
 
+	/* this input needs its next record after this one */
+	heappop();
+	pending[npending++] = ilog;
+
 	iap = &inarch[ilog];
 	if (iap->mark) {
 	    if (do_not_need_mark(iap)) {
@@ -2855,6 +2920,8 @@ main(int argc, char **argv)
 	}
     } /*while()*/
 
+    stopreadahead();
+
     if (first_datarec) {
         fprintf(stderr, "%s: Warning: no qualifying records found.\n",
                 pmGetProgname());
@@ -2875,8 +2942,8 @@ cleanup:
 	assert(new_meta_offset >= 0);
 
 #if 0
-	fprintf(stderr, "*** last tstamp: \n\tmintime=%d.%06d \n\ttmptime=%d.%06d \n\tlogend=%d.%06d \n\twinend=%d.%06d \n\tcurrent=%d.%06d\n",
-	    mintime.tv_sec, mintime.tv_usec, tmptime.tv_sec, tmptime.tv_usec, logend.tv_sec, logend.tv_usec, winend.tv_sec, winend.tv_usec, current.tv_sec, current.tv_usec);
+	fprintf(stderr, "*** last tstamp: \n\tlogend=%d.%06d \n\twinend=%d.%06d \n\tcurrent=%d.%06d\n",
+	    logend.tv_sec, logend.tv_usec, winend.tv_sec, winend.tv_usec, current.tv_sec, current.tv_usec);
 #endif
 
 	__pmFseek(archctl.ac_mfp, old_log_offset, SEEK_SET);
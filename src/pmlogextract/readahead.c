@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2020 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * read-ahead of input archive log records for pmlogextract
+ *
+ * Each worker thread owns the inputs indx, indx+nworker, ... and keeps
+ * up to RA_DEPTH decoded pmResults queued for each of them, so reading
+ * and decoding the inputs overlaps with the merge and with writing the
+ * output archive.  Records are handed out in the order they were read,
+ * and an input is not read beyond its first error (or end of log), so
+ * the merged output is the same with or without read-ahead.
+ */
+
+#include <pthread.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "logger.h"
+
+#define RA_DEPTH	4		/* decoded records queued per input */
+
+typedef struct {
+    int		sts;			/* from __pmLogRead_ctx() */
+    pmResult	*result;
+} rarec_t;
+
+typedef struct {
+    rarec_t	rec[RA_DEPTH];		/* ring of decoded records */
+    int		head;			/* next record to hand out */
+    int		count;			/* records decoded, not handed out */
+    int		done;			/* no reads after error or end of log */
+    int		queued;			/* on the worker's todo ring */
+} rainput_t;
+
+typedef struct {
+    pthread_t		tid;
+    pthread_mutex_t	lock;		/* guards this worker and its inputs */
+    pthread_cond_t	more;		/* worker: input(s) need reading */
+    pthread_cond_t	ready;		/* main: a record has been decoded */
+    int			*todo;		/* ring of inputs with queue space */
+    int			ntodo;
+    int			first;		/* head of todo ring */
+    int			size;		/* number of inputs owned */
+    int			urgent;		/* input main is waiting for, or -1 */
+    int			idle;		/* worker is waiting on more */
+    int			waiting;	/* main is waiting on ready */
+    int			stop;
+} raworker_t;
+
+static rainput_t	*rainput;
+static raworker_t	*raworker;
+static int		nworker;
+
+/*
+ * read the next log record for input indx, holding the context lock
+ */
+static int
+logread(int indx, pmResult **result)
+{
+    __pmContext	*ctxp;
+    int		sts;
+
+    if ((ctxp = __pmHandleToPtr(inarch[indx].ctx)) == NULL) {
+	fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), inarch[indx].ctx);
+	abandon_extract();
+    }
+    /* Need to hold c_lock for __pmLogRead_ctx() */
+    sts = __pmLogRead_ctx(ctxp, PM_MODE_FORW, NULL, result, PMLOGREAD_NEXT);
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
+
+/* caller holds wp->lock */
+static void
+addtodo(raworker_t *wp, int indx)
+{
+    rainput_t	*ip = &rainput[indx];
+
+    if (ip->queued || ip->done || ip->count == RA_DEPTH)
+	return;
+    wp->todo[(wp->first + wp->ntodo) % wp->size] = indx;
+    wp->ntodo++;
+    ip->queued = 1;
+}
+
+/*
+ * pick the next input to read, the one main is waiting for first,
+ * otherwise round-robin over the inputs with queue space ... caller
+ * holds wp->lock, returns -1 if there is nothing to do
+ */
+static int
+picktodo(raworker_t *wp)
+{
+    rainput_t	*ip;
+    int		indx;
+
+    if ((indx = wp->urgent) >= 0) {
+	wp->urgent = -1;
+	ip = &rainput[indx];
+	if (!ip->done && ip->count < RA_DEPTH)
+	    return indx;
+    }
+    while (wp->ntodo > 0) {
+	indx = wp->todo[wp->first];
+	wp->first = (wp->first + 1) % wp->size;
+	wp->ntodo--;
+	ip = &rainput[indx];
+	ip->queued = 0;
+	if (!ip->done && ip->count < RA_DEPTH)
+	    return indx;
+    }
+    return -1;
+}
+
+static void *
+worker(void *arg)
+{
+    raworker_t	*wp = (raworker_t *)arg;
+    rainput_t	*ip;
+    pmResult	*result;
+    int		indx;
+    int		slot;
+    int		sts;
+
+    PM_LOCK(wp->lock);
+    while (!wp->stop) {
+	if ((indx = picktodo(wp)) < 0) {
+	    wp->idle = 1;
+	    pthread_cond_wait(&wp->more, &wp->lock);
+	    wp->idle = 0;
+	    continue;
+	}
+	PM_UNLOCK(wp->lock);
+
+	result = NULL;
+	sts = logread(indx, &result);
+
+	PM_LOCK(wp->lock);
+	ip = &rainput[indx];
+	slot = (ip->head + ip->count) % RA_DEPTH;
+	ip->rec[slot].sts = sts;
+	ip->rec[slot].result = sts < 0 ? NULL : result;
+	ip->count++;
+	if (sts < 0)
+	    ip->done = 1;
+	else
+	    addtodo(wp, indx);
+	if (wp->waiting)
+	    pthread_cond_signal(&wp->ready);
+    }
+    PM_UNLOCK(wp->lock);
+    return NULL;
+}
+
+/*
+ * start up to nthreads read-ahead threads for the inarch[] inputs,
+ * called once all of the metadata has been read ... with no threads
+ * readlog() simply reads each record on demand
+ */
+void
+startreadahead(int nthreads)
+{
+    raworker_t	*wp;
+    int		indx;
+    int		w;
+    int		sts;
+
+    if (nthreads > inarchnum)
+	nthreads = inarchnum;
+    if (nthreads <= 0)
+	return;
+
+    rainput = (rainput_t *)calloc(inarchnum, sizeof(rainput_t));
+    raworker = (raworker_t *)calloc(nthreads, sizeof(raworker_t));
+    if (rainput == NULL || raworker == NULL) {
+	fprintf(stderr, "%s: Warning: no memory for read-ahead, continuing without it\n", pmGetProgname());
+	free(rainput);
+	free(raworker);
+	rainput = NULL;
+	raworker = NULL;
+	return;
+    }
+
+    for (w = 0; w < nthreads; w++) {
+	wp = &raworker[w];
+	wp->size = (inarchnum - w + nthreads - 1) / nthreads;
+	if ((wp->todo = (int *)malloc(wp->size * sizeof(int))) == NULL) {
+	    fprintf(stderr, "%s: Error: cannot malloc read-ahead list: %s\n",
+		    pmGetProgname(), osstrerror());
+	    abandon_extract();
+	}
+	pthread_mutex_init(&wp->lock, NULL);
+	pthread_cond_init(&wp->more, NULL);
+	pthread_cond_init(&wp->ready, NULL);
+	wp->urgent = -1;
+    }
+    nworker = nthreads;
+    for (indx = 0; indx < inarchnum; indx++)
+	addtodo(&raworker[indx % nworker], indx);
+
+    for (w = 0; w < nworker; w++) {
+	wp = &raworker[w];
+	if ((sts = pthread_create(&wp->tid, NULL, worker, wp)) != 0) {
+	    fprintf(stderr, "%s: Error: cannot create read-ahead thread: %s\n",
+		    pmGetProgname(), strerror(sts));
+	    abandon_extract();
+	}
+    }
+    if (pmDebugOptions.appl1)
+	fprintf(stderr, "startreadahead: %d threads for %d archives\n",
+		nworker, inarchnum);
+}
+
+/*
+ * stop the read-ahead threads ... any records they have decoded but not
+ * handed out are discarded
+ */
+void
+stopreadahead(void)
+{
+    rainput_t	*ip;
+    raworker_t	*wp;
+    int		indx;
+    int		w;
+
+    if (nworker == 0)
+	return;
+
+    for (w = 0; w < nworker; w++) {
+	wp = &raworker[w];
+	PM_LOCK(wp->lock);
+	wp->stop = 1;
+	pthread_cond_signal(&wp->more);
+	PM_UNLOCK(wp->lock);
+    }
+    for (w = 0; w < nworker; w++) {
+	wp = &raworker[w];
+	pthread_join(wp->tid, NULL);
+	pthread_mutex_destroy(&wp->lock);
+	pthread_cond_destroy(&wp->more);
+	pthread_cond_destroy(&wp->ready);
+	free(wp->todo);
+    }
+    for (indx = 0; indx < inarchnum; indx++) {
+	ip = &rainput[indx];
+	for ( ; ip->count > 0; ip->count--) {
+	    if (ip->rec[ip->head].result != NULL)
+		pmFreeResult(ip->rec[ip->head].result);
+	    ip->head = (ip->head + 1) % RA_DEPTH;
+	}
+    }
+    free(raworker);
+    free(rainput);
+    raworker = NULL;
+    rainput = NULL;
+    nworker = 0;
+}
+
+/*
+ * next log record for input indx, same semantics as __pmLogRead_ctx()
+ * in PM_MODE_FORW ... the caller must not hold the context lock
+ */
+int
+readlog(int indx, pmResult **result)
+{
+    rainput_t	*ip;
+    raworker_t	*wp;
+    int		sts;
+
+    if (nworker == 0)
+	return logread(indx, result);
+
+    ip = &rainput[indx];
+    wp = &raworker[indx % nworker];
+    PM_LOCK(wp->lock);
+    while (ip->count == 0) {
+	if (ip->done) {
+	    /* never read beyond the first error or end of log */
+	    PM_UNLOCK(wp->lock);
+	    return PM_ERR_EOL;
+	}
+	wp->urgent = indx;
+	if (wp->idle)
+	    pthread_cond_signal(&wp->more);
+	wp->waiting = 1;
+	pthread_cond_wait(&wp->ready, &wp->lock);
+	wp->waiting = 0;
+    }
+    sts = ip->rec[ip->head].sts;
+    *result = ip->rec[ip->head].result;
+    ip->head = (ip->head + 1) % RA_DEPTH;
+    ip->count--;
+    if (!ip->queued && !ip->done) {
+	addtodo(wp, indx);
+	if (wp->idle)
+	    pthread_cond_signal(&wp->more);
+    }
+    PM_UNLOCK(wp->lock);
+    return sts;
+}
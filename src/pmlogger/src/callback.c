@@ -620,7 +620,7 @@ do_work(task_t *tp)
 	    if (fp == (fetchctl_t *)0) {
 		lfp->lf_fp = (fetchctl_t *)0;	/* mark lastfetch_t as free */
 		if (lfp->lf_resp != (pmResult *)0) {
-		    pmFreeResult(lfp->lf_resp);
+		    __pmFreeResultPinned(lfp->lf_resp);
 		    lfp->lf_resp =(pmResult *)0;
 		}
 	    }
@@ -728,13 +728,17 @@ do_work(task_t *tp)
 	 * the metadata changes have been written out, call
 	 * __pmEncodeResult to re-encode a PDU buffer before doing
 	 * the pmResult write.
+	 *
+	 * The pmResult is only needed until the next fetch for this
+	 * group, and pb_in is kept pinned until then anyway, so decode
+	 * without copying the pmValueBlocks out of pb_in.
 	 */
 	last_log_offset = __pmFtell(archctl.ac_mfp);
 	assert(last_log_offset >= 0);
 
 	resp = NULL; /* silence coverity */
-	if ((sts = __pmDecodeResult(pb_in, &resp)) < 0) {
-	    fprintf(stderr, "__pmDecodeResult: %s\n", pmErrStr(sts));
+	if ((sts = __pmDecodeResultPinned(pb_in, &resp)) < 0) {
+	    fprintf(stderr, "__pmDecodeResultPinned: %s\n", pmErrStr(sts));
 	    exit(1);
 	}
 	setavail(resp);
@@ -948,9 +952,10 @@ do_work(task_t *tp)
 
 	if (lfp->lf_resp != (pmResult *)0) {
 	    /*
-	     * release memory that is allocated and pinned in pmDecodeResult
+	     * release memory that is allocated and pinned in
+	     * __pmDecodeResultPinned
 	     */
-	    pmFreeResult(lfp->lf_resp);
+	    __pmFreeResultPinned(lfp->lf_resp);
 	}
 	lfp->lf_resp = resp;
 	if (lfp->lf_pb != NULL)
@@ -17,10 +17,27 @@
 #include "encoding.h"
 #include "dict.h"
 #include "util.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 static int chunked_transfer_size; /* pmproxy.chunksize, pagesize by default */
 static int smallest_buffer_size = 128;
 
+#ifdef HAVE_ZLIB
+#define DEFAULT_COMPRESS_SIZE	1024
+static int compress_responses;	/* pmproxy.compress, on by default */
+static int compress_threshold;	/* pmproxy.compressmin, smallest body */
+
+/* only textual content is worth compressing, images already are */
+#define HTTP_FLAG_COMPRESSIBLE	\
+	(HTTP_FLAG_JSON|HTTP_FLAG_TEXT|HTTP_FLAG_HTML|HTTP_FLAG_JS|HTTP_FLAG_CSS)
+
+static void *http_metrics_map;
+static pmAtomValue *http_metrics[NUM_HTTP_METRIC];
+static uv_mutex_t http_metrics_lock;	/* updated from worker threads too */
+#endif
+
 /*
  * Simple helpers to manage the cumulative addition of JSON
  * (arrays and/or objects) to a buffer.
@@ -247,6 +264,129 @@ http_set_buffer(struct client *client, sds buffer, http_flags flags)
     client->buffer = buffer;
 }
 
+#ifdef HAVE_ZLIB
+/*
+ * Parse an Accept-Encoding header value, e.g. "gzip, deflate;q=0.5",
+ * returning non-zero if gzip encoded responses are acceptable.
+ */
+static int
+http_accept_gzip(const char *value)
+{
+    const char		*p = value, *name;
+    char		*endnum;
+    size_t		length;
+    double		quality;
+
+    while (*p) {
+	while (*p == ' ' || *p == '\t' || *p == ',')
+	    p++;
+	name = p;
+	while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+	    p++;
+	length = p - name;
+	quality = 1.0;
+	/* parameters, of which only quality (q=) is of interest */
+	while (*p && *p != ',') {
+	    if (*p == ';') {
+		while (*++p == ' ' || *p == '\t')
+		    ;
+		if ((*p == 'q' || *p == 'Q') && p[1] == '=') {
+		    quality = strtod(p + 2, &endnum);
+		    p = endnum;
+		    continue;
+		}
+	    }
+	    p++;
+	}
+	if (((length == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+	     (length == 6 && strncasecmp(name, "x-gzip", 6) == 0) ||
+	     (length == 1 && *name == '*')) && quality > 0.0)
+	    return 1;
+    }
+    return 0;
+}
+
+static z_stream *
+http_compress_start(void)
+{
+    z_stream		*zs;
+
+    if ((zs = calloc(1, sizeof(z_stream))) == NULL)
+	return NULL;
+    /* window bits of 15, plus 16 to select the gzip format wrapper */
+    if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+	free(zs);
+	return NULL;
+    }
+    return zs;
+}
+
+static void
+http_compress_end(z_stream *zs)
+{
+    if (zs) {
+	deflateEnd(zs);
+	free(zs);
+    }
+}
+
+/*
+ * Compress the next part of a response body - returns all compressed
+ * output available so far, which may be empty in the middle of a stream
+ * (zlib buffers input internally), or NULL on failure.  When finishing,
+ * the remainder of the stream is flushed, including the gzip trailer.
+ */
+static sds
+http_compress(z_stream *zs, const char *data, size_t length, int finish)
+{
+    __uint64_t		start = uv_hrtime();
+    size_t		size, used = 0;
+    sds			output;
+    int			sts;
+
+    size = deflateBound(zs, length);
+    if ((output = sdsnewlen(SDS_NOINIT, size)) == NULL)
+	return NULL;
+    zs->next_in = (Bytef *)data;
+    zs->avail_in = length;
+    for (;;) {
+	zs->next_out = (Bytef *)output + used;
+	zs->avail_out = size - used;
+	sts = deflate(zs, finish ? Z_FINISH : Z_NO_FLUSH);
+	used = size - zs->avail_out;
+	if (sts == Z_STREAM_ERROR) {
+	    sdsfree(output);
+	    return NULL;
+	}
+	if (finish ? (sts == Z_STREAM_END) : (zs->avail_out != 0))
+	    break;
+	/* output space exhausted, double it and go again */
+	if ((output = sdsgrowzero(output, size * 2)) == NULL)
+	    return NULL;
+	size = sdslen(output);
+    }
+    output[used] = '\0';
+    sdssetlen(output, used);
+
+    if (http_metrics_map) {
+	uv_mutex_lock(&http_metrics_lock);
+	if (finish)
+	    mmv_inc_value(http_metrics_map,
+			http_metrics[HTTP_COMPRESS_RESPONSES], 1);
+	mmv_inc_value(http_metrics_map,
+			http_metrics[HTTP_COMPRESS_BYTES_IN], length);
+	mmv_inc_value(http_metrics_map,
+			http_metrics[HTTP_COMPRESS_BYTES_OUT], used);
+	mmv_inc_value(http_metrics_map,
+			http_metrics[HTTP_COMPRESS_TIME],
+			(uv_hrtime() - start) / 1000);
+	uv_mutex_unlock(&http_metrics_lock);
+    }
+    return output;
+}
+#endif
+
 static sds
 http_response_header(struct client *client, unsigned int length, http_code sts, http_flags flags)
 {
@@ -274,6 +414,15 @@ http_response_header(struct client *client, unsigned int length, http_code sts,
     if (!(flags & HTTP_FLAG_STREAMING))
 	header = sdscatfmt(header, "Content-Length: %u\r\n", length);
 
+    if ((flags & HTTP_FLAG_COMPRESS))
+	header = sdscatfmt(header, "Content-Encoding: %s\r\n", "gzip");
+
+#ifdef HAVE_ZLIB
+    /* caches must not hand one encoding to clients asking for another */
+    if (compress_responses && (flags & HTTP_FLAG_COMPRESSIBLE))
+	header = sdscatfmt(header, "Vary: %s\r\n", "Accept-Encoding");
+#endif
+
     header = sdscatfmt(header,
 		"Content-Type: %s%s\r\n"
 		"Date: %s\r\n\r\n",
@@ -287,14 +436,42 @@ http_response_header(struct client *client, unsigned int length, http_code sts,
     return header;
 }
 
+/*
+ * Send a complete response - type is the response content type, along
+ * with the request flags of the request being answered (in particular,
+ * HTTP_FLAG_GZIP if that request accepted a compressed response).
+ */
 void
 http_reply(struct client *client, sds message, http_code sts, http_flags type)
 {
     http_flags		flags = client->u.http.flags;
     char		length[32]; /* hex length */
     sds			buffer, suffix;
+#ifdef HAVE_ZLIB
+    sds			compressed;
+#endif
 
     if (flags & HTTP_FLAG_STREAMING) {
+#ifdef HAVE_ZLIB
+	if (flags & HTTP_FLAG_COMPRESS) {
+	    /* the final chunk completes the compressed stream */
+	    if (client->buffer != NULL) {
+		if (message != NULL) {
+		    client->buffer = sdscatsds(client->buffer, message);
+		    sdsfree(message);
+		}
+		message = client->buffer;
+		client->buffer = NULL;
+	    }
+	    compressed = http_compress(client->u.http.compress, message,
+				message ? sdslen(message) : 0, 1);
+	    http_compress_end(client->u.http.compress);
+	    client->u.http.compress = NULL;
+	    client->u.http.flags &= ~HTTP_FLAG_COMPRESS;
+	    sdsfree(message);
+	    message = compressed ? compressed : sdsempty();
+	}
+#endif
 	buffer = sdsempty();
 	if (client->buffer == NULL) {	/* no data currently accumulated */
 	    pmsprintf(length, sizeof(length), "%lX", (unsigned long)sdslen(message));
@@ -322,6 +499,20 @@ http_reply(struct client *client, sds message, http_code sts, http_flags type)
 	} else {
 	    suffix = sdsempty();
 	}
+#ifdef HAVE_ZLIB
+	if ((type & HTTP_FLAG_GZIP) && (type & HTTP_FLAG_COMPRESSIBLE) &&
+	    sdslen(suffix) >= compress_threshold) {
+	    z_stream	*zs = http_compress_start();
+
+	    if (zs && (compressed = http_compress(zs, suffix,
+						sdslen(suffix), 1)) != NULL) {
+		sdsfree(suffix);
+		suffix = compressed;
+		type |= HTTP_FLAG_COMPRESS;
+	    }
+	    http_compress_end(zs);
+	}
+#endif
 	buffer = http_response_header(client, sdslen(suffix), sts, type);
     }
 
@@ -382,12 +573,42 @@ http_transfer(struct client *client)
 	    if (!(flags & HTTP_FLAG_STREAMING)) {
 		/* send headers (no content length) and initial content */
 		flags |= HTTP_FLAG_STREAMING;
+#ifdef HAVE_ZLIB
+		if ((flags & HTTP_FLAG_GZIP) &&
+		    (flags & HTTP_FLAG_COMPRESSIBLE) &&
+		    (client->u.http.compress = http_compress_start()) != NULL)
+		    flags |= HTTP_FLAG_COMPRESS;
+#endif
 		buffer = http_response_header(client, 0, HTTP_STATUS_OK, flags);
 		client->u.http.flags = flags;
 	    } else {
 		/* headers already sent, send the next chunk of content */
 		buffer = sdsempty();
 	    }
+#ifdef HAVE_ZLIB
+	    if (flags & HTTP_FLAG_COMPRESS) {
+		suffix = http_compress(client->u.http.compress, client->buffer,
+					sdslen(client->buffer), 0);
+		sdsfree(client->buffer);
+		client->buffer = NULL;
+		if (suffix == NULL) {
+		    sdsfree(buffer);
+		    client_close(client);
+		    return;
+		}
+		/* zlib may hold all of this input back, in which case */
+		/* there is no chunk - an empty one would end the body */
+		if (sdslen(suffix) == 0) {
+		    sdsfree(suffix);
+		    if (sdslen(buffer) == 0)
+			sdsfree(buffer);
+		    else
+			client_write(client, buffer, NULL);
+		    return;
+		}
+		client->buffer = suffix;
+	    }
+#endif
 	    /* prepend a chunked transfer encoding message length (hex) */
 	    buffer = sdscatprintf(buffer, "%lX\r\n", (unsigned long)sdslen(client->buffer));
 	    suffix = sdscatfmt(client->buffer, "\r\n");
@@ -419,6 +640,7 @@ http_client_release(struct client *client)
     if (servlet && servlet->on_release)
 	servlet->on_release(client);
     client->u.http.privdata = NULL;
+    client->u.http.flags &= ~HTTP_FLAG_GZIP;	/* negotiated per request */
 
     if (client->u.http.headers) {
 	dictRelease(client->u.http.headers);
@@ -664,6 +886,12 @@ on_header_value(http_parser *request, const char *offset, size_t length)
 	    client->u.http.parser.status_code = HTTP_STATUS_UNAUTHORIZED;
 	}
     }
+#ifdef HAVE_ZLIB
+    /* compressed responses, if the client supports them */
+    else if (compress_responses &&
+	strcasecmp(field, "Accept-Encoding") == 0 && http_accept_gzip(value))
+	client->u.http.flags |= HTTP_FLAG_GZIP;
+#endif
 
     return 0;
 }
@@ -736,6 +964,9 @@ on_http_client_close(struct client *client)
 	fprintf(stderr, "HTTP client close (client=%p)\n", client);
 
     http_client_release(client);
+#ifdef HAVE_ZLIB
+    http_compress_end(client->u.http.compress);
+#endif
     memset(&client->u.http, 0, sizeof(client->u.http));
 }
 
@@ -811,6 +1042,54 @@ setup:
     servlet->setup(proxy);
 }
 
+#ifdef HAVE_ZLIB
+static void
+http_metrics_init(struct proxy *proxy)
+{
+    mmv_registry_t	*registry;
+    pmInDom		noindom = MMV_INDOM_NULL;
+    pmUnits		countunits = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE);
+    pmUnits		byteunits = MMV_UNITS(1,0,0,PM_SPACE_BYTE,0,0);
+    pmUnits		timeunits = MMV_UNITS(0,1,0,0,PM_TIME_USEC,0);
+    void		*map;
+
+    if ((registry = proxy->metrics[METRICS_HTTP]) == NULL)
+	return;
+
+    mmv_stats_add_metric(registry, "compress.responses",
+		HTTP_COMPRESS_RESPONSES,
+		MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, noindom,
+		"HTTP responses sent with gzip content encoding", NULL);
+    mmv_stats_add_metric(registry, "compress.bytes.in",
+		HTTP_COMPRESS_BYTES_IN,
+		MMV_TYPE_U64, MMV_SEM_COUNTER, byteunits, noindom,
+		"HTTP response body bytes before compression", NULL);
+    mmv_stats_add_metric(registry, "compress.bytes.out",
+		HTTP_COMPRESS_BYTES_OUT,
+		MMV_TYPE_U64, MMV_SEM_COUNTER, byteunits, noindom,
+		"HTTP response body bytes after compression", NULL);
+    mmv_stats_add_metric(registry, "compress.time",
+		HTTP_COMPRESS_TIME,
+		MMV_TYPE_U64, MMV_SEM_COUNTER, timeunits, noindom,
+		"Time spent compressing HTTP response bodies", NULL);
+
+    if ((map = mmv_stats_start(registry)) == NULL) {
+	fprintf(stderr, "%s: http instrumentation disabled\n",
+			pmGetProgname());
+	return;
+    }
+    http_metrics[HTTP_COMPRESS_RESPONSES] =
+		mmv_lookup_value_desc(map, "compress.responses", NULL);
+    http_metrics[HTTP_COMPRESS_BYTES_IN] =
+		mmv_lookup_value_desc(map, "compress.bytes.in", NULL);
+    http_metrics[HTTP_COMPRESS_BYTES_OUT] =
+		mmv_lookup_value_desc(map, "compress.bytes.out", NULL);
+    http_metrics[HTTP_COMPRESS_TIME] =
+		mmv_lookup_value_desc(map, "compress.time", NULL);
+    http_metrics_map = map;
+}
+#endif
+
 void
 setup_http_module(struct proxy *proxy)
 {
@@ -825,6 +1104,20 @@ setup_http_module(struct proxy *proxy)
     if (chunked_transfer_size < smallest_buffer_size)
 	chunked_transfer_size = smallest_buffer_size;
 
+#ifdef HAVE_ZLIB
+    if ((option = pmIniFileLookup(config, "pmproxy", "compress")) != NULL)
+	compress_responses = (strcmp(option, "true") == 0);
+    else
+	compress_responses = 1;
+    if ((option = pmIniFileLookup(config, "pmproxy", "compressmin")) != NULL)
+	compress_threshold = atoi(option);
+    else
+	compress_threshold = DEFAULT_COMPRESS_SIZE;
+
+    uv_mutex_init(&http_metrics_lock);
+    http_metrics_init(proxy);
+#endif
+
     register_servlet(proxy, &pmseries_servlet);
     register_servlet(proxy, &pmwebapi_servlet);
 }
@@ -837,5 +1130,8 @@ close_http_module(struct proxy *proxy)
     for (servlet = proxy->servlets; servlet != NULL; servlet = servlet->next)
 	servlet->close(proxy);
 
+#ifdef HAVE_ZLIB
+    http_metrics_map = NULL;
+#endif
     proxymetrics_close(proxy, METRICS_HTTP);
 }
@@ -42,7 +42,8 @@ typedef enum http_flags {
     HTTP_FLAG_GIF	= (1<<8),
     HTTP_FLAG_UTF8	= (1<<10),
     HTTP_FLAG_UTF16	= (1<<11),
-    HTTP_FLAG_COMPRESS	= (1<<14),
+    HTTP_FLAG_GZIP	= (1<<12),	/* client accepts gzip encoding */
+    HTTP_FLAG_COMPRESS	= (1<<14),	/* response body is compressed */
     HTTP_FLAG_STREAMING	= (1<<15),
     /* maximum 16 for server.h */
 } http_flags;
@@ -47,6 +47,23 @@ typedef enum server_metric {
     NUM_SERVER_METRIC
 } server_metric;
 
+typedef enum http_metric {
+    HTTP_COMPRESS_RESPONSES,
+    HTTP_COMPRESS_BYTES_IN,
+    HTTP_COMPRESS_BYTES_OUT,
+    HTTP_COMPRESS_TIME,
+    NUM_HTTP_METRIC
+} http_metric;
+
+typedef enum webgroup_metric {
+    WEBGROUP_REQUESTS,
+    WEBGROUP_ACTIVE,
+    WEBGROUP_QUEUED,
+    WEBGROUP_QUEUETIME,
+    WEBGROUP_WORKTIME,
+    NUM_WEBGROUP_METRIC
+} webgroup_metric;
+
 typedef struct stream_write_baton {
     uv_write_t		writer;
     uv_buf_t		buffer[2];
@@ -95,6 +112,7 @@ typedef struct http_client {
     sds			realm;		/* optional Basic Auth realm */
     void		*privdata;	/* private HTTP parsing state */
     void		*data;		/* opaque servlet information */
+    void		*compress;	/* streaming response compression */
     unsigned int	type : 16;	/* HTTP response content type */
     unsigned int	flags : 16;	/* request status flags field */
 } http_client;
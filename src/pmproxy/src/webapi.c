@@ -37,9 +37,15 @@ typedef struct pmWebRestCommand {
 } pmWebRestCommand;
 
 typedef struct pmWebGroupBaton {
+    uv_work_t		work;		/* worker thread request */
+    struct pmWebGroupBaton *next;	/* next request on this context */
+    struct pmWebGroupBaton *after;	/* next request from this client */
     struct client	*client;
     pmWebRestKey	restkey;
     sds			context;
+    sds			queue;		/* context queued on, if any */
+    sds			origin;		/* client key for webclients */
+    dict		*params;	/* request parameters, once submitted */
     dict		*labels;
     sds			suffix;		/* response trailer (stack) */
     sds			clientid;	/* user-supplied identifier */
@@ -47,12 +53,20 @@ typedef struct pmWebGroupBaton {
     sds			password;	/* from basic auth header */
     unsigned int	times : 1;
     unsigned int	compat : 1;
+    unsigned int	done : 1;	/* worker finished, reply ready */
     unsigned int	numpmids;
     unsigned int	numvsets;
     unsigned int	numinsts;
     unsigned int	numindoms;
     pmID		pmid;		/* metric currently being processed */
     pmInDom		indom;		/* indom currently being processed */
+    sds			buffer;		/* response body built by worker */
+    sds			reply;		/* response, sent from event loop */
+    http_code		code;
+    http_flags		flags;		/* request flags, response type */
+    __uint64_t		received;	/* uv_hrtime of request submission */
+    __uint64_t		started;	/* uv_hrtime worker thread started */
+    __uint64_t		finished;	/* uv_hrtime worker thread finished */
 } pmWebGroupBaton;
 
 static pmWebRestCommand commands[] = {
@@ -77,6 +91,28 @@ static sds PARAM_NAMES, PARAM_NAME, PARAM_PMIDS, PARAM_PMID,
 	   PARAM_INDOM, PARAM_EXPR, PARAM_VALUE, PARAM_TIMES,
 	   PARAM_CONTEXT, PARAM_CLIENT;
 
+/*
+ * Requests run on libuv worker threads, but at most one at a time for
+ * any one context (PMAPI contexts are not safe for concurrent use) - a
+ * request for a busy context waits here, chained from the one running.
+ * Keyed by context identifier, the value is the most recent request.
+ * Only accessed from the event loop thread.
+ */
+static dict *webqueues;
+
+/*
+ * Responses must be sent in the order each client sent its requests,
+ * but requests on different contexts (or none) complete in any order.
+ * Keyed by client address, the value is the oldest request from that
+ * client whose response has not been sent, chained through ->after.
+ * Only accessed from the event loop thread.
+ */
+static dict *webclients;
+
+static void *webmetrics;
+static pmAtomValue *webvalues[NUM_WEBGROUP_METRIC];
+static unsigned int webactive, webqueued;
+
 
 static pmWebRestKey
 pmwebapi_lookup_restkey(sds url, unsigned int *compat, sds *context)
@@ -112,23 +148,40 @@ pmwebapi_lookup_restkey(sds url, unsigned int *compat, sds *context)
 }
 
 static void
-pmwebapi_data_release(struct client *client)
+pmwebapi_free_baton(pmWebGroupBaton *baton)
 {
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)client->u.http.data;
-
-    if (pmDebugOptions.http)
-	fprintf(stderr, "%s: baton %p for client %p\n", "pmwebapi_data_release",
-			baton, client);
-
     sdsfree(baton->suffix);
     sdsfree(baton->context);
+    sdsfree(baton->queue);
+    sdsfree(baton->origin);
     sdsfree(baton->clientid);
+    sdsfree(baton->username);
+    sdsfree(baton->password);
+    sdsfree(baton->buffer);
+    sdsfree(baton->reply);
+    if (baton->params)
+	dictRelease(baton->params);
     if (baton->labels)
 	dictRelease(baton->labels);
     memset(baton, 0, sizeof(*baton));
     free(baton);
 }
 
+static void
+pmwebapi_data_release(struct client *client)
+{
+    pmWebGroupBaton	*baton = (pmWebGroupBaton *)client->u.http.data;
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "%s: baton %p for client %p\n", "pmwebapi_data_release",
+			baton, client);
+
+    /* submitted requests are detached, and freed when completed */
+    if (baton)
+	pmwebapi_free_baton(baton);
+    client->u.http.data = NULL;
+}
+
 static void
 pmwebapi_set_context(pmWebGroupBaton *baton, sds context)
 {
@@ -140,16 +193,37 @@ pmwebapi_set_context(pmWebGroupBaton *baton, sds context)
     }
 }
 
+/*
+ * Worker threads build the response in the baton and never touch the
+ * client, which may be parsing its next request on the event loop.
+ */
+static sds
+pmwebapi_get_buffer(pmWebGroupBaton *baton)
+{
+    sds		buffer = baton->buffer;
+
+    baton->buffer = NULL;
+    if (buffer == NULL)
+	buffer = sdsempty();
+    return buffer;
+}
+
+static void
+pmwebapi_set_buffer(pmWebGroupBaton *baton, sds buffer, http_flags flags)
+{
+    baton->buffer = buffer;
+    baton->flags |= flags;
+}
+
 static void
 on_pmwebapi_context(sds context, pmWebSource *source, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    struct client	*client = baton->client;
     sds			result;
 
     pmwebapi_set_context(baton, context);
 
-    result = http_get_buffer(client);
+    result = pmwebapi_get_buffer(baton);
     result = sdscatfmt(result, "{\"context\":%S", context);
     baton->suffix = json_push_suffix(baton->suffix, JSON_FLAG_OBJECT);
     if (baton->compat == 0) {
@@ -163,17 +237,15 @@ on_pmwebapi_context(sds context, pmWebSource *source, void *arg)
 	else
 	    result = sdscatlen(result, "{}", 2);
     }
-    http_set_buffer(client, result, HTTP_FLAG_JSON);
-    http_transfer(client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
 }
 
 static void
 on_pmwebapi_metric(sds context, pmWebMetric *metric, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    struct client	*client = baton->client;
     char		pmidstr[20], indomstr[20];
-    sds			quoted, result = http_get_buffer(client);
+    sds			quoted, result = pmwebapi_get_buffer(baton);
     int			first = (baton->numpmids == 0);
 
     pmwebapi_set_context(baton, context);
@@ -228,15 +300,14 @@ on_pmwebapi_metric(sds context, pmWebMetric *metric, void *arg)
     }
     result = sdscatlen(result, "}", 1);
 
-    http_set_buffer(client, result, HTTP_FLAG_JSON);
-    http_transfer(client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
 }
 
 static int
 on_pmwebapi_fetch(sds context, pmWebResult *fetch, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			result = http_get_buffer(baton->client);
+    sds			result = pmwebapi_get_buffer(baton);
 
     pmwebapi_set_context(baton, context);
 
@@ -255,8 +326,7 @@ on_pmwebapi_fetch(sds context, pmWebResult *fetch, void *arg)
     result = sdscatfmt(result, "\"values\":[");
     baton->suffix = json_push_suffix(baton->suffix, JSON_FLAG_ARRAY);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
     return 0;
 }
 
@@ -264,7 +334,7 @@ static int
 on_pmwebapi_fetch_values(sds context, pmWebValueSet *valueset, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			result = http_get_buffer(baton->client);
+    sds			result = pmwebapi_get_buffer(baton);
     char		pmidstr[20];
 
     pmwebapi_set_context(baton, context);
@@ -295,8 +365,7 @@ on_pmwebapi_fetch_values(sds context, pmWebValueSet *valueset, void *arg)
 				valueset->name);
     baton->suffix = json_push_suffix(baton->suffix, JSON_FLAG_ARRAY);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
     return 0;
 }
 
@@ -304,7 +373,7 @@ static int
 on_pmwebapi_fetch_value(sds context, pmWebValue *value, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			result = http_get_buffer(baton->client);
+    sds			result = pmwebapi_get_buffer(baton);
 
     assert(value->pmid == baton->pmid);
     pmwebapi_set_context(baton, context);
@@ -323,8 +392,7 @@ on_pmwebapi_fetch_value(sds context, pmWebValue *value, void *arg)
 				sdslen(value->value) ? value->value : "null");
     }
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
     return 0;
 }
 
@@ -333,7 +401,7 @@ on_pmwebapi_indom(sds context, pmWebInDom *indom, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
     char		indomstr[20];
-    sds			quoted, result = http_get_buffer(baton->client);
+    sds			quoted, result = pmwebapi_get_buffer(baton);
 
     pmwebapi_set_context(baton, context);
 
@@ -375,8 +443,7 @@ on_pmwebapi_indom(sds context, pmWebInDom *indom, void *arg)
     result = sdscatfmt(result, ",\"instances\":[");
     baton->suffix = json_push_suffix(baton->suffix, JSON_FLAG_ARRAY);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
     return 0;
 }
 
@@ -384,7 +451,7 @@ static int
 on_pmwebapi_instance(sds context, pmWebInstance *instance, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			quoted, result = http_get_buffer(baton->client);
+    sds			quoted, result = pmwebapi_get_buffer(baton);
 
     assert(instance->indom == baton->indom);
     pmwebapi_set_context(baton, context);
@@ -403,8 +470,7 @@ on_pmwebapi_instance(sds context, pmWebInstance *instance, void *arg)
 	result = sdscatlen(result, "{}", 2);
     result = sdscatlen(result, "}", 1);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
     return 0;
 }
 
@@ -412,7 +478,7 @@ static int
 on_pmwebapi_children(sds context, pmWebChildren *children, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    sds			result = http_get_buffer(baton->client);
+    sds			result = pmwebapi_get_buffer(baton);
     unsigned int	i;
 
     pmwebapi_set_context(baton, context);
@@ -432,8 +498,7 @@ on_pmwebapi_children(sds context, pmWebChildren *children, void *arg)
 			    sdscatfmt(result, "\"%S\"", children->nonleaf[i]);
     result = sdscatlen(result, "]", 1);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_JSON);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_JSON);
     return 0;
 }
 
@@ -460,7 +525,7 @@ on_pmwebapi_scrape(sds context, pmWebScrape *scrape, void *arg)
     if (open_metrics_type_check(metric->type) < 0)
 	return 0;
 
-    result = http_get_buffer(baton->client);
+    result = pmwebapi_get_buffer(baton);
     name = open_metrics_name(metric->name, baton->compat);
 
     if (metric->pmid != baton->pmid)	/* new metric */
@@ -518,8 +583,7 @@ value:
     sdsfree(semantics);
     sdsfree(name);
 
-    http_set_buffer(baton->client, result, HTTP_FLAG_TEXT);
-    http_transfer(baton->client);
+    pmwebapi_set_buffer(baton, result, HTTP_FLAG_TEXT);
     return 0;
 }
 
@@ -568,9 +632,11 @@ on_pmwebapi_check(sds context, pmWebAccess *access,
 	    return 1;
 	}
 	if ((access->username != NULL &&
-		sdscmp(access->username, client->u.http.username) != 0) ||
+		(baton->username == NULL ||
+		 sdscmp(access->username, baton->username) != 0)) ||
 	    (access->password != NULL &&
-		(sdscmp(access->password, client->u.http.password) != 0))) {
+		(baton->password == NULL ||
+		 sdscmp(access->password, baton->password) != 0))) {
 	    *message = sdsnew("authentication failed");
 	    *status = -EPERM;
 	    return 1;
@@ -584,14 +650,13 @@ static void
 on_pmwebapi_done(sds context, int status, sds message, void *arg)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)arg;
-    struct client	*client = (struct client *)baton->client;
     sds			quoted, msg;
-    http_flags		flags = client->u.http.flags;
+    http_flags		flags = baton->flags;
     http_code		code;
 
     if (pmDebugOptions.series)
 	fprintf(stderr, "%s: client=%p (sts=%d,msg=%s)\n", "on_pmwebapi_done",
-			client, status, message ? message : "");
+			baton->client, status, message ? message : "");
 
     if (status == 0) {
 	code = HTTP_STATUS_OK;
@@ -607,16 +672,21 @@ on_pmwebapi_done(sds context, int status, sds message, void *arg)
 	    }
 	}
 	baton->suffix = NULL;
+	if ((quoted = baton->buffer) != NULL) {	/* prepend response body */
+	    baton->buffer = NULL;
+	    quoted = sdscatsds(quoted, msg);
+	    sdsfree(msg);
+	    msg = quoted;
+	}
     } else {
+	/* on error, any partial response body is discarded */
 	flags |= HTTP_FLAG_JSON;	/* all errors in JSON */
-	if (((code = client->u.http.parser.status_code)) == 0) {
-	    if (status == -EPERM)
-		code = HTTP_STATUS_FORBIDDEN;
-	    else if (status == -EAGAIN)
-		code = HTTP_STATUS_UNAUTHORIZED;
-	    else
-		code = HTTP_STATUS_BAD_REQUEST;
-	}
+	if (status == -EPERM)
+	    code = HTTP_STATUS_FORBIDDEN;
+	else if (status == -EAGAIN)
+	    code = HTTP_STATUS_UNAUTHORIZED;
+	else
+	    code = HTTP_STATUS_BAD_REQUEST;
 	if (message)
 	    quoted = json_string(message);
 	else
@@ -629,8 +699,10 @@ on_pmwebapi_done(sds context, int status, sds message, void *arg)
 	sdsfree(quoted);
     }
 
-    http_reply(client, msg, code, flags);
-    client_put(client);
+    /* response is sent, and client released, from the event loop */
+    baton->reply = msg;
+    baton->code = code;
+    baton->flags = flags;
 }
 
 static pmWebGroupSettings pmwebapi_settings = {
@@ -790,152 +862,268 @@ pmwebapi_request_body(struct client *client, const char *content, size_t length)
     return 0;
 }
 
+/*
+ * Worker thread - issue the PMWEBAPI(3) command, which may block in
+ * PMAPI calls on a slow or unresponsive pmcd; all response data is
+ * built in the baton, and sent later from the event loop thread.
+ */
 static void
-pmwebapi_fetch(uv_work_t *work)
-{
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
-
-    pmWebGroupFetch(&pmwebapi_settings, baton->context, params, baton);
-}
-
-static void
-pmwebapi_indom(uv_work_t *work)
+pmwebapi_work(uv_work_t *work)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
+    struct dict		*params = baton->params;
+    sds			context = baton->context;
 
-    pmWebGroupInDom(&pmwebapi_settings, baton->context, params, baton);
-}
+    baton->started = uv_hrtime();
 
-static void
-pmwebapi_metric(uv_work_t *work)
-{
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
+    switch (baton->restkey) {
+    case RESTKEY_CONTEXT:
+	pmWebGroupContext(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_PROFILE:
+	pmWebGroupProfile(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_METRIC:
+	pmWebGroupMetric(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_FETCH:
+	pmWebGroupFetch(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_INDOM:
+	pmWebGroupInDom(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_CHILD:
+	pmWebGroupChildren(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_STORE:
+	pmWebGroupStore(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_DERIVE:
+	pmWebGroupDerive(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_SCRAPE:
+	pmWebGroupScrape(&pmwebapi_settings, context, params, baton);
+	break;
+    case RESTKEY_NONE:
+    default:
+	break;
+    }
 
-    pmWebGroupMetric(&pmwebapi_settings, baton->context, params, baton);
+    baton->finished = uv_hrtime();
 }
 
 static void
-pmwebapi_children(uv_work_t *work)
-{
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
-
-    pmWebGroupChildren(&pmwebapi_settings, baton->context, params, baton);
-}
-
+pmwebapi_work_done(uv_work_t *, int);
 
 static void
-pmwebapi_store(uv_work_t *work)
+pmwebapi_metrics_update(void)
 {
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
-
-    pmWebGroupStore(&pmwebapi_settings, baton->context, params, baton);
+    if (webmetrics == NULL)
+	return;
+    mmv_set_value(webmetrics, webvalues[WEBGROUP_ACTIVE], webactive);
+    mmv_set_value(webmetrics, webvalues[WEBGROUP_QUEUED], webqueued);
 }
 
 static void
-pmwebapi_derive(uv_work_t *work)
+pmwebapi_queue_work(struct client *client, pmWebGroupBaton *baton)
 {
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
-
-    pmWebGroupDerive(&pmwebapi_settings, baton->context, params, baton);
+    uv_queue_work(client->proxy->events, &baton->work,
+			pmwebapi_work, pmwebapi_work_done);
 }
 
+/*
+ * Event loop thread - send the responses of completed requests from
+ * this client, oldest first, stopping at the first one still running.
+ */
 static void
-pmwebapi_profile(uv_work_t *work)
+pmwebapi_send_replies(sds origin)
 {
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
+    pmWebGroupBaton	*baton, *after;
+    dictEntry		*entry;
+    struct client	*client;
 
-    pmWebGroupProfile(&pmwebapi_settings, baton->context, params, baton);
-}
+    if ((entry = dictFind(webclients, origin)) == NULL)
+	return;
+    baton = (pmWebGroupBaton *)dictGetVal(entry);
+    if (!baton->done)
+	return;
+    origin = sdsdup(origin);
+    dictDelete(webclients, origin);
+
+    do {
+	after = baton->after;
+	client = baton->client;
+	if (baton->reply) {
+	    http_reply(client, baton->reply, baton->code, baton->flags);
+	    baton->reply = NULL;	/* now owned by http_reply */
+	}
+	client_put(client);
+	pmwebapi_free_baton(baton);
+    } while ((baton = after) != NULL && baton->done);
 
-static void
-pmwebapi_scrape(uv_work_t *work)
-{
-    pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
-    
-    pmWebGroupScrape(&pmwebapi_settings, baton->context, params, baton);
+    if (baton != NULL)
+	dictAdd(webclients, origin, baton);
+    sdsfree(origin);
 }
 
+/*
+ * Event loop thread - a request has been completed by a worker thread,
+ * start the next request waiting on the same context (if any), then
+ * send this response unless an earlier one from the client is pending.
+ */
 static void
-pmwebapi_context(uv_work_t *work)
+pmwebapi_work_done(uv_work_t *work, int status)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)work->data;
-    struct dict		*params = baton->client->u.http.parameters;
+    pmWebGroupBaton	*next = baton->next;
 
-    pmWebGroupContext(&pmwebapi_settings, baton->context, params, baton);
-}
+    if (pmDebugOptions.http)
+	fprintf(stderr, "%s: baton %p for client %p (sts=%d)\n",
+			"pmwebapi_work_done", baton, baton->client, status);
+
+    baton->done = 1;
+    webactive--;
+    if (webmetrics) {
+	mmv_inc_value(webmetrics, webvalues[WEBGROUP_QUEUETIME],
+			(baton->started - baton->received) / 1000);
+	mmv_inc_value(webmetrics, webvalues[WEBGROUP_WORKTIME],
+			(baton->finished - baton->started) / 1000);
+    }
 
-static void
-pmwebapi_work_done(uv_work_t *work, int status)
-{
-    (void)status;
-    free(work);
+    if (next != NULL) {
+	webqueued--;
+	webactive++;
+	pmwebapi_queue_work(next->client, next);
+    } else if (baton->queue != NULL) {
+	dictDelete(webqueues, baton->queue);	/* context now idle */
+    }
+    pmwebapi_metrics_update();
+    pmwebapi_send_replies(baton->origin);
 }
 
 static int
 pmwebapi_request_done(struct client *client)
 {
     pmWebGroupBaton	*baton = (pmWebGroupBaton *)client->u.http.data;
-    uv_loop_t		*loop = client->proxy->events;
-    uv_work_t		*work;
+    pmWebGroupBaton	*last;
+    dictEntry		*entry;
 
     /* fail early if something has already gone wrong */
     if (client->u.http.parser.status_code != 0)
 	return 1;
 
-    if ((work = (uv_work_t *)calloc(1, sizeof(uv_work_t))) == NULL)
+    if (baton->restkey == RESTKEY_NONE) {
+	client->u.http.parser.status_code = HTTP_STATUS_BAD_REQUEST;
 	return 1;
-    work->data = baton;
+    }
+
+    /*
+     * Detach the request from the client, which may start parsing its
+     * next request (releasing per-request state) while this one runs.
+     * The request flags (response type, accepted encodings) are kept
+     * with the request, for its response.
+     */
+    client->u.http.data = NULL;
+    baton->params = client->u.http.parameters;
+    client->u.http.parameters = NULL;
+    if (client->u.http.username)
+	baton->username = sdsdup(client->u.http.username);
+    if (client->u.http.password)
+	baton->password = sdsdup(client->u.http.password);
+    baton->flags = client->u.http.flags &
+			~(HTTP_FLAG_STREAMING | HTTP_FLAG_COMPRESS);
+    baton->work.data = baton;
+    baton->received = uv_hrtime();
 
     /* take a reference on the client to prevent freeing races on close */
     client_get(client);
 
-    /* submit command request to worker thread */
-    switch (baton->restkey) {
-    case RESTKEY_CONTEXT:
-	uv_queue_work(loop, work, pmwebapi_context, pmwebapi_work_done);
-	break;
-    case RESTKEY_PROFILE:
-	uv_queue_work(loop, work, pmwebapi_profile, pmwebapi_work_done);
-	break;
-    case RESTKEY_METRIC:
-	uv_queue_work(loop, work, pmwebapi_metric, pmwebapi_work_done);
-	break;
-    case RESTKEY_FETCH:
-	uv_queue_work(loop, work, pmwebapi_fetch, pmwebapi_work_done);
-	break;
-    case RESTKEY_INDOM:
-	uv_queue_work(loop, work, pmwebapi_indom, pmwebapi_work_done);
-	break;
-    case RESTKEY_CHILD:
-	uv_queue_work(loop, work, pmwebapi_children, pmwebapi_work_done);
-	break;
-    case RESTKEY_STORE:
-	uv_queue_work(loop, work, pmwebapi_store, pmwebapi_work_done);
-	break;
-    case RESTKEY_DERIVE:
-	uv_queue_work(loop, work, pmwebapi_derive, pmwebapi_work_done);
-	break;
-    case RESTKEY_SCRAPE:
-	uv_queue_work(loop, work, pmwebapi_scrape, pmwebapi_work_done);
-	break;
-    case RESTKEY_NONE:
-    default:
-	client->u.http.parser.status_code = HTTP_STATUS_BAD_REQUEST;
-	client_put(client);
-	free(work);
-	return 1;
+    if (webmetrics)
+	mmv_inc_value(webmetrics, webvalues[WEBGROUP_REQUESTS], 1);
+
+    /* responses are sent in request order, after any before them */
+    baton->origin = sdscatprintf(sdsempty(), "%p", client);
+    if ((entry = dictFind(webclients, baton->origin)) != NULL) {
+	for (last = (pmWebGroupBaton *)dictGetVal(entry); last->after; )
+	    last = last->after;
+	last->after = baton;
+    } else {
+	dictAdd(webclients, baton->origin, baton);
     }
+
+    /* requests for an existing context wait for any before them */
+    if (baton->context != NULL) {
+	baton->queue = sdsdup(baton->context);
+	if ((entry = dictFind(webqueues, baton->queue)) != NULL) {
+	    last = (pmWebGroupBaton *)dictGetVal(entry);
+	    last->next = baton;
+	    dictSetVal(webqueues, entry, baton);
+	    webqueued++;
+	    pmwebapi_metrics_update();
+	    return 0;
+	}
+	dictAdd(webqueues, baton->queue, baton);
+    }
+
+    /* submit command request to worker thread */
+    webactive++;
+    pmwebapi_metrics_update();
+    pmwebapi_queue_work(client, baton);
     return 0;
 }
 
+static void
+pmwebapi_metrics_setup(mmv_registry_t *registry)
+{
+    pmInDom		noindom = MMV_INDOM_NULL;
+    pmUnits		nounits = MMV_UNITS(0,0,0,0,0,0);
+    pmUnits		countunits = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE);
+    pmUnits		timeunits = MMV_UNITS(0,1,0,0,PM_TIME_USEC,0);
+    void		*map;
+
+    if (registry == NULL)
+	return;
+
+    mmv_stats_add_metric(registry, "requests.total", WEBGROUP_REQUESTS,
+		MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, noindom,
+		"PMWEBAPI requests submitted to worker threads",
+		"Count of REST API requests handed to the worker thread pool "
+		"for PMAPI processing, since pmproxy started.");
+    mmv_stats_add_metric(registry, "requests.active", WEBGROUP_ACTIVE,
+		MMV_TYPE_U32, MMV_SEM_INSTANT, nounits, noindom,
+		"PMWEBAPI requests in the worker thread pool",
+		"Number of REST API requests currently queued for, or being\n"
+		"processed by, the worker thread pool.");
+    mmv_stats_add_metric(registry, "requests.queued", WEBGROUP_QUEUED,
+		MMV_TYPE_U32, MMV_SEM_INSTANT, nounits, noindom,
+		"PMWEBAPI requests waiting on a busy context",
+		"Number of REST API requests waiting for an earlier request on\n"
+		"the same context to complete - requests on any one context are\n"
+		"processed one at a time, in order of arrival.");
+    mmv_stats_add_metric(registry, "requests.queuetime", WEBGROUP_QUEUETIME,
+		MMV_TYPE_U64, MMV_SEM_COUNTER, timeunits, noindom,
+		"Time PMWEBAPI requests spent waiting to start",
+		"Cumulative time from submission of REST API requests until a\n"
+		"worker thread started processing them.");
+    mmv_stats_add_metric(registry, "requests.worktime", WEBGROUP_WORKTIME,
+		MMV_TYPE_U64, MMV_SEM_COUNTER, timeunits, noindom,
+		"Time PMWEBAPI requests spent in worker threads",
+		"Cumulative time spent processing REST API requests on worker\n"
+		"threads, including all time blocked waiting on pmcd.");
+
+    if ((map = mmv_stats_start(registry)) == NULL) {
+	fprintf(stderr, "%s: webgroup instrumentation disabled\n",
+			pmGetProgname());
+	return;
+    }
+    webvalues[WEBGROUP_REQUESTS] = mmv_lookup_value_desc(map, "requests.total", NULL);
+    webvalues[WEBGROUP_ACTIVE] = mmv_lookup_value_desc(map, "requests.active", NULL);
+    webvalues[WEBGROUP_QUEUED] = mmv_lookup_value_desc(map, "requests.queued", NULL);
+    webvalues[WEBGROUP_QUEUETIME] = mmv_lookup_value_desc(map, "requests.queuetime", NULL);
+    webvalues[WEBGROUP_WORKTIME] = mmv_lookup_value_desc(map, "requests.worktime", NULL);
+    webmetrics = map;
+}
+
 static void
 pmwebapi_servlet_setup(struct proxy *proxy)
 {
@@ -956,6 +1144,10 @@ pmwebapi_servlet_setup(struct proxy *proxy)
     pmWebGroupSetEventLoop(&pmwebapi_settings.module, proxy->events);
     pmWebGroupSetConfiguration(&pmwebapi_settings.module, proxy->config);
     pmWebGroupSetMetricRegistry(&pmwebapi_settings.module, metric_registry);
+
+    webqueues = dictCreate(&sdsKeyDictCallBacks, NULL);
+    webclients = dictCreate(&sdsKeyDictCallBacks, NULL);
+    pmwebapi_metrics_setup(metric_registry);
 }
 
 static void
@@ -963,6 +1155,16 @@ pmwebapi_servlet_close(struct proxy *proxy)
 {
     pmWebGroupClose(&pmwebapi_settings.module);
     proxymetrics_close(proxy, METRICS_WEBGROUP);
+    webmetrics = NULL;
+
+    if (webqueues) {
+	dictRelease(webqueues);
+	webqueues = NULL;
+    }
+    if (webclients) {
+	dictRelease(webclients);
+	webclients = NULL;
+    }
 
     sdsfree(PARAM_NAMES);
     sdsfree(PARAM_NAME);
@@ -457,6 +457,9 @@ main(int argc, char **argv)
 
     pmview->init();
     liveGroup->init(pmtime->liveInterval(), pmtime->livePosition());
+    // Fetch from all live hosts in parallel, a laggard misses its sample
+    liveGroup->setConcurrentFetch(true,
+			(int)(pmtimevalToReal(pmtime->liveInterval()) * 1000.0));
     archiveGroup->init(pmtime->archiveInterval(), pmtime->archivePosition());
     console->post("Phase2 user interface setup complete");
 
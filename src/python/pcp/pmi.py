@@ -113,6 +113,14 @@ LIBPCP_IMPORT.pmiGetHandle.argtypes = [c_char_p, c_char_p]
 LIBPCP_IMPORT.pmiPutValueHandle.restype = c_int
 LIBPCP_IMPORT.pmiPutValueHandle.argtypes = [c_int, c_char_p]
 
+LIBPCP_IMPORT.pmiPutValues.restype = c_int
+LIBPCP_IMPORT.pmiPutValues.argtypes = [
+    c_int, POINTER(c_char_p), POINTER(c_char_p), POINTER(c_char_p)]
+
+LIBPCP_IMPORT.pmiPutValueHandles.restype = c_int
+LIBPCP_IMPORT.pmiPutValueHandles.argtypes = [
+    c_int, POINTER(c_int), POINTER(c_char_p)]
+
 LIBPCP_IMPORT.pmiWrite.restype = c_int
 LIBPCP_IMPORT.pmiWrite.argtypes = [c_int, c_int]
 
@@ -328,6 +336,43 @@ class pmiLogImport(object):
             raise pmiErr(status)
         return status
 
+    @staticmethod
+    def _encode(value):
+        if value is None or isinstance(value, bytes):
+            return value
+        return value.encode('utf-8')
+
+    def pmiPutValues(self, names, insts, values):
+        """PMI - add values for a list of metric-instance pairs at once """
+        status = LIBPCP_IMPORT.pmiUseContext(self._ctx)
+        if status < 0:
+            raise pmiErr(status)
+        count = len(names)
+        if len(insts) != count or len(values) != count:
+            raise ValueError("names, insts and values differ in length")
+        c_names = (c_char_p * count)(*[self._encode(n) for n in names])
+        c_insts = (c_char_p * count)(*[self._encode(i) for i in insts])
+        c_values = (c_char_p * count)(*[self._encode(v) for v in values])
+        status = LIBPCP_IMPORT.pmiPutValues(count, c_names, c_insts, c_values)
+        if status < 0:
+            raise pmiErr(status)
+        return status
+
+    def pmiPutValueHandles(self, handles, values):
+        """PMI - add values for a list of metric-instance pairs via handles """
+        status = LIBPCP_IMPORT.pmiUseContext(self._ctx)
+        if status < 0:
+            raise pmiErr(status)
+        count = len(handles)
+        if len(values) != count:
+            raise ValueError("handles and values differ in length")
+        c_handles = (c_int * count)(*handles)
+        c_values = (c_char_p * count)(*[self._encode(v) for v in values])
+        status = LIBPCP_IMPORT.pmiPutValueHandles(count, c_handles, c_values)
+        if status < 0:
+            raise pmiErr(status)
+        return status
+
     def pmiWrite(self, sec, usec):
         """PMI - flush data to a Log Import archive """
         status = LIBPCP_IMPORT.pmiUseContext(self._ctx)